@@ -0,0 +1,78 @@
+#include "Bus.h"
+#include "Cpu.h"
+#include "FlatBus.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+// Instruction throughput of the CPU on a memory-heavy loop, against the full Game Boy bus and
+// against FlatBus. Build once with GBC_INLINE_BUS_ACCESS on and once with it off to see what
+// the inlined page-table path is worth. Usage: bus_access_bench [instructions]
+namespace {
+    // Copies 256 bytes from 0xC100 to 0xC200 with a running sum, forever:
+    //   LD HL,0xC100 / LD DE,0xC200 / loop: LD A,(HL+) / ADD A,B / LD B,A / LD (DE),A /
+    //   INC E / JR NZ,loop / JR start
+    const uint8_t PROGRAM[] = {
+        0x21, 0x00, 0xC1, 0x11, 0x00, 0xC2,
+        0x2A, 0x80, 0x47, 0x12, 0x1C, 0x20, 0xF9,
+        0x18, 0xF1,
+    };
+    const uint16_t PROGRAM_ADDRESS = 0xC000;
+
+    template <class BusType>
+    void load(BusType& bus) {
+        for (uint16_t i = 0; i < sizeof(PROGRAM); ++i) {
+            bus.write(static_cast<uint16_t>(PROGRAM_ADDRESS + i), PROGRAM[i]);
+        }
+        for (uint16_t i = 0; i < 0x100; ++i) {
+            bus.write(static_cast<uint16_t>(0xC100 + i), static_cast<uint8_t>(i * 7));
+        }
+    }
+
+    template <class BusType>
+    double run(BasicCpu<BusType>& cpu, uint64_t instructions) {
+        cpu.pc = PROGRAM_ADDRESS;
+        cpu.debug_trace_enabled_ = false;
+        cpu.idle_loop_skipping_enabled_ = false;
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < instructions; ++i) {
+            cpu.step();
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const char* label, double seconds, uint64_t instructions, uint8_t checksum) {
+        std::cout << label << ": " << instructions / seconds / 1e6 << " M instructions/s"
+            << " (checksum " << static_cast<int>(checksum) << ")" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t instructions = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50000000;
+    if (instructions == 0) instructions = 1;
+
+#ifdef GBC_INLINE_BUS_ACCESS
+    std::cout << "GBC_INLINE_BUS_ACCESS: on" << std::endl;
+#else
+    std::cout << "GBC_INLINE_BUS_ACCESS: off" << std::endl;
+#endif
+
+    auto bus = std::make_unique<Bus>();
+    Cpu cpu;
+    cpu.connectBus(bus.get());
+    load(*bus);
+    double seconds = run(cpu, instructions);
+    report("Bus", seconds, instructions, cpu.b());
+
+    auto flat_bus = std::make_unique<FlatBus>();
+    BasicCpu<FlatBus> flat_cpu;
+    flat_cpu.connectBus(flat_bus.get());
+    load(*flat_bus);
+    seconds = run(flat_cpu, instructions);
+    report("FlatBus", seconds, instructions, flat_cpu.b());
+    return 0;
+}
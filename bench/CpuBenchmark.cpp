@@ -0,0 +1,68 @@
+#include "Cpu.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Cpu instance creation / reset / copy throughput, as used by fuzzing and batch pools that
+// build many cores. Usage: cpu_bench [instances]
+namespace {
+    const double TARGET_NANOSECONDS_PER_INSTANCE = 1000.0;
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const char* label, double seconds, size_t count) {
+        double nanoseconds = seconds * 1e9 / count;
+        std::cout << label << ": " << nanoseconds << " ns each (" << count / seconds / 1e6 << " M/s)" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t instances = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    if (instances == 0) instances = 1;
+
+    // Raw storage so the timings cover only Cpu construction, not allocation.
+    std::unique_ptr<std::aligned_storage<sizeof(Cpu), alignof(Cpu)>::type[]> storage(
+        new std::aligned_storage<sizeof(Cpu), alignof(Cpu)>::type[instances]);
+    Cpu* pool = reinterpret_cast<Cpu*>(storage.get());
+
+    auto start = std::chrono::steady_clock::now();
+    new (&pool[0]) Cpu();
+    report("First construction (builds shared tables)", secondsSince(start), 1);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < instances; ++i) {
+        new (&pool[i]) Cpu();
+    }
+    double construct_seconds = secondsSince(start);
+    report("Construction", construct_seconds, instances);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < instances; ++i) {
+        pool[i].reset();
+    }
+    report("Reset", secondsSince(start), instances);
+
+    Cpu prototype;
+    prototype.pc = 0x0150;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < instances; ++i) {
+        pool[i] = prototype;
+    }
+    report("Copy from prototype", secondsSince(start), instances);
+
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < instances; ++i) checksum += pool[i].pc;
+
+    double nanoseconds = construct_seconds * 1e9 / instances;
+    std::cout << "sizeof(Cpu) = " << sizeof(Cpu) << " bytes, checksum " << checksum << std::endl;
+    std::cout << "Construction target " << TARGET_NANOSECONDS_PER_INSTANCE << " ns: "
+        << (nanoseconds < TARGET_NANOSECONDS_PER_INSTANCE ? "met" : "missed") << std::endl;
+    return 0;
+}
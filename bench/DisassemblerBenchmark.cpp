@@ -0,0 +1,72 @@
+#include "Disassembler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+// Whole-bank disassembly throughput. Usage: disassembler_bench [rom]
+// Without a ROM, a pseudo-random 16 KiB bank is used (every opcode, including CB and
+// invalid ones, shows up).
+namespace {
+    const size_t BANK_SIZE = 0x4000;
+    const double TARGET_INSTRUCTIONS_PER_SECOND = 50e6;
+    const double MIN_SECONDS = 1.0;
+
+    std::vector<uint8_t> randomBank() {
+        std::vector<uint8_t> bank(BANK_SIZE);
+        uint32_t state = 0x12345678;
+        for (uint8_t& byte : bank) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            byte = static_cast<uint8_t>(state);
+        }
+        return bank;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<uint8_t> data;
+    if (argc > 1) {
+        std::ifstream file(argv[1], std::ios::binary);
+        if (!file) {
+            std::cerr << "Error: Could not open ROM file: " << argv[1] << std::endl;
+            return 1;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    if (data.empty()) data = randomBank();
+
+    std::vector<Disassembler::Line> lines(BANK_SIZE);
+    std::vector<uint32_t> line_of_offset(BANK_SIZE);
+    size_t bank_count = (data.size() + BANK_SIZE - 1) / BANK_SIZE;
+
+    uint64_t instructions = 0;
+    uint64_t passes = 0;
+    auto start = std::chrono::steady_clock::now();
+    double seconds = 0.0;
+    do {
+        for (size_t bank = 0; bank < bank_count; ++bank) {
+            size_t offset = bank * BANK_SIZE;
+            size_t size = std::min(BANK_SIZE, data.size() - offset);
+            uint16_t base = static_cast<uint16_t>(bank == 0 ? 0x0000 : 0x4000);
+            instructions += Disassembler::disassembleRange(data.data() + offset, size, base,
+                nullptr, 0, lines.data(), line_of_offset.data());
+        }
+        ++passes;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < MIN_SECONDS);
+
+    double rate = instructions / seconds;
+    std::cout << "Disassembled " << instructions << " instructions (" << passes << " passes over "
+        << bank_count << " bank(s)) in " << seconds << " s" << std::endl;
+    std::cout << "Throughput: " << rate / 1e6 << " M instructions/s (target "
+        << TARGET_INSTRUCTIONS_PER_SECOND / 1e6 << " M: " << (rate >= TARGET_INSTRUCTIONS_PER_SECOND ? "met" : "missed")
+        << ")" << std::endl;
+    std::cout << "Sample: " << lines[0].text << std::endl;
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "SaveState.h"
+#include "Cartridge.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Cost of run-ahead per host frame: one real frame, a state save, N ahead frames (the last one
+// drawn) and a state load, against the 16 ms of a 60 Hz display. Runs the given ROM, or a
+// built-in program that keeps VRAM, cartridge RAM, SCX, a sound channel and two interrupts busy.
+// Usage: run_ahead_bench [rom] [ahead frames] [host frames]
+namespace {
+    const double BUDGET_MILLISECONDS = 16.0;
+
+    std::vector<uint8_t> builtInRom() {
+        std::vector<uint8_t> rom(0x8000, 0x00);
+        auto put = [&rom](uint16_t address, std::initializer_list<uint8_t> bytes) {
+            for (uint8_t byte : bytes) rom[address++] = byte;
+        };
+        // VBlank and timer handlers: INC (0xC000) / INC (0xC001) via A, then RETI.
+        put(0x0040, { 0xF5, 0xFA, 0x00, 0xC0, 0x3C, 0xEA, 0x00, 0xC0, 0xF1, 0xD9 });
+        put(0x0050, { 0xF5, 0xFA, 0x01, 0xC0, 0x3C, 0xEA, 0x01, 0xC0, 0xF1, 0xD9 });
+        put(0x0100, { 0x00, 0xC3, 0x50, 0x01 });
+        // Enable cartridge RAM, the timer, IE = VBlank | timer and sound, then EI; HL = 0x8000,
+        // DE = 0xA000, B = 1. Loop: B = B rotated ^ B + 0x3B, written to (HL+), (DE), SCX, NR12
+        // and NR14; HL wraps within VRAM.
+        put(0x0150, {
+            0x3E, 0x0A, 0xEA, 0x00, 0x00, 0x3E, 0x05, 0xE0, 0x07, 0x3E, 0x05, 0xE0, 0xFF,
+            0x3E, 0x80, 0xE0, 0x26, 0xFB, 0x21, 0x00, 0x80, 0x11, 0x00, 0xA0, 0x06, 0x01,
+            0x78, 0x07, 0xA8, 0xC6, 0x3B, 0x47, 0x22, 0x12, 0x1C, 0xE0, 0x43, 0xE0, 0x12,
+            0xE0, 0x14, 0x7C, 0xE6, 0x1F, 0xF6, 0x80, 0x67, 0x18, 0xE9 });
+        rom[0x0147] = 0x03; // MBC1 + RAM + battery
+        rom[0x0149] = 0x02; // 8 KiB RAM
+        return rom;
+    }
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int ahead = argc > 2 ? std::atoi(argv[2]) : 2;
+    int host_frames = argc > 3 ? std::atoi(argv[3]) : 600;
+    if (ahead < 1) ahead = 1;
+    if (host_frames < 1) host_frames = 1;
+
+    auto cartridge = std::make_shared<Cartridge>();
+    bool loaded = argc > 1 ? cartridge->loadRom(argv[1]) : cartridge->loadTestData(builtInRom());
+    if (!loaded) return 1;
+
+    auto bus = std::make_unique<Bus>();
+    bus->connectCartridge(cartridge);
+    bus->reset();
+    Cpu cpu;
+    cpu.connectBus(bus.get());
+    cpu.reset();
+    cpu.debug_trace_enabled_ = false;
+    auto state = std::make_unique<MachineState>();
+
+    auto runFrame = [&](bool draw) {
+        bus->ppu().setSkipDrawing(!draw);
+        bus->ppu().consumeFrameReady();
+        while (!bus->ppu().consumeFrameReady()) cpu.step();
+        bus->apu().endFrame();
+    };
+
+    double frame_ms = 0.0, save_ms = 0.0, load_ms = 0.0, worst_ms = 0.0;
+    auto total_start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < host_frames; ++frame) {
+        auto host_frame_start = std::chrono::steady_clock::now();
+        runFrame(false);
+
+        auto start = std::chrono::steady_clock::now();
+        state->save(cpu, *bus);
+        save_ms += millisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        bus->apu().setMuted(true);
+        for (int i = 0; i < ahead; ++i) runFrame(i + 1 == ahead);
+        bus->apu().setMuted(false);
+        frame_ms += millisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        state->load(cpu, *bus);
+        load_ms += millisecondsSince(start);
+
+        double host_frame_ms = millisecondsSince(host_frame_start);
+        if (host_frame_ms > worst_ms) worst_ms = host_frame_ms;
+    }
+    double total_ms = millisecondsSince(total_start);
+
+    std::cout << "Run-ahead " << ahead << " frame(s), " << host_frames << " host frames" << std::endl;
+    std::cout << "Save: " << save_ms * 1000.0 / host_frames << " us  Load: " << load_ms * 1000.0 / host_frames
+        << " us  Ahead frame: " << frame_ms / (host_frames * ahead) << " ms" << std::endl;
+    std::cout << "Host frame: " << total_ms / host_frames << " ms average, " << worst_ms << " ms worst ("
+        << (worst_ms <= BUDGET_MILLISECONDS ? "within" : "over") << " the " << BUDGET_MILLISECONDS << " ms budget)" << std::endl;
+    return 0;
+}
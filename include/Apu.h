@@ -0,0 +1,124 @@
+#ifndef APU_H
+#define APU_H
+
+#include <cstdint>
+#include <array>
+#include <vector>
+
+#include "BlipBuffer.h"
+#include "SpscRingBuffer.h"
+
+class Bus;
+
+// Sound controller (0xFF10-0xFF3F): two square channels (the first with a frequency sweep), a
+// wave channel and a noise channel. Nothing runs per CPU step: the channels are caught up to the
+// current time only when a sound register is accessed or a frame's samples are handed to the
+// output, and each waveform edge is emitted as a band-limited delta rather than point-sampled.
+class Apu {
+public:
+    static const uint32_t CLOCK_RATE = 4194304;
+    static const uint32_t FRAME_SEQUENCER_PERIOD = 8192; // 512 Hz
+    static const int VOLUME_SCALE = 48;
+
+    struct Channel {
+        bool enabled;
+        bool dac_enabled;
+        bool length_enabled;
+        uint16_t length_counter;
+        uint16_t frequency;
+        uint8_t duty;
+        uint8_t position;
+        uint8_t volume;
+        uint8_t envelope_period;
+        uint8_t envelope_timer;
+        bool envelope_increase;
+        uint8_t output;
+        uint64_t next_step_time;
+    };
+
+    struct State {
+        std::array<uint8_t, 0x20> registers;
+        std::array<uint8_t, 16> wave_ram;
+        std::array<Channel, 4> channels;
+        bool power;
+        uint16_t lfsr;
+        uint16_t sweep_shadow_frequency;
+        uint8_t sweep_timer;
+        bool sweep_enabled;
+        uint8_t frame_sequencer_step;
+        uint64_t next_frame_sequencer_time;
+        uint64_t last_time;
+        uint64_t frame_start_time;
+        int mix_left;
+        int mix_right;
+    };
+
+    explicit Apu(Bus& bus);
+
+    void reset();
+    uint8_t read(uint16_t address);
+    void write(uint16_t address, uint8_t value);
+
+    // Interleaved stereo samples are pushed into `ring` at the end of every frame. With no ring
+    // connected the channel state is still tracked (NR52 reads stay exact) but nothing is synthesized.
+    void setOutput(SpscRingBuffer<int16_t>* ring, int sample_rate);
+    // Resampling rate for the frame in progress; dynamic rate control moves it by fractions of
+    // a percent around the device rate without disturbing the band-limited buffers.
+    void setOutputRate(double sample_rate);
+    void endFrame();
+
+    // While muted, frames are emulated without synthesizing or outputting samples and the
+    // band-limited buffers are left exactly as they were, so muting, running ahead and loading
+    // the state saved before continues the sound without a seam.
+    void setMuted(bool muted) { muted_ = muted; }
+
+    // The output buffers are not part of the state (see setMuted).
+    void saveState(State& state) const;
+    void loadState(const State& state);
+
+    uint64_t droppedSamples() const { return dropped_samples_; }
+
+private:
+    void catchUp();
+    void runUntil(uint64_t time);
+    void runChannel(int index, uint64_t end);
+    void stepWaveform(int index);
+    uint32_t channelPeriod(int index) const;
+    void clockFrameSequencer();
+    void clockSweep();
+    uint16_t sweepCalculation();
+    void trigger(int index);
+    void powerOff();
+    void updateOutputs(uint64_t time);
+
+    Bus& bus_;
+
+    // Raw register values for 0xFF10-0xFF2F (read back through READ_MASKS).
+    std::array<uint8_t, 0x20> registers_;
+    std::array<uint8_t, 16> wave_ram_;
+    std::array<Channel, 4> channels_;
+    bool power_;
+
+    uint16_t lfsr_;
+    uint16_t sweep_shadow_frequency_;
+    uint8_t sweep_timer_;
+    bool sweep_enabled_;
+
+    uint8_t frame_sequencer_step_;
+    uint64_t next_frame_sequencer_time_;
+    uint64_t last_time_;
+
+    bool synthesizing() const { return output_ && !muted_; }
+
+    SpscRingBuffer<int16_t>* output_;
+    bool muted_;
+    BlipBuffer blip_left_;
+    BlipBuffer blip_right_;
+    std::vector<int16_t> frame_samples_;
+    uint64_t frame_start_time_;
+    int mix_left_;
+    int mix_right_;
+    uint64_t dropped_samples_;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef AUDIO_OUTPUT_H
+#define AUDIO_OUTPUT_H
+
+#include <cstdint>
+#include <atomic>
+
+#include "SpscRingBuffer.h"
+
+typedef uint32_t SDL_AudioDeviceID;
+
+// SDL audio device fed from a lock-free ring of interleaved stereo int16 samples. The emulation
+// thread is the only producer and the SDL callback the only consumer, so neither side locks.
+class AudioOutput {
+public:
+    static const int DEFAULT_SAMPLE_RATE = 48000;
+    static const int DEFAULT_DEVICE_FRAMES = 256; // ~5 ms; the pacer keeps ~25 ms queued on top
+    static const size_t RING_CAPACITY = 8192; // samples (4096 stereo frames, ~85 ms at 48 kHz)
+
+    AudioOutput();
+    ~AudioOutput();
+
+    bool open(int sample_rate = DEFAULT_SAMPLE_RATE, int device_frames = DEFAULT_DEVICE_FRAMES);
+    void close();
+    bool isOpen() const { return device_ != 0; }
+
+    SpscRingBuffer<int16_t>& ring() { return ring_; }
+    int sampleRate() const { return sample_rate_; }
+    uint64_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+private:
+    static void audioCallback(void* userdata, uint8_t* stream, int len);
+    void fill(int16_t* out, size_t samples);
+
+    SDL_AudioDeviceID device_;
+    int sample_rate_;
+    SpscRingBuffer<int16_t> ring_;
+    int16_t last_left_;
+    int16_t last_right_;
+    std::atomic<uint64_t> underruns_;
+};
+
+#endif
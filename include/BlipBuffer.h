@@ -0,0 +1,56 @@
+#ifndef BLIP_BUFFER_H
+#define BLIP_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+// Band-limited step synthesis. Callers describe a waveform purely as amplitude changes
+// ("deltas") stamped with a clock time; each delta is added as a windowed-sinc step at its exact
+// fractional sample position, so square and noise edges produce no aliasing no matter how high
+// the channel frequency. Reading integrates the deltas into samples and removes DC.
+class BlipBuffer {
+public:
+    static const int PHASE_BITS = 5;
+    static const int PHASES = 1 << PHASE_BITS;
+    static const int KERNEL_WIDTH = 16;
+    static const int KERNEL_BITS = 15;
+
+    explicit BlipBuffer(int max_samples_per_frame = 4096);
+
+    // The ratio may change between frames (used for dynamic rate control).
+    void setRates(double clock_rate, double sample_rate);
+    void clear();
+
+    // `clock_time` is relative to the start of the current frame.
+    void addDelta(uint32_t clock_time, int32_t delta) {
+        uint64_t position = offset_ + static_cast<uint64_t>(clock_time) * factor_;
+        uint32_t index = static_cast<uint32_t>(position >> FRAC_BITS);
+        if (index + KERNEL_WIDTH > buffer_.size()) return;
+        const int16_t* kernel = KERNEL[(position >> (FRAC_BITS - PHASE_BITS)) & (PHASES - 1)];
+        int64_t* out = &buffer_[index];
+        for (int i = 0; i < KERNEL_WIDTH; ++i) {
+            out[i] += static_cast<int64_t>(kernel[i]) * delta;
+        }
+    }
+
+    // Ends the frame at `clock_duration`; samples up to that point become readable.
+    void endFrame(uint32_t clock_duration);
+    int samplesAvailable() const { return static_cast<int>(offset_ >> FRAC_BITS); }
+    // Writes up to `max_count` samples to out[0], out[stride], ... and returns the count written.
+    int readSamples(int16_t* out, int max_count, int stride);
+
+private:
+    static const int FRAC_BITS = 32;
+    static int16_t KERNEL[PHASES][KERNEL_WIDTH];
+    static void buildKernel();
+
+    std::vector<int64_t> buffer_;
+    uint64_t factor_;
+    // Position of the current frame start in samples, with FRAC_BITS fractional bits.
+    uint64_t offset_;
+    int64_t integrator_;
+    double highpass_previous_in_;
+    double highpass_previous_out_;
+};
+
+#endif
@@ -5,23 +5,230 @@
 #include <array>   
 #include <memory>  
 
-class Cartridge;
+#include "Scheduler.h"
+#include "Timer.h"
+#include "Serial.h"
+#include "Ppu.h"
+#include "Apu.h"
+#include "Joypad.h"
+#include "Cartridge.h"
 
 class Bus {
 public:
+    static const uint8_t INTERRUPT_VBLANK = 0x01;
+    static const uint8_t INTERRUPT_LCD_STAT = 0x02;
+    static const uint8_t INTERRUPT_TIMER = 0x04;
+    static const uint8_t INTERRUPT_SERIAL = 0x08;
+    static const uint8_t INTERRUPT_JOYPAD = 0x10;
+
+    // WRAM bank 0 is at 0xC000; 0xD000 shows bank 1, or in CGB mode the bank SVBK selects (1-7).
+    static const uint16_t WRAM_BANK_SIZE = 0x1000;
+    static const int WRAM_BANKS = 8;
+    // How long a KEY1 speed switch stops the CPU, in base T-cycles.
+    static const uint32_t SPEED_SWITCH_CYCLES = 8200;
+    // OAM DMA owns the bus for 160 M-cycles (CPU T-cycles, so half as long in double speed).
+    static const uint32_t OAM_DMA_CYCLES = 640;
+    // VRAM DMA stops the CPU for 8 us per 16-byte block at either speed (base T-cycles).
+    static const uint32_t VRAM_DMA_BLOCK_CYCLES = 32;
+    static const uint16_t VRAM_DMA_BLOCK_SIZE = 0x10;
+
+    // CGB VRAM DMA (HDMA1-5, 0xFF51-0xFF55): the addresses of the next block and the blocks
+    // left. General-purpose DMA copies everything at once; HBlank DMA one block per HBlank.
+    struct VramDma {
+        uint16_t source;
+        uint16_t destination; // VRAM offset, 0x0000-0x1FF0
+        uint8_t blocks_left;
+        bool hblank_active;
+    };
+
+    // Everything behind the bus that a save state needs: RAM and its bank, the interrupt,
+    // speed and DMA registers, the scheduler (which holds the CPU speed), the timer, serial port,
+    // PPU, APU and joypad, and the connected cartridge's RAM and bank registers.
+    struct State {
+        std::array<uint8_t, WRAM_BANK_SIZE * WRAM_BANKS> wram;
+        uint8_t wram_bank;
+        bool speed_switch_armed;
+        uint8_t oam_dma_source;
+        bool oam_dma_active;
+        uint64_t oam_dma_start;
+        VramDma vram_dma;
+        std::array<uint8_t, 127> hram;
+        uint8_t interrupt_enable;
+        uint8_t interrupt_flag;
+        Scheduler scheduler;
+        Timer::State timer;
+        Serial::State serial;
+        Ppu::State ppu;
+        Apu::State apu;
+        Joypad::State joypad;
+        Cartridge::State cartridge;
+    };
+
     Bus();
 
+    // The page tables point into the cartridge's ROM/RAM, so after reloading a connected
+    // cartridge call connectCartridge() or reset() again. CGB mode (banked WRAM/VRAM and
+    // double speed) follows the cartridge header.
     void connectCartridge(const std::shared_ptr<Cartridge>& cartridge);
+    void reset();
+    // Only valid with the same cartridge connected. Debugger write generations advance on load
+    // rather than being restored.
+    void saveState(State& state) const;
+    void loadState(const State& state);
+
+    // Reads of ROM, VRAM, external RAM and WRAM go through a table of 256-byte pages as
+    // currently mapped, and WRAM writes through a second one (switching a ROM, RAM, VRAM or
+    // WRAM bank just repoints the affected pages); everything else (I/O, VRAM and
+    // OAM writes, MBC registers, unmapped pages) takes the out-of-line slow path. While an OAM
+    // DMA runs, the pages of the bus it reads from (VRAM's, or the external one) are empty, so
+    // the slow path can apply the bus conflicts. With GBC_INLINE_BUS_ACCESS the fast path is
+    // inlined into the CPU's opcode handlers; without it read()/write() are plain out-of-line
+    // calls, which is easier to break on in a debugger.
+#ifdef GBC_INLINE_BUS_ACCESS
+    uint8_t read(uint16_t address) {
+        const uint8_t* page = read_pages_[address >> 8];
+        return page ? page[address & 0xFF] : readSlow(address);
+    }
+    void write(uint16_t address, uint8_t value) {
+        uint8_t* page = wram_write_pages_[address >> 8];
+        if (page) {
+            idle_poll_dirty_ = true;
+            page[address & 0xFF] = value;
+            wram_write_generation_++;
+            return;
+        }
+        writeSlow(address, value);
+    }
+#else
     uint8_t read(uint16_t address);
     void write(uint16_t address, uint8_t value);
-    void reset();
+#endif
+
+    // Advances the clock by `cycles` CPU T-cycles and runs any scheduler events that fell due.
+    void tick(uint32_t cycles) {
+        scheduler_.advanceCpu(cycles);
+        if (scheduler_.now() >= scheduler_.nextEventTime()) {
+            dispatchDueEvents();
+        }
+    }
+    // Jumps the clock to the next scheduled event and runs it. Returns the CPU cycles skipped.
+    uint64_t skipToNextEvent();
+    // Jumps the clock to scheduler time `time` (capped at the next scheduled event). Returns
+    // the CPU cycles skipped.
+    uint64_t skipTo(uint64_t time);
+    // The STOP instruction. In CGB mode with a speed switch armed through KEY1 it toggles
+    // double speed, resets DIV and runs the clock through the switch delay; returns the CPU
+    // cycles that took (0 when there was nothing to switch).
+    uint64_t stop();
+    // CPU cycles the CPU has been held since the last call (VRAM DMA), for its cycle count.
+    uint64_t takeStallCycles() { uint64_t cycles = stall_cycles_; stall_cycles_ = 0; return cycles; }
+
+    // Idle-loop support. Between beginIdlePollWindow() calls the bus remembers whether anything
+    // was written and the earliest time at which a register that was read can change without
+    // a scheduler event (LY, STAT, DIV, TIMA). Components report that time when read.
+    void beginIdlePollWindow() { idle_poll_dirty_ = false; idle_poll_deadline_ = Scheduler::NEVER; }
+    bool idlePollWindowDirty() const { return idle_poll_dirty_; }
+    uint64_t idlePollDeadline() const { return idle_poll_deadline_; }
+    void notePolledValueChangeTime(uint64_t time) {
+        if (time < idle_poll_deadline_) idle_poll_deadline_ = time;
+    }
+
+    void requestInterrupt(uint8_t mask) { interrupt_flag_register_ |= mask; }
+    void acknowledgeInterrupt(uint8_t mask) { interrupt_flag_register_ &= static_cast<uint8_t>(~mask); }
+    uint8_t pendingInterrupts() const { return interrupt_enable_register_ & interrupt_flag_register_ & 0x1F; }
+    uint8_t interruptEnable() const { return interrupt_enable_register_; }
+    uint8_t interruptFlag() const { return interrupt_flag_register_; }
+
+    // Changes whenever the RAM region containing `address` is written (0 for ROM and I/O).
+    // Lets the debugger's disassembly cache notice self-modifying or freshly copied code.
+    uint64_t ramWriteGeneration(uint16_t address) const;
+    Cartridge* cartridge() const { return cartridge_.get(); }
+    bool cgbMode() const { return cgb_mode_; }
+    bool doubleSpeed() const { return scheduler_.doubleSpeed(); }
+    uint8_t wramBank() const { return wram_bank_; }
+
+    // Debugger access. peekSpan returns the storage backing `address` (ROM bank, VRAM bank,
+    // external RAM, WRAM bank, OAM, HRAM) and how many bytes from there are contiguous, or null for I/O and
+    // unmapped addresses. peekRange copies `size` bytes starting at `address` (wrapping at 0xFFFF) using
+    // those spans, falling back to per-byte reads elsewhere; it leaves emulated state untouched.
+    const uint8_t* peekSpan(uint16_t address, size_t& out_length) const;
+    void peekRange(uint16_t address, uint8_t* out, size_t size);
+
+    Scheduler& scheduler() { return scheduler_; }
+    Ppu& ppu() { return ppu_; }
+    Apu& apu() { return apu_; }
+    Joypad& joypad() { return joypad_; }
+    Serial& serial() { return serial_; }
 
 private:
+    void dispatchDueEvents();
+    // Runs the clock `cycles` base T-cycles ahead, dispatching events as they fall due, with
+    // the CPU held. Returns the CPU cycles that took. Not for event handlers (holdClockFor).
+    uint64_t runClockFor(uint64_t cycles);
+    // Has the running dispatch loop hold the clock `cycles` base T-cycles longer, once the
+    // events already due have run.
+    void holdClockFor(uint64_t cycles);
+    void startOamDma(uint8_t value);
+    void onOamDmaEndEvent();
+    // Whether an OAM DMA in progress takes `address` away from the CPU: OAM, and the bus the
+    // DMA is reading from. HRAM and I/O are never affected.
+    bool oamDmaBlocks(uint16_t address) const;
+    uint8_t readDuringOamDma(uint16_t address) const;
+    void writeVramDmaRegister(uint16_t address, uint8_t value);
+    void copyVramDmaBlocks(uint8_t blocks);
+    void scheduleVramDma();
+    void onVramDmaHBlankEvent();
+    // Passes `length` bytes from `source` on to `sink(data, count)`: straight from the backing
+    // arrays where the source is plain memory, byte by byte through the slow path elsewhere.
+    template <class Sink>
+    void dmaRead(uint16_t source, size_t length, Sink&& sink);
+    uint8_t readSlow(uint16_t address);
+    void writeSlow(uint16_t address, uint8_t value);
+    void mapVramPages();
+    void mapWramPages();
+    // Re-reads the cartridge's current ROM/RAM banks into the page table (after MBC writes).
+    void mapCartridgePages();
+    // All of the above (each leaving out the pages an OAM DMA blocks).
+    void mapPages();
+    void mapReadPages(const uint8_t* span, size_t length, uint8_t first_page, uint8_t page_count);
+    // Offset into wram_ of 0xC000-0xFDFF (echo RAM included) with the current bank.
+    size_t wramIndex(uint16_t address) const {
+        uint16_t offset = (address - 0xC000) & 0x1FFF;
+        return offset < WRAM_BANK_SIZE ? offset : wram_bank_ * WRAM_BANK_SIZE + (offset - WRAM_BANK_SIZE);
+    }
+    uint8_t readIo(uint16_t address);
+    uint8_t peekByte(uint16_t address);
+    void writeIo(uint16_t address, uint8_t value);
+
     std::shared_ptr<Cartridge> cartridge_;
-    std::array<uint8_t, 8 * 1024> wram_;
+    std::array<uint8_t, WRAM_BANK_SIZE * WRAM_BANKS> wram_;
     std::array<uint8_t, 127> hram_;
+    bool cgb_mode_ = false;
+    uint8_t wram_bank_ = 1;           // bank at 0xD000 (SVBK, with 0 selecting 1)
+    bool speed_switch_armed_ = false; // KEY1 bit 0
+    uint8_t oam_dma_source_ = 0xFF;   // DMA (0xFF46)
+    bool oam_dma_active_ = false;
+    uint64_t oam_dma_start_ = 0;      // CPU clock
+    VramDma vram_dma_{};
+    uint64_t stall_cycles_ = 0;
+    uint64_t hold_until_ = 0;         // scheduler time (see holdClockFor)
+    std::array<const uint8_t*, 0x100> read_pages_;
+    std::array<uint8_t*, 0x100> wram_write_pages_;
     uint8_t interrupt_enable_register_;
+    uint8_t interrupt_flag_register_;
+
+    uint64_t wram_write_generation_ = 0;
+    uint64_t hram_write_generation_ = 0;
+
+    bool idle_poll_dirty_ = true;
+    uint64_t idle_poll_deadline_ = Scheduler::NEVER;
 
+    Scheduler scheduler_;
+    Timer timer_;
+    Serial serial_;
+    Ppu ppu_;
+    Apu apu_;
+    Joypad joypad_;
 };
 
-#endif 
\ No newline at end of file
+#endif 
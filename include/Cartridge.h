@@ -3,20 +3,72 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include <cstdint>
 
 class Cartridge {
 public:
+    enum class MbcType { None, Mbc1, Mbc3, Mbc5 };
+
+    static const uint32_t ROM_BANK_SIZE = 0x4000;
+    static const uint32_t RAM_BANK_SIZE = 0x2000;
+
+    // Everything but the ROM. `ram` keeps its capacity between saves, so saving into the same
+    // State again does not allocate.
+    struct State {
+        std::vector<uint8_t> ram;
+        bool ram_enabled = false;
+        uint16_t rom_bank = 1;
+        uint8_t bank_high = 0;
+        bool mbc1_ram_mode = false;
+    };
+
     Cartridge();
     bool loadRom(const std::string& rom_path);
     bool loadTestData(const std::vector<uint8_t>& data);
     
+    // 0x0000-0x7FFF (ROM) and 0xA000-0xBFFF (external RAM).
     uint8_t read(uint16_t address) const;
+    // Memory bank controller registers (0x0000-0x7FFF) and external RAM.
+    void write(uint16_t address, uint8_t value);
     
     const std::vector<uint8_t>& getRomData() const;
+    // The ROM image never changes after loading, so other threads may keep a reference to it.
+    std::shared_ptr<const std::vector<uint8_t>> sharedRomData() const { return rom_data_; }
+
+    MbcType mbcType() const { return mbc_type_; }
+    // Header byte 0x143 has bit 7 set: the game uses CGB features (CGB-only or dual mode).
+    bool cgbSupport() const { return cgb_support_; }
+    // ROM bank currently mapped at `address` (0x0000-0x7FFF).
+    uint32_t romBankAt(uint16_t address) const;
+    uint32_t romBankCount() const;
+    uint8_t ramBank() const;
+    // Incremented on every external RAM write.
+    uint64_t ramWriteGeneration() const { return ram_write_generation_; }
+    const std::vector<uint8_t>& ramData() const { return ram_data_; }
+    // Backing storage behind `address` as currently mapped (ROM bank or enabled external RAM)
+    // and how many bytes from there are contiguous, or null where read() would return 0xFF.
+    const uint8_t* peekSpan(uint16_t address, size_t& out_length) const;
+
+    // Only valid with the same ROM loaded. The bus must remap its pages after a load.
+    void saveState(State& state) const;
+    void loadState(const State& state);
 
 private:
-    std::vector<uint8_t> rom_data_;
+    void parseHeader();
+    bool isRamAccessible() const { return ram_enabled_ && !ram_data_.empty(); }
+    size_t ramOffset(uint16_t address) const;
+
+    std::shared_ptr<std::vector<uint8_t>> rom_data_;
+    std::vector<uint8_t> ram_data_;
+    MbcType mbc_type_;
+    bool cgb_support_;
+
+    bool ram_enabled_;
+    uint16_t rom_bank_;      // MBC1: low 5 bits; MBC3: 7 bits; MBC5: 9 bits
+    uint8_t bank_high_;      // MBC1 upper bits / RAM bank, MBC3/5 RAM bank
+    bool mbc1_ram_mode_;
+    uint64_t ram_write_generation_;
 };
 
-#endif 
\ No newline at end of file
+#endif 
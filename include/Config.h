@@ -5,6 +5,10 @@
 
 namespace Config {
     const std::string DEFAULT_ROM_PATH = "H:\\1tb HDD 2013\\Games\\Gameboy\\Tetris Blast.gb";
+    // Where the UI writes recorded movies (replay with --headless <rom> --movie <file>).
+    const std::string MOVIE_PATH = "recording.gbm";
+    // Frame captures (one numbered subdirectory per session) and screenshots go here.
+    const std::string CAPTURE_DIRECTORY = "captures";
 }
 
 #endif
\ No newline at end of file
@@ -3,14 +3,24 @@
 
 #include <cstdint>
 #include <string>
-#include <vector>
-#include <memory> 
 
-class Bus;
-class Instruction;
+#include "CpuFwd.h"
 #include "Utils.h" 
-
-class Cpu {
+#include "Profiler.h"
+#include "Disassembler.h"
+
+template <class CpuType> class Instruction;
+template <class CpuType> struct InstructionSet;
+
+// The CPU holds only registers, flags and debug/profiling state plus pointers to its bus and
+// to the shared opcode handler tables, so it is trivially copyable and constructing or
+// copying one allocates nothing.
+//
+// BusType is fixed at compile time so the handlers' memory accesses are direct (inlinable)
+// calls: Cpu (BasicCpu<Bus>) runs against the full Game Boy bus, BasicCpu<FlatBus> against
+// 64 KiB of plain RAM for CPU-only tests. Both are instantiated in Cpu.cpp.
+template <class BusType>
+class BasicCpu {
 public:
     
     uint16_t af, bc, de, hl;
@@ -58,41 +68,110 @@ public:
     uint8_t  debug_last_opcode_;
     uint16_t debug_last_operand_;
     uint8_t  debug_last_instr_length_;
-    std::string debug_last_disassembled_;
-    std::vector<uint8_t> debug_last_instr_bytes_;
+    char debug_last_disassembled_[Disassembler::MNEMONIC_BUFFER_SIZE];
+    uint8_t debug_last_instr_bytes_[3]; // debug_last_instr_length_ of them are valid
+
+    // When false, step() skips disassembling every executed instruction into
+    // debug_last_disassembled_ / debug_last_instr_bytes_ (free-running mode).
+    bool debug_trace_enabled_;
 
     uint64_t cycles_elapsed_total_;
     uint8_t  current_instruction_cycles_;
 
-    Cpu();
-    ~Cpu();
-
-    void connectBus(const std::shared_ptr<Bus>& bus_ptr);
+    bool ime_;
+    // EI enables interrupts only after the following instruction: 2 = set by EI, 1 = armed.
+    uint8_t ime_enable_delay_;
+    bool halted_;
+    // HALT with IME=0 and an interrupt already pending fails to advance PC past the next opcode.
+    bool halt_bug_;
+
+    // Counters live outside the Cpu (they are most of its would-be size); null when profiling
+    // is off. The owner attaches one and must keep it alive while attached.
+    CpuProfiler* profiler_;
+
+    // Runtime detection of side-effect-free polling loops (e.g. LD A,(nn) / CP / JR NZ).
+    // When a short backward branch returns to the same head with identical registers, no bus
+    // writes and only reads whose values cannot change before a known time, the clock jumps
+    // to that time instead of spinning. Disabled while single-step tracing.
+    bool idle_loop_skipping_enabled_;
+    static const uint8_t IDLE_LOOP_MAX_BYTES = 32;
+    static const uint8_t IDLE_LOOP_MAX_INSTRUCTIONS = 8;
+
+    BasicCpu();
+
+    // The bus is owned by the caller and must outlive the Cpu (or the next connectBus).
+    void connectBus(BusType* bus);
+    // Registers as the boot ROM leaves them: the DMG values, or the CGB ones (A = 0x11, which
+    // games check for) when the connected bus is in CGB mode.
     void reset();
+    // A saved state is just a copy of the Cpu. Loading one keeps this Cpu's bus, profiler and
+    // trace / idle-loop-skipping settings.
+    void loadState(const BasicCpu& saved);
     void step();
 
-    uint8_t busRead(uint16_t address);
-    void busWrite(uint16_t address, uint8_t data);
-
-    Instruction* getCbInstruction(uint8_t cb_opcode);
-    std::string disassembleInstructionAt(uint16_t address, uint8_t& out_length, std::vector<uint8_t>& out_bytes);
-    
-    void updateFlags_INC8(uint8_t old_val, uint8_t new_val);
-    
-    void updateFlags_DEC8(uint8_t old_val, uint8_t new_val);
-    
-    void updateFlags_ADD8(uint8_t val_a, uint8_t val_b, uint16_t result_wide);
-    
-    void updateFlags_SUB8(uint8_t val_a, uint8_t val_b, uint8_t result_byte);
-    
-    void updateFlags_LOGIC8(uint8_t result_val, bool h_flag_val); 
+    uint8_t pendingInterrupts() const;
+
+    // Only valid with a bus connected; step() checks once so the per-access path does not.
+    uint8_t busRead(uint16_t address) { return bus_->read(address); }
+    void busWrite(uint16_t address, uint8_t data) { bus_->write(address, data); }
+
+    const Instruction<BasicCpu>* getCbInstruction(uint8_t cb_opcode) const;
+    // Called by conditional JR/JP/CALL/RET handlers when the condition holds.
+    void applyTakenBranchCycles();
+    // Called by STOP: lets the bus perform a CGB speed switch and counts the cycles it took.
+    void stop() { cycles_elapsed_total_ += bus_->stop(); }
+    // Disassembles the instruction at `address` through the bus into `out` (at least
+    // Disassembler::MNEMONIC_BUFFER_SIZE chars) and copies its bytes to `out_bytes` (3 bytes).
+    size_t disassembleInstructionAt(uint16_t address, char* out, uint8_t* out_bytes, uint8_t& out_length);
+    // Disassembles from a copy of memory (e.g. a debugger snapshot); `available` bytes are readable
+    // at `bytes`. Returns an empty string with out_length 0 if the instruction is truncated.
+    static std::string disassembleBytes(const uint8_t* bytes, size_t available, uint16_t address, uint8_t& out_length);
+
+    void updateFlags_INC8(uint8_t old_val, uint8_t new_val) {
+        setFlagZ(new_val == 0);
+        setFlagN(false);
+        setFlagH((old_val & 0x0F) == 0x0F);
+    }
+
+    void updateFlags_DEC8(uint8_t old_val, uint8_t new_val) {
+        setFlagZ(new_val == 0);
+        setFlagN(true);
+        setFlagH((old_val & 0x0F) == 0x00);
+    }
+
+    void updateFlags_ADD8(uint8_t val_a, uint8_t val_b, uint16_t result_wide) {
+        setFlagZ(static_cast<uint8_t>(result_wide) == 0);
+        setFlagN(false);
+        setFlagH(((val_a & 0x0F) + (val_b & 0x0F)) > 0x0F);
+        setFlagC(result_wide > 0xFF);
+    }
+
+    void updateFlags_SUB8(uint8_t val_a, uint8_t val_b, uint8_t result_byte) {
+        setFlagZ(result_byte == 0);
+        setFlagN(true);
+        setFlagH((val_a & 0x0F) < (val_b & 0x0F));
+        setFlagC(val_a < val_b);
+    }
+
+    void updateFlags_LOGIC8(uint8_t result_val, bool h_flag_val) {
+        setFlagZ(result_val == 0);
+        setFlagN(false);
+        setFlagH(h_flag_val);
+        setFlagC(false);
+    }
 
 private:
-    void initializeInstructionTables();
+    // Returns true if an interrupt was dispatched instead of executing an instruction.
+    bool serviceInterrupts();
+    void checkIdleLoop();
+
+    bool idle_loop_armed_;
+    uint16_t idle_loop_head_;
+    uint8_t idle_loop_instructions_;
+    uint16_t idle_loop_registers_[5];
 
-    std::shared_ptr<Bus> bus_;
-    std::vector<std::unique_ptr<Instruction>> instruction_table_;
-    std::vector<std::unique_ptr<Instruction>> cb_instruction_table_;
+    BusType* bus_;
+    const InstructionSet<BasicCpu>* instruction_set_;
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,11 @@
+#ifndef CPU_FWD_H
+#define CPU_FWD_H
+
+class Bus;
+class FlatBus;
+template <class BusType> class BasicCpu;
+
+// The CPU wired to the full Game Boy bus, as used by the emulator, debugger and headless runner.
+typedef BasicCpu<Bus> Cpu;
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef DEBUG_SNAPSHOT_H
+#define DEBUG_SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+
+#include "Profiler.h"
+#include "FramePacer.h"
+#include "Ppu.h"
+
+#include "CpuFwd.h"
+
+struct CpuDebugState {
+    uint16_t af = 0, bc = 0, de = 0, hl = 0;
+    uint16_t sp = 0, pc = 0;
+
+    uint16_t last_instr_pc = 0;
+    uint8_t  last_opcode = 0;
+    uint16_t last_operand = 0; 
+    uint8_t  last_instr_length = 0;
+    std::string last_disassembled_str;
+    std::vector<uint8_t> last_instr_bytes_vec;
+
+    void capture(const Cpu& cpu_obj); 
+};
+
+// Address spaces the memory viewer can browse: the CPU's 64 KiB view (current banks mapped)
+// or the whole ROM / external RAM with every bank laid out linearly.
+enum class MemorySpace : uint8_t { Bus, Rom, ExternalRam };
+
+// Everything the debugger UI draws, copied out by the emulation thread at frame boundaries
+// (or after a single step) and handed over through a TripleBuffer.
+struct DebugSnapshot {
+    static const uint32_t MEMORY_WINDOW_SIZE = 0x400;
+    static const uint16_t CODE_REGION_MAX_SIZE = 0x2000;
+
+    CpuDebugState cpu;
+    // State before the step / frame that produced this snapshot, for change highlighting.
+    CpuDebugState cpu_previous;
+    bool ime = false;
+    bool halted = false;
+    uint8_t interrupt_enable = 0;
+    uint8_t interrupt_flag = 0;
+    uint8_t ly = 0;
+    uint8_t ppu_mode = 0;
+    bool cgb_mode = false;
+    bool double_speed = false;
+    uint8_t wram_bank = 1;
+    uint8_t vram_bank = 0;
+    uint64_t cycles = 0;
+    uint8_t last_instruction_cycles = 0;
+    std::array<uint8_t, 3> next_instruction_bytes{};
+
+    bool paused = true;
+    uint64_t frame_count = 0;
+    std::string rom_info;
+
+    // The memory viewer's visible rows: memory_window_size bytes of memory_space starting at
+    // memory_window_base (fewer than MEMORY_WINDOW_SIZE at the end of the space).
+    MemorySpace memory_space = MemorySpace::Bus;
+    uint32_t memory_space_size = 0x10000;
+    uint32_t memory_window_base = 0;
+    uint32_t memory_window_size = 0;
+    std::array<uint8_t, MEMORY_WINDOW_SIZE> memory_window{};
+    uint16_t code_window_center = 0;
+    bool follow_pc = true;
+    // ROM is immutable and shared; the disassembly view reads whole banks straight from it.
+    std::shared_ptr<const std::vector<uint8_t>> rom;
+    uint32_t rom_bank_low = 0;  // mapped at 0x0000-0x3FFF
+    uint32_t rom_bank_high = 1; // mapped at 0x4000-0x7FFF
+    uint8_t external_ram_bank = 0;
+    // When code_window_center is in RAM, a copy of that whole RAM region (VRAM, external RAM,
+    // WRAM or HRAM) and its write generation; code_region_size is 0 otherwise.
+    uint16_t code_region_base = 0;
+    uint16_t code_region_size = 0;
+    uint64_t code_region_generation = 0;
+    std::array<uint8_t, CODE_REGION_MAX_SIZE> code_region{};
+
+    CpuProfiler profiler;
+    bool idle_loop_skipping = true;
+    bool threaded_rendering = false;
+    PacingMode pacing_mode = PacingMode::Audio;
+    uint32_t speed = 1; // FramePacer::speed()
+    uint32_t run_ahead_frames = 0;
+    double run_ahead_milliseconds = 0.0;
+    bool movie_recording = false;
+    uint32_t movie_frames = 0;
+    bool capture_active = false;
+    uint64_t capture_written = 0;
+    uint64_t capture_dropped = 0;
+    FramePacer::Stats pacing;
+
+    std::array<uint32_t, Ppu::SCREEN_WIDTH * Ppu::SCREEN_HEIGHT> framebuffer{};
+};
+
+// UI -> emulation thread requests, passed through an SpscRingBuffer. Trivially copyable so
+// the queue never allocates; test ROMs are referred to by their index in the TestSuite.
+struct EmulatorCommand {
+    enum Type : uint8_t {
+        Run,
+        Pause,
+        Step,
+        Reset,
+        LoadTestRom,
+        SetMemoryWindow,
+        SetCodeView,
+        SetFollowPc,
+        SetPacingMode,
+        SetProfilerEnabled,
+        ClearProfiler,
+        SetIdleLoopSkipping,
+        SetThreadedRendering,
+        SetSpeed, // value: frames per tick, FramePacer::SPEED_UNCAPPED for no limit
+        SetRunAhead, // value: frames
+        SetMovieRecording, // value: 1 starts (restarting the game), 0 stops and saves
+        SetCapture, // value: 0 stops, else CAPTURE_* flags
+        SaveScreenshot
+    };
+
+    static const uint32_t CAPTURE_PNG_FRAMES = 0x01;
+    static const uint32_t CAPTURE_VIDEO = 0x02;
+    static const uint32_t CAPTURE_BLOCK = 0x04; // CapturePolicy::Block instead of Drop
+
+    Type type = Pause;
+    uint32_t value = 0;
+
+    // SetMemoryWindow packs the space into the top byte and the offset into the low 24 bits.
+    static uint32_t memoryWindowValue(MemorySpace space, uint32_t base) {
+        return (static_cast<uint32_t>(space) << 24) | (base & 0xFFFFFF);
+    }
+};
+
+#endif
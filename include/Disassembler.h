@@ -0,0 +1,44 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Allocation-free SM83 disassembler. The OpcodeTable mnemonic templates are split at compile
+// time into literal text around at most one operand placeholder, so formatting an instruction
+// is two fixed-size copies plus a table-driven hex write into a caller-supplied buffer.
+namespace Disassembler {
+
+    // Buffer sizes include slack for the fixed-size copies; only the NUL-terminated prefix
+    // is meaningful.
+    static const size_t MNEMONIC_BUFFER_SIZE = 32;
+    static const size_t LINE_BUFFER_SIZE = 60;
+
+    // One listing line: "0x0100: 3E 12       LD A, 0x12".
+    struct Line {
+        uint16_t address;
+        uint8_t length;
+        char text[LINE_BUFFER_SIZE];
+    };
+
+    // Writes the mnemonic of the instruction at `bytes` (executing at `address`) to `out`,
+    // which must hold MNEMONIC_BUFFER_SIZE chars. Returns the text length and sets
+    // `out_length` to the instruction length; both are 0 if fewer than the instruction's
+    // bytes are `available`. Invalid opcodes render as "DB 0xNN (INVALID)", length 1.
+    size_t formatInstruction(const uint8_t* bytes, size_t available, uint16_t address, char* out, uint8_t& out_length);
+
+    // Writes a full listing line (address, raw bytes, mnemonic) for the instruction at
+    // `bytes`. An instruction truncated by `available` is emitted as a one-byte "DB 0xNN".
+    // Always consumes at least one byte; returns the text length.
+    size_t formatLine(const uint8_t* bytes, size_t available, uint16_t address, char* out, uint8_t& out_length);
+
+    // Linear sweep over `size` bytes mapped at `base_address`. `anchors` (sorted, may be
+    // null) are addresses that must start an instruction; an instruction that would overlap
+    // one is emitted as "DB" instead. `lines` must have room for `size` entries and
+    // `line_of_offset`, if non-null, receives the index of the line covering each byte.
+    // Returns the number of lines written.
+    size_t disassembleRange(const uint8_t* data, size_t size, uint16_t base_address,
+        const uint16_t* anchors, size_t anchor_count, Line* lines, uint32_t* line_of_offset);
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef DISASSEMBLY_CACHE_H
+#define DISASSEMBLY_CACHE_H
+
+#include "Disassembler.h"
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+// Disassembly of whole memory banks, built once and reused by the debugger until the bank's
+// contents change. Each bank keeps its lines with pre-rendered text plus a per-byte index of
+// the line covering that byte (instruction-start markers), so the view only touches the lines
+// it shows and finding the PC is a lookup rather than a look-back search.
+class DisassemblyCache {
+public:
+    enum Region : uint8_t { REGION_ROM = 0, REGION_VRAM, REGION_EXTERNAL_RAM, REGION_WRAM, REGION_HRAM };
+
+    typedef Disassembler::Line Line;
+
+    struct Bank {
+        uint64_t generation = 0;
+        bool stale = true;
+        uint16_t base_address = 0;
+        std::vector<Line> lines;
+        std::vector<uint32_t> line_of_offset;
+        // Addresses that must start an instruction (e.g. a PC the linear sweep had stepped over).
+        std::vector<uint16_t> anchors;
+
+        // Index of the line covering `address`, or -1 if it is outside the bank.
+        int lineForAddress(uint16_t address) const;
+        bool isInstructionStart(uint16_t address) const;
+    };
+
+    static uint32_t makeKey(Region region, uint32_t bank) { return (static_cast<uint32_t>(region) << 24) | bank; }
+
+    // Returns the bank identified by `key`, rebuilding it from `data` if it was never built,
+    // its generation changed (RAM written) or an anchor was added since.
+    const Bank& get(uint32_t key, const uint8_t* data, size_t size, uint16_t base_address, uint64_t generation);
+    void addAnchor(uint32_t key, uint16_t address);
+    void clear() { banks_.clear(); }
+
+private:
+    static void build(Bank& bank, const uint8_t* data, size_t size);
+
+    std::unordered_map<uint32_t, Bank> banks_;
+};
+
+#endif
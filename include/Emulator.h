@@ -4,14 +4,27 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <atomic>
+#include <thread>
 #include "TestSuite.h" 
 #include "Cpu.h"       
+#include "FramePacer.h"
+#include "DebugSnapshot.h"
+#include "TripleBuffer.h"
+#include "SpscRingBuffer.h"
 
 
 class Bus;
 class Cartridge;
 class EmulatorUI; 
+class AudioOutput;
+struct MachineState;
+class Movie;
+class FrameCapture;
 
+// The core runs on its own thread (emulationThreadMain). The UI thread never touches Cpu/Bus:
+// it reads DebugSnapshots published through snapshots_ and sends EmulatorCommands through
+// commands_, so a slow ImGui frame cannot slow emulation down.
 class Emulator {
 public:
     Emulator();
@@ -25,27 +38,84 @@ public:
     void printCpuStateForDebug() const;
 
 private:
+    static const size_t COMMAND_QUEUE_CAPACITY = 64;
+    static const uint32_t MAX_RUN_AHEAD_FRAMES = 4;
+
     void step(); 
+    // Runs until the next VBlank. With `draw` false the frame's pixels are skipped (it will
+    // not be displayed); timing and every other side effect are unchanged.
+    void runFrame(bool draw);
+    // Runs until the next VBlank and closes the APU frame; false if the CPU halted forever.
+    bool emulateFrame();
+    void runAhead();
+    void setRunAheadFrames(uint32_t frames);
+    void setSpeed(uint32_t speed);
+    bool isHaltedForever() const;
+    // Restarts the game from power-on and records every following frame's input until
+    // stopMovieRecording(), which writes the movie to Config::MOVIE_PATH.
+    void startMovieRecording();
+    void stopMovieRecording();
+    // `flags` are EmulatorCommand::CAPTURE_*; 0 stops.
+    void setCapture(uint32_t flags);
+    void saveScreenshot();
+
+    void emulationThreadMain();
+    // Returns true if any command was handled.
+    bool processCommands();
+    void publishSnapshot();
 
     
     std::shared_ptr<Cartridge> cartridge_;
     std::shared_ptr<Bus> bus_;
     std::unique_ptr<Cpu> cpu_;
+    CpuProfiler profiler_;
 
     TestSuite test_suite_; 
     std::string current_rom_info_; 
     
     std::unique_ptr<EmulatorUI> ui_;
+    std::unique_ptr<AudioOutput> audio_;
+    FramePacer pacer_;
+    // Frames shown ahead of the real state (0 = off) and the state they are run from.
+    uint32_t run_ahead_frames_ = 0;
+    std::unique_ptr<MachineState> run_ahead_state_;
+    double run_ahead_milliseconds_ = 0.0; // smoothed cost per host frame
+    // The movie being recorded (null when not recording), the input word latched for the
+    // current frame while recording, and scratch space for the per-frame state hash.
+    std::unique_ptr<Movie> movie_;
+    std::atomic<uint8_t> movie_input_;
+    std::unique_ptr<MachineState> movie_state_;
+    uint16_t initial_pc_ = 0x0100;
+    // Created on first use; every frame is drawn while a capture session is active.
+    std::unique_ptr<FrameCapture> capture_;
+
+    std::thread emulation_thread_;
+    TripleBuffer<DebugSnapshot> snapshots_;
+    SpscRingBuffer<EmulatorCommand> commands_;
+    // Incremented by the UI thread after every presented frame (drives PacingMode::Vsync).
+    std::atomic<uint64_t> frames_presented_;
+    uint64_t frames_presented_seen_ = 0;
+    // Pressed Joypad::Buttons, written by the UI thread and sampled by the joypad on JOYP reads.
+    std::atomic<uint8_t> joypad_input_;
     
     bool is_initialized_ = false;
-    bool is_running_ = false;
+    std::atomic<bool> is_running_;
+    // Owned by the emulation thread once run() has started.
     bool is_paused_for_step_ = true; 
     bool step_requested_ = false;   
+    CpuDebugState cpu_state_before_;
+    MemorySpace memory_space_ = MemorySpace::Bus;
+    uint32_t memory_window_base_ = 0x0000;
+    uint16_t code_view_center_ = 0x0100;
+    bool follow_pc_ = true;
 
     bool coreInitialize(const std::shared_ptr<Cartridge>& cart, uint16_t initial_pc, const std::string& rom_info);
+    bool initializeUi();
     
     void uiLoadTestRom(const TestRom& test_rom_struct);
     void uiResetCpu();
+    void openAudio();
+    uint32_t memorySpaceSize(MemorySpace space) const;
 };
 
-#endif 
\ No newline at end of file
+#endif 
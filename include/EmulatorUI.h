@@ -4,11 +4,15 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <functional> 
+#include <atomic>
+
+#include "DebugSnapshot.h"
+#include "TripleBuffer.h"
+#include "SpscRingBuffer.h"
+#include "DisassemblyCache.h"
+#include "Scaler.h"
 
 
-class Cpu;
-class Bus;
 class TestSuite;
 struct TestRom;
 
@@ -17,33 +21,17 @@ struct SDL_Window;
 typedef void* SDL_GLContext;
 
 
-struct CpuDebugState {
-    uint16_t af = 0, bc = 0, de = 0, hl = 0;
-    uint16_t sp = 0, pc = 0;
-
-    uint16_t last_instr_pc = 0;
-    uint8_t  last_opcode = 0;
-    uint16_t last_operand = 0; 
-    uint8_t  last_instr_length = 0;
-    std::string last_disassembled_str;
-    std::vector<uint8_t> last_instr_bytes_vec;
-
-    void capture(const Cpu& cpu_obj); 
-};
-
-
 class EmulatorUI {
 public:
+    // The UI only sees the core through published snapshots and the command queue, so it can
+    // run on a different thread from emulation.
     EmulatorUI(
-        Cpu& cpu_ref,
-        Bus& bus_ref,
         TestSuite& ts_ref,
-        std::string& rom_info_ref,
-        bool& paused_ref,
-        bool& step_req_ref,
-        bool& emu_is_running_ref, 
-        std::function<void(const TestRom&)> load_test_rom_fn,
-        std::function<void()> reset_cpu_fn
+        TripleBuffer<DebugSnapshot>& snapshots_ref,
+        SpscRingBuffer<EmulatorCommand>& commands_ref,
+        std::atomic<bool>& emu_is_running_ref,
+        std::atomic<uint64_t>& frames_presented_ref,
+        std::atomic<uint8_t>& joypad_input_ref
     );
     ~EmulatorUI();
 
@@ -53,18 +41,23 @@ public:
     void processInput(); 
     void render();       
 
-    void captureCpuStateForDiff();   
-    void resetDisassemblyViewToPc(); 
 
 private:
     
     SDL_Window* window_;
     SDL_GLContext gl_context_;
 
-    uint16_t memory_editor_address_ = 0x0000; 
-    char memory_editor_addr_input_buf_[5] = "0000"; 
+    MemorySpace memory_view_space_ = MemorySpace::Bus;
+    uint32_t memory_editor_address_ = 0x0000; // offset of the first visible row
+    char memory_editor_addr_input_buf_[7] = "0000"; 
     int memory_editor_bytes_per_row_ = 16;
-    int memory_editor_num_rows_ = 16; 
+    int memory_editor_visible_rows_ = 16;
+    int memory_editor_scroll_to_row_ = -1;
+    uint32_t requested_memory_window_ = 0;
+
+    bool capture_png_frames_ = false;
+    bool capture_video_ = true;
+    bool capture_wait_for_encoder_ = false;
 
 
     
@@ -79,27 +72,31 @@ private:
     void drawDisassemblyContextWindow();
     void drawStackViewWindow();
     void drawMemoryViewerWindow(); 
+    void drawProfilerWindow();
     void renderGBCFrame(); 
+    void sendCommand(EmulatorCommand::Type type, uint32_t value = 0);
 
     
-    Cpu& cpu_;
-    Bus& bus_;
     TestSuite& test_suite_;
-    std::string& current_rom_info_;
-    bool& is_paused_for_step_;
-    bool& step_requested_;
-    bool& emulator_is_running_; 
-
-    
-    std::function<void(const TestRom&)> load_test_rom_callback_;
-    std::function<void()> reset_cpu_callback_;
-
-    
-    CpuDebugState cpu_state_prev_frame_;
-
-    
-    uint16_t disassembly_view_center_address_ = 0x0100;
-    bool follow_pc_in_disassembly_ = true;
+    TripleBuffer<DebugSnapshot>& snapshots_;
+    SpscRingBuffer<EmulatorCommand>& commands_;
+    std::atomic<bool>& emulator_is_running_; 
+    std::atomic<uint64_t>& frames_presented_;
+    std::atomic<uint8_t>& joypad_input_;
+
+    unsigned int screen_texture_ = 0;
+    bool screen_texture_stale_ = true;
+    int screen_texture_width_ = 0;
+    int screen_texture_height_ = 0;
+    // Optional CPU filtering of the frame before upload (the GPU otherwise scales it, nearest).
+    FrameScaler scaler_;
+    ScaleFilter scale_filter_ = ScaleFilter::None;
+    bool color_correction_ = false;
+
+    DisassemblyCache disassembly_cache_;
+    const void* disassembly_rom_identity_ = nullptr;
+    uint16_t disassembly_scrolled_center_ = 0xFFFF;
+    uint32_t disassembly_scrolled_key_ = 0xFFFFFFFF;
 
     
     static const int INITIAL_WINDOW_WIDTH = 1280;
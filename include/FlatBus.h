@@ -0,0 +1,45 @@
+#ifndef FLAT_BUS_H
+#define FLAT_BUS_H
+
+#include <array>
+#include <cstdint>
+
+// 64 KiB of flat RAM with no I/O, banking or timing, for running the CPU in isolation
+// (instruction tests, fuzzing, benchmarks). Implements, all inline, the part of Bus's
+// interface that BasicCpu uses. IE and IF are plain registers rather than memory-mapped.
+class FlatBus {
+public:
+    static const uint64_t NEVER = ~0ull;
+
+    std::array<uint8_t, 0x10000> memory{};
+    uint8_t interrupt_enable = 0;
+    uint8_t interrupt_flag = 0;
+    uint64_t cycles = 0;
+
+    uint8_t read(uint16_t address) const { return memory[address]; }
+    void write(uint16_t address, uint8_t value) {
+        memory[address] = value;
+        written_ = true;
+    }
+
+    void tick(uint32_t elapsed) { cycles += elapsed; }
+    // Nothing is ever scheduled, so HALT and idle loops are never fast-forwarded.
+    uint64_t skipToNextEvent() { return 0; }
+    uint64_t skipTo(uint64_t) { return 0; }
+    // No speed switching: STOP is a two-byte no-op, as it is on the DMG bus outside button waits.
+    uint64_t stop() { return 0; }
+    uint64_t takeStallCycles() { return 0; }
+    bool cgbMode() const { return false; }
+    void beginIdlePollWindow() { written_ = false; }
+    bool idlePollWindowDirty() const { return written_; }
+    uint64_t idlePollDeadline() const { return NEVER; }
+
+    void requestInterrupt(uint8_t mask) { interrupt_flag |= mask; }
+    void acknowledgeInterrupt(uint8_t mask) { interrupt_flag &= static_cast<uint8_t>(~mask); }
+    uint8_t pendingInterrupts() const { return interrupt_enable & interrupt_flag & 0x1F; }
+
+private:
+    bool written_ = true;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What submit() does when every frame buffer is still queued or being encoded.
+enum class CapturePolicy : uint8_t {
+    Drop,  // the frame is not captured (never slows emulation; gaps in the output)
+    Block  // the emulation thread waits for an encoder (every frame captured)
+};
+
+// Writes completed frames to disk without encoding on the emulation thread: submit() copies
+// the frame into one of a fixed set of recycled buffers and queues it for a small pool of
+// encoder threads. A capture session writes a PNG per frame and/or one uncompressed YUV4MPEG2
+// (.y4m, 4:4:4) video; screenshots are single PNGs queued the same way. PNGs are encoded here
+// (fixed-Huffman deflate), so there are no library dependencies.
+class FrameCapture {
+public:
+    struct Options {
+        std::string directory;
+        bool png_frames = false;
+        bool video = true;
+        CapturePolicy policy = CapturePolicy::Drop;
+    };
+
+    // Frames of the current (or last) session.
+    struct Stats {
+        uint64_t submitted = 0;
+        uint64_t written = 0;
+        uint64_t dropped = 0;
+    };
+
+    static const unsigned DEFAULT_ENCODER_THREADS = 2;
+    static const size_t DEFAULT_FRAME_BUFFERS = 8;
+
+    FrameCapture(int width, int height, unsigned encoder_threads = DEFAULT_ENCODER_THREADS,
+        size_t frame_buffers = DEFAULT_FRAME_BUFFERS);
+    ~FrameCapture();
+
+    // Starts a session writing into a new numbered subdirectory of `directory` (video.y4m,
+    // frame_<n>.png); an active session is stopped first. False if nothing can be created.
+    bool start(const Options& options);
+    // Waits until every frame of the session is written, then closes the video.
+    void stop();
+    bool active() const { return active_; }
+    void setPolicy(CapturePolicy policy);
+
+    // Queues a frame of the active session (`pixels` as the PPU produces them, R in the low
+    // byte). False if the frame was dropped or no session is active.
+    bool submit(const uint32_t* pixels, uint64_t frame_number);
+    // Queues a single PNG, independent of any session (it waits for a free buffer).
+    void screenshot(const uint32_t* pixels, const std::string& path);
+
+    Stats stats() const;
+
+    // RGB PNG, 8 bits per channel.
+    static void encodePng(const uint32_t* pixels, int width, int height, std::vector<uint8_t>& out);
+
+private:
+    struct Job {
+        std::vector<uint32_t> pixels;
+        uint64_t frame_number = 0;
+        uint64_t sequence = 0; // order in the video
+        bool video = false;
+        bool screenshot = false; // not part of the session (or its stats)
+        std::string png_path;
+    };
+
+    // Takes a free buffer, waiting for one if `wait` (else null when there is none).
+    std::unique_ptr<Job> acquire(std::unique_lock<std::mutex>& lock, bool wait);
+    void encoderMain();
+    void writeVideoFrame(const Job& job, std::vector<uint8_t>& planes);
+
+    const int width_;
+    const int height_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable buffer_free_;
+    std::condition_variable video_turn_;
+    std::condition_variable idle_;
+    std::vector<std::unique_ptr<Job>> free_buffers_;
+    std::deque<std::unique_ptr<Job>> queue_;
+    size_t jobs_in_progress_ = 0;
+    bool stopping_ = false;
+
+    Options options_;
+    std::atomic<bool> active_{ false };
+    FILE* video_file_ = nullptr;
+    uint64_t next_video_sequence_ = 0;   // next frame submitted to the video
+    uint64_t video_sequence_written_ = 0; // next frame the video file expects
+    Stats stats_;
+
+    std::vector<std::thread> encoders_;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+
+enum class PacingMode {
+    Audio, // host clock + dynamic rate control on the audio ring; independent of display refresh
+    Vsync  // one emulated frame per presented frame (legacy; runs fast on >60 Hz displays)
+};
+
+// Decides when emulated frames run in PacingMode::Audio and nudges the audio resampling rate
+// so the ring buffer fill stays near TARGET_LATENCY_MS. The host clock paces frames at the
+// real Game Boy rate; the rate control only absorbs the drift between the host clock and the
+// audio device clock, so the pitch change never exceeds MAX_RATE_DEVIATION.
+//
+// Fast-forward keeps the same tick (one per Game Boy frame period, or per presented frame in
+// vsync pacing) but runs a batch of frames on each: `speed` frames, or for SPEED_UNCAPPED as
+// many as the measured cost per frame fits into UNCAPPED_BUSY_FRACTION of a period. Only one
+// frame per batch needs to be drawn. Audio rate control is suspended while fast-forwarding.
+class FramePacer {
+public:
+    static constexpr double FRAME_RATE = 4194304.0 / 70224.0; // ~59.73 Hz
+    static constexpr double MAX_RATE_DEVIATION = 0.005;        // +/-0.5%
+    static constexpr double TARGET_LATENCY_MS = 25.0;
+    static constexpr double MAX_LATENCY_MS = 40.0;
+    static constexpr double LOW_LATENCY_MS = 5.0;
+    static constexpr double FILL_SMOOTHING = 0.05;
+    static constexpr double INTEGRAL_GAIN = 0.005; // per frame; absorbs the steady clock drift
+    static const int MAX_CATCH_UP_FRAMES = 3;
+    static const uint32_t SPEED_UNCAPPED = 0;
+    static const int MAX_UNCAPPED_BATCH = 64;
+    static constexpr double UNCAPPED_BUSY_FRACTION = 0.9;
+
+    struct Stats {
+        double audio_latency_ms = 0.0;
+        double rate_adjustment = 0.0; // fraction, e.g. 0.001 = +0.1%
+        uint64_t underruns = 0;
+        double frames_per_second = 0.0;
+        double speed = 0.0; // emulated time / host time, e.g. 4.0 = running at 4x
+    };
+
+    FramePacer();
+
+    PacingMode mode() const { return mode_; }
+    void setMode(PacingMode mode) { mode_ = mode; reset(); }
+
+    // Frames per tick: 1 is real time, 2 and 4 are fixed fast-forward rates, SPEED_UNCAPPED runs
+    // as fast as the host allows.
+    uint32_t speed() const { return speed_; }
+    void setSpeed(uint32_t speed) { speed_ = speed; reset(); }
+    bool fastForwarding() const { return speed_ != 1; }
+    // Frames to run on one tick (1 unless fast-forwarding).
+    int framesPerTick() const { return speed_ == SPEED_UNCAPPED ? uncapped_batch_ : static_cast<int>(speed_); }
+
+    // Forget the schedule (after pausing, loading or a long stall) so no burst of frames follows.
+    void reset();
+
+    // Number of frames to emulate now. `queued_frames` is the audio ring fill in stereo frames;
+    // pass sample_rate 0 when there is no audio device.
+    int framesDue(size_t queued_frames, int sample_rate);
+    // PacingMode::Vsync: number of frames to emulate for one presented frame.
+    int framesDueOnPresent();
+    // Resampling rate to use for the next frame's samples.
+    double resampleRate(size_t queued_frames, int sample_rate);
+    // Milliseconds until the next frame is due (0 if one is due already).
+    uint32_t millisecondsUntilNextFrame() const;
+
+    void noteFrameEmulated();
+    void setUnderruns(uint64_t underruns) { stats_.underruns = underruns; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    int fastForwardFramesDue(Clock::time_point now);
+    // Sizes the uncapped batch from the previous one and starts timing a new one.
+    int startBatch(Clock::time_point now);
+
+    PacingMode mode_;
+    uint32_t speed_;
+    bool started_;
+    Clock::time_point next_frame_time_;
+    Clock::duration frame_period_;
+    double smoothed_latency_ms_;
+    double drift_correction_;
+
+    // Uncapped fast-forward: the current batch size and the timing of the batch in progress.
+    int uncapped_batch_;
+    Clock::time_point batch_start_;
+    Clock::time_point last_frame_time_;
+    uint32_t batch_frames_;
+
+    Clock::time_point fps_window_start_;
+    uint32_t fps_window_frames_;
+    Stats stats_;
+};
+
+#endif
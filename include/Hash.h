@@ -0,0 +1,60 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// 64-bit hash of a block of memory in one call, for whole frames (golden-image regression
+// runs). Built like XXH3's long-input loop: eight 64-bit lanes each take a 32x32->64 multiply
+// of the data mixed with a key per 64-byte stripe, which maps onto SSE2 (_mm_mul_epu32) two
+// lanes per instruction; without SSE2 (or with GBC_NO_SIMD) a scalar loop gives the same
+// result. Not cryptographic; words are read in host order.
+uint64_t hashBytes(const void* data, size_t size);
+
+// Streaming 64-bit hash for desync detection (movie state hashes). Not cryptographic and not
+// portable across byte orders: words are read in host order.
+class Hasher {
+public:
+    void add(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (; size >= 8; size -= 8, bytes += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes, 8);
+            mix(word);
+        }
+        if (size != 0) {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes, size);
+            mix(word ^ (static_cast<uint64_t>(size) << 56));
+        }
+    }
+
+    template <typename T>
+    void addValue(T value) {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "hash fields one at a time");
+        mix(static_cast<uint64_t>(value));
+    }
+
+    uint64_t value() const {
+        // Final avalanche (MurmurHash3's fmix64).
+        uint64_t h = state_;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+private:
+    void mix(uint64_t word) {
+        state_ ^= word * 0x9E3779B97F4A7C15ull;
+        state_ = ((state_ << 31) | (state_ >> 33)) * 0xC2B2AE3D27D4EB4Full;
+    }
+
+    uint64_t state_ = 0x27D4EB2F165667C5ull;
+};
+
+#endif
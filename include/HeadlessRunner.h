@@ -0,0 +1,55 @@
+#ifndef HEADLESS_RUNNER_H
+#define HEADLESS_RUNNER_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <vector>
+
+#include "Profiler.h"
+
+#include "CpuFwd.h"
+class Bus;
+class Cartridge;
+
+struct HeadlessOptions {
+    std::string rom_path;
+    uint64_t frames = 600;
+    bool idle_loop_skipping = true;
+    // When set, replays this movie (instead of running `frames` frames with no input) and
+    // checks every frame's state hash against the recording. The movie decides whether idle
+    // loops are skipped.
+    std::string movie_path;
+};
+
+// Runs the core without SDL/ImGui as fast as the host allows, for batch runs and benchmarks.
+class HeadlessRunner {
+public:
+    HeadlessRunner();
+    ~HeadlessRunner();
+
+    bool loadRom(const std::string& rom_path);
+    // A cartridge image built in memory (LinkRunner's test programs).
+    bool loadRomData(const std::vector<uint8_t>& data);
+    void runFrame();
+    // Hash of the last completed frame's pixels (hashBytes over the framebuffer).
+    uint64_t frameHash() const;
+    int run(const HeadlessOptions& options);
+    // Returns 0 if every frame matched, 2 at the first desync (1 if the movie or ROM is unusable).
+    int replayMovie(const HeadlessOptions& options);
+    // Bus-level DMA checks on a built-in CGB cartridge (--dma-test): an HBlank VRAM DMA block
+    // whose event fires while other events are overdue, and which bus an OAM DMA takes away from
+    // the CPU. 0 if all passed, 2 if any failed.
+    static int runDmaSelfTest();
+
+    Cpu& cpu() { return *cpu_; }
+    Bus& bus() { return *bus_; }
+
+private:
+    std::shared_ptr<Cartridge> cartridge_;
+    std::shared_ptr<Bus> bus_;
+    std::unique_ptr<Cpu> cpu_;
+    CpuProfiler profiler_;
+};
+
+#endif
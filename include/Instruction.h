@@ -1,24 +1,29 @@
 #ifndef INSTRUCTION_H
 #define INSTRUCTION_H
 
-#include <string>
-#include <vector>
+#include <array>
 #include <cstdint>
-#include <memory> 
-
-class Cpu;
+#include <memory>
 
+// Length, cycle counts and disassembly text are described by OpcodeTable; an
+// Instruction only implements the behaviour. Handlers are immutable and shared by every
+// CPU of the same type.
+template <class CpuType>
 class Instruction {
 public:
     virtual ~Instruction() = default;
 
-    virtual void execute(Cpu& cpu) = 0;
+    virtual void execute(CpuType& cpu) const = 0;
+};
 
-    virtual std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) = 0;
+// Handlers for every opcode, built once per CPU type on first use and shared read-only.
+template <class CpuType>
+struct InstructionSet {
+    std::array<std::unique_ptr<const Instruction<CpuType>>, 0x100> main;
+    std::array<std::unique_ptr<const Instruction<CpuType>>, 0x100> cb;
 
-    virtual bool isInvalid() const {
-        return false;
-    }
+    InstructionSet();
+    static const InstructionSet& shared();
 };
 
-#endif 
\ No newline at end of file
+#endif 
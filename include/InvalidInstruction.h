@@ -3,18 +3,14 @@
 
 #include "Instruction.h"
 
-class InvalidInstruction : public Instruction {
+template <class CpuType>
+class InvalidInstruction : public Instruction<CpuType> {
 public:
     explicit InvalidInstruction(uint8_t opcode_val);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
-
-    bool isInvalid() const override {
-        return true;
-    }
+    void execute(CpuType& cpu) const override;
 
 private:
     uint8_t illegal_opcode_value_;
 };
 
-#endif 
\ No newline at end of file
+#endif 
@@ -0,0 +1,53 @@
+#ifndef JOYPAD_H
+#define JOYPAD_H
+
+#include <atomic>
+#include <cstdint>
+
+class Bus;
+
+// JOYP (0xFF00). The host's button state is not copied in once per frame: it lives in an
+// atomic word that the UI thread updates as events arrive, and the joypad samples it at the
+// moment the game reads JOYP (or changes the selection), so a press is seen by the very next
+// poll. It is also sampled at every VBlank so the joypad interrupt can wake a halted game.
+class Joypad {
+public:
+    // Bits of the input word; a set bit is a pressed button.
+    enum Button : uint8_t {
+        RIGHT = 0x01, LEFT = 0x02, UP = 0x04, DOWN = 0x08,
+        A = 0x10, B = 0x20, SELECT = 0x40, START = 0x80
+    };
+
+    // Input can change at any time, so a polling loop on JOYP may only be skipped this far ahead.
+    static const uint32_t POLL_QUANTUM = 456;
+
+    // The input word is host state, not part of this.
+    struct State {
+        uint8_t select;
+        uint8_t lines;
+    };
+
+    explicit Joypad(Bus& bus);
+
+    void reset();
+    // The word must outlive the joypad (or the next setInput); null means nothing is pressed.
+    void setInput(const std::atomic<uint8_t>* input) { input_ = input; }
+
+    uint8_t read();
+    void write(uint8_t value);
+    // The register as last sampled, without sampling (for the debugger).
+    uint8_t peek() const { return static_cast<uint8_t>(0xC0 | select_ | lines_); }
+    // Re-reads the input word; a selected line going low requests the joypad interrupt.
+    void sample();
+
+    void saveState(State& state) const;
+    void loadState(const State& state);
+
+private:
+    Bus& bus_;
+    const std::atomic<uint8_t>* input_;
+    uint8_t select_; // bits 4-5 as written: a 0 selects the d-pad (4) or the buttons (5)
+    uint8_t lines_;  // bits 0-3, low = pressed
+};
+
+#endif
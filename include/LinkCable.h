@@ -0,0 +1,81 @@
+#ifndef LINK_CABLE_H
+#define LINK_CABLE_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "Serial.h"
+
+// Connects the serial ports of two cores that each run on their own thread. The cores are not
+// locked cycle by cycle: each one runs freely in slices and calls sync() between them, which
+// publishes its scheduler time and holds it back only while it is more than `max_drift` base
+// T-cycles ahead of the other. A transfer is posted when the clocking side writes SC, so the
+// other side stops at the exact completion time instead of running past it, and the clocking
+// side waits at that time for the byte coming back. Transfers shorter than `max_drift` (the
+// CGB's fast clock) may land on the receiving side up to `max_drift` late.
+//
+// Both cores must have started from reset at the same time. The uncontended path of sync() is
+// two atomic stores and a few loads; the mutex is only taken around transfers and waits.
+class LinkCable : public SerialLink {
+public:
+    // Under one byte at the normal serial clock (4096), so those transfers are exact.
+    static const uint64_t DEFAULT_MAX_DRIFT = 2048;
+
+    explicit LinkCable(uint64_t max_drift = DEFAULT_MAX_DRIFT);
+
+    // Plugs `serial` into end `side` (0 or 1). Attach both ends before either core runs.
+    void attach(int side, Serial& serial);
+    // Unplugs a core that stops running, so the other no longer waits for it.
+    void detach(int side);
+
+    // From side `side`'s thread, between instructions, at scheduler time `now`: delivers the
+    // other side's transfer if it is due, waits while too far ahead, and returns the time to
+    // run to (at least one instruction past `now`) before the next call.
+    uint64_t sync(int side, uint64_t now);
+
+    // From Serial, for a transfer clocked by `side` completing at `end_time`.
+    void beginTransfer(int side, uint8_t value, uint64_t end_time) override;
+    void cancelTransfer(int side) override;
+    // At the completion time: waits for the other side to reach it and returns its byte
+    // (0xFF if it was not listening or has been unplugged).
+    uint8_t finishTransfer(int side) override;
+
+    uint64_t transferCount() const { return transfer_count_.load(std::memory_order_relaxed); }
+
+private:
+    static const int SPIN_LIMIT = 100;
+
+    struct End {
+        Serial* serial = nullptr;
+        std::atomic<bool> attached{ false };
+        std::atomic<uint64_t> clock{ 0 };
+        std::atomic<bool> waiting{ false };
+        // The transfer this end is clocking. Changed under mutex_; `sending` is also read
+        // without it, as a hint that sync() has to take the slow path.
+        std::atomic<bool> sending{ false };
+        uint8_t value = 0xFF;
+        uint64_t end_time = 0;
+        bool answered = false;
+        uint8_t answer = 0xFF;
+    };
+
+    // Stores `self`'s clock and wakes the other side if it is blocked.
+    void publish(End& self, const End& other, uint64_t now);
+    // With mutex_ held: answers the other end's transfer from `self` if it is due by `now`.
+    void deliver(End& self, End& other, uint64_t now);
+    // With mutex_ held: blocks until another thread changes something, unless `done` already
+    // holds once `self` is marked as waiting (so a clock published meanwhile is not missed).
+    template <class Done>
+    void block(std::unique_lock<std::mutex>& lock, End& self, Done&& done);
+
+    const uint64_t max_drift_;
+    std::array<End, 2> ends_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::atomic<uint64_t> transfer_count_{ 0 };
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef LINK_RUNNER_H
+#define LINK_RUNNER_H
+
+#include <cstdint>
+#include <string>
+
+#include "LinkCable.h"
+
+struct LinkOptions {
+    std::string rom_paths[2];
+    uint64_t frames = 600;
+    bool idle_loop_skipping = true;
+    uint64_t max_drift = LinkCable::DEFAULT_MAX_DRIFT;
+};
+
+class HeadlessRunner;
+
+// Two headless cores joined by a LinkCable, each on its own thread, for link-cable games and
+// serial test ROMs. Both run `frames` frames with no input; the cable only makes them wait
+// for each other around transfers and when one gets too far ahead.
+class LinkRunner {
+public:
+    static const uint64_t SELF_TEST_FRAMES = 120;
+
+    // 0 when both ran to the end, 1 if a ROM could not be loaded.
+    int run(const LinkOptions& options);
+
+    // Links a built-in master program, which clocks 32 bytes out and stores the replies at
+    // C000, to a slave that answers from HALT and to one that polls SC, for SELF_TEST_FRAMES
+    // frames each (options.rom_paths and options.frames are ignored). Checks the bytes both
+    // sides received and, when max_drift keeps transfers exact, each console's state hash.
+    // If `rom_directory` is set the images are written there first, so --link and --net-link
+    // can be run on them and must print the same hashes. 0 if every check passed, 2 if any
+    // failed, 1 if the images could not be written.
+    int runSelfTest(const LinkOptions& options, const std::string& rom_directory);
+
+private:
+    // Runs both (loaded) cores for `frames` frames; returns the number of transfers.
+    static uint64_t runPair(HeadlessRunner& first, HeadlessRunner& second, const LinkOptions& options, uint64_t frames);
+    static void runSide(HeadlessRunner& core, LinkCable& cable, int side, uint64_t frames);
+    static uint64_t stateHash(HeadlessRunner& core);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Leveled, rate-limited, asynchronous logging for the core. A log call formats into a slot of a
+// fixed-size lock-free queue and returns; a background thread writes the queue to stderr. Each
+// call site emits at most RATE_LIMIT_MESSAGES per RATE_LIMIT_WINDOW_MS and counts the rest, so a
+// ROM spinning on an illegal opcode costs a clock read per hit rather than a console write.
+//
+// Use the GBC_LOG_* macros rather than calling write() directly. GBC_LOG_DEBUG compiles to
+// nothing (arguments unevaluated) unless GBC_LOG_DEBUG_ENABLED is defined, which is the
+// default when NDEBUG is not.
+namespace Log {
+
+    enum class Level : uint8_t { Debug, Info, Warning, Error };
+
+    static const uint32_t RATE_LIMIT_MESSAGES = 5;
+    static const uint32_t RATE_LIMIT_WINDOW_MS = 1000;
+    // Longer messages are truncated.
+    static const size_t MAX_MESSAGE_LENGTH = 240;
+
+    // Per-call-site rate limiter state; the macros give every call site its own static one.
+    struct Site {
+        std::atomic<uint64_t> window{ ~0ull };
+        std::atomic<uint32_t> messages_in_window{ 0 };
+        std::atomic<uint32_t> suppressed{ 0 };
+    };
+
+    // True if the site may log now; otherwise the message is counted as suppressed and the
+    // count is appended to the site's next message.
+    bool admit(Site& site);
+
+#if defined(__GNUC__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    void write(Site& site, Level level, const char* format, ...);
+
+    // Blocks until every message queued before the call has been written.
+    void flush();
+}
+
+#define GBC_LOG(level, ...) \
+    do { \
+        static ::Log::Site gbc_log_site_; \
+        if (::Log::admit(gbc_log_site_)) ::Log::write(gbc_log_site_, level, __VA_ARGS__); \
+    } while (0)
+
+#if !defined(NDEBUG) && !defined(GBC_LOG_DEBUG_ENABLED)
+#define GBC_LOG_DEBUG_ENABLED
+#endif
+
+#ifdef GBC_LOG_DEBUG_ENABLED
+#define GBC_LOG_DEBUG(...) GBC_LOG(::Log::Level::Debug, __VA_ARGS__)
+#else
+#define GBC_LOG_DEBUG(...) do { } while (0)
+#endif
+#define GBC_LOG_INFO(...) GBC_LOG(::Log::Level::Info, __VA_ARGS__)
+#define GBC_LOG_WARNING(...) GBC_LOG(::Log::Level::Warning, __VA_ARGS__)
+#define GBC_LOG_ERROR(...) GBC_LOG(::Log::Level::Error, __VA_ARGS__)
+
+#endif
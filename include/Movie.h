@@ -0,0 +1,62 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CpuFwd.h"
+class Bus;
+struct MachineState;
+
+// A recorded play session: the joypad input word of every frame from power-on, plus a hash of
+// the machine state after each frame. Replaying the inputs against the same ROM must reproduce
+// every hash; the first frame that does not is where the replay desynced.
+//
+// The core only sees input through Joypad::setInput's word, so recording and replay both
+// latch that word once per frame (at the frame boundary) instead of letting the joypad sample
+// live host input mid-frame.
+//
+// Idle-loop skipping leaves the CPU at the loop head rather than mid-iteration when a frame
+// ends, which the hashes see, so the movie records whether it was on and replays the same way.
+//
+// File layout (little-endian): "GBCMOVIE", format version (u32), ROM hash (u64), start PC
+// (u16), flags (u8: bit 0 = idle-loop skipping), frame count (u32), then the inputs run-length
+// encoded as (input byte, LEB128 run length) pairs, then one u64 state hash per frame.
+class Movie {
+public:
+    // 2: the state hash covers banked WRAM/VRAM and the CPU speed; 3: and the DMA registers;
+    // 4: and the serial port; 5: the noise LFSR advances with no audio output attached.
+    static const uint32_t FORMAT_VERSION = 5;
+
+    // Starts an empty movie for the ROM with this hash, recorded from powerOn(start_pc).
+    void begin(uint64_t rom_hash, uint16_t start_pc, bool idle_loop_skipping);
+    void appendFrame(uint8_t input, uint64_t state_hash);
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+    uint64_t romHash() const { return rom_hash_; }
+    uint16_t startPc() const { return start_pc_; }
+    bool idleLoopSkipping() const { return idle_loop_skipping_; }
+    uint32_t frameCount() const { return static_cast<uint32_t>(inputs_.size()); }
+    uint8_t input(uint32_t frame) const { return inputs_[frame]; }
+    uint64_t stateHash(uint32_t frame) const { return state_hashes_[frame]; }
+
+    static uint64_t hashRom(const std::vector<uint8_t>& rom);
+    // Hash of everything a desync would show up in: CPU registers and cycle count, RAM, VRAM,
+    // OAM, cartridge RAM and banking, and the I/O registers. Host-side state (framebuffers,
+    // audio output, profiler) is left out, so it does not depend on how the frame was shown.
+    static uint64_t hashState(const MachineState& state);
+    // The state movies start from: the bus and CPU reset, with execution starting at `start_pc`.
+    static void powerOn(Cpu& cpu, Bus& bus, uint16_t start_pc);
+
+private:
+    uint64_t rom_hash_ = 0;
+    uint16_t start_pc_ = 0x0100;
+    bool idle_loop_skipping_ = true;
+    std::vector<uint8_t> inputs_;
+    std::vector<uint64_t> state_hashes_;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef NET_LINK_H
+#define NET_LINK_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Serial.h"
+
+struct NetLinkOptions {
+    std::string rom_path;
+    uint16_t port = 5419;
+    // One process listens on 127.0.0.1:port, the other connects to it.
+    bool listen = false;
+    uint64_t frames = 600;
+    bool idle_loop_skipping = true;
+};
+
+class HeadlessRunner;
+struct MachineState;
+
+// One console's end of a link cable to another process, over a loopback TCP socket. Emulation
+// never waits on the socket for a transfer: a transfer this side clocks uses the peer's byte
+// if it has already arrived and otherwise predicts it (the peer's last answer), and bytes the
+// peer clocked can arrive after this side has passed their time. Either way the console keeps
+// a ring of per-frame save states and, when a message shows that the past went differently,
+// loads the last state before it and re-simulates up to the present. Only running more than
+// MAX_FRAMES_AHEAD frames ahead of the peer (beyond what the ring can undo) waits.
+//
+// Messages are 10 bytes: type, value, and an emulated time (scheduler base T-cycles, the
+// same timeline on both sides since both start from reset):
+//   Transfer(t, v)  the sender clocked a transfer completing at t and shifted out v
+//   Reply(t, v)     the sender shifted out v for the peer's transfer at t
+//   Retract(t)      the sender re-simulated: its Transfers at or after t are void
+//   Clock(t)        the sender has simulated up to t (for pacing)
+//   Done(n)         the sender has run all its frames and processed n content messages
+// The ordering TCP guarantees is relied on (a Retract precedes the Transfers replacing it).
+class NetLink : public SerialLink {
+public:
+    static const uint64_t MAX_FRAMES_AHEAD = 8;
+    // Either side may be up to MAX_FRAMES_AHEAD ahead of the other's last Clock, and a side
+    // that was ahead re-simulates before answering, so corrections reach back about twice that.
+    static const size_t ROLLBACK_FRAMES = 2 * MAX_FRAMES_AHEAD + 4;
+
+    NetLink();
+    ~NetLink();
+
+    // 0 once both consoles have run all their frames, 1 if the ROM or the connection failed.
+    int run(const NetLinkOptions& options);
+
+    void beginTransfer(int side, uint8_t value, uint64_t end_time) override;
+    void cancelTransfer(int side) override;
+    uint8_t finishTransfer(int side) override;
+
+private:
+    enum class MessageType : uint8_t { Transfer, Reply, Retract, Clock, Done };
+    struct Connection;
+
+    // Frame `frame` as it started: the machine, plus the transfer this side was clocking
+    // (which lives here rather than in the machine).
+    struct Snapshot {
+        std::unique_ptr<MachineState> state;
+        uint64_t frame = 0;
+        uint64_t time = 0;
+        bool valid = false;
+        bool transfer_active = false;
+        uint8_t transfer_value = 0;
+        uint64_t transfer_end = 0;
+    };
+
+    void simulateFrame();
+    void applyDueDeliveries();
+    void updateNextDelivery();
+    void rollBack();
+    void requestRollback(uint64_t time);
+    // Retracts the Transfers sent before that the re-simulated timeline has passed without
+    // repeating, and forgets what is older than the ring can reach.
+    void settleFrame();
+
+    void send(MessageType type, uint64_t time, uint8_t value = 0);
+    // Handles every complete message that has arrived, waiting up to `timeout_ms` for the
+    // first. False once the peer has disconnected.
+    bool receive(int timeout_ms);
+    void handleMessage(MessageType type, uint64_t time, uint8_t value);
+
+    std::unique_ptr<Connection> connection_;
+    std::unique_ptr<HeadlessRunner> core_;
+    std::vector<Snapshot> ring_;
+    uint64_t frame_ = 0;
+
+    // This side's transfer in progress (from beginTransfer).
+    bool transfer_active_ = false;
+    uint8_t transfer_value_ = 0;
+    uint64_t transfer_end_ = 0;
+
+    // Bytes the peer clocked, by time; those at or before applied_until_ are in this timeline.
+    std::map<uint64_t, uint8_t> deliveries_;
+    uint64_t applied_until_ = 0;
+    uint64_t next_delivery_ = 0;
+    // Replies sent for them, so a re-simulation only sends the ones that changed.
+    std::map<uint64_t, uint8_t> sent_replies_;
+
+    // Transfers this side sent; those from verify_from_ on belong to a timeline being
+    // re-simulated and are retracted unless it repeats them.
+    std::map<uint64_t, uint8_t> sent_transfers_;
+    uint64_t verify_from_ = 0;
+    // The peer's replies to them, and the byte this timeline used at each (a reply or a
+    // prediction).
+    std::map<uint64_t, uint8_t> replies_;
+    std::map<uint64_t, uint8_t> used_replies_;
+    uint8_t last_reply_ = 0xFF;
+    // History before this has been forgotten (it is older than the ring).
+    uint64_t forgotten_until_ = 0;
+
+    uint64_t rollback_to_;
+    uint64_t peer_clock_ = 0;
+    bool peer_done_ = false;
+    uint64_t peer_received_ = 0;
+    bool peer_gone_ = false;
+    uint64_t content_sent_ = 0;
+    uint64_t content_received_ = 0;
+    bool done_sent_ = false;
+
+    uint64_t mispredictions_ = 0;
+    uint64_t rollbacks_ = 0;
+    uint64_t frames_resimulated_ = 0;
+    uint64_t rollbacks_out_of_range_ = 0;
+};
+
+#endif
@@ -3,156 +3,424 @@
 
 #include "Instruction.h" 
 
+// Register index order used by every r/r' operand: B, C, D, E, H, L, (HL), A.
+// Register pair order: BC, DE, HL, SP (PUSH/POP use AF in place of SP).
 
-class Instr_NOP : public Instruction {
+enum class BranchCondition : uint8_t { NZ, Z, NC, C, Always };
+
+enum class AluOp : uint8_t { ADD, ADC, SUB, SBC, AND, XOR, OR, CP };
+
+enum class ShiftOp : uint8_t { RLC, RRC, RL, RR, SLA, SRA, SWAP, SRL };
+
+
+template <class CpuType>
+class Instr_NOP : public Instruction<CpuType> {
 public:
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_LD_RR_D16 : public Instruction {
+template <class CpuType>
+class Instr_LD_RR_D16 : public Instruction<CpuType> {
     uint8_t rp_index_; 
 public:
     explicit Instr_LD_RR_D16(uint8_t rp);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_LD_MA16_SP : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_INC_R : public Instruction {
+template <class CpuType>
+class Instr_INC_R : public Instruction<CpuType> {
     uint8_t reg_index_; 
 public:
     explicit Instr_INC_R(uint8_t reg);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_LD_R_D8 : public Instruction {
-    uint8_t reg_index_; 
+template <class CpuType>
+class Instr_DEC_R : public Instruction<CpuType> {
+    uint8_t reg_index_;
 public:
-    explicit Instr_LD_R_D8(uint8_t reg);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    explicit Instr_DEC_R(uint8_t reg);
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_ADD_A_R : public Instruction {
-    uint8_t reg_index_; 
+template <class CpuType>
+class Instr_INC_MHL : public Instruction<CpuType> {
 public:
-    explicit Instr_ADD_A_R(uint8_t reg);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_SUB_A_R : public Instruction {
-    uint8_t reg_index_; 
+template <class CpuType>
+class Instr_DEC_MHL : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_INC_RR : public Instruction<CpuType> {
+    uint8_t rp_index_;
+public:
+    explicit Instr_INC_RR(uint8_t rp);
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_DEC_RR : public Instruction<CpuType> {
+    uint8_t rp_index_;
 public:
-    explicit Instr_SUB_A_R(uint8_t reg);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    explicit Instr_DEC_RR(uint8_t rp);
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_XOR_A : public Instruction {
+template <class CpuType>
+class Instr_ADD_HL_RR : public Instruction<CpuType> {
+    uint8_t rp_index_;
 public:
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    explicit Instr_ADD_HL_RR(uint8_t rp);
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_JP_A16 : public Instruction {
+template <class CpuType>
+class Instr_LD_R_D8 : public Instruction<CpuType> {
+    uint8_t reg_index_; 
 public:
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    explicit Instr_LD_R_D8(uint8_t reg);
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_HALT : public Instruction {
+template <class CpuType>
+class Instr_LD_MHL_D8 : public Instruction<CpuType> {
 public:
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_CB_PREFIX : public Instruction {
+template <class CpuType>
+class Instr_LD_R_R : public Instruction<CpuType> {
+    uint8_t dest_reg_index_; 
+    uint8_t src_reg_index_;  
 public:
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    explicit Instr_LD_R_R(uint8_t dest_r, uint8_t src_r);
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_LD_MHL_R : public Instruction {
+template <class CpuType>
+class Instr_LD_MHL_R : public Instruction<CpuType> {
     uint8_t src_reg_index_;
 public:
     explicit Instr_LD_MHL_R(uint8_t src_reg);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    void execute(CpuType& cpu) const override;
+};
+
+
+// rp: 0 = (BC), 1 = (DE), 2 = (HL+), 3 = (HL-)
+template <class CpuType>
+class Instr_LD_A_MRR : public Instruction<CpuType> {
+    uint8_t rp_index_; 
+public:
+    explicit Instr_LD_A_MRR(uint8_t rp);
+    void execute(CpuType& cpu) const override;
+};
+
+
+// rp: 0 = (BC), 1 = (DE), 2 = (HL+), 3 = (HL-)
+template <class CpuType>
+class Instr_LD_MRR_A : public Instruction<CpuType> {
+    uint8_t rp_index_; 
+public:
+    explicit Instr_LD_MRR_A(uint8_t rp);
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_DEC_R : public Instruction {
+template <class CpuType>
+class Instr_LD_A_MA16 : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_LD_MA16_A : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_LDH_A_MA8 : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_LDH_MA8_A : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_LD_A_MC : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_LD_MC_A : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_ALU_A_R : public Instruction<CpuType> {
+    AluOp op_;
     uint8_t reg_index_;
 public:
-    explicit Instr_DEC_R(uint8_t reg);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    Instr_ALU_A_R(AluOp op, uint8_t reg);
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_INC_MHL : public Instruction {
+template <class CpuType>
+class Instr_ALU_A_D8 : public Instruction<CpuType> {
+    AluOp op_;
 public:
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    explicit Instr_ALU_A_D8(AluOp op);
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_LD_MHL_D8 : public Instruction {
+// op: 0 = RLCA, 1 = RRCA, 2 = RLA, 3 = RRA
+template <class CpuType>
+class Instr_ROTATE_A : public Instruction<CpuType> {
+    uint8_t op_index_;
 public:
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    explicit Instr_ROTATE_A(uint8_t op);
+    void execute(CpuType& cpu) const override;
 };
 
-class Instr_LD_R_R : public Instruction {
-    uint8_t dest_reg_index_; 
-    uint8_t src_reg_index_;  
+
+template <class CpuType>
+class Instr_DAA : public Instruction<CpuType> {
 public:
-    explicit Instr_LD_R_R(uint8_t dest_r, uint8_t src_r);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    void execute(CpuType& cpu) const override;
 };
 
-class Instr_LD_A_MRR : public Instruction {
-    uint8_t rp_index_; 
+
+template <class CpuType>
+class Instr_CPL : public Instruction<CpuType> {
 public:
-    explicit Instr_LD_A_MRR(uint8_t rp);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_LD_MRR_A : public Instruction {
-    uint8_t rp_index_; 
+template <class CpuType>
+class Instr_SCF : public Instruction<CpuType> {
 public:
-    explicit Instr_LD_MRR_A(uint8_t rp);
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_LD_A_MA16 : public Instruction {
+template <class CpuType>
+class Instr_CCF : public Instruction<CpuType> {
 public:
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    void execute(CpuType& cpu) const override;
 };
 
 
-class Instr_LD_MA16_A : public Instruction {
+template <class CpuType>
+class Instr_JR : public Instruction<CpuType> {
+    BranchCondition cond_;
+public:
+    explicit Instr_JR(BranchCondition cond);
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_JP_A16 : public Instruction<CpuType> {
+    BranchCondition cond_;
+public:
+    explicit Instr_JP_A16(BranchCondition cond = BranchCondition::Always);
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_JP_HL : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_CALL_A16 : public Instruction<CpuType> {
+    BranchCondition cond_;
+public:
+    explicit Instr_CALL_A16(BranchCondition cond = BranchCondition::Always);
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_RET : public Instruction<CpuType> {
+    BranchCondition cond_;
+public:
+    explicit Instr_RET(BranchCondition cond = BranchCondition::Always);
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_RETI : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_RST : public Instruction<CpuType> {
+    uint16_t vector_;
+public:
+    explicit Instr_RST(uint16_t vector);
+    void execute(CpuType& cpu) const override;
+};
+
+
+// rp: 0 = BC, 1 = DE, 2 = HL, 3 = AF
+template <class CpuType>
+class Instr_PUSH_RR : public Instruction<CpuType> {
+    uint8_t rp_index_;
+public:
+    explicit Instr_PUSH_RR(uint8_t rp);
+    void execute(CpuType& cpu) const override;
+};
+
+
+// rp: 0 = BC, 1 = DE, 2 = HL, 3 = AF
+template <class CpuType>
+class Instr_POP_RR : public Instruction<CpuType> {
+    uint8_t rp_index_;
+public:
+    explicit Instr_POP_RR(uint8_t rp);
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_ADD_SP_E8 : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_LD_HL_SP_E8 : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_LD_SP_HL : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_DI : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_EI : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_HALT : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_STOP : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_CB_PREFIX : public Instruction<CpuType> {
+public:
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_CB_SHIFT : public Instruction<CpuType> {
+    ShiftOp op_;
+    uint8_t reg_index_;
+public:
+    Instr_CB_SHIFT(ShiftOp op, uint8_t reg);
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_CB_BIT : public Instruction<CpuType> {
+    uint8_t bit_;
+    uint8_t reg_index_;
+public:
+    Instr_CB_BIT(uint8_t bit, uint8_t reg);
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_CB_RES : public Instruction<CpuType> {
+    uint8_t bit_;
+    uint8_t reg_index_;
+public:
+    Instr_CB_RES(uint8_t bit, uint8_t reg);
+    void execute(CpuType& cpu) const override;
+};
+
+
+template <class CpuType>
+class Instr_CB_SET : public Instruction<CpuType> {
+    uint8_t bit_;
+    uint8_t reg_index_;
 public:
-    void execute(Cpu& cpu) override;
-    std::string disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) override;
+    Instr_CB_SET(uint8_t bit, uint8_t reg);
+    void execute(CpuType& cpu) const override;
 };
 
-#endif 
\ No newline at end of file
+#endif
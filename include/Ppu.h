@@ -0,0 +1,159 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "PpuRenderer.h"
+
+class Bus;
+
+// LCD controller timing and registers (0xFF40-0xFF4B). LY and the STAT mode are derived from
+// the scheduler clock when read; the only scheduled events are the start of VBlank and, while
+// the game has STAT interrupt sources enabled, the points where the STAT line can rise. A
+// frame with no STAT interrupts therefore costs a single event.
+//
+// Pixels are drawn by catching up: before any register, VRAM or OAM write (and at VBlank) every
+// line whose pixel transfer has started since the last catch-up is rendered from the current
+// state, so mid-frame raster effects land on the right line without a per-line event. With
+// threaded rendering those writes are instead logged with their timestamps and each frame's log
+// is replayed by a RenderWorker while the next frame runs, one frame behind.
+class Ppu {
+public:
+    static const uint32_t CYCLES_PER_LINE = 456;
+    static const uint32_t CYCLES_PER_FRAME = 70224;
+    static const uint8_t VISIBLE_LINES = 144;
+    static const uint8_t TOTAL_LINES = 154;
+    static const int SCREEN_WIDTH = 160;
+    static const int SCREEN_HEIGHT = 144;
+
+    static const uint32_t MODE2_CYCLES = 80;
+    static const uint32_t MODE3_CYCLES = 172;
+
+    static const uint16_t VRAM_BANK_SIZE = 0x2000;
+    static const uint16_t OAM_SIZE = 0xA0;
+
+    enum Mode : uint8_t { MODE_HBLANK = 0, MODE_VBLANK = 1, MODE_OAM_SCAN = 2, MODE_TRANSFER = 3 };
+
+    struct State {
+        uint8_t lcdc, stat, scy, scx, lyc;
+        uint8_t bgp, obp0, obp1, wy, wx;
+        uint64_t lcd_epoch;
+        bool stat_interrupt_line;
+        bool frame_ready;
+        uint64_t frame_count;
+        uint8_t vram_bank;
+        std::array<uint8_t, VRAM_BANK_SIZE * TileCache::BANKS> vram;
+        std::array<uint8_t, OAM_SIZE> oam;
+    };
+
+    explicit Ppu(Bus& bus);
+    ~Ppu();
+
+    void reset();
+    // The renderer and the framebuffers are not part of the state: loading rebuilds the
+    // renderer from VRAM, OAM and the registers (dropping a frame in flight on the worker),
+    // and framebuffer() keeps the last frame drawn until the next one is. The scheduled
+    // events live in the scheduler, which the bus saves alongside.
+    void saveState(State& state) const;
+    void loadState(const State& state);
+    uint8_t read(uint16_t address) const;
+    void write(uint16_t address, uint8_t value);
+
+    // 0x8000-0x9FFF (in the bank VBK selects) and 0xFE00-0xFE9F. Reads have no side effects,
+    // so the bus maps the selected VRAM bank straight into its read page table via
+    // vramBankData(), and remaps it when the bank changes.
+    uint8_t readVram(uint16_t address) const { return vram_[vramIndex(address)]; }
+    void writeVram(uint16_t address, uint8_t value);
+    uint8_t readOam(uint16_t address) const { return oam_[address - 0xFE00]; }
+    void writeOam(uint16_t address, uint8_t value);
+    // DMA copies: the same effect as writing each byte in turn. `data` may point into VRAM.
+    void writeVramBlock(uint16_t address, const uint8_t* data, size_t length);
+    void writeOamBlock(uint16_t offset, const uint8_t* data, size_t length);
+    // VBK (0xFF4F, CGB only); the bus owns the register decoding.
+    uint8_t vramBank() const { return vram_bank_; }
+    void setVramBank(uint8_t bank) {
+        // Code shown at 0x8000 changes with the bank, as far as the debugger is concerned.
+        if ((bank & 1) != vram_bank_) vram_write_generation_++;
+        vram_bank_ = bank & 1;
+    }
+    const uint8_t* vramData() const { return vram_.data(); }
+    const uint8_t* vramBankData() const { return vram_.data() + vram_bank_ * VRAM_BANK_SIZE; }
+    const uint8_t* oamData() const { return oam_.data(); }
+    uint64_t vramWriteGeneration() const { return vram_write_generation_; }
+
+    void onVBlankEvent();
+    void onStatEvent();
+
+    uint8_t ly() const;
+    Mode mode() const;
+    // Start of the next HBlank of a visible line strictly after `after` (NEVER with the LCD off).
+    uint64_t nextHBlankTime(uint64_t after) const;
+    bool isLcdEnabled() const { return (lcdc_ & 0x80) != 0; }
+
+    // Set at the start of VBlank (or every CYCLES_PER_FRAME while the LCD is off).
+    bool consumeFrameReady() { bool ready = frame_ready_; frame_ready_ = false; return ready; }
+    uint64_t frameCount() const { return frame_count_; }
+    // RGBA8888 pixels (red in the lowest byte), row-major: the last completed frame, which with
+    // threaded rendering is the one before the frame that just ended.
+    const std::array<uint32_t, SCREEN_WIDTH * SCREEN_HEIGHT>& framebuffer() const { return framebuffers_[front_framebuffer_]; }
+
+    void setThreadedRendering(bool enabled);
+    bool threadedRendering() const { return threaded_rendering_requested_; }
+    // Frames finished before the one that just ended that framebuffer() shows: 1 while a
+    // render worker is running, 0 otherwise.
+    int presentationLatency() const { return render_worker_ ? 1 : 0; }
+
+    // Frame skipping for fast-forward: frames ended while this is set are not drawn, and
+    // framebuffer() keeps showing the last frame that was. Render-relevant writes are still
+    // tracked, and LY, STAT and interrupt timing do not depend on it. Change it between frames.
+    void setSkipDrawing(bool skip) { skip_drawing_ = skip; }
+
+private:
+    size_t vramIndex(uint16_t address) const { return vram_bank_ * VRAM_BANK_SIZE + (address & (VRAM_BANK_SIZE - 1)); }
+    uint32_t frameCycle(uint64_t time) const { return static_cast<uint32_t>((time - lcd_epoch_) % CYCLES_PER_FRAME); }
+    static Mode modeAt(uint32_t frame_cycle);
+    bool statLineAt(uint64_t time) const;
+    uint64_t nextStatCandidateTime(uint64_t after) const;
+    void scheduleVBlank();
+    void scheduleStat();
+    // Rebuilds the renderer's copies of VRAM, OAM and the registers from the PPU's own.
+    void syncRenderer();
+    void recordRenderWrite(uint16_t address, uint8_t value);
+    void catchUpRendering();
+    void presentRenderedFrame();
+    // Threaded mode: waits for the worker and draws the current frame's log so far inline.
+    void finishRendering();
+
+    Bus& bus_;
+
+    uint8_t lcdc_, stat_, scy_, scx_, lyc_;
+    uint8_t bgp_, obp0_, obp1_, wy_, wx_;
+
+    // Time at which line 0 of the first frame started after the LCD was last switched on.
+    uint64_t lcd_epoch_;
+    bool stat_interrupt_line_;
+    bool frame_ready_;
+    uint64_t frame_count_;
+
+    std::array<uint8_t, VRAM_BANK_SIZE * TileCache::BANKS> vram_;
+    uint8_t vram_bank_ = 0;
+    std::array<uint8_t, OAM_SIZE> oam_;
+    uint64_t vram_write_generation_ = 0;
+
+    PpuRenderer renderer_;
+    std::array<std::array<uint32_t, SCREEN_WIDTH * SCREEN_HEIGHT>, 2> framebuffers_;
+    uint8_t front_framebuffer_ = 0;
+    uint8_t render_target_ = 0;
+    bool threaded_rendering_requested_ = false;
+    bool render_in_flight_ = false;
+    // Whether the frame the worker has in flight is being drawn (false when it was skipped).
+    bool in_flight_drawn_ = false;
+    bool skip_drawing_ = false;
+    std::unique_ptr<RenderWorker> render_worker_;
+    std::vector<RenderWrite> render_log_;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef PPU_RENDERER_H
+#define PPU_RENDERER_H
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "TileCache.h"
+
+// A write that changes what the PPU draws (VRAM, OAM or an LCD register), stamped with the
+// scheduler time at which it happened. VRAM bank 1 is logged at 0xA000-0xBFFF (the address
+// the write would have in a flat 16 KiB VRAM), so the log does not depend on VBK.
+struct RenderWrite {
+    uint64_t time;
+    uint16_t address;
+    uint8_t value;
+};
+
+// Scanline renderer with its own copy of VRAM, OAM and the drawing registers, kept in step by
+// applying the Ppu's render-relevant writes. The Ppu either drives it inline (catch up, then
+// apply each write as it happens) or hands a whole frame's write log to a RenderWorker; both go
+// through replay(), so they produce the same pixels.
+class PpuRenderer {
+public:
+    PpuRenderer();
+
+    void reset();
+    // Lines are drawn into `target` (Ppu::SCREEN_WIDTH * Ppu::SCREEN_HEIGHT pixels).
+    void setTarget(uint32_t* target) { target_ = target; }
+    void apply(uint16_t address, uint8_t value);
+    // Replaces the VRAM and OAM copies wholesale (after a state load); the next replay starts
+    // its frame from line 0.
+    void loadMemory(const uint8_t* vram, const uint8_t* oam);
+
+    // Draws every line of the frame starting at `frame_start` whose pixel transfer began by
+    // `end_time`, first applying each logged write made before that line's transfer; writes
+    // left over are applied at the end. Lines already drawn for this frame are skipped. With
+    // `draw` false the writes are applied and the lines counted as done, but no pixels are
+    // produced (a frame that will not be displayed).
+    void replay(const RenderWrite* writes, size_t count, uint64_t frame_start, uint64_t end_time, bool draw);
+
+private:
+    void renderLine(uint8_t line);
+    void renderBackgroundSpan(uint8_t line, uint16_t map_base, uint8_t map_y, uint8_t map_x, int first_x, uint8_t* bg_indices);
+    void renderSprites(uint8_t line, const uint8_t* bg_indices);
+    int tileIndex(uint8_t map_entry, bool sprite) const;
+    static void decodePalette(uint8_t value, std::array<uint32_t, 4>& colors);
+
+    std::array<uint8_t, 0x2000 * TileCache::BANKS> vram_;
+    std::array<uint8_t, 0xA0> oam_;
+    uint8_t lcdc_, scy_, scx_, wy_, wx_;
+    std::array<uint32_t, 4> bg_colors_;
+    std::array<std::array<uint32_t, 4>, 2> obj_colors_;
+    TileCache tile_cache_;
+
+    uint32_t* target_;
+    // Start time of the frame being drawn, the next line to draw in it and the window's own
+    // line counter (it only advances on lines where the window was visible).
+    uint64_t frame_start_;
+    uint8_t next_line_;
+    uint8_t window_line_;
+};
+
+// Replays logged frames on a thread of its own, so frame N is drawn while the CPU runs frame
+// N+1. The renderer belongs to the worker between submit() and the next wait().
+class RenderWorker {
+public:
+    explicit RenderWorker(PpuRenderer& renderer);
+    ~RenderWorker();
+
+    // Waits for the previous frame, then starts replaying `log` into `target` (see
+    // PpuRenderer::replay for `draw`). The log is swapped for the worker's previous (emptied)
+    // one rather than copied.
+    void submit(std::vector<RenderWrite>& log, uint64_t frame_start, uint64_t end_time, uint32_t* target, bool draw);
+    // Blocks until the last submitted frame has been drawn.
+    void wait();
+
+private:
+    void run();
+
+    PpuRenderer& renderer_;
+    std::vector<RenderWrite> log_;
+    uint64_t frame_start_ = 0;
+    uint64_t end_time_ = 0;
+    uint32_t* target_ = nullptr;
+    bool draw_ = true;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    bool pending_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <cstdint>
+
+// Per-opcode execution counters gathered by Cpu::step. Labels come from OpcodeTable.
+struct CpuProfiler {
+    bool enabled = true;
+
+    std::array<uint64_t, 256> opcode_counts{};
+    std::array<uint64_t, 256> opcode_cycles{};
+    std::array<uint64_t, 256> cb_opcode_counts{};
+    uint64_t instructions_executed = 0;
+    uint64_t interrupts_serviced = 0;
+    // Cycles a halted CPU jumped over by fast-forwarding to the next scheduled event.
+    uint64_t halt_cycles_skipped = 0;
+    uint64_t idle_loops_skipped = 0;
+    uint64_t idle_cycles_skipped = 0;
+
+    void reset() {
+        opcode_counts.fill(0);
+        opcode_cycles.fill(0);
+        cb_opcode_counts.fill(0);
+        instructions_executed = 0;
+        interrupts_serviced = 0;
+        halt_cycles_skipped = 0;
+        idle_loops_skipped = 0;
+        idle_cycles_skipped = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef REGRESSION_RUNNER_H
+#define REGRESSION_RUNNER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct RegressionOptions {
+    std::string rom_directory;
+    std::string manifest_path;
+    uint64_t frames = 600;
+    // Frame hashes are compared every this many frames, and after the last frame.
+    uint64_t checkpoint_interval = 60;
+    unsigned jobs = 0; // 0 = one per hardware thread
+    bool idle_loop_skipping = true;
+    // Write the manifest from this run instead of comparing against it.
+    bool update_manifest = false;
+};
+
+// Golden-image regression runs: every ROM (*.gb, *.gbc) in a directory runs headless for a
+// fixed number of frames with no input, ROMs in parallel, and the hash of each checkpoint
+// frame is compared against a manifest of known-good hashes.
+//
+// The manifest is text, one checkpoint per line: "<rom file name> <frame> <hash in hex>";
+// blank lines and lines starting with '#' are ignored.
+class RegressionRunner {
+public:
+    // 0 if every checkpoint matched (or the manifest was written), 2 if any did not, 1 if the
+    // run could not be set up.
+    int run(const RegressionOptions& options);
+
+private:
+    struct Checkpoint {
+        uint64_t frame;
+        uint64_t hash;
+    };
+
+    struct RomResult {
+        std::string name;
+        std::string path;
+        bool loaded = false;
+        std::vector<Checkpoint> checkpoints;
+        double milliseconds = 0.0;
+    };
+
+    static void runRom(RomResult& result, const RegressionOptions& options);
+    static bool readManifest(const std::string& path, std::vector<std::pair<std::string, Checkpoint>>& entries);
+    static bool writeManifest(const std::string& path, const std::vector<RomResult>& results);
+};
+
+#endif
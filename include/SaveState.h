@@ -0,0 +1,26 @@
+#ifndef SAVE_STATE_H
+#define SAVE_STATE_H
+
+#include "Cpu.h"
+#include "Bus.h"
+
+// A complete machine state: the Cpu (trivially copyable, so a plain copy) and everything behind
+// its bus, cartridge RAM and bank registers included. Saving into the same MachineState again
+// does not allocate, which is what makes per-frame save/load (run-ahead) cheap. It is not a
+// file format: a state is only valid in the same process with the same ROM loaded.
+struct MachineState {
+    Cpu cpu;
+    Bus::State bus;
+
+    void save(const Cpu& from_cpu, const Bus& from_bus) {
+        cpu = from_cpu;
+        from_bus.saveState(bus);
+    }
+
+    void load(Cpu& to_cpu, Bus& to_bus) const {
+        to_bus.loadState(bus);
+        to_cpu.loadState(cpu);
+    }
+};
+
+#endif
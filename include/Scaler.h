@@ -0,0 +1,56 @@
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU upscaling filters, for hosts where the GPU cannot (or should not) do it.
+enum class ScaleFilter : uint8_t {
+    None,
+    Nearest2x,
+    Nearest3x,
+    Nearest4x,
+    Scale2x, // AdvMAME2x / EPX: corners take an edge colour where two neighbours agree
+    Scale3x,
+    Scale4x, // Scale2x applied twice
+    Hq2x,    // Scale2x's rules with hqx-style YUV similarity, blending corners instead of replacing
+    Count
+};
+
+// Runs the optional CGB colour correction and a ScaleFilter over a frame, into buffers kept
+// between calls (steady-state processing does not allocate). Pixels are as the PPU produces
+// them: R in the low byte, then G, B, A. The filters have SSE2 paths, four pixels per step,
+// and scalar versions with identical output (used for the tail of a row, and everywhere
+// with GBC_NO_SIMD).
+class FrameScaler {
+public:
+    static int factor(ScaleFilter filter);
+    static const char* name(ScaleFilter filter);
+
+    // The result stays valid until the next call (or is `pixels` itself when there is
+    // nothing to do).
+    const uint32_t* process(const uint32_t* pixels, int width, int height, ScaleFilter filter, bool color_correction);
+    int outputWidth() const { return output_width_; }
+    int outputHeight() const { return output_height_; }
+
+    // Maps each pixel through a 32K-entry table indexed by its RGB555 value, approximating
+    // how the CGB's LCD mixes and desaturates colours. In place.
+    static void correctColors(uint32_t* pixels, size_t count);
+
+private:
+    const uint32_t* scale(const uint32_t* pixels, int width, int height, ScaleFilter filter, std::vector<uint32_t>& out);
+    // Copies a frame into padded_ with a one-pixel border repeated from its edges, so every
+    // 3x3 neighbourhood read is in bounds.
+    void pad(const uint32_t* pixels, int width, int height);
+
+    std::vector<uint32_t> corrected_;
+    std::vector<uint32_t> padded_;
+    std::vector<uint32_t> keys_; // YUV per padded pixel (Hq2x)
+    std::vector<uint32_t> intermediate_;
+    std::vector<uint32_t> output_;
+    int output_width_ = 0;
+    int output_height_ = 0;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+// Every component that changes state on its own (PPU modes, timer overflow, ...) registers
+// the T-cycle timestamp of its next event here instead of being ticked per instruction.
+// Bus::tick advances `now` and dispatches the events that fell due, and a halted CPU can
+// jump straight to nextEventTime().
+//
+// Time is counted in base T-cycles (4.194304 MHz, one PPU dot), whatever the CPU speed. In
+// CGB double speed the CPU runs twice as fast: its cycles are converted on the way in
+// (advanceCpu) and out (toCpuCycles), and the CPU clock (cpuNow) keeps counting at the CPU's
+// own rate for the components clocked by it (the timer), so nothing else checks the speed.
+enum class SchedulerEvent : uint8_t {
+    PpuVBlank,
+    PpuStat,
+    TimerOverflow,
+    OamDmaEnd,
+    VramDmaHBlank,
+    SerialTransfer,
+    LinkSync, // nothing happens; a link cable stops the CPU there (HALT and idle-loop skips too)
+    Count
+};
+
+class Scheduler {
+public:
+    static constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+
+    Scheduler() { reset(); }
+
+    void reset() {
+        now_ = 0;
+        speed_shift_ = 0;
+        cpu_clock_epoch_ = 0;
+        time_epoch_ = 0;
+        event_times_.fill(NEVER);
+        next_event_time_ = NEVER;
+    }
+
+    uint64_t now() const { return now_; }
+    uint64_t nextEventTime() const { return next_event_time_; }
+
+    void advance(uint64_t cycles) { now_ += cycles; }
+    // `cycles` at the current CPU speed (a multiple of 2 in double speed).
+    void advanceCpu(uint64_t cycles) { now_ += cycles >> speed_shift_; }
+    uint64_t toCpuCycles(uint64_t cycles) const { return cycles << speed_shift_; }
+
+    bool doubleSpeed() const { return speed_shift_ != 0; }
+    void setDoubleSpeed(bool enabled) {
+        cpu_clock_epoch_ = cpuNow();
+        time_epoch_ = now_;
+        speed_shift_ = enabled ? 1 : 0;
+    }
+    // CPU cycles since reset; continuous across speed switches.
+    uint64_t cpuNow() const { return cpu_clock_epoch_ + ((now_ - time_epoch_) << speed_shift_); }
+    // The first time at which cpuNow() >= `cpu_clock` (which must not be in the past), at the
+    // current speed.
+    uint64_t timeAtCpuClock(uint64_t cpu_clock) const {
+        uint64_t rounding = (1ull << speed_shift_) - 1;
+        return time_epoch_ + ((cpu_clock - cpu_clock_epoch_ + rounding) >> speed_shift_);
+    }
+
+    void schedule(SchedulerEvent event, uint64_t time) {
+        event_times_[static_cast<size_t>(event)] = time;
+        updateNextEventTime();
+    }
+
+    void cancel(SchedulerEvent event) {
+        schedule(event, NEVER);
+    }
+
+    uint64_t eventTime(SchedulerEvent event) const {
+        return event_times_[static_cast<size_t>(event)];
+    }
+
+    // Removes and returns the earliest event if it is due; returns Count otherwise.
+    SchedulerEvent popDueEvent() {
+        if (now_ < next_event_time_) return SchedulerEvent::Count;
+        size_t earliest = 0;
+        for (size_t i = 1; i < event_times_.size(); ++i) {
+            if (event_times_[i] < event_times_[earliest]) earliest = i;
+        }
+        event_times_[earliest] = NEVER;
+        updateNextEventTime();
+        return static_cast<SchedulerEvent>(earliest);
+    }
+
+private:
+    void updateNextEventTime() {
+        next_event_time_ = NEVER;
+        for (uint64_t t : event_times_) {
+            if (t < next_event_time_) next_event_time_ = t;
+        }
+    }
+
+    uint64_t now_;
+    uint64_t next_event_time_;
+    uint32_t speed_shift_; // 1 in double speed
+    // cpuNow() was cpu_clock_epoch_ at time_epoch_, the last speed switch.
+    uint64_t cpu_clock_epoch_;
+    uint64_t time_epoch_;
+    std::array<uint64_t, static_cast<size_t>(SchedulerEvent::Count)> event_times_;
+};
+
+#endif
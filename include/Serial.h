@@ -0,0 +1,65 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <cstdint>
+
+class Bus;
+
+// The far end of a serial port's cable: another core in this process (LinkCable) or in another
+// one (NetLink). The port reports the transfers it clocks; `side` is the end it was connected as.
+class SerialLink {
+public:
+    virtual ~SerialLink() = default;
+    virtual void beginTransfer(int side, uint8_t value, uint64_t end_time) = 0;
+    virtual void cancelTransfer(int side) = 0;
+    // At the completion time; returns the byte shifted in.
+    virtual uint8_t finishTransfer(int side) = 0;
+};
+
+// SB/SC (0xFF01-0xFF02). A transfer clocked by this side (SC bit 0) is one scheduled event
+// 8 serial clocks after the SC write; its byte is swapped with the other end of the link cable
+// as a whole when it completes, and with no cable connected 0xFF is shifted in. A transfer
+// clocked by the other side only completes when the cable delivers a byte (receive).
+class Serial {
+public:
+    // Serial clock periods in CPU T-cycles (so twice as fast in CGB double speed): 8192 Hz,
+    // or 262144 Hz with the CGB's SC bit 1.
+    static const uint32_t BIT_CYCLES = 512;
+    static const uint32_t FAST_BIT_CYCLES = 16;
+
+    // The cable is host state, not part of this; the transfer event lives in the scheduler.
+    struct State {
+        uint8_t data;
+        uint8_t control;
+    };
+
+    explicit Serial(Bus& bus);
+
+    void reset();
+    void saveState(State& state) const;
+    void loadState(const State& state);
+    // `side` is this console's end of the cable (0 or 1); null disconnects.
+    void connectLink(SerialLink* link, int side) { link_ = link; link_side_ = side; }
+
+    uint8_t read(uint16_t address) const;
+    void write(uint16_t address, uint8_t value);
+    void onTransferEvent();
+
+    // A byte clocked in by the other console. Completes a transfer waiting for the external
+    // clock and returns the byte shifted out; with none waiting nothing changes and the other
+    // side sees 0xFF (an idle line).
+    uint8_t receive(uint8_t value);
+
+private:
+    bool transferActive() const { return (control_ & 0x80) != 0; }
+    bool internalClock() const { return (control_ & 0x01) != 0; }
+    void completeTransfer(uint8_t value);
+
+    Bus& bus_;
+    SerialLink* link_ = nullptr;
+    int link_side_ = 0;
+    uint8_t data_;    // SB
+    uint8_t control_; // SC bits 7, 1 and 0 as written
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SPSC_RING_BUFFER_H
+#define SPSC_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded single-producer/single-consumer queue. push() is only called from one thread and
+// pop() from one other thread; neither ever blocks or allocates after construction.
+template <typename T>
+class SpscRingBuffer {
+public:
+    // Capacity is rounded up to a power of two.
+    explicit SpscRingBuffer(size_t capacity) {
+        size_t rounded = 1;
+        while (rounded < capacity) rounded <<= 1;
+        buffer_.resize(rounded);
+        mask_ = rounded - 1;
+    }
+
+    size_t capacity() const { return buffer_.size(); }
+
+    // Number of elements currently queued (approximate when read from the other thread).
+    size_t size() const {
+        return write_index_.load(std::memory_order_acquire) - read_index_.load(std::memory_order_acquire);
+    }
+
+    bool push(const T& value) {
+        return push(&value, 1) == 1;
+    }
+
+    bool pop(T& out) {
+        return pop(&out, 1) == 1;
+    }
+
+    // Returns how many elements were written; the rest are dropped by the caller.
+    size_t push(const T* data, size_t count) {
+        size_t write = write_index_.load(std::memory_order_relaxed);
+        size_t read = read_index_.load(std::memory_order_acquire);
+        size_t free_space = buffer_.size() - (write - read);
+        if (count > free_space) count = free_space;
+        for (size_t i = 0; i < count; ++i) {
+            buffer_[(write + i) & mask_] = data[i];
+        }
+        write_index_.store(write + count, std::memory_order_release);
+        return count;
+    }
+
+    // Returns how many elements were read.
+    size_t pop(T* out, size_t count) {
+        size_t read = read_index_.load(std::memory_order_relaxed);
+        size_t write = write_index_.load(std::memory_order_acquire);
+        size_t available = write - read;
+        if (count > available) count = available;
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = buffer_[(read + i) & mask_];
+        }
+        read_index_.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    std::vector<T> buffer_;
+    size_t mask_;
+    // Kept on separate cache lines so producer and consumer do not false-share.
+    alignas(64) std::atomic<size_t> write_index_{ 0 };
+    alignas(64) std::atomic<size_t> read_index_{ 0 };
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <cstdint>
+#include <array>
+
+// Decoded copies of the 384 tiles (0x8000-0x97FF) of each VRAM bank: one colour index (0-3)
+// per byte, both as stored and mirrored horizontally, so drawing a tile row is a copy through
+// a palette. VRAM writes only mark the tile they touch; it is decoded again the next time the
+// renderer asks for it. Vertical flips just pick a different row.
+class TileCache {
+public:
+    static const int BANKS = 2; // bank 1 is CGB-only
+    static const int TILES_PER_BANK = 384;
+    static const uint16_t TILE_DATA_SIZE = TILES_PER_BANK * 16;
+
+    TileCache();
+
+    void invalidateAll();
+    void markDirty(int bank, uint16_t vram_offset) {
+        if (vram_offset < TILE_DATA_SIZE) dirty_[bank][vram_offset >> 4] = 1;
+    }
+
+    // The eight colour indices of `row` (0-7) of `tile`; `bank_data` is the start of that
+    // VRAM bank, used to re-decode the tile if it is dirty.
+    const uint8_t* row(const uint8_t* bank_data, int bank, int tile, int row, bool x_flip) {
+        if (dirty_[bank][tile]) decode(bank_data, bank, tile);
+        const Tile& decoded = tiles_[bank][tile];
+        return (x_flip ? decoded.flipped : decoded.pixels) + row * 8;
+    }
+
+private:
+    struct Tile {
+        uint8_t pixels[64];
+        uint8_t flipped[64];
+    };
+
+    void decode(const uint8_t* bank_data, int bank, int tile);
+
+    std::array<std::array<Tile, TILES_PER_BANK>, BANKS> tiles_;
+    std::array<std::array<uint8_t, TILES_PER_BANK>, BANKS> dirty_;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <cstdint>
+
+class Bus;
+
+// DIV/TIMA/TMA/TAC (0xFF04-0xFF07). DIV and TIMA are derived from the scheduler's CPU clock
+// when read (so they run twice as fast in CGB double speed); only the TIMA overflow is a
+// scheduled event.
+class Timer {
+public:
+    // Times are on the CPU clock (Scheduler::cpuNow).
+    struct State {
+        uint64_t div_epoch;
+        uint64_t tima_last_update;
+        uint8_t tima;
+        uint8_t tma;
+        uint8_t tac;
+    };
+
+    explicit Timer(Bus& bus);
+
+    void reset();
+    // The overflow event lives in the scheduler, which the bus saves alongside.
+    void saveState(State& state) const;
+    void loadState(const State& state);
+    uint8_t read(uint16_t address);
+    void write(uint16_t address, uint8_t value);
+
+    void onOverflowEvent();
+
+private:
+    uint64_t internalCounter(uint64_t cpu_clock) const { return cpu_clock - div_epoch_; }
+    bool isEnabled() const { return (tac_ & 0x04) != 0; }
+    int periodShift() const;
+    void catchUpTima();
+    void scheduleOverflow();
+
+    Bus& bus_;
+    uint64_t div_epoch_;
+    uint64_t tima_last_update_;
+    uint8_t tima_;
+    uint8_t tma_;
+    uint8_t tac_;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer triple buffer. The producer fills back() and
+// publish()es it; the consumer calls update() and reads front(). Each side owns one slot and
+// the third is exchanged through an atomic index, so neither side ever waits for the other and
+// the consumer always sees the most recently published value.
+template <typename T>
+class TripleBuffer {
+public:
+    T& back() { return slots_[back_]; }
+
+    void publish() {
+        back_ = middle_.exchange(static_cast<uint8_t>(back_ | DIRTY), std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Returns true if a newer value was published since the last call.
+    bool update() {
+        if ((middle_.load(std::memory_order_relaxed) & DIRTY) == 0) return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& front() const { return slots_[front_]; }
+
+private:
+    static const uint8_t INDEX_MASK = 0x03;
+    static const uint8_t DIRTY = 0x04;
+
+    T slots_[3];
+    uint8_t back_ = 0;
+    uint8_t front_ = 1;
+    std::atomic<uint8_t> middle_{ 2 };
+};
+
+#endif
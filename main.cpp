@@ -1,12 +1,141 @@
 #include "Config.h"
 #include "Emulator.h"
+#include "HeadlessRunner.h"
+#include "RegressionRunner.h"
+#include "LinkRunner.h"
+#include "NetLink.h"
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstdlib>
 
-int main() {
+namespace {
+    void printUsage() {
+        std::cout << "Usage: gbc_emu [--headless <rom> [--frames N | --movie <file>] [--no-idle-skip]]" << std::endl;
+        std::cout << "       gbc_emu --dma-test" << std::endl;
+        std::cout << "       gbc_emu --regress <rom dir> --manifest <file> [--frames N] [--checkpoint N] [--jobs N]" << std::endl;
+        std::cout << "               [--update-manifest] [--no-idle-skip]" << std::endl;
+        std::cout << "       gbc_emu --link <rom 1> <rom 2> [--frames N] [--link-drift cycles] [--no-idle-skip]" << std::endl;
+        std::cout << "       gbc_emu --link-test [--link-test-roms <dir>] [--link-drift cycles] [--no-idle-skip]" << std::endl;
+        std::cout << "       gbc_emu --net-link <rom> (--listen <port> | --connect <port>) [--frames N] [--no-idle-skip]" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
     bool load_real_rom_on_startup = false;
 
+    HeadlessOptions headless_options;
+    bool headless = false;
+    bool dma_test = false;
+    RegressionOptions regression_options;
+    bool regression = false;
+    LinkOptions link_options;
+    bool link = false;
+    bool link_test = false;
+    std::string link_test_rom_directory;
+    NetLinkOptions net_link_options;
+    bool net_link = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--headless" && i + 1 < argc) {
+            headless = true;
+            headless_options.rom_path = argv[++i];
+        }
+        else if (arg == "--dma-test") {
+            dma_test = true;
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            headless_options.frames = std::strtoull(argv[++i], nullptr, 10);
+            regression_options.frames = headless_options.frames;
+            link_options.frames = headless_options.frames;
+            net_link_options.frames = headless_options.frames;
+        }
+        else if (arg == "--movie" && i + 1 < argc) {
+            headless_options.movie_path = argv[++i];
+        }
+        else if (arg == "--regress" && i + 1 < argc) {
+            regression = true;
+            regression_options.rom_directory = argv[++i];
+        }
+        else if (arg == "--manifest" && i + 1 < argc) {
+            regression_options.manifest_path = argv[++i];
+        }
+        else if (arg == "--checkpoint" && i + 1 < argc) {
+            regression_options.checkpoint_interval = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--jobs" && i + 1 < argc) {
+            regression_options.jobs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--link" && i + 2 < argc) {
+            link = true;
+            link_options.rom_paths[0] = argv[++i];
+            link_options.rom_paths[1] = argv[++i];
+        }
+        else if (arg == "--link-drift" && i + 1 < argc) {
+            link_options.max_drift = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--link-test") {
+            link_test = true;
+        }
+        else if (arg == "--link-test-roms" && i + 1 < argc) {
+            link_test_rom_directory = argv[++i];
+        }
+        else if (arg == "--net-link" && i + 1 < argc) {
+            net_link = true;
+            net_link_options.rom_path = argv[++i];
+        }
+        else if ((arg == "--listen" || arg == "--connect") && i + 1 < argc) {
+            net_link_options.listen = arg == "--listen";
+            net_link_options.port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--update-manifest") {
+            regression_options.update_manifest = true;
+        }
+        else if (arg == "--no-idle-skip") {
+            headless_options.idle_loop_skipping = false;
+            regression_options.idle_loop_skipping = false;
+            link_options.idle_loop_skipping = false;
+            net_link_options.idle_loop_skipping = false;
+        }
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (regression) {
+        if (regression_options.manifest_path.empty()) {
+            printUsage();
+            return 1;
+        }
+        RegressionRunner runner;
+        return runner.run(regression_options);
+    }
+
+    if (net_link) {
+        NetLink net;
+        return net.run(net_link_options);
+    }
+
+    if (link_test) {
+        LinkRunner runner;
+        return runner.runSelfTest(link_options, link_test_rom_directory);
+    }
+
+    if (link) {
+        LinkRunner runner;
+        return runner.run(link_options);
+    }
+
+    if (dma_test) {
+        return HeadlessRunner::runDmaSelfTest();
+    }
+
+    if (headless) {
+        HeadlessRunner runner;
+        return runner.run(headless_options);
+    }
+
     Emulator gbc_emulator;
 
     if (load_real_rom_on_startup) {
@@ -34,4 +163,4 @@ int main() {
 
     std::cout << "All operations finished." << std::endl;
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,424 @@
+#include "Apu.h"
+#include "Bus.h"
+
+#include <algorithm>
+
+namespace {
+    // Bits that always read back as 1, indexed by address - 0xFF10.
+    const uint8_t READ_MASKS[0x20] = {
+        0x80, 0x3F, 0x00, 0xFF, 0xBF, // NR10-NR14
+        0xFF, 0x3F, 0x00, 0xFF, 0xBF, // (unused), NR21-NR24
+        0x7F, 0xFF, 0x9F, 0xFF, 0xBF, // NR30-NR34
+        0xFF, 0xFF, 0x00, 0x00, 0xBF, // (unused), NR41-NR44
+        0x00, 0x00, 0x70,             // NR50-NR52
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+    };
+
+    const uint8_t DUTY_PATTERNS[4] = { 0x01, 0x81, 0x87, 0x7E };
+
+    const uint8_t NR52 = 0x16;
+}
+
+Apu::Apu(Bus& bus)
+    : bus_(bus), output_(nullptr), muted_(false), blip_left_(), blip_right_(), dropped_samples_(0) {
+    blip_left_.setRates(CLOCK_RATE, 48000);
+    blip_right_.setRates(CLOCK_RATE, 48000);
+    reset();
+}
+
+void Apu::reset() {
+    registers_.fill(0);
+    wave_ram_.fill(0);
+    for (Channel& ch : channels_) {
+        ch = Channel{};
+    }
+    power_ = true;
+    registers_[0x14] = 0x77; // NR50
+    registers_[0x15] = 0xF3; // NR51
+    lfsr_ = 0x7FFF;
+    sweep_shadow_frequency_ = 0;
+    sweep_timer_ = 8;
+    sweep_enabled_ = false;
+
+    uint64_t now = bus_.scheduler().now();
+    frame_sequencer_step_ = 0;
+    next_frame_sequencer_time_ = now + FRAME_SEQUENCER_PERIOD;
+    last_time_ = now;
+    frame_start_time_ = now;
+    mix_left_ = 0;
+    mix_right_ = 0;
+    blip_left_.clear();
+    blip_right_.clear();
+}
+
+void Apu::setOutput(SpscRingBuffer<int16_t>* ring, int sample_rate) {
+    catchUp();
+    output_ = ring;
+    blip_left_.setRates(CLOCK_RATE, sample_rate);
+    blip_right_.setRates(CLOCK_RATE, sample_rate);
+    blip_left_.clear();
+    blip_right_.clear();
+    frame_samples_.assign(2 * 4096, 0);
+    frame_start_time_ = last_time_;
+}
+
+void Apu::saveState(State& state) const {
+    state.registers = registers_;
+    state.wave_ram = wave_ram_;
+    state.channels = channels_;
+    state.power = power_;
+    state.lfsr = lfsr_;
+    state.sweep_shadow_frequency = sweep_shadow_frequency_;
+    state.sweep_timer = sweep_timer_;
+    state.sweep_enabled = sweep_enabled_;
+    state.frame_sequencer_step = frame_sequencer_step_;
+    state.next_frame_sequencer_time = next_frame_sequencer_time_;
+    state.last_time = last_time_;
+    state.frame_start_time = frame_start_time_;
+    state.mix_left = mix_left_;
+    state.mix_right = mix_right_;
+}
+
+void Apu::loadState(const State& state) {
+    registers_ = state.registers;
+    wave_ram_ = state.wave_ram;
+    channels_ = state.channels;
+    power_ = state.power;
+    lfsr_ = state.lfsr;
+    sweep_shadow_frequency_ = state.sweep_shadow_frequency;
+    sweep_timer_ = state.sweep_timer;
+    sweep_enabled_ = state.sweep_enabled;
+    frame_sequencer_step_ = state.frame_sequencer_step;
+    next_frame_sequencer_time_ = state.next_frame_sequencer_time;
+    last_time_ = state.last_time;
+    frame_start_time_ = state.frame_start_time;
+    mix_left_ = state.mix_left;
+    mix_right_ = state.mix_right;
+}
+
+void Apu::setOutputRate(double sample_rate) {
+    blip_left_.setRates(CLOCK_RATE, sample_rate);
+    blip_right_.setRates(CLOCK_RATE, sample_rate);
+}
+
+void Apu::endFrame() {
+    uint64_t now = bus_.scheduler().now();
+    runUntil(now);
+    if (synthesizing()) {
+        uint32_t duration = static_cast<uint32_t>(std::min<uint64_t>(now - frame_start_time_, UINT32_MAX));
+        blip_left_.endFrame(duration);
+        blip_right_.endFrame(duration);
+        int frames = std::min(blip_left_.samplesAvailable(), static_cast<int>(frame_samples_.size() / 2));
+        blip_left_.readSamples(frame_samples_.data(), frames, 2);
+        blip_right_.readSamples(frame_samples_.data() + 1, frames, 2);
+        // The emulation thread never waits for the audio device; overflow is dropped and counted.
+        size_t pushed = output_->push(frame_samples_.data(), static_cast<size_t>(frames) * 2);
+        dropped_samples_ += static_cast<size_t>(frames) * 2 - pushed;
+    }
+    frame_start_time_ = now;
+}
+
+void Apu::catchUp() {
+    runUntil(bus_.scheduler().now());
+}
+
+void Apu::runUntil(uint64_t time) {
+    while (last_time_ < time) {
+        uint64_t segment_end = std::min(time, next_frame_sequencer_time_);
+        for (int i = 0; i < 4; ++i) {
+            runChannel(i, segment_end);
+        }
+        last_time_ = segment_end;
+        if (last_time_ == next_frame_sequencer_time_) {
+            clockFrameSequencer();
+            next_frame_sequencer_time_ += FRAME_SEQUENCER_PERIOD;
+            updateOutputs(last_time_);
+        }
+    }
+}
+
+uint32_t Apu::channelPeriod(int index) const {
+    const Channel& ch = channels_[index];
+    switch (index) {
+    case 0:
+    case 1: return (2048u - ch.frequency) * 4u;
+    case 2: return (2048u - ch.frequency) * 2u;
+    default: {
+        uint8_t nr43 = registers_[0x12];
+        uint32_t divisor = (nr43 & 0x07) ? (nr43 & 0x07) * 16u : 8u;
+        return divisor << (nr43 >> 4);
+    }
+    }
+}
+
+void Apu::runChannel(int index, uint64_t end) {
+    Channel& ch = channels_[index];
+    if (!ch.enabled || ch.next_step_time > end) return;
+
+    uint32_t period = channelPeriod(index);
+    if (!synthesizing()) {
+        // Nothing is listening: only the waveform position and the noise LFSR matter (they must
+        // end up the same with or without an output, for save states and movie hashes), so
+        // advance them without mixing. The position wraps arithmetically; the LFSR has to step.
+        uint64_t steps = (end - ch.next_step_time) / period + 1;
+        if (index == 3) {
+            for (uint64_t i = 0; i < steps; ++i) stepWaveform(3);
+        } else {
+            ch.position = static_cast<uint8_t>((ch.position + steps) & (index == 2 ? 31 : 7));
+        }
+        ch.next_step_time += steps * period;
+        return;
+    }
+    while (ch.next_step_time <= end) {
+        uint64_t time = ch.next_step_time;
+        stepWaveform(index);
+        ch.next_step_time += period;
+        updateOutputs(time);
+    }
+}
+
+void Apu::stepWaveform(int index) {
+    Channel& ch = channels_[index];
+    switch (index) {
+    case 0:
+    case 1:
+        ch.position = (ch.position + 1) & 7;
+        break;
+    case 2:
+        ch.position = (ch.position + 1) & 31;
+        break;
+    default: {
+        uint16_t bit = (lfsr_ ^ (lfsr_ >> 1)) & 1;
+        lfsr_ = static_cast<uint16_t>((lfsr_ >> 1) | (bit << 14));
+        if (registers_[0x12] & 0x08) {
+            lfsr_ = static_cast<uint16_t>((lfsr_ & ~0x40) | (bit << 6));
+        }
+        break;
+    }
+    }
+}
+
+void Apu::updateOutputs(uint64_t time) {
+    int left = 0;
+    int right = 0;
+    uint8_t panning = registers_[0x15];
+    for (int i = 0; i < 4; ++i) {
+        Channel& ch = channels_[i];
+        uint8_t level = 0;
+        if (power_ && ch.enabled && ch.dac_enabled) {
+            switch (i) {
+            case 0:
+            case 1:
+                level = ((DUTY_PATTERNS[ch.duty] >> (7 - ch.position)) & 1) ? ch.volume : 0;
+                break;
+            case 2: {
+                uint8_t volume_code = (registers_[0x0C] >> 5) & 0x03;
+                uint8_t sample = wave_ram_[ch.position >> 1];
+                sample = (ch.position & 1) ? (sample & 0x0F) : (sample >> 4);
+                level = volume_code ? static_cast<uint8_t>(sample >> (volume_code - 1)) : 0;
+                break;
+            }
+            default:
+                level = (lfsr_ & 1) ? 0 : ch.volume;
+                break;
+            }
+        }
+        ch.output = level;
+        if (panning & (0x10 << i)) left += level;
+        if (panning & (0x01 << i)) right += level;
+    }
+    uint8_t master = registers_[0x14];
+    left *= ((master >> 4) & 0x07) + 1;
+    right *= (master & 0x07) + 1;
+
+    if (synthesizing()) {
+        uint32_t clock_time = static_cast<uint32_t>(std::min<uint64_t>(time - frame_start_time_, UINT32_MAX));
+        if (left != mix_left_) blip_left_.addDelta(clock_time, (left - mix_left_) * VOLUME_SCALE);
+        if (right != mix_right_) blip_right_.addDelta(clock_time, (right - mix_right_) * VOLUME_SCALE);
+    }
+    mix_left_ = left;
+    mix_right_ = right;
+}
+
+void Apu::clockFrameSequencer() {
+    uint8_t step = frame_sequencer_step_;
+    frame_sequencer_step_ = (step + 1) & 7;
+
+    if ((step & 1) == 0) {
+        for (Channel& ch : channels_) {
+            if (ch.length_enabled && ch.length_counter > 0 && --ch.length_counter == 0) {
+                ch.enabled = false;
+            }
+        }
+    }
+    if (step == 2 || step == 6) {
+        clockSweep();
+    }
+    if (step == 7) {
+        for (int i : { 0, 1, 3 }) {
+            Channel& ch = channels_[i];
+            if (ch.envelope_period == 0) continue;
+            if (--ch.envelope_timer == 0) {
+                ch.envelope_timer = ch.envelope_period;
+                if (ch.envelope_increase && ch.volume < 15) ch.volume++;
+                else if (!ch.envelope_increase && ch.volume > 0) ch.volume--;
+            }
+        }
+    }
+}
+
+uint16_t Apu::sweepCalculation() {
+    uint8_t nr10 = registers_[0x00];
+    uint16_t delta = sweep_shadow_frequency_ >> (nr10 & 0x07);
+    uint16_t frequency = (nr10 & 0x08) ? sweep_shadow_frequency_ - delta : sweep_shadow_frequency_ + delta;
+    if (frequency > 2047) {
+        channels_[0].enabled = false;
+    }
+    return frequency;
+}
+
+void Apu::clockSweep() {
+    if (--sweep_timer_ != 0) return;
+    uint8_t nr10 = registers_[0x00];
+    uint8_t period = (nr10 >> 4) & 0x07;
+    sweep_timer_ = period ? period : 8;
+    if (!sweep_enabled_ || period == 0) return;
+
+    uint16_t frequency = sweepCalculation();
+    if (frequency <= 2047 && (nr10 & 0x07) != 0) {
+        sweep_shadow_frequency_ = frequency;
+        channels_[0].frequency = frequency;
+        registers_[0x03] = frequency & 0xFF;
+        registers_[0x04] = static_cast<uint8_t>((registers_[0x04] & 0xF8) | (frequency >> 8));
+        sweepCalculation();
+    }
+}
+
+void Apu::trigger(int index) {
+    Channel& ch = channels_[index];
+    uint8_t base = static_cast<uint8_t>(index * 5);
+    ch.enabled = ch.dac_enabled;
+    if (ch.length_counter == 0) {
+        ch.length_counter = (index == 2) ? 256 : 64;
+    }
+    ch.next_step_time = last_time_ + channelPeriod(index);
+
+    if (index == 2) {
+        ch.position = 0;
+        return;
+    }
+
+    uint8_t envelope = registers_[base + 2];
+    ch.volume = envelope >> 4;
+    ch.envelope_increase = (envelope & 0x08) != 0;
+    ch.envelope_period = envelope & 0x07;
+    ch.envelope_timer = ch.envelope_period ? ch.envelope_period : 8;
+
+    if (index == 3) {
+        lfsr_ = 0x7FFF;
+    }
+    else if (index == 0) {
+        uint8_t nr10 = registers_[0x00];
+        uint8_t period = (nr10 >> 4) & 0x07;
+        sweep_shadow_frequency_ = ch.frequency;
+        sweep_timer_ = period ? period : 8;
+        sweep_enabled_ = period != 0 || (nr10 & 0x07) != 0;
+        if (nr10 & 0x07) {
+            sweepCalculation();
+        }
+    }
+}
+
+void Apu::powerOff() {
+    std::fill(registers_.begin(), registers_.begin() + NR52, 0);
+    for (Channel& ch : channels_) {
+        ch = Channel{};
+    }
+    sweep_enabled_ = false;
+}
+
+uint8_t Apu::read(uint16_t address) {
+    catchUp();
+    if (address >= 0xFF30) {
+        return wave_ram_[address - 0xFF30];
+    }
+    uint8_t index = static_cast<uint8_t>(address - 0xFF10);
+    if (index == NR52) {
+        // Channel status bits only change on frame sequencer ticks (length expiry).
+        bus_.notePolledValueChangeTime(next_frame_sequencer_time_);
+        uint8_t status = power_ ? 0x80 : 0x00;
+        for (int i = 0; i < 4; ++i) {
+            if (channels_[i].enabled) status |= static_cast<uint8_t>(1 << i);
+        }
+        return status | READ_MASKS[NR52];
+    }
+    return registers_[index] | READ_MASKS[index];
+}
+
+void Apu::write(uint16_t address, uint8_t value) {
+    catchUp();
+    if (address >= 0xFF30) {
+        wave_ram_[address - 0xFF30] = value;
+        return;
+    }
+    uint8_t index = static_cast<uint8_t>(address - 0xFF10);
+    if (index == NR52) {
+        bool power = (value & 0x80) != 0;
+        if (power_ && !power) {
+            powerOff();
+        }
+        else if (!power_ && power) {
+            frame_sequencer_step_ = 0;
+        }
+        power_ = power;
+        updateOutputs(last_time_);
+        return;
+    }
+    if (!power_ || index > NR52) {
+        return;
+    }
+    registers_[index] = value;
+
+    if (index < 0x14) {
+        int channel_index = index / 5;
+        Channel& ch = channels_[channel_index];
+        switch (index % 5) {
+        case 0:
+            if (channel_index == 2) {
+                ch.dac_enabled = (value & 0x80) != 0;
+                if (!ch.dac_enabled) ch.enabled = false;
+            }
+            break;
+        case 1:
+            if (channel_index == 2) {
+                ch.length_counter = static_cast<uint16_t>(256 - value);
+            }
+            else {
+                ch.length_counter = static_cast<uint16_t>(64 - (value & 0x3F));
+                ch.duty = value >> 6;
+            }
+            break;
+        case 2:
+            if (channel_index != 2) {
+                ch.dac_enabled = (value & 0xF8) != 0;
+                if (!ch.dac_enabled) ch.enabled = false;
+            }
+            break;
+        case 3:
+            if (channel_index != 3) {
+                ch.frequency = static_cast<uint16_t>((ch.frequency & 0x700) | value);
+            }
+            break;
+        case 4:
+            if (channel_index != 3) {
+                ch.frequency = static_cast<uint16_t>((ch.frequency & 0x0FF) | ((value & 0x07) << 8));
+            }
+            ch.length_enabled = (value & 0x40) != 0;
+            if (value & 0x80) {
+                trigger(channel_index);
+            }
+            break;
+        }
+    }
+    updateOutputs(last_time_);
+}
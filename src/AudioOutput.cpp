@@ -0,0 +1,66 @@
+#include "AudioOutput.h"
+
+#include <SDL.h>
+
+#include <iostream>
+
+AudioOutput::AudioOutput()
+    : device_(0), sample_rate_(DEFAULT_SAMPLE_RATE), ring_(RING_CAPACITY),
+    last_left_(0), last_right_(0), underruns_(0) {
+}
+
+AudioOutput::~AudioOutput() {
+    close();
+}
+
+bool AudioOutput::open(int sample_rate, int device_frames) {
+    close();
+
+    SDL_AudioSpec desired;
+    SDL_zero(desired);
+    desired.freq = sample_rate;
+    desired.format = AUDIO_S16SYS;
+    desired.channels = 2;
+    desired.samples = static_cast<Uint16>(device_frames);
+    desired.callback = audioCallback;
+    desired.userdata = this;
+
+    SDL_AudioSpec obtained;
+    device_ = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (device_ == 0) {
+        std::cerr << "Audio Error: SDL_OpenAudioDevice failed: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    sample_rate_ = obtained.freq;
+    SDL_PauseAudioDevice(device_, 0);
+    std::cout << "Audio output opened: " << sample_rate_ << " Hz, " << obtained.samples << " frames per callback." << std::endl;
+    return true;
+}
+
+void AudioOutput::close() {
+    if (device_ != 0) {
+        SDL_CloseAudioDevice(device_);
+        device_ = 0;
+    }
+}
+
+void AudioOutput::audioCallback(void* userdata, uint8_t* stream, int len) {
+    static_cast<AudioOutput*>(userdata)->fill(reinterpret_cast<int16_t*>(stream), static_cast<size_t>(len) / sizeof(int16_t));
+}
+
+void AudioOutput::fill(int16_t* out, size_t samples) {
+    // The producer only ever pushes whole stereo frames, so `got` is always even.
+    size_t got = ring_.pop(out, samples);
+    if (got >= 2) {
+        last_left_ = out[got - 2];
+        last_right_ = out[got - 1];
+    }
+    if (got < samples) {
+        // Hold the last sample instead of dropping to zero so an underrun does not click.
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = got; i + 1 < samples; i += 2) {
+            out[i] = last_left_;
+            out[i + 1] = last_right_;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#include "BlipBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+int16_t BlipBuffer::KERNEL[BlipBuffer::PHASES][BlipBuffer::KERNEL_WIDTH];
+
+void BlipBuffer::buildKernel() {
+    // Buffers are constructed on several threads at once (RegressionRunner's workers); the
+    // function-local static fills the table exactly once and makes the others wait for it.
+    static const bool built = [] {
+        const double pi = 3.14159265358979323846;
+        const double cutoff = 0.9; // slightly below Nyquist so the transition band does not alias
+        for (int phase = 0; phase < PHASES; ++phase) {
+            double fraction = static_cast<double>(phase) / PHASES;
+            double taps[KERNEL_WIDTH];
+            double sum = 0.0;
+            for (int i = 0; i < KERNEL_WIDTH; ++i) {
+                double x = i - (KERNEL_WIDTH / 2 - 1) - fraction;
+                double sinc = (x == 0.0) ? 1.0 : std::sin(pi * x * cutoff) / (pi * x * cutoff);
+                double w = (x + KERNEL_WIDTH / 2) / KERNEL_WIDTH; // Blackman window over [-8, 8)
+                double window = 0.42 - 0.5 * std::cos(2 * pi * w) + 0.08 * std::cos(4 * pi * w);
+                taps[i] = sinc * window;
+                sum += taps[i];
+            }
+            // Normalise each phase so a step always integrates to exactly its delta.
+            int total = 0;
+            for (int i = 0; i < KERNEL_WIDTH; ++i) {
+                KERNEL[phase][i] = static_cast<int16_t>(std::lround(taps[i] / sum * (1 << KERNEL_BITS)));
+                total += KERNEL[phase][i];
+            }
+            KERNEL[phase][KERNEL_WIDTH / 2 - 1] += static_cast<int16_t>((1 << KERNEL_BITS) - total);
+        }
+        return true;
+    }();
+    (void)built;
+}
+
+BlipBuffer::BlipBuffer(int max_samples_per_frame)
+    : buffer_(max_samples_per_frame + KERNEL_WIDTH, 0), factor_(0), offset_(0),
+    integrator_(0), highpass_previous_in_(0.0), highpass_previous_out_(0.0) {
+    buildKernel();
+}
+
+void BlipBuffer::setRates(double clock_rate, double sample_rate) {
+    factor_ = static_cast<uint64_t>(sample_rate / clock_rate * static_cast<double>(1ull << FRAC_BITS) + 0.5);
+}
+
+void BlipBuffer::clear() {
+    std::fill(buffer_.begin(), buffer_.end(), 0);
+    offset_ = 0;
+    integrator_ = 0;
+    highpass_previous_in_ = 0.0;
+    highpass_previous_out_ = 0.0;
+}
+
+void BlipBuffer::endFrame(uint32_t clock_duration) {
+    offset_ += static_cast<uint64_t>(clock_duration) * factor_;
+    // A frame longer than the buffer can hold loses its oldest samples rather than overflowing.
+    uint64_t limit = static_cast<uint64_t>(buffer_.size() - KERNEL_WIDTH) << FRAC_BITS;
+    if (offset_ > limit) offset_ = limit;
+}
+
+int BlipBuffer::readSamples(int16_t* out, int max_count, int stride) {
+    int count = std::min(max_count, samplesAvailable());
+    if (count <= 0) return 0;
+
+    // One-pole high-pass, like the output capacitor on the real hardware.
+    const double highpass = 0.999;
+    for (int i = 0; i < count; ++i) {
+        integrator_ += buffer_[i];
+        double in = static_cast<double>(integrator_ >> KERNEL_BITS);
+        double filtered = in - highpass_previous_in_ + highpass * highpass_previous_out_;
+        highpass_previous_in_ = in;
+        highpass_previous_out_ = filtered;
+        long sample = std::lround(filtered);
+        out[i * stride] = static_cast<int16_t>(std::clamp<long>(sample, -32768, 32767));
+    }
+
+    // Shift the unread samples and the kernel tails of recent deltas to the front.
+    size_t remaining = static_cast<size_t>(samplesAvailable() - count) + KERNEL_WIDTH;
+    std::memmove(buffer_.data(), buffer_.data() + count, remaining * sizeof(int64_t));
+    std::fill(buffer_.begin() + remaining, buffer_.begin() + remaining + count, 0);
+    offset_ -= static_cast<uint64_t>(count) << FRAC_BITS;
+    return count;
+}
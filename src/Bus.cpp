@@ -1,22 +1,493 @@
 #include "Bus.h"
 #include "Cartridge.h" 
-#include <iostream>    
+#include "Log.h"
+#include <algorithm>
 
-Bus::Bus() : interrupt_enable_register_(0) {
+Bus::Bus() : interrupt_enable_register_(0), interrupt_flag_register_(0), timer_(*this), serial_(*this), ppu_(*this), apu_(*this), joypad_(*this) {
+    read_pages_.fill(nullptr);
+    wram_write_pages_.fill(nullptr);
+    mapVramPages();
+    mapWramPages();
     reset();
 }
 
 void Bus::connectCartridge(const std::shared_ptr<Cartridge>& cartridge) {
     cartridge_ = cartridge;
+    cgb_mode_ = cartridge_ && cartridge_->cgbSupport();
+    mapCartridgePages();
+}
+
+void Bus::mapVramPages() {
+    bool blocked = oamDmaBlocks(0x8000);
+    for (int page = 0x80; page <= 0x9F; ++page) {
+        read_pages_[page] = blocked ? nullptr : ppu_.vramBankData() + (page - 0x80) * 0x100;
+    }
+}
+
+void Bus::mapWramPages() {
+    bool blocked = oamDmaBlocks(0xC000);
+    for (int page = 0xC0; page <= 0xFD; ++page) {
+        uint8_t* backing = nullptr;
+        if (!blocked) backing = wram_.data() + wramIndex(static_cast<uint16_t>(page << 8));
+        read_pages_[page] = backing;
+        wram_write_pages_[page] = backing;
+    }
+}
+
+void Bus::mapReadPages(const uint8_t* span, size_t length, uint8_t first_page, uint8_t page_count) {
+    for (uint8_t i = 0; i < page_count; ++i) {
+        bool whole_page = span && (static_cast<size_t>(i) + 1) * 0x100 <= length;
+        read_pages_[first_page + i] = whole_page ? span + i * 0x100 : nullptr;
+    }
+}
+
+void Bus::mapCartridgePages() {
+    if (oamDmaBlocks(0x0000)) {
+        mapReadPages(nullptr, 0, 0x00, 0x80);
+        mapReadPages(nullptr, 0, 0xA0, 0x20);
+        return;
+    }
+    size_t length = 0;
+    const uint8_t* span = cartridge_ ? cartridge_->peekSpan(0x0000, length) : nullptr;
+    mapReadPages(span, length, 0x00, 0x40);
+    span = cartridge_ ? cartridge_->peekSpan(0x4000, length) : nullptr;
+    mapReadPages(span, length, 0x40, 0x40);
+    // A RAM smaller than 8 KiB is mirrored; the pages past its end stay on the slow path.
+    span = cartridge_ ? cartridge_->peekSpan(0xA000, length) : nullptr;
+    mapReadPages(span, length, 0xA0, 0x20);
+}
+
+void Bus::mapPages() {
+    mapCartridgePages();
+    mapVramPages();
+    mapWramPages();
 }
 
 void Bus::reset()
 {
     wram_.fill(0);
     hram_.fill(0);
+    wram_write_generation_++;
+    hram_write_generation_++;
+    interrupt_enable_register_ = 0;
+    interrupt_flag_register_ = INTERRUPT_VBLANK;
+    wram_bank_ = 1;
+    speed_switch_armed_ = false;
+    oam_dma_source_ = 0xFF;
+    oam_dma_active_ = false;
+    oam_dma_start_ = 0;
+    vram_dma_ = VramDma{};
+    stall_cycles_ = 0;
+    hold_until_ = 0;
+
+    scheduler_.reset();
+    timer_.reset();
+    serial_.reset();
+    ppu_.reset();
+    apu_.reset();
+    joypad_.reset();
+    mapPages();
 }
 
+void Bus::saveState(State& state) const {
+    state.wram = wram_;
+    state.wram_bank = wram_bank_;
+    state.speed_switch_armed = speed_switch_armed_;
+    state.oam_dma_source = oam_dma_source_;
+    state.oam_dma_active = oam_dma_active_;
+    state.oam_dma_start = oam_dma_start_;
+    state.vram_dma = vram_dma_;
+    state.hram = hram_;
+    state.interrupt_enable = interrupt_enable_register_;
+    state.interrupt_flag = interrupt_flag_register_;
+    state.scheduler = scheduler_;
+    timer_.saveState(state.timer);
+    serial_.saveState(state.serial);
+    ppu_.saveState(state.ppu);
+    apu_.saveState(state.apu);
+    joypad_.saveState(state.joypad);
+    if (cartridge_) cartridge_->saveState(state.cartridge);
+}
+
+void Bus::loadState(const State& state) {
+    wram_ = state.wram;
+    wram_bank_ = state.wram_bank;
+    speed_switch_armed_ = state.speed_switch_armed;
+    oam_dma_source_ = state.oam_dma_source;
+    oam_dma_active_ = state.oam_dma_active;
+    oam_dma_start_ = state.oam_dma_start;
+    vram_dma_ = state.vram_dma;
+    hold_until_ = 0; // only ever set while events are being dispatched
+    hram_ = state.hram;
+    wram_write_generation_++;
+    hram_write_generation_++;
+    interrupt_enable_register_ = state.interrupt_enable;
+    interrupt_flag_register_ = state.interrupt_flag;
+    scheduler_ = state.scheduler;
+    timer_.loadState(state.timer);
+    serial_.loadState(state.serial);
+    ppu_.loadState(state.ppu);
+    apu_.loadState(state.apu);
+    joypad_.loadState(state.joypad);
+    if (cartridge_) cartridge_->loadState(state.cartridge);
+    mapPages();
+    // Whatever an idle-loop check saw being polled belongs to the timeline just left.
+    idle_poll_dirty_ = true;
+}
+
+void Bus::dispatchDueEvents() {
+    for (;;) {
+        SchedulerEvent event = scheduler_.popDueEvent();
+        if (event == SchedulerEvent::Count) {
+            // Nothing is overdue any more: run the clock through a hold an event asked for (an
+            // HBlank DMA block), up to the next event at a time, so events inside it still run.
+            uint64_t now = scheduler_.now();
+            if (hold_until_ <= now) return;
+            scheduler_.advance(std::min(hold_until_, scheduler_.nextEventTime()) - now);
+            continue;
+        }
+        // Whatever the event changes (an interrupt flag, a register) is news to an idle loop
+        // that polled before it, so that iteration cannot be used to skip ahead.
+        idle_poll_dirty_ = true;
+        switch (event) {
+        case SchedulerEvent::PpuVBlank:
+            ppu_.onVBlankEvent();
+            joypad_.sample();
+            break;
+        case SchedulerEvent::PpuStat: ppu_.onStatEvent(); break;
+        case SchedulerEvent::TimerOverflow: timer_.onOverflowEvent(); break;
+        case SchedulerEvent::OamDmaEnd: onOamDmaEndEvent(); break;
+        case SchedulerEvent::VramDmaHBlank: onVramDmaHBlankEvent(); break;
+        case SchedulerEvent::SerialTransfer: serial_.onTransferEvent(); break;
+        case SchedulerEvent::LinkSync: break;
+        case SchedulerEvent::Count: break;
+        }
+    }
+}
+
+uint64_t Bus::skipToNextEvent() {
+    uint64_t next_event_time = scheduler_.nextEventTime();
+    if (next_event_time == Scheduler::NEVER) return 0;
+    uint64_t skipped = next_event_time > scheduler_.now() ? next_event_time - scheduler_.now() : 0;
+    scheduler_.advance(skipped);
+    dispatchDueEvents();
+    return scheduler_.toCpuCycles(skipped);
+}
+
+uint64_t Bus::skipTo(uint64_t time) {
+    uint64_t target = std::min(time, scheduler_.nextEventTime());
+    if (target == Scheduler::NEVER || target <= scheduler_.now()) return 0;
+    uint64_t skipped = target - scheduler_.now();
+    scheduler_.advance(skipped);
+    dispatchDueEvents();
+    return scheduler_.toCpuCycles(skipped);
+}
+
+uint64_t Bus::stop() {
+    if (!cgb_mode_ || !speed_switch_armed_) return 0;
+    speed_switch_armed_ = false;
+    idle_poll_dirty_ = true;
+    // The CPU clock is continuous across the switch, so the timer only has to reschedule its
+    // overflow, which the DIV reset does.
+    scheduler_.setDoubleSpeed(!scheduler_.doubleSpeed());
+    timer_.write(0xFF04, 0);
+    return runClockFor(SPEED_SWITCH_CYCLES);
+}
+
+uint64_t Bus::runClockFor(uint64_t cycles) {
+    holdClockFor(cycles);
+    dispatchDueEvents();
+    return scheduler_.toCpuCycles(cycles);
+}
+
+void Bus::holdClockFor(uint64_t cycles) {
+    hold_until_ = std::max(hold_until_, scheduler_.now()) + cycles;
+}
+
+template <class Sink>
+void Bus::dmaRead(uint16_t source, size_t length, Sink&& sink) {
+    while (length > 0) {
+        size_t span_length = 0;
+        const uint8_t* span = peekSpan(source, span_length);
+        size_t count = 1;
+        if (span) {
+            count = std::min(span_length, length);
+            sink(span, count);
+        }
+        else {
+            uint8_t value = readSlow(source);
+            sink(&value, count);
+        }
+        source = static_cast<uint16_t>(source + count);
+        length -= count;
+    }
+}
+
+void Bus::startOamDma(uint8_t value) {
+    oam_dma_source_ = value;
+    // Sources past 0xDFFF read the WRAM echo. A restart reads its source without conflicts.
+    uint16_t source = static_cast<uint16_t>(value << 8);
+    if (source >= 0xE000) source -= 0x2000;
+    oam_dma_active_ = false;
+    uint16_t offset = 0;
+    dmaRead(source, Ppu::OAM_SIZE, [&](const uint8_t* data, size_t count) {
+        ppu_.writeOamBlock(offset, data, count);
+        offset = static_cast<uint16_t>(offset + count);
+    });
+
+    // The copy has landed, but the bus stays busy for the length of the real transfer.
+    oam_dma_active_ = true;
+    oam_dma_start_ = scheduler_.cpuNow();
+    scheduler_.schedule(SchedulerEvent::OamDmaEnd, scheduler_.timeAtCpuClock(oam_dma_start_ + OAM_DMA_CYCLES));
+    mapPages();
+}
+
+void Bus::onOamDmaEndEvent() {
+    oam_dma_active_ = false;
+    mapPages();
+}
+
+bool Bus::oamDmaBlocks(uint16_t address) const {
+    if (!oam_dma_active_ || address >= 0xFF00) return false;
+    if (address >= 0xFE00) return true;
+    // VRAM has a bus of its own; ROM, cartridge RAM and WRAM share the external one.
+    bool vram_source = oam_dma_source_ >= 0x80 && oam_dma_source_ <= 0x9F;
+    bool vram_address = address >= 0x8000 && address <= 0x9FFF;
+    return vram_source == vram_address;
+}
+
+uint8_t Bus::readDuringOamDma(uint16_t address) const {
+    // OAM reads see 0xFF, and reads on the bus the DMA is using whatever byte it is moving at
+    // that moment.
+    if (address >= 0xFE00) return 0xFF;
+    uint64_t index = (scheduler_.cpuNow() - oam_dma_start_) / 4;
+    return ppu_.oamData()[std::min<uint64_t>(index, Ppu::OAM_SIZE - 1)];
+}
+
+void Bus::writeVramDmaRegister(uint16_t address, uint8_t value) {
+    switch (address) {
+    case 0xFF51: vram_dma_.source = static_cast<uint16_t>((vram_dma_.source & 0x00F0) | value << 8); break;
+    case 0xFF52: vram_dma_.source = static_cast<uint16_t>((vram_dma_.source & 0xFF00) | (value & 0xF0)); break;
+    case 0xFF53: vram_dma_.destination = static_cast<uint16_t>((vram_dma_.destination & 0x00F0) | (value & 0x1F) << 8); break;
+    case 0xFF54: vram_dma_.destination = static_cast<uint16_t>((vram_dma_.destination & 0x1F00) | (value & 0xF0)); break;
+    case 0xFF55:
+        if (vram_dma_.hblank_active && !(value & 0x80)) {
+            // Cancels the HBlank DMA; HDMA5 keeps the count of blocks that were left.
+            vram_dma_.hblank_active = false;
+            scheduler_.cancel(SchedulerEvent::VramDmaHBlank);
+            break;
+        }
+        vram_dma_.blocks_left = static_cast<uint8_t>((value & 0x7F) + 1);
+        if (value & 0x80) {
+            vram_dma_.hblank_active = true;
+            scheduleVramDma();
+        }
+        else {
+            uint8_t blocks = vram_dma_.blocks_left;
+            copyVramDmaBlocks(blocks);
+            stall_cycles_ += runClockFor(static_cast<uint64_t>(blocks) * VRAM_DMA_BLOCK_CYCLES);
+        }
+        break;
+    }
+}
+
+void Bus::copyVramDmaBlocks(uint8_t blocks) {
+    idle_poll_dirty_ = true;
+    size_t length = static_cast<size_t>(blocks) * VRAM_DMA_BLOCK_SIZE;
+    while (length > 0) {
+        // The destination wraps within VRAM (in the bank VBK selects).
+        size_t count = std::min<size_t>(length, Ppu::VRAM_BANK_SIZE - vram_dma_.destination);
+        dmaRead(vram_dma_.source, count, [&](const uint8_t* data, size_t chunk) {
+            ppu_.writeVramBlock(static_cast<uint16_t>(0x8000 + vram_dma_.destination), data, chunk);
+            vram_dma_.destination = static_cast<uint16_t>((vram_dma_.destination + chunk) & (Ppu::VRAM_BANK_SIZE - 1));
+        });
+        vram_dma_.source = static_cast<uint16_t>(vram_dma_.source + count);
+        length -= count;
+    }
+    vram_dma_.blocks_left = static_cast<uint8_t>(vram_dma_.blocks_left - blocks);
+}
+
+void Bus::scheduleVramDma() {
+    uint64_t next = ppu_.nextHBlankTime(scheduler_.now());
+    // With the LCD off there are no HBlanks; look again a line later.
+    if (next == Scheduler::NEVER) next = scheduler_.now() + Ppu::CYCLES_PER_LINE;
+    scheduler_.schedule(SchedulerEvent::VramDmaHBlank, next);
+}
+
+void Bus::onVramDmaHBlankEvent() {
+    if (!vram_dma_.hblank_active) return;
+    if (!ppu_.isLcdEnabled()) {
+        scheduleVramDma();
+        return;
+    }
+    copyVramDmaBlocks(1);
+    vram_dma_.hblank_active = vram_dma_.blocks_left != 0;
+    if (vram_dma_.hblank_active) scheduleVramDma();
+    // Not run from here: other events may already be overdue, and only the dispatch loop
+    // that called this can run them first.
+    holdClockFor(VRAM_DMA_BLOCK_CYCLES);
+    stall_cycles_ += scheduler_.toCpuCycles(VRAM_DMA_BLOCK_CYCLES);
+}
+
+uint64_t Bus::ramWriteGeneration(uint16_t address) const {
+    if (address >= 0x8000 && address <= 0x9FFF) return ppu_.vramWriteGeneration();
+    if (address >= 0xA000 && address <= 0xBFFF) return cartridge_ ? cartridge_->ramWriteGeneration() : 0;
+    if (address >= 0xC000 && address <= 0xFDFF) return wram_write_generation_;
+    if (address >= 0xFF80 && address <= 0xFFFE) return hram_write_generation_;
+    return 0;
+}
+
+const uint8_t* Bus::peekSpan(uint16_t address, size_t& out_length) const {
+    out_length = 0;
+    if (address <= 0x7FFF || (address >= 0xA000 && address <= 0xBFFF)) {
+        return cartridge_ ? cartridge_->peekSpan(address, out_length) : nullptr;
+    }
+    if (address >= 0x8000 && address <= 0x9FFF) {
+        out_length = 0xA000 - address;
+        return ppu_.vramBankData() + (address - 0x8000);
+    }
+    if (address >= 0xC000 && address <= 0xFDFF) {
+        // Contiguous to the end of the 4 KiB bank window containing `address`.
+        out_length = std::min<size_t>(WRAM_BANK_SIZE - (address & (WRAM_BANK_SIZE - 1)), 0xFE00 - address);
+        return wram_.data() + wramIndex(address);
+    }
+    if (address >= 0xFE00 && address <= 0xFE9F) {
+        out_length = 0xFEA0 - address;
+        return ppu_.oamData() + (address - 0xFE00);
+    }
+    if (address >= 0xFF80 && address <= 0xFFFE) {
+        out_length = 0xFFFF - address;
+        return hram_.data() + (address - 0xFF80);
+    }
+    return nullptr;
+}
+
+void Bus::peekRange(uint16_t address, uint8_t* out, size_t size) {
+    while (size > 0) {
+        size_t span_length;
+        const uint8_t* span = peekSpan(address, span_length);
+        size_t count = 1;
+        if (span) {
+            count = std::min(span_length, size);
+            std::copy(span, span + count, out);
+        }
+        else {
+            *out = peekByte(address);
+        }
+        out += count;
+        size -= count;
+        address = static_cast<uint16_t>(address + count);
+    }
+}
+
+uint8_t Bus::peekByte(uint16_t address) {
+    if (address < 0xFF00 || address > 0xFF7F) {
+        return read(address);
+    }
+    // JOYP reads sample the host input and can raise the joypad interrupt; show the last sample.
+    if (address == 0xFF00) {
+        return joypad_.peek();
+    }
+    // Other register reads only have bookkeeping side effects (lazy catch-up, which is invisible,
+    // and idle-loop poll tracking); undo the latter so a debugger view cannot change how the
+    // running idle loop is fast-forwarded.
+    uint64_t poll_deadline = idle_poll_deadline_;
+    uint8_t value = readIo(address);
+    idle_poll_deadline_ = poll_deadline;
+    return value;
+}
+
+uint8_t Bus::readIo(uint16_t address) {
+    if (address == 0xFF00) {
+        return joypad_.read();
+    }
+    if (address == 0xFF01 || address == 0xFF02) {
+        return serial_.read(address);
+    }
+    if (address >= 0xFF04 && address <= 0xFF07) {
+        return timer_.read(address);
+    }
+    if (address == 0xFF0F) {
+        return 0xE0 | interrupt_flag_register_;
+    }
+    if (address >= 0xFF10 && address <= 0xFF3F) {
+        return apu_.read(address);
+    }
+    if (address == 0xFF46) {
+        return oam_dma_source_;
+    }
+    if (address >= 0xFF40 && address <= 0xFF4B) {
+        return ppu_.read(address);
+    }
+    if (cgb_mode_) {
+        switch (address) {
+        case 0xFF4D: return static_cast<uint8_t>(0x7E | (scheduler_.doubleSpeed() ? 0x80 : 0) | (speed_switch_armed_ ? 0x01 : 0));
+        case 0xFF4F: return 0xFE | ppu_.vramBank();
+        case 0xFF55:
+            return static_cast<uint8_t>((vram_dma_.hblank_active ? 0x00 : 0x80) | ((vram_dma_.blocks_left - 1) & 0x7F));
+        case 0xFF70: return 0xF8 | wram_bank_;
+        }
+    }
+    return 0xFF;
+}
+
+void Bus::writeIo(uint16_t address, uint8_t value) {
+    if (address == 0xFF00) {
+        joypad_.write(value);
+    }
+    else if (address == 0xFF01 || address == 0xFF02) {
+        serial_.write(address, value);
+    }
+    else if (address >= 0xFF04 && address <= 0xFF07) {
+        timer_.write(address, value);
+    }
+    else if (address == 0xFF0F) {
+        interrupt_flag_register_ = value & 0x1F;
+    }
+    else if (address >= 0xFF10 && address <= 0xFF3F) {
+        apu_.write(address, value);
+    }
+    else if (address == 0xFF46) {
+        startOamDma(value);
+    }
+    else if (address >= 0xFF40 && address <= 0xFF4B) {
+        ppu_.write(address, value);
+    }
+    else if (!cgb_mode_) {
+        return;
+    }
+    else if (address == 0xFF4D) {
+        speed_switch_armed_ = (value & 0x01) != 0;
+    }
+    else if (address == 0xFF4F) {
+        ppu_.setVramBank(value);
+        mapVramPages();
+    }
+    else if (address >= 0xFF51 && address <= 0xFF55) {
+        writeVramDmaRegister(address, value);
+    }
+    else if (address == 0xFF70) {
+        uint8_t bank = value & 0x07;
+        wram_bank_ = bank != 0 ? bank : 1;
+        wram_write_generation_++;
+        mapWramPages();
+    }
+}
+
+#ifndef GBC_INLINE_BUS_ACCESS
 uint8_t Bus::read(uint16_t address) {
+    return readSlow(address);
+}
+
+void Bus::write(uint16_t address, uint8_t value) {
+    writeSlow(address, value);
+}
+#endif
+
+uint8_t Bus::readSlow(uint16_t address) {
+    if (oamDmaBlocks(address)) {
+        return readDuringOamDma(address);
+    }
     if (address >= 0x0000 && address <= 0x7FFF) {
         if (cartridge_) {
             return cartridge_->read(address);
@@ -24,27 +495,25 @@ uint8_t Bus::read(uint16_t address) {
         return 0xFF;
     }
     else if (address >= 0x8000 && address <= 0x9FFF) {
-        return 0xFF;
+        return ppu_.readVram(address);
     }
     else if (address >= 0xA000 && address <= 0xBFFF) {
         if (cartridge_) {
+            return cartridge_->read(address);
         }
         return 0xFF;
     }
-    else if (address >= 0xC000 && address <= 0xDFFF) {
-        return wram_[address - 0xC000];
-    }
-    else if (address >= 0xE000 && address <= 0xFDFF) {
-        return wram_[(address - 0xE000) % wram_.size()];
+    else if (address >= 0xC000 && address <= 0xFDFF) {
+        return wram_[wramIndex(address)];
     }
     else if (address >= 0xFE00 && address <= 0xFE9F) {
-        return 0xFF;
+        return ppu_.readOam(address);
     }
     else if (address >= 0xFEA0 && address <= 0xFEFF) {
         return 0xFF;
     }
     else if (address >= 0xFF00 && address <= 0xFF7F) {
-        return 0xFF;
+        return readIo(address);
     }
     else if (address >= 0xFF80 && address <= 0xFFFE) {
         return hram_[address - 0xFF80];
@@ -53,43 +522,52 @@ uint8_t Bus::read(uint16_t address) {
         return interrupt_enable_register_;
     }
 
-    std::cerr << "Warning: Unhandled bus read at address 0x" << std::hex << address << std::endl;
+    GBC_LOG_WARNING("Unhandled bus read at address 0x%04X", address);
     return 0xFF;
 }
 
-void Bus::write(uint16_t address, uint8_t value) {
+void Bus::writeSlow(uint16_t address, uint8_t value) {
+    idle_poll_dirty_ = true;
+    if (oamDmaBlocks(address)) {
+        return;
+    }
     if (address >= 0x0000 && address <= 0x7FFF) {
         if (cartridge_) {
+            cartridge_->write(address, value);
+            mapCartridgePages();
         }
         return;
     }
     else if (address >= 0x8000 && address <= 0x9FFF) {
+        // Marks the written tile dirty in the PPU's decoded tile cache.
+        ppu_.writeVram(address, value);
         return;
     }
     else if (address >= 0xA000 && address <= 0xBFFF) {
         if (cartridge_) {
+            cartridge_->write(address, value);
         }
         return;
     }
-    else if (address >= 0xC000 && address <= 0xDFFF) {
-        wram_[address - 0xC000] = value;
-        return;
-    }
-    else if (address >= 0xE000 && address <= 0xFDFF) {
-        wram_[(address - 0xE000) % wram_.size()] = value;
+    else if (address >= 0xC000 && address <= 0xFDFF) {
+        wram_[wramIndex(address)] = value;
+        wram_write_generation_++;
         return;
     }
     else if (address >= 0xFE00 && address <= 0xFE9F) {
+        ppu_.writeOam(address, value);
         return;
     }
     else if (address >= 0xFEA0 && address <= 0xFEFF) {
         return;
     }
     else if (address >= 0xFF00 && address <= 0xFF7F) {
+        writeIo(address, value);
         return;
     }
     else if (address >= 0xFF80 && address <= 0xFFFE) {
         hram_[address - 0xFF80] = value;
+        hram_write_generation_++;
         return;
     }
     else if (address == 0xFFFF) {
@@ -97,6 +575,5 @@ void Bus::write(uint16_t address, uint8_t value) {
         return;
     }
 
-    std::cerr << "Warning: Unhandled bus write at address 0x" << std::hex << address
-        << " value: 0x" << (int)value << std::endl;
+    GBC_LOG_WARNING("Unhandled bus write at address 0x%04X value: 0x%02X", address, value);
 }
\ No newline at end of file
@@ -1,54 +1,209 @@
 #include "Cartridge.h"
+#include "Log.h"
 #include <fstream>
-#include <iostream>
+#include <algorithm>
 
-Cartridge::Cartridge() {
+Cartridge::Cartridge()
+    : rom_data_(std::make_shared<std::vector<uint8_t>>()), mbc_type_(MbcType::None), cgb_support_(false),
+    ram_enabled_(false), rom_bank_(1), bank_high_(0), mbc1_ram_mode_(false), ram_write_generation_(0) {
 }
 
 bool Cartridge::loadRom(const std::string& rom_path) {
     std::ifstream rom_file(rom_path, std::ios::binary | std::ios::ate);
 
     if (!rom_file.is_open()) {
-        std::cerr << "Error: Could not open ROM file: " << rom_path << std::endl;
+        GBC_LOG_ERROR("Could not open ROM file: %s", rom_path.c_str());
         return false;
     }
 
     std::streamsize size = rom_file.tellg();
     rom_file.seekg(0, std::ios::beg);
 
-    rom_data_.resize(static_cast<size_t>(size));
+    // A fresh vector each time: snapshots handed out earlier keep the previous image alive.
+    auto rom_data = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(size));
     if (size > 0) { 
-        if (!rom_file.read(reinterpret_cast<char*>(rom_data_.data()), size)) {
-            std::cerr << "Error: Could not read ROM file: " << rom_path << std::endl;
-            rom_data_.clear();
+        if (!rom_file.read(reinterpret_cast<char*>(rom_data->data()), size)) {
+            GBC_LOG_ERROR("Could not read ROM file: %s", rom_path.c_str());
             return false;
         }
     }
+    rom_data_ = rom_data;
 
 
     rom_file.close();
-    std::cout << "Successfully loaded ROM: " << rom_path << " (" << size << " bytes)" << std::endl;
+    parseHeader();
+    GBC_LOG_INFO("Successfully loaded ROM: %s (%lld bytes)", rom_path.c_str(), static_cast<long long>(size));
     return true;
 }
 
+void Cartridge::parseHeader() {
+    mbc_type_ = MbcType::None;
+    cgb_support_ = false;
+    ram_data_.clear();
+    ram_enabled_ = false;
+    rom_bank_ = 1;
+    bank_high_ = 0;
+    mbc1_ram_mode_ = false;
+    ram_write_generation_ = 0;
+
+    const std::vector<uint8_t>& rom = *rom_data_;
+    if (rom.size() < 0x150) return; // test snippets have no header
+
+    cgb_support_ = (rom[0x143] & 0x80) != 0;
+    uint8_t type = rom[0x147];
+    if (type >= 0x01 && type <= 0x03) mbc_type_ = MbcType::Mbc1;
+    else if (type >= 0x0F && type <= 0x13) mbc_type_ = MbcType::Mbc3;
+    else if (type >= 0x19 && type <= 0x1E) mbc_type_ = MbcType::Mbc5;
+    else if (type != 0x00 && type != 0x08 && type != 0x09) {
+        GBC_LOG_WARNING("Unsupported cartridge type 0x%02X, treating it as ROM only.", type);
+    }
+
+    static const uint32_t RAM_SIZES[] = { 0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000 };
+    uint8_t ram_size_code = rom[0x149];
+    if (ram_size_code < sizeof(RAM_SIZES) / sizeof(RAM_SIZES[0])) {
+        ram_data_.assign(RAM_SIZES[ram_size_code], 0);
+    }
+}
+
+uint32_t Cartridge::romBankCount() const {
+    uint32_t count = static_cast<uint32_t>((rom_data_->size() + ROM_BANK_SIZE - 1) / ROM_BANK_SIZE);
+    return count ? count : 1;
+}
+
+uint32_t Cartridge::romBankAt(uint16_t address) const {
+    uint32_t bank;
+    if (address < 0x4000) {
+        bank = (mbc_type_ == MbcType::Mbc1 && mbc1_ram_mode_) ? static_cast<uint32_t>(bank_high_) << 5 : 0;
+    }
+    else {
+        switch (mbc_type_) {
+        case MbcType::Mbc1: bank = (static_cast<uint32_t>(bank_high_) << 5) | rom_bank_; break;
+        case MbcType::Mbc3:
+        case MbcType::Mbc5: bank = rom_bank_; break;
+        default: bank = 1; break;
+        }
+    }
+    return bank % romBankCount();
+}
+
+void Cartridge::saveState(State& state) const {
+    state.ram.assign(ram_data_.begin(), ram_data_.end());
+    state.ram_enabled = ram_enabled_;
+    state.rom_bank = rom_bank_;
+    state.bank_high = bank_high_;
+    state.mbc1_ram_mode = mbc1_ram_mode_;
+}
+
+void Cartridge::loadState(const State& state) {
+    if (state.ram.size() == ram_data_.size()) {
+        std::copy(state.ram.begin(), state.ram.end(), ram_data_.begin());
+    }
+    else {
+        GBC_LOG_WARNING("Cartridge state has %zu bytes of RAM, expected %zu; RAM not restored.",
+            state.ram.size(), ram_data_.size());
+    }
+    ram_enabled_ = state.ram_enabled;
+    rom_bank_ = state.rom_bank;
+    bank_high_ = state.bank_high;
+    mbc1_ram_mode_ = state.mbc1_ram_mode;
+    ram_write_generation_++;
+}
+
+uint8_t Cartridge::ramBank() const {
+    switch (mbc_type_) {
+    case MbcType::Mbc1: return mbc1_ram_mode_ ? bank_high_ : 0;
+    case MbcType::Mbc3:
+    case MbcType::Mbc5: return bank_high_;
+    default: return 0;
+    }
+}
+
+size_t Cartridge::ramOffset(uint16_t address) const {
+    return (static_cast<size_t>(ramBank()) * RAM_BANK_SIZE + (address - 0xA000)) % ram_data_.size();
+}
+
 uint8_t Cartridge::read(uint16_t address) const {
-    if (address < rom_data_.size()) {
-        return rom_data_[address];
+    const std::vector<uint8_t>& rom = *rom_data_;
+    if (address < 0x8000) {
+        size_t offset = static_cast<size_t>(romBankAt(address)) * ROM_BANK_SIZE + (address & 0x3FFF);
+        if (offset < rom.size()) {
+            return rom[offset];
+        }
+        return 0xFF;
+    }
+    if (address >= 0xA000 && address < 0xC000 && isRamAccessible()) {
+        // MBC3 RTC registers (RAM bank 0x08-0x0C) are not emulated.
+        if (mbc_type_ == MbcType::Mbc3 && bank_high_ > 0x03) return 0xFF;
+        return ram_data_[ramOffset(address)];
     }
     return 0xFF;
 }
 
+const uint8_t* Cartridge::peekSpan(uint16_t address, size_t& out_length) const {
+    out_length = 0;
+    const std::vector<uint8_t>& rom = *rom_data_;
+    if (address < 0x8000) {
+        size_t offset = static_cast<size_t>(romBankAt(address)) * ROM_BANK_SIZE + (address & 0x3FFF);
+        if (offset >= rom.size()) return nullptr;
+        out_length = std::min<size_t>(ROM_BANK_SIZE - (address & 0x3FFF), rom.size() - offset);
+        return rom.data() + offset;
+    }
+    if (address >= 0xA000 && address < 0xC000 && isRamAccessible()) {
+        if (mbc_type_ == MbcType::Mbc3 && bank_high_ > 0x03) return nullptr;
+        size_t offset = ramOffset(address);
+        out_length = std::min<size_t>(0xC000 - address, ram_data_.size() - offset);
+        return ram_data_.data() + offset;
+    }
+    return nullptr;
+}
+
+void Cartridge::write(uint16_t address, uint8_t value) {
+    if (address >= 0xA000 && address < 0xC000) {
+        if (isRamAccessible() && !(mbc_type_ == MbcType::Mbc3 && bank_high_ > 0x03)) {
+            ram_data_[ramOffset(address)] = value;
+            ram_write_generation_++;
+        }
+        else {
+            GBC_LOG_DEBUG("Cartridge RAM write to 0x%04X ignored (RAM disabled or unmapped)", address);
+        }
+        return;
+    }
+
+    switch (mbc_type_) {
+    case MbcType::Mbc1:
+        if (address < 0x2000) ram_enabled_ = (value & 0x0F) == 0x0A;
+        else if (address < 0x4000) { rom_bank_ = value & 0x1F; if (rom_bank_ == 0) rom_bank_ = 1; }
+        else if (address < 0x6000) bank_high_ = value & 0x03;
+        else mbc1_ram_mode_ = (value & 0x01) != 0;
+        break;
+    case MbcType::Mbc3:
+        if (address < 0x2000) ram_enabled_ = (value & 0x0F) == 0x0A;
+        else if (address < 0x4000) { rom_bank_ = value & 0x7F; if (rom_bank_ == 0) rom_bank_ = 1; }
+        else if (address < 0x6000) bank_high_ = value;
+        break;
+    case MbcType::Mbc5:
+        if (address < 0x2000) ram_enabled_ = (value & 0x0F) == 0x0A;
+        else if (address < 0x3000) rom_bank_ = static_cast<uint16_t>((rom_bank_ & 0x100) | value);
+        else if (address < 0x4000) rom_bank_ = static_cast<uint16_t>((rom_bank_ & 0x0FF) | ((value & 0x01) << 8));
+        else if (address < 0x6000) bank_high_ = value & 0x0F;
+        break;
+    default:
+        break;
+    }
+}
+
 const std::vector<uint8_t>& Cartridge::getRomData() const {
-    return rom_data_;
+    return *rom_data_;
 }
 
 bool Cartridge::loadTestData(const std::vector<uint8_t>& data) {
-    rom_data_ = data;
-    if (rom_data_.empty()) {
-        std::cout << "Warning: Loaded empty test data into cartridge." << std::endl;
+    rom_data_ = std::make_shared<std::vector<uint8_t>>(data);
+    parseHeader();
+    if (rom_data_->empty()) {
+        GBC_LOG_WARNING("Loaded empty test data into cartridge.");
     }
     else {
-        std::cout << "Successfully loaded " << rom_data_.size() << " bytes of test data into cartridge." << std::endl;
+        GBC_LOG_INFO("Successfully loaded %zu bytes of test data into cartridge.", rom_data_->size());
     }
     return true;
-}
\ No newline at end of file
+}
@@ -1,240 +1,234 @@
 #include "Cpu.h"
 #include "Bus.h"
-#include "InvalidInstruction.h"
-#include "Opcodes.h" 
-#include <iostream>
+#include "FlatBus.h"
+#include "Instruction.h"
+#include "OpcodeTable.h"
+#include "Disassembler.h"
+#include "Log.h"
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
-
-Cpu::Cpu() {
-    instruction_table_.resize(0x100);
-    cb_instruction_table_.resize(0x100);
-    initializeInstructionTables();
+#include <algorithm>
+#include <iterator>
+#include <array>
+#include <memory>
+#include <cstring>
+#include <type_traits>
+
+template <class BusType>
+BasicCpu<BusType>::BasicCpu() : debug_trace_enabled_(true), profiler_(nullptr), idle_loop_skipping_enabled_(true),
+    bus_(nullptr), instruction_set_(&InstructionSet<BasicCpu>::shared()) {
     reset();
 }
 
-Cpu::~Cpu() {
+template <class BusType>
+void BasicCpu<BusType>::connectBus(BusType* bus) {
+    bus_ = bus;
 }
 
-void Cpu::connectBus(const std::shared_ptr<Bus>& bus_ptr) {
-    bus_ = bus_ptr;
+template <class BusType>
+void BasicCpu<BusType>::loadState(const BasicCpu& saved) {
+    BusType* bus = bus_;
+    CpuProfiler* profiler = profiler_;
+    bool debug_trace_enabled = debug_trace_enabled_;
+    bool idle_loop_skipping_enabled = idle_loop_skipping_enabled_;
+    *this = saved;
+    bus_ = bus;
+    profiler_ = profiler;
+    debug_trace_enabled_ = debug_trace_enabled;
+    idle_loop_skipping_enabled_ = idle_loop_skipping_enabled;
 }
 
-void Cpu::reset() {
-    af = 0x01B0; bc = 0x0013; de = 0x00D8; hl = 0x014D;
+template <class BusType>
+void BasicCpu<BusType>::reset() {
+    if (bus_ && bus_->cgbMode()) {
+        af = 0x1180; bc = 0x0000; de = 0xFF56; hl = 0x000D;
+    }
+    else {
+        af = 0x01B0; bc = 0x0013; de = 0x00D8; hl = 0x014D;
+    }
     sp = 0xFFFE; pc = 0x0100;
 
     cycles_elapsed_total_ = 0;
     current_instruction_cycles_ = 0;
+    ime_ = false;
+    ime_enable_delay_ = 0;
+    halted_ = false;
+    halt_bug_ = false;
+    idle_loop_armed_ = false;
+    idle_loop_head_ = 0;
+    idle_loop_instructions_ = 0;
     debug_last_instr_pc_ = 0;
     debug_last_opcode_ = 0;
     debug_last_operand_ = 0;
     debug_last_instr_length_ = 0;
-    debug_last_disassembled_ = "RESET";
-    debug_last_instr_bytes_.clear();
+    std::memcpy(debug_last_disassembled_, "RESET", 6);
+    std::fill(std::begin(debug_last_instr_bytes_), std::end(debug_last_instr_bytes_), 0);
 }
 
-uint8_t Cpu::busRead(uint16_t address) {
-    if (!bus_) {
-        std::cerr << "FATAL: CPU busRead with no bus connected!" << std::endl;
-        return 0xFF;
-    }
-    return bus_->read(address);
+template <class BusType>
+uint8_t BasicCpu<BusType>::pendingInterrupts() const {
+    return bus_ ? bus_->pendingInterrupts() : 0;
 }
 
-void Cpu::busWrite(uint16_t address, uint8_t data) {
-    if (!bus_) {
-        std::cerr << "FATAL: CPU busWrite with no bus connected!" << std::endl;
-        return;
-    }
-    bus_->write(address, data);
+template <class BusType>
+const Instruction<BasicCpu<BusType>>* BasicCpu<BusType>::getCbInstruction(uint8_t cb_opcode) const {
+    return instruction_set_->cb[cb_opcode].get();
 }
 
-Instruction* Cpu::getCbInstruction(uint8_t cb_opcode) {
-    if (cb_opcode < cb_instruction_table_.size() && cb_instruction_table_[cb_opcode]) {
-        return cb_instruction_table_[cb_opcode].get();
-    }
-    std::cerr << "CRITICAL: CB Opcode " << formatHex8(cb_opcode) << " out of cb_instruction_table_ bounds or table not initialized." << std::endl;
-    static InvalidInstruction static_invalid_cb_handler(cb_opcode);
-    return &static_invalid_cb_handler;
+template <class BusType>
+void BasicCpu<BusType>::applyTakenBranchCycles() {
+    current_instruction_cycles_ = OpcodeTable::MAIN[debug_last_opcode_].cycles_taken;
 }
 
-void Cpu::initializeInstructionTables() {
-    
-    for (int i = 0; i < 0x100; ++i) {
-        instruction_table_[i] = std::make_unique<InvalidInstruction>(static_cast<uint8_t>(i));
-        cb_instruction_table_[i] = std::make_unique<InvalidInstruction>(static_cast<uint8_t>(i));
-    }
 
+template <class BusType>
+bool BasicCpu<BusType>::serviceInterrupts() {
+    uint8_t pending = bus_->pendingInterrupts();
+    if (pending == 0) return false;
 
-    instruction_table_[0x06] = std::make_unique<Instr_LD_R_D8>(0); instruction_table_[0x0E] = std::make_unique<Instr_LD_R_D8>(1);
-    instruction_table_[0x16] = std::make_unique<Instr_LD_R_D8>(2); instruction_table_[0x1E] = std::make_unique<Instr_LD_R_D8>(3);
-    instruction_table_[0x26] = std::make_unique<Instr_LD_R_D8>(4); instruction_table_[0x2E] = std::make_unique<Instr_LD_R_D8>(5);
-    instruction_table_[0x3E] = std::make_unique<Instr_LD_R_D8>(7);
-    
-    instruction_table_[0x36] = std::make_unique<Instr_LD_MHL_D8>();
-    
-    instruction_table_[0x70] = std::make_unique<Instr_LD_MHL_R>(0); instruction_table_[0x71] = std::make_unique<Instr_LD_MHL_R>(1);
-    instruction_table_[0x72] = std::make_unique<Instr_LD_MHL_R>(2); instruction_table_[0x73] = std::make_unique<Instr_LD_MHL_R>(3);
-    instruction_table_[0x74] = std::make_unique<Instr_LD_MHL_R>(4); instruction_table_[0x75] = std::make_unique<Instr_LD_MHL_R>(5);
-    instruction_table_[0x77] = std::make_unique<Instr_LD_MHL_R>(7);
-    
-    instruction_table_[0x01] = std::make_unique<Instr_LD_RR_D16>(0); instruction_table_[0x11] = std::make_unique<Instr_LD_RR_D16>(1);
-    instruction_table_[0x21] = std::make_unique<Instr_LD_RR_D16>(2); instruction_table_[0x31] = std::make_unique<Instr_LD_RR_D16>(3);
-    
-    instruction_table_[0x04] = std::make_unique<Instr_INC_R>(0); instruction_table_[0x0C] = std::make_unique<Instr_INC_R>(1);
-    instruction_table_[0x14] = std::make_unique<Instr_INC_R>(2); instruction_table_[0x1C] = std::make_unique<Instr_INC_R>(3);
-    instruction_table_[0x24] = std::make_unique<Instr_INC_R>(4); instruction_table_[0x2C] = std::make_unique<Instr_INC_R>(5);
-    instruction_table_[0x3C] = std::make_unique<Instr_INC_R>(7);
-    
-    instruction_table_[0x34] = std::make_unique<Instr_INC_MHL>();
-    
-    instruction_table_[0x05] = std::make_unique<Instr_DEC_R>(0); instruction_table_[0x0D] = std::make_unique<Instr_DEC_R>(1);
-    instruction_table_[0x15] = std::make_unique<Instr_DEC_R>(2); instruction_table_[0x1D] = std::make_unique<Instr_DEC_R>(3);
-    instruction_table_[0x25] = std::make_unique<Instr_DEC_R>(4); instruction_table_[0x2D] = std::make_unique<Instr_DEC_R>(5);
-    instruction_table_[0x3D] = std::make_unique<Instr_DEC_R>(7);
-    
-    for (int i = 0; i < 8; ++i) { instruction_table_[0x80 + i] = std::make_unique<Instr_ADD_A_R>(i); }
-    
-    for (int i = 0; i < 8; ++i) { instruction_table_[0x90 + i] = std::make_unique<Instr_SUB_A_R>(i); }
-    
-    instruction_table_[0xAF] = std::make_unique<Instr_XOR_A>(); 
-    
-    instruction_table_[0xC3] = std::make_unique<Instr_JP_A16>();
-    
-    instruction_table_[0x00] = std::make_unique<Instr_NOP>();
-    instruction_table_[0x76] = std::make_unique<Instr_HALT>();
-    
-    instruction_table_[0xCB] = std::make_unique<Instr_CB_PREFIX>();
-
-    
-    for (uint8_t opcode = 0x40; opcode <= 0x7F; ++opcode) {
-        if (opcode == 0x76) continue; 
-
-        uint8_t dest_idx = (opcode & 0b00111000) >> 3;
-        uint8_t src_idx = (opcode & 0b00000111);
-
-        if (dest_idx == 6) { 
-            continue;
-        }
-        
-        instruction_table_[opcode] = std::make_unique<Instr_LD_R_R>(dest_idx, src_idx);
-    }
-    
-    instruction_table_[0x0A] = std::make_unique<Instr_LD_A_MRR>(0); 
-    
-    instruction_table_[0x1A] = std::make_unique<Instr_LD_A_MRR>(1); 
-
-    instruction_table_[0x02] = std::make_unique<Instr_LD_MRR_A>(0); 
-    
-    instruction_table_[0x12] = std::make_unique<Instr_LD_MRR_A>(1); 
-        
-    instruction_table_[0xFA] = std::make_unique<Instr_LD_A_MA16>();
-    
-    instruction_table_[0xEA] = std::make_unique<Instr_LD_MA16_A>();
-}
+    // Any enabled+requested interrupt ends HALT, even with IME clear.
+    halted_ = false;
+    if (!ime_) return false;
 
+    uint8_t bit = 0;
+    while (!(pending & (1 << bit))) bit++;
 
-void Cpu::updateFlags_INC8(uint8_t old_val, uint8_t new_val) {
-    setFlagZ(new_val == 0);
-    setFlagN(false);
-    setFlagH((old_val & 0x0F) == 0x0F); 
-}
+    ime_ = false;
+    ime_enable_delay_ = 0;
+    bus_->acknowledgeInterrupt(static_cast<uint8_t>(1 << bit));
 
-void Cpu::updateFlags_DEC8(uint8_t old_val, uint8_t new_val) {
-    setFlagZ(new_val == 0);
-    setFlagN(true);
-    setFlagH((old_val & 0x0F) == 0x00); 
-}
+    debug_last_instr_pc_ = pc;
+    sp--; busWrite(sp, static_cast<uint8_t>(pc >> 8));
+    sp--; busWrite(sp, static_cast<uint8_t>(pc & 0xFF));
+    pc = static_cast<uint16_t>(0x0040 + bit * 8);
 
-void Cpu::updateFlags_ADD8(uint8_t val_a, uint8_t val_b, uint16_t result_wide) {
-    uint8_t result_byte = static_cast<uint8_t>(result_wide);
-    setFlagZ(result_byte == 0);
-    setFlagN(false);
-    setFlagH(((val_a & 0x0F) + (val_b & 0x0F)) > 0x0F);
-    setFlagC(result_wide > 0xFF);
+    current_instruction_cycles_ = 20;
+    cycles_elapsed_total_ += current_instruction_cycles_;
+    bus_->tick(current_instruction_cycles_);
+    if (profiler_) profiler_->interrupts_serviced++;
+    return true;
 }
 
-void Cpu::updateFlags_SUB8(uint8_t val_a, uint8_t val_b, uint8_t result_byte) {
-    setFlagZ(result_byte == 0);
-    setFlagN(true);
-    setFlagH((val_a & 0x0F) < (val_b & 0x0F));
-    setFlagC(val_a < val_b);
-}
+template <class BusType>
+void BasicCpu<BusType>::step() {
+    if (!bus_) {
+        GBC_LOG_ERROR("CPU Step: No bus connected!");
+        return;
+    }
 
-void Cpu::updateFlags_LOGIC8(uint8_t result_val, bool h_flag_val) {
-    setFlagZ(result_val == 0);
-    setFlagN(false);
-    setFlagH(h_flag_val); 
-    setFlagC(false);
-}
+    // Time the bus held the CPU (DMA) since the last step.
+    cycles_elapsed_total_ += bus_->takeStallCycles();
+    if (serviceInterrupts()) return;
 
-void Cpu::step() {
-    if (!bus_) {
-        std::cerr << "CPU Step: No bus connected!" << std::endl;
+    if (halted_) {
+        // Nothing can wake the CPU before the next scheduled event, so jump straight to it.
+        uint64_t skipped = bus_->skipToNextEvent();
+        if (skipped == 0) {
+            skipped = 4;
+            bus_->tick(4);
+        }
+        cycles_elapsed_total_ += skipped;
+        current_instruction_cycles_ = 0;
+        if (profiler_) profiler_->halt_cycles_skipped += skipped;
         return;
     }
 
     debug_last_instr_pc_ = pc; 
 
     uint8_t opcode = busRead(pc);
-    pc++; 
+    if (halt_bug_) {
+        halt_bug_ = false;
+    }
+    else {
+        pc++;
+    }
 
     debug_last_opcode_ = opcode;
 
-    Instruction* instr = nullptr;
-    if (opcode < instruction_table_.size() && instruction_table_[opcode]) {
-        instr = instruction_table_[opcode].get();
+    const OpcodeInfo& info = OpcodeTable::MAIN[opcode];
+    current_instruction_cycles_ = info.cycles;
+    debug_last_instr_length_ = info.length;
+    debug_last_operand_ = 0;
+
+    instruction_set_->main[opcode]->execute(*this);
+
+    if (ime_enable_delay_ != 0 && --ime_enable_delay_ == 0) {
+        ime_ = true;
     }
-    else {
-        std::cerr << "CRITICAL: Opcode " << formatHex8(opcode) << " has no entry in instruction_table_." << std::endl;
-        static InvalidInstruction static_invalid_handler(opcode); 
-        instr = &static_invalid_handler;
+
+    if (profiler_) {
+        profiler_->opcode_counts[opcode]++;
+        profiler_->opcode_cycles[opcode] += current_instruction_cycles_;
+        profiler_->instructions_executed++;
+    }
+
+    if (debug_trace_enabled_) {
+        uint8_t disasm_temp_len;
+        disassembleInstructionAt(debug_last_instr_pc_, debug_last_disassembled_, debug_last_instr_bytes_, disasm_temp_len);
     }
-    
-    
-    instr->execute(*this);    
-    
-    uint8_t disasm_temp_len; 
-    debug_last_instr_bytes_.clear();
-    debug_last_disassembled_ = disassembleInstructionAt(debug_last_instr_pc_,
-        disasm_temp_len,
-        debug_last_instr_bytes_);
 
     cycles_elapsed_total_ += current_instruction_cycles_;
-  
-}
+    bus_->tick(current_instruction_cycles_);
 
-std::string Cpu::disassembleInstructionAt(uint16_t address, uint8_t& out_length, std::vector<uint8_t>& out_bytes) {
-    
-    out_bytes.clear();
-    out_length = 0;
+    if (idle_loop_skipping_enabled_ && !debug_trace_enabled_) {
+        if (idle_loop_instructions_ < 0xFF) idle_loop_instructions_++;
+        if (pc < debug_last_instr_pc_ && debug_last_instr_pc_ - pc <= IDLE_LOOP_MAX_BYTES) {
+            checkIdleLoop();
+        }
+    }
+}
 
-    if (!bus_) { return "ERR:NO_BUS"; }
+template <class BusType>
+void BasicCpu<BusType>::checkIdleLoop() {
+    uint16_t registers[5] = { af, bc, de, hl, sp };
+    bool same_state = idle_loop_armed_ && pc == idle_loop_head_ &&
+        idle_loop_instructions_ <= IDLE_LOOP_MAX_INSTRUCTIONS &&
+        !bus_->idlePollWindowDirty() &&
+        std::equal(std::begin(registers), std::end(registers), std::begin(idle_loop_registers_));
+
+    if (same_state) {
+        // The last iteration was a pure function of values that stay fixed until the next
+        // event (or the earliest change of a polled register), so every iteration until then
+        // would behave the same.
+        uint64_t skipped = bus_->skipTo(bus_->idlePollDeadline());
+        cycles_elapsed_total_ += skipped;
+        if (skipped != 0 && profiler_) {
+            profiler_->idle_loops_skipped++;
+            profiler_->idle_cycles_skipped += skipped;
+        }
+    }
 
-    uint8_t opcode_at_addr = busRead(address);
-    Instruction* instr_to_disassemble = nullptr;
+    idle_loop_armed_ = true;
+    idle_loop_head_ = pc;
+    idle_loop_instructions_ = 0;
+    std::copy(std::begin(registers), std::end(registers), std::begin(idle_loop_registers_));
+    bus_->beginIdlePollWindow();
+}
 
-    if (opcode_at_addr < instruction_table_.size() && instruction_table_[opcode_at_addr]) {
-        instr_to_disassemble = instruction_table_[opcode_at_addr].get();
-    }
-    else {
-        out_bytes.push_back(opcode_at_addr);
-        out_length = 1;
-        return "DB " + formatHex8(opcode_at_addr) + " ; Unknown Opcode";
+template <class BusType>
+size_t BasicCpu<BusType>::disassembleInstructionAt(uint16_t address, char* out, uint8_t* out_bytes, uint8_t& out_length) {
+    out_length = 0;
+    if (!bus_) {
+        std::memcpy(out, "ERR:NO_BUS", 11);
+        return 10;
     }
-    
-    std::string disasm_string = instr_to_disassemble->disassemble(*this, address, out_bytes);
-    out_length = static_cast<uint8_t>(out_bytes.size());
-
-    if (out_length == 0 && !(disasm_string.rfind("ERR:", 0) == 0) && !(instr_to_disassemble->isInvalid())) {
-        
-        
-        std::cerr << "Warning: Disassemble for opcode " << formatHex8(opcode_at_addr)
-            << " did not populate out_bytes. Defaulting to 1 byte." << std::endl;
-        out_bytes.push_back(opcode_at_addr); 
-        out_length = 1;
+
+    uint8_t length = OpcodeTable::MAIN[busRead(address)].length;
+    for (uint8_t i = 0; i < length; ++i) {
+        out_bytes[i] = busRead(static_cast<uint16_t>(address + i));
     }
-    return disasm_string;
-}
\ No newline at end of file
+    return Disassembler::formatInstruction(out_bytes, length, address, out, out_length);
+}
+
+template <class BusType>
+std::string BasicCpu<BusType>::disassembleBytes(const uint8_t* bytes, size_t available, uint16_t address, uint8_t& out_length) {
+    char text[Disassembler::MNEMONIC_BUFFER_SIZE];
+    size_t length = Disassembler::formatInstruction(bytes, available, address, text, out_length);
+    return std::string(text, length);
+}
+
+template class BasicCpu<Bus>;
+template class BasicCpu<FlatBus>;
+
+static_assert(std::is_trivially_copyable<Cpu>::value, "Cpu must stay trivially copyable");
@@ -0,0 +1,233 @@
+#include "Disassembler.h"
+#include "OpcodeTable.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+    enum class Operand : uint8_t { None, D8, D16, A8, A16, R8, E8 };
+
+    // A mnemonic template with its placeholder cut out: `text` holds the literal prefix
+    // followed directly by the literal suffix, zero padded so both halves can be copied with
+    // fixed-size memcpy.
+    struct Template {
+        char text[32];
+        uint8_t prefix_length;
+        uint8_t suffix_length;
+        Operand operand;
+    };
+
+    static const size_t TEMPLATE_COPY_SIZE = 16;
+
+    constexpr Template makeTemplate(const char* mnemonic) {
+        Template result{};
+        if (!mnemonic) return result;
+
+        size_t length = 0;
+        const char* p = mnemonic;
+        while (*p) {
+            Operand operand = Operand::None;
+            size_t placeholder_length = 0;
+            if (result.operand == Operand::None) {
+                if ((p[0] == 'd' || p[0] == 'a') && p[1] == '1' && p[2] == '6') {
+                    operand = p[0] == 'd' ? Operand::D16 : Operand::A16;
+                    placeholder_length = 3;
+                }
+                else if (p[1] == '8') {
+                    switch (p[0]) {
+                        case 'd': operand = Operand::D8; break;
+                        case 'a': operand = Operand::A8; break;
+                        case 'r': operand = Operand::R8; break;
+                        case 'e': operand = Operand::E8; break;
+                        default: break;
+                    }
+                    placeholder_length = operand == Operand::None ? 0 : 2;
+                }
+            }
+            if (operand != Operand::None) {
+                result.operand = operand;
+                result.prefix_length = static_cast<uint8_t>(length);
+                p += placeholder_length;
+            }
+            else {
+                result.text[length++] = *p++;
+            }
+        }
+        if (result.operand == Operand::None) {
+            result.prefix_length = static_cast<uint8_t>(length);
+        }
+        result.suffix_length = static_cast<uint8_t>(length - result.prefix_length);
+        return result;
+    }
+
+    constexpr std::array<Template, 256> makeTemplates(const std::array<OpcodeInfo, 256>& table) {
+        std::array<Template, 256> result{};
+        for (size_t i = 0; i < table.size(); ++i) {
+            result[i] = makeTemplate(table[i].mnemonic);
+        }
+        return result;
+    }
+
+    constexpr std::array<Template, 256> MAIN_TEMPLATES = makeTemplates(OpcodeTable::MAIN);
+    constexpr std::array<Template, 256> CB_TEMPLATES = makeTemplates(OpcodeTable::CB);
+
+    constexpr bool templatesFitCopySize(const std::array<Template, 256>& templates) {
+        for (const Template& t : templates) {
+            if (t.prefix_length > TEMPLATE_COPY_SIZE || t.suffix_length > TEMPLATE_COPY_SIZE) return false;
+        }
+        return true;
+    }
+    static_assert(templatesFitCopySize(MAIN_TEMPLATES) && templatesFitCopySize(CB_TEMPLATES),
+        "Mnemonic template longer than the fixed copy size");
+
+    // Two upper-case hex digits per byte value, so formatting never branches on a digit.
+    struct HexPairs {
+        char digits[512];
+    };
+
+    constexpr HexPairs makeHexPairs() {
+        HexPairs result{};
+        const char* hex = "0123456789ABCDEF";
+        for (int value = 0; value < 256; ++value) {
+            result.digits[value * 2] = hex[value >> 4];
+            result.digits[value * 2 + 1] = hex[value & 0x0F];
+        }
+        return result;
+    }
+
+    constexpr HexPairs HEX_PAIRS = makeHexPairs();
+
+    inline char* writeHex8(char* p, uint8_t value) {
+        std::memcpy(p, &HEX_PAIRS.digits[value * 2], 2);
+        return p + 2;
+    }
+
+    inline char* writeHex16(char* p, uint16_t value) {
+        p = writeHex8(p, static_cast<uint8_t>(value >> 8));
+        return writeHex8(p, static_cast<uint8_t>(value));
+    }
+
+    inline char* writePrefixedHex8(char* p, uint8_t value) {
+        std::memcpy(p, "0x", 2);
+        return writeHex8(p + 2, value);
+    }
+
+    inline char* writePrefixedHex16(char* p, uint16_t value) {
+        std::memcpy(p, "0x", 2);
+        return writeHex16(p + 2, value);
+    }
+
+    // "DB 0xNN" for a byte that does not start a complete instruction.
+    inline size_t writeDataByte(char* out, uint8_t value) {
+        std::memcpy(out, "DB ", 3);
+        char* p = writePrefixedHex8(out + 3, value);
+        *p = '\0';
+        return static_cast<size_t>(p - out);
+    }
+}
+
+size_t Disassembler::formatInstruction(const uint8_t* bytes, size_t available, uint16_t address, char* out, uint8_t& out_length) {
+    out_length = 0;
+    out[0] = '\0';
+    if (available == 0) return 0;
+
+    uint8_t opcode = bytes[0];
+    const OpcodeInfo& info = OpcodeTable::MAIN[opcode];
+    if (!info.mnemonic) {
+        out_length = 1;
+        size_t length = writeDataByte(out, opcode);
+        std::memcpy(out + length, " (INVALID)", 11);
+        return length + 10;
+    }
+    if (available < info.length) return 0;
+    out_length = info.length;
+
+    const Template& t = opcode == 0xCB ? CB_TEMPLATES[bytes[1]] : MAIN_TEMPLATES[opcode];
+    char* p = out;
+    std::memcpy(p, t.text, TEMPLATE_COPY_SIZE);
+    p += t.prefix_length;
+
+    switch (t.operand) {
+        case Operand::None:
+            break;
+        case Operand::D8:
+            p = writePrefixedHex8(p, bytes[1]);
+            break;
+        case Operand::D16:
+        case Operand::A16:
+            p = writePrefixedHex16(p, static_cast<uint16_t>((bytes[2] << 8) | bytes[1]));
+            break;
+        case Operand::A8:
+            p = writePrefixedHex16(p, static_cast<uint16_t>(0xFF00 | bytes[1]));
+            break;
+        case Operand::R8:
+            p = writePrefixedHex16(p, static_cast<uint16_t>(address + info.length + static_cast<int8_t>(bytes[1])));
+            break;
+        case Operand::E8: {
+            int8_t offset = static_cast<int8_t>(bytes[1]);
+            if (offset < 0) {
+                // "SP+e8" reads as "SP-0x02" for negative offsets.
+                if (t.prefix_length != 0 && t.text[t.prefix_length - 1] == '+') p[-1] = '-';
+                else *p++ = '-';
+            }
+            p = writePrefixedHex8(p, static_cast<uint8_t>(offset < 0 ? -offset : offset));
+            break;
+        }
+    }
+
+    std::memcpy(p, t.text + t.prefix_length, TEMPLATE_COPY_SIZE);
+    p += t.suffix_length;
+    *p = '\0';
+    return static_cast<size_t>(p - out);
+}
+
+size_t Disassembler::formatLine(const uint8_t* bytes, size_t available, uint16_t address, char* out, uint8_t& out_length) {
+    // "0xAAAA: " then the raw bytes in a 12-column field, then the mnemonic.
+    static const size_t BYTES_COLUMN = 8;
+    static const size_t MNEMONIC_COLUMN = 20;
+
+    char* p = writePrefixedHex16(out, address);
+    std::memcpy(p, ": ", 2);
+    std::memset(out + BYTES_COLUMN, ' ', MNEMONIC_COLUMN - BYTES_COLUMN);
+
+    char* mnemonic = out + MNEMONIC_COLUMN;
+    size_t text_length = formatInstruction(bytes, available, address, mnemonic, out_length);
+    if (out_length == 0) {
+        out_length = 1;
+        text_length = writeDataByte(mnemonic, bytes[0]);
+    }
+    for (uint8_t i = 0; i < out_length; ++i) {
+        writeHex8(out + BYTES_COLUMN + i * 3, bytes[i]);
+    }
+    return MNEMONIC_COLUMN + text_length;
+}
+
+size_t Disassembler::disassembleRange(const uint8_t* data, size_t size, uint16_t base_address,
+    const uint16_t* anchors, size_t anchor_count, Line* lines, uint32_t* line_of_offset) {
+    const uint16_t* next_anchor = anchors;
+    const uint16_t* anchors_end = anchors + (anchors ? anchor_count : 0);
+    size_t line_count = 0;
+    size_t offset = 0;
+    while (offset < size) {
+        while (next_anchor != anchors_end && static_cast<uint16_t>(*next_anchor - base_address) <= offset) {
+            ++next_anchor;
+        }
+        size_t limit = size - offset;
+        // An anchor inside this instruction means the sweep is out of sync: stop short of it.
+        if (next_anchor != anchors_end) {
+            limit = std::min(limit, static_cast<size_t>(static_cast<uint16_t>(*next_anchor - base_address)) - offset);
+        }
+
+        Line& line = lines[line_count];
+        line.address = static_cast<uint16_t>(base_address + offset);
+        formatLine(data + offset, limit, line.address, line.text, line.length);
+
+        if (line_of_offset) {
+            std::fill(line_of_offset + offset, line_of_offset + offset + line.length, static_cast<uint32_t>(line_count));
+        }
+        offset += line.length;
+        ++line_count;
+    }
+    return line_count;
+}
@@ -0,0 +1,44 @@
+#include "DisassemblyCache.h"
+
+#include <algorithm>
+
+int DisassemblyCache::Bank::lineForAddress(uint16_t address) const {
+    uint32_t offset = static_cast<uint16_t>(address - base_address);
+    if (offset >= line_of_offset.size()) return -1;
+    return static_cast<int>(line_of_offset[offset]);
+}
+
+bool DisassemblyCache::Bank::isInstructionStart(uint16_t address) const {
+    int line = lineForAddress(address);
+    return line >= 0 && lines[line].address == address;
+}
+
+const DisassemblyCache::Bank& DisassemblyCache::get(uint32_t key, const uint8_t* data, size_t size,
+    uint16_t base_address, uint64_t generation) {
+    Bank& bank = banks_[key];
+    if (bank.stale || bank.generation != generation || bank.base_address != base_address ||
+        bank.line_of_offset.size() != size) {
+        bank.generation = generation;
+        bank.base_address = base_address;
+        build(bank, data, size);
+        bank.stale = false;
+    }
+    return bank;
+}
+
+void DisassemblyCache::addAnchor(uint32_t key, uint16_t address) {
+    Bank& bank = banks_[key];
+    if (std::find(bank.anchors.begin(), bank.anchors.end(), address) != bank.anchors.end()) return;
+    bank.anchors.insert(std::upper_bound(bank.anchors.begin(), bank.anchors.end(), address), address);
+    bank.stale = true;
+}
+
+void DisassemblyCache::build(Bank& bank, const uint8_t* data, size_t size) {
+    // Sized for the worst case of one line per byte, then trimmed; rebuilding a bank reuses
+    // the previous storage.
+    bank.lines.resize(size);
+    bank.line_of_offset.resize(size);
+    size_t line_count = Disassembler::disassembleRange(data, size, bank.base_address,
+        bank.anchors.data(), bank.anchors.size(), bank.lines.data(), bank.line_of_offset.data());
+    bank.lines.resize(line_count);
+}
@@ -5,20 +5,37 @@
 #include "Cartridge.h"
 #include "Utils.h"     
 #include "TestSuite.h" 
+#include "AudioOutput.h"
+#include "SaveState.h"
+#include "Movie.h"
+#include "Config.h"
+#include "FrameCapture.h"
 
 #include <SDL_timer.h> 
 
 #include <iostream>
 #include <iomanip> 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 
 Emulator::Emulator()
-    : cartridge_(nullptr), bus_(nullptr), cpu_(nullptr), ui_(nullptr),
+    : cartridge_(nullptr), bus_(nullptr), cpu_(nullptr),
+    current_rom_info_("No ROM Loaded"), ui_(nullptr),
+    movie_input_(0), commands_(COMMAND_QUEUE_CAPACITY), frames_presented_(0), joypad_input_(0),
     is_initialized_(false), is_running_(false),
-    is_paused_for_step_(true), step_requested_(false),
-    current_rom_info_("No ROM Loaded") {
+    is_paused_for_step_(true), step_requested_(false) {
 }
 
 Emulator::~Emulator() {
+    is_running_ = false;
+    if (emulation_thread_.joinable()) {
+        emulation_thread_.join();
+    }
+    stopMovieRecording();
+    if (audio_) {
+        audio_->close();
+    }
     if (ui_) {
         ui_->shutdown(); 
     }
@@ -28,12 +45,15 @@ Emulator::~Emulator() {
 bool Emulator::coreInitialize(const std::shared_ptr<Cartridge>& cart, uint16_t initial_pc, const std::string& rom_info) {
     cartridge_ = cart;
     current_rom_info_ = rom_info;
+    initial_pc_ = initial_pc;
 
     if (!bus_) bus_ = std::make_shared<Bus>();
     bus_->connectCartridge(cartridge_);
+    bus_->joypad().setInput(&joypad_input_);
 
     if (!cpu_) cpu_ = std::make_unique<Cpu>();
-    cpu_->connectBus(bus_);
+    cpu_->connectBus(bus_.get());
+    cpu_->profiler_ = profiler_.enabled ? &profiler_ : nullptr;
 
     cpu_->reset();
     cpu_->pc = initial_pc;
@@ -45,6 +65,22 @@ bool Emulator::coreInitialize(const std::shared_ptr<Cartridge>& cart, uint16_t i
     is_initialized_ = true;
     is_paused_for_step_ = true;
     step_requested_ = false;
+    cpu_state_before_.capture(*cpu_);
+    code_view_center_ = cpu_->pc;
+    follow_pc_ = true;
+    pacer_.reset();
+    return true;
+}
+
+bool Emulator::initializeUi() {
+    if (!ui_) {
+        ui_ = std::make_unique<EmulatorUI>(test_suite_, snapshots_, commands_, is_running_, frames_presented_, joypad_input_);
+    }
+    if (!ui_->initialize()) {
+        return false;
+    }
+    openAudio();
+    publishSnapshot();
     return true;
 }
 
@@ -61,19 +97,10 @@ bool Emulator::initialize(const std::string& rom_path) {
         return false;
     }
 
-    if (!ui_) {
-        ui_ = std::make_unique<EmulatorUI>(
-            *cpu_, *bus_, test_suite_, current_rom_info_,
-            is_paused_for_step_, step_requested_, is_running_,
-            [this](const TestRom& tr) { this->uiLoadTestRom(tr); },
-            [this]() { this->uiResetCpu(); }
-        );
-    }
-    if (!ui_->initialize()) {
+    if (!initializeUi()) {
         std::cerr << "Emulator UI initialization failed." << std::endl;
         return false;
     }
-    ui_->resetDisassemblyViewToPc();
 
     return true;
 }
@@ -89,24 +116,26 @@ bool Emulator::initialize(const std::vector<uint8_t>& test_data, uint16_t initia
         return false;
     }
 
-    if (!ui_) {
-        ui_ = std::make_unique<EmulatorUI>(
-            *cpu_, *bus_, test_suite_, current_rom_info_,
-            is_paused_for_step_, step_requested_, is_running_,
-            [this](const TestRom& tr) { this->uiLoadTestRom(tr); },
-            [this]() { this->uiResetCpu(); }
-        );
-    }
-    if (!ui_->initialize()) {
+    if (!initializeUi()) {
         std::cerr << "Emulator UI initialization failed for test data." << std::endl;
         return false;
     }
-    ui_->resetDisassemblyViewToPc();
 
     return true;
 }
 
+void Emulator::openAudio() {
+    // SDL's audio subsystem is initialised by the UI, so this has to follow ui_->initialize().
+    if (!audio_) audio_ = std::make_unique<AudioOutput>();
+    if (!audio_->isOpen() && !audio_->open()) {
+        std::cerr << "Emulator Warning: Audio unavailable, continuing without sound." << std::endl;
+        return;
+    }
+    bus_->apu().setOutput(&audio_->ring(), audio_->sampleRate());
+}
+
 void Emulator::uiLoadTestRom(const TestRom& test_rom_struct) {
+    stopMovieRecording();
     std::cout << "Loading Test ROM via UI: " << test_rom_struct.name << std::endl;
     bus_->reset();
 
@@ -119,26 +148,19 @@ void Emulator::uiLoadTestRom(const TestRom& test_rom_struct) {
         std::cerr << "Core re-initialization failed for test ROM: " << test_rom_struct.name << std::endl;
         return;
     }
-
-    if (ui_ && cpu_) {
-        ui_->captureCpuStateForDiff();
-        ui_->resetDisassemblyViewToPc();
-    }
-    is_paused_for_step_ = true;
-    step_requested_ = false;
 }
 
 void Emulator::uiResetCpu() {
     if (cpu_ && bus_ && cartridge_) {
+        stopMovieRecording();
         cpu_->reset();
         bus_->reset();
         std::cout << "CPU Reset requested by UI." << std::endl;
         printCpuStateForDebug();
 
-        if (ui_) {
-            ui_->captureCpuStateForDiff();
-            ui_->resetDisassemblyViewToPc();
-        }
+        cpu_state_before_.capture(*cpu_);
+        code_view_center_ = cpu_->pc;
+        follow_pc_ = true;
         is_paused_for_step_ = true;
         step_requested_ = false;
     }
@@ -158,69 +180,432 @@ void Emulator::printCpuStateForDebug() const {
     }
 }
 
+bool Emulator::isHaltedForever() const {
+    // Nothing can ever wake the CPU; this is how the test ROMs signal completion.
+    return cpu_->halted_ && (bus_->interruptEnable() & 0x1F) == 0;
+}
+
 void Emulator::step() {
     if (!is_initialized_ || !cpu_ || !bus_) return;
     cpu_->step();
 }
 
-void Emulator::run() {
-    if (!is_initialized_ || !ui_) {
-        std::cerr << "Emulator Error: Not fully initialized. Call initialize() first." << std::endl;
+bool Emulator::emulateFrame() {
+    // Free running: execute until the PPU completes a frame.
+    bool completed = true;
+    bus_->ppu().consumeFrameReady();
+    while (!bus_->ppu().consumeFrameReady()) {
+        step();
+        if (isHaltedForever()) {
+            completed = false;
+            break;
+        }
+    }
+    bus_->apu().endFrame();
+    return completed;
+}
+
+void Emulator::runFrame(bool draw) {
+    bool capturing = capture_ && capture_->active();
+    bus_->ppu().setSkipDrawing(!draw && !capturing);
+    if (movie_) {
+        movie_input_.store(joypad_input_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    if (!emulateFrame()) {
+        std::cout << "HALT with no interrupts enabled @ " << formatHex16(cpu_->debug_last_instr_pc_) << ". Emulation paused." << std::endl;
+        is_paused_for_step_ = true;
+        // The frame never finished, so a replay could not line up with it.
+        stopMovieRecording();
+    }
+    else if (movie_) {
+        movie_state_->save(*cpu_, *bus_);
+        movie_->appendFrame(movie_input_.load(std::memory_order_relaxed), Movie::hashState(*movie_state_));
+    }
+    if (capturing) {
+        const Ppu& ppu = bus_->ppu();
+        capture_->submit(ppu.framebuffer().data(), ppu.frameCount() - ppu.presentationLatency());
+    }
+
+    if (audio_ && audio_->isOpen() && !pacer_.fastForwarding()) {
+        size_t queued_frames = audio_->ring().size() / 2;
+        bus_->apu().setOutputRate(pacer_.mode() == PacingMode::Audio
+            ? pacer_.resampleRate(queued_frames, audio_->sampleRate())
+            : static_cast<double>(audio_->sampleRate()));
+        pacer_.setUnderruns(audio_->underruns());
+    }
+    pacer_.noteFrameEmulated();
+}
+
+void Emulator::runAhead() {
+    // Run past the real state with the current input, draw the last frame, then go back: the
+    // screen shows where the game will be, hiding that many frames of the game's own input lag.
+    // The real frames are never drawn while this is on, and the ahead frames are not heard
+    // or profiled.
+    auto start = std::chrono::steady_clock::now();
+    if (!run_ahead_state_) run_ahead_state_ = std::make_unique<MachineState>();
+    run_ahead_state_->save(*cpu_, *bus_);
+
+    CpuProfiler* profiler = cpu_->profiler_;
+    cpu_->profiler_ = nullptr;
+    bus_->apu().setMuted(true);
+    for (uint32_t i = 0; i < run_ahead_frames_; ++i) {
+        bus_->ppu().setSkipDrawing(i + 1 < run_ahead_frames_);
+        if (!emulateFrame()) break;
+    }
+    bus_->apu().setMuted(false);
+    run_ahead_state_->load(*cpu_, *bus_);
+    cpu_->profiler_ = profiler;
+
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    run_ahead_milliseconds_ += (milliseconds - run_ahead_milliseconds_) * 0.05;
+}
+
+void Emulator::setRunAheadFrames(uint32_t frames) {
+    const uint32_t max_frames = MAX_RUN_AHEAD_FRAMES;
+    run_ahead_frames_ = std::min(frames, max_frames);
+    run_ahead_milliseconds_ = 0.0;
+    // A worker would present every ahead frame one host frame late, undoing the point of it.
+    if (run_ahead_frames_ > 0) bus_->ppu().setThreadedRendering(false);
+}
+
+void Emulator::startMovieRecording() {
+    stopMovieRecording();
+    movie_ = std::make_unique<Movie>();
+    movie_->begin(Movie::hashRom(cartridge_->getRomData()), initial_pc_, cpu_->idle_loop_skipping_enabled_);
+    if (!movie_state_) movie_state_ = std::make_unique<MachineState>();
+
+    // Live input is sampled whenever the game polls; a movie needs it fixed for each frame.
+    movie_input_.store(0, std::memory_order_relaxed);
+    bus_->joypad().setInput(&movie_input_);
+    Movie::powerOn(*cpu_, *bus_, initial_pc_);
+
+    cpu_state_before_.capture(*cpu_);
+    code_view_center_ = cpu_->pc;
+    step_requested_ = false;
+    std::cout << "Recording movie from power-on." << std::endl;
+}
+
+void Emulator::stopMovieRecording() {
+    if (!movie_) return;
+    bus_->joypad().setInput(&joypad_input_);
+    if (movie_->save(Config::MOVIE_PATH)) {
+        std::cout << "Movie saved to " << Config::MOVIE_PATH << " (" << movie_->frameCount() << " frames)." << std::endl;
+    }
+    movie_.reset();
+}
+
+void Emulator::setCapture(uint32_t flags) {
+    if (flags == 0) {
+        if (capture_) capture_->stop();
         return;
     }
-    is_running_ = true;
-    std::cout << "\n--- Starting Emulation Main Loop (" << current_rom_info_ << ") ---" << std::endl;
+    if (!capture_) capture_ = std::make_unique<FrameCapture>(Ppu::SCREEN_WIDTH, Ppu::SCREEN_HEIGHT);
+    FrameCapture::Options options;
+    options.directory = Config::CAPTURE_DIRECTORY;
+    options.png_frames = (flags & EmulatorCommand::CAPTURE_PNG_FRAMES) != 0;
+    options.video = (flags & EmulatorCommand::CAPTURE_VIDEO) != 0;
+    options.policy = (flags & EmulatorCommand::CAPTURE_BLOCK) ? CapturePolicy::Block : CapturePolicy::Drop;
+    capture_->start(options);
+}
 
-    while (is_running_) {
-        ui_->processInput();
-        if (!is_running_) break;
+void Emulator::saveScreenshot() {
+    if (!capture_) capture_ = std::make_unique<FrameCapture>(Ppu::SCREEN_WIDTH, Ppu::SCREEN_HEIGHT);
+    char name[40];
+    std::snprintf(name, sizeof(name), "/screenshot_%06llu.png", (unsigned long long)bus_->ppu().frameCount());
+    capture_->screenshot(bus_->ppu().framebuffer().data(), Config::CAPTURE_DIRECTORY + name);
+}
 
-        bool should_execute_cpu_step = false;
-        if (!is_paused_for_step_) {
-            should_execute_cpu_step = true;
+void Emulator::setSpeed(uint32_t speed) {
+    pacer_.setSpeed(speed);
+    // Fast-forwarded samples would only overflow the ring, so the APU runs without an output
+    // (its register state stays exact) until normal speed is restored.
+    if (audio_ && audio_->isOpen()) {
+        bus_->apu().setOutput(pacer_.fastForwarding() ? nullptr : &audio_->ring(), audio_->sampleRate());
+    }
+}
+
+bool Emulator::processCommands() {
+    bool any_processed = false;
+    EmulatorCommand command;
+    while (commands_.pop(command)) {
+        any_processed = true;
+        switch (command.type) {
+        case EmulatorCommand::Run:
+            is_paused_for_step_ = false;
+            step_requested_ = false;
+            pacer_.reset();
+            break;
+        case EmulatorCommand::Pause:
+            is_paused_for_step_ = true;
+            step_requested_ = false;
+            break;
+        case EmulatorCommand::Step:
+            if (is_paused_for_step_) {
+                // Movies are made of whole frames; a single step would leave one half run.
+                stopMovieRecording();
+                step_requested_ = true;
+            }
+            break;
+        case EmulatorCommand::Reset:
+            uiResetCpu();
+            break;
+        case EmulatorCommand::LoadTestRom: {
+            const std::vector<TestRom>& all_tests = test_suite_.getAllTests();
+            if (command.value < all_tests.size()) {
+                uiLoadTestRom(all_tests[command.value]);
+            }
+            break;
         }
-        else if (step_requested_) {
-            should_execute_cpu_step = true;
+        case EmulatorCommand::SetMemoryWindow:
+            memory_space_ = static_cast<MemorySpace>(command.value >> 24);
+            memory_window_base_ = command.value & 0xFFFFFF;
+            break;
+        case EmulatorCommand::SetCodeView:
+            code_view_center_ = static_cast<uint16_t>(command.value);
+            follow_pc_ = false;
+            break;
+        case EmulatorCommand::SetFollowPc:
+            follow_pc_ = command.value != 0;
+            break;
+        case EmulatorCommand::SetPacingMode:
+            pacer_.setMode(static_cast<PacingMode>(command.value));
+            break;
+        case EmulatorCommand::SetProfilerEnabled:
+            profiler_.enabled = command.value != 0;
+            cpu_->profiler_ = profiler_.enabled ? &profiler_ : nullptr;
+            break;
+        case EmulatorCommand::ClearProfiler:
+            profiler_.reset();
+            break;
+        case EmulatorCommand::SetIdleLoopSkipping:
+            // Fixed for the length of a movie (see Movie).
+            if (movie_ && (command.value != 0) != cpu_->idle_loop_skipping_enabled_) stopMovieRecording();
+            cpu_->idle_loop_skipping_enabled_ = command.value != 0;
+            break;
+        case EmulatorCommand::SetThreadedRendering:
+            // Run-ahead hands only its last ahead frame to the renderer and then loads the real
+            // state back, which would drop that frame in flight on a worker (a frozen screen).
+            if (run_ahead_frames_ == 0) bus_->ppu().setThreadedRendering(command.value != 0);
+            break;
+        case EmulatorCommand::SetSpeed:
+            setSpeed(command.value);
+            break;
+        case EmulatorCommand::SetRunAhead:
+            setRunAheadFrames(command.value);
+            break;
+        case EmulatorCommand::SetMovieRecording:
+            if (command.value != 0) startMovieRecording();
+            else stopMovieRecording();
+            break;
+        case EmulatorCommand::SetCapture:
+            setCapture(command.value);
+            break;
+        case EmulatorCommand::SaveScreenshot:
+            saveScreenshot();
+            break;
         }
+    }
+    return any_processed;
+}
+
+uint32_t Emulator::memorySpaceSize(MemorySpace space) const {
+    Cartridge* cartridge = bus_->cartridge();
+    switch (space) {
+    case MemorySpace::Rom: return cartridge ? static_cast<uint32_t>(cartridge->getRomData().size()) : 0;
+    case MemorySpace::ExternalRam: return cartridge ? static_cast<uint32_t>(cartridge->ramData().size()) : 0;
+    default: return 0x10000;
+    }
+}
+
+void Emulator::publishSnapshot() {
+    DebugSnapshot& snapshot = snapshots_.back();
+    snapshot.cpu.capture(*cpu_);
+    snapshot.cpu_previous = cpu_state_before_;
+    snapshot.ime = cpu_->ime_;
+    snapshot.halted = cpu_->halted_;
+    snapshot.interrupt_enable = bus_->interruptEnable();
+    snapshot.interrupt_flag = bus_->interruptFlag();
+    snapshot.ly = bus_->ppu().ly();
+    snapshot.ppu_mode = static_cast<uint8_t>(bus_->ppu().mode());
+    snapshot.cgb_mode = bus_->cgbMode();
+    snapshot.double_speed = bus_->doubleSpeed();
+    snapshot.wram_bank = bus_->wramBank();
+    snapshot.vram_bank = bus_->ppu().vramBank();
+    snapshot.cycles = cpu_->cycles_elapsed_total_;
+    snapshot.last_instruction_cycles = cpu_->current_instruction_cycles_;
+    bus_->peekRange(cpu_->pc, snapshot.next_instruction_bytes.data(), snapshot.next_instruction_bytes.size());
+
+    snapshot.paused = is_paused_for_step_;
+    snapshot.frame_count = bus_->ppu().frameCount();
+    snapshot.rom_info = current_rom_info_;
+
+    Cartridge* cartridge = bus_->cartridge();
+    snapshot.memory_space = memory_space_;
+    snapshot.memory_space_size = memorySpaceSize(memory_space_);
+    snapshot.memory_window_base = memory_window_base_;
+    uint32_t window_capacity = DebugSnapshot::MEMORY_WINDOW_SIZE;
+    snapshot.memory_window_size = memory_window_base_ < snapshot.memory_space_size ?
+        std::min(snapshot.memory_space_size - memory_window_base_, window_capacity) : 0;
+    if (snapshot.memory_window_size != 0) {
+        uint8_t* window = snapshot.memory_window.data();
+        switch (memory_space_) {
+        case MemorySpace::Bus:
+            bus_->peekRange(static_cast<uint16_t>(memory_window_base_), window, snapshot.memory_window_size);
+            break;
+        case MemorySpace::Rom: {
+            const uint8_t* rom = cartridge->getRomData().data() + memory_window_base_;
+            std::copy(rom, rom + snapshot.memory_window_size, window);
+            break;
+        }
+        case MemorySpace::ExternalRam: {
+            const uint8_t* ram = cartridge->ramData().data() + memory_window_base_;
+            std::copy(ram, ram + snapshot.memory_window_size, window);
+            break;
+        }
+        }
+    }
+
+    if (follow_pc_) {
+        code_view_center_ = cpu_->pc;
+    }
+    snapshot.code_window_center = code_view_center_;
+    snapshot.follow_pc = follow_pc_;
+    snapshot.rom = cartridge ? cartridge->sharedRomData() : nullptr;
+    snapshot.rom_bank_low = cartridge ? cartridge->romBankAt(0x0000) : 0;
+    snapshot.rom_bank_high = cartridge ? cartridge->romBankAt(0x4000) : 1;
+    snapshot.external_ram_bank = cartridge ? cartridge->ramBank() : 0;
+    snapshot.code_region_base = 0;
+    snapshot.code_region_size = 0;
+    if (code_view_center_ >= 0x8000 && code_view_center_ <= 0xDFFF) {
+        snapshot.code_region_base = static_cast<uint16_t>(code_view_center_ & 0xE000);
+        snapshot.code_region_size = 0x2000;
+    }
+    else if (code_view_center_ >= 0xFF80 && code_view_center_ <= 0xFFFE) {
+        snapshot.code_region_base = 0xFF80;
+        snapshot.code_region_size = 0x7F;
+    }
+    snapshot.code_region_generation = bus_->ramWriteGeneration(snapshot.code_region_base);
+    bus_->peekRange(snapshot.code_region_base, snapshot.code_region.data(), snapshot.code_region_size);
+
+    snapshot.profiler = profiler_;
+    snapshot.idle_loop_skipping = cpu_->idle_loop_skipping_enabled_;
+    snapshot.threaded_rendering = bus_->ppu().threadedRendering();
+    snapshot.pacing_mode = pacer_.mode();
+    snapshot.speed = pacer_.speed();
+    snapshot.run_ahead_frames = run_ahead_frames_;
+    snapshot.run_ahead_milliseconds = run_ahead_milliseconds_;
+    snapshot.movie_recording = movie_ != nullptr;
+    snapshot.movie_frames = movie_ ? movie_->frameCount() : 0;
+    snapshot.capture_active = capture_ && capture_->active();
+    FrameCapture::Stats capture_stats = capture_ ? capture_->stats() : FrameCapture::Stats();
+    snapshot.capture_written = capture_stats.written;
+    snapshot.capture_dropped = capture_stats.dropped;
+    snapshot.pacing = pacer_.stats();
+
+    snapshot.framebuffer = bus_->ppu().framebuffer();
+    snapshots_.publish();
+}
+
+void Emulator::emulationThreadMain() {
+    while (is_running_) {
+        bool commands_processed = processCommands();
+
+        if (is_paused_for_step_) {
+            if (!step_requested_) {
+                // Nothing else will publish while paused, so reflect view/state changes right away.
+                if (commands_processed) publishSnapshot();
+                pacer_.reset();
+                SDL_Delay(1);
+                continue;
+            }
 
-        if (should_execute_cpu_step) {
-            if (cpu_ && bus_) {
-                ui_->captureCpuStateForDiff();
-
-                uint16_t pc_before_step = cpu_->pc;
-                uint8_t opcode_about_to_execute = bus_->read(pc_before_step);
-
-                step();
-
-                if (is_paused_for_step_ && step_requested_) {
-                    printf("(Prev PC: %s Op: %s) -> New PC: %s, AF: %s (Cyc: %d)\n",
-                        formatHex16(pc_before_step).c_str(),
-                        formatHex8(opcode_about_to_execute).c_str(),
-                        formatHex16(cpu_->pc).c_str(),
-                        formatHex16(cpu_->af).c_str(),
-                        cpu_->current_instruction_cycles_);
-                }
-                step_requested_ = false;
-
-                if (opcode_about_to_execute == 0x76) { 
-                    std::cout << "HALT instruction encountered @ " << formatHex16(pc_before_step) << ". Emulation paused." << std::endl;
-                    is_paused_for_step_ = true;
-                }
+            cpu_->debug_trace_enabled_ = true;
+            cpu_state_before_.capture(*cpu_);
+
+            uint16_t pc_before_step = cpu_->pc;
+            uint8_t opcode_about_to_execute = bus_->read(pc_before_step);
+
+            step();
+
+            printf("(Prev PC: %s Op: %s) -> New PC: %s, AF: %s (Cyc: %d)\n",
+                formatHex16(pc_before_step).c_str(),
+                formatHex8(opcode_about_to_execute).c_str(),
+                formatHex16(cpu_->pc).c_str(),
+                formatHex16(cpu_->af).c_str(),
+                cpu_->current_instruction_cycles_);
+            step_requested_ = false;
+
+            if (isHaltedForever()) {
+                std::cout << "HALT with no interrupts enabled @ " << formatHex16(cpu_->debug_last_instr_pc_) << "." << std::endl;
             }
+            publishSnapshot();
+            continue;
         }
 
-        ui_->render();
+        // In audio pacing the host clock decides how many frames are due; in vsync pacing the
+        // UI thread's buffer swaps do, one frame per presented frame.
+        int frames_due = 0;
+        if (pacer_.mode() == PacingMode::Audio) {
+            bool has_audio = audio_ && audio_->isOpen();
+            frames_due = pacer_.framesDue(has_audio ? audio_->ring().size() / 2 : 0,
+                has_audio ? audio_->sampleRate() : 0);
+        }
+        else {
+            uint64_t presented = frames_presented_.load(std::memory_order_acquire);
+            frames_due = (presented != frames_presented_seen_) ? pacer_.framesDueOnPresent() : 0;
+            frames_presented_seen_ = presented;
+        }
 
-        if (is_paused_for_step_ && !step_requested_) {
-            SDL_Delay(16);
+        if (frames_due > 0) {
+            cpu_->debug_trace_enabled_ = false;
+            cpu_state_before_.capture(*cpu_);
+            // Only one frame of a batch (catch-up or fast-forward) is ever displayed: the one
+            // framebuffer() shows after the last, which with threaded rendering is one earlier.
+            // With run-ahead it is the last ahead frame instead.
+            bool run_ahead = run_ahead_frames_ > 0 && !pacer_.fastForwarding();
+            int displayed_frame = run_ahead ? -1 : std::max(0, frames_due - 1 - bus_->ppu().presentationLatency());
+            for (int i = 0; i < frames_due && !is_paused_for_step_; ++i) {
+                runFrame(i == displayed_frame);
+            }
+            if (run_ahead && !is_paused_for_step_) {
+                runAhead();
+            }
+            // Single steps after a pause always draw.
+            bus_->ppu().setSkipDrawing(false);
+            publishSnapshot();
+        }
+
+        uint32_t wait_ms = (pacer_.mode() == PacingMode::Audio) ? pacer_.millisecondsUntilNextFrame() : 1;
+        if (wait_ms > 1) {
+            SDL_Delay(wait_ms - 1);
         }
-        else if (!is_paused_for_step_) {
-            
+        else if (frames_due == 0) {
+            SDL_Delay(1);
         }
     }
+}
+
+void Emulator::run() {
+    if (!is_initialized_ || !ui_) {
+        std::cerr << "Emulator Error: Not fully initialized. Call initialize() first." << std::endl;
+        return;
+    }
+    is_running_ = true;
+    std::cout << "\n--- Starting Emulation Main Loop (" << current_rom_info_ << ") ---" << std::endl;
+
+    emulation_thread_ = std::thread(&Emulator::emulationThreadMain, this);
+
+    // The calling thread only handles input and drawing.
+    while (is_running_) {
+        ui_->processInput();
+        if (!is_running_) break;
+        ui_->render();
+    }
+
+    emulation_thread_.join();
 
     std::cout << "\n--- Emulation Loop Finished ---" << std::endl;
     if (cpu_) {
         std::cout << "Total CPU cycles elapsed: " << cpu_->cycles_elapsed_total_ << std::endl;
     }
-}
\ No newline at end of file
+}
@@ -3,6 +3,9 @@
 #include "Bus.h"
 #include "Utils.h"
 #include "TestSuite.h"
+#include "OpcodeTable.h"
+#include "Cartridge.h"
+#include "Log.h"
 
 #include <SDL.h>
 #include "imgui.h"
@@ -18,6 +21,7 @@
 
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <cstdio>  
 
 void CpuDebugState::capture(const Cpu& cpu_obj) {
@@ -33,20 +37,20 @@ void CpuDebugState::capture(const Cpu& cpu_obj) {
     last_operand = cpu_obj.debug_last_operand_;
     last_instr_length = cpu_obj.debug_last_instr_length_;
     last_disassembled_str = cpu_obj.debug_last_disassembled_;
-    last_instr_bytes_vec = cpu_obj.debug_last_instr_bytes_;
+    last_instr_bytes_vec.assign(cpu_obj.debug_last_instr_bytes_,
+        cpu_obj.debug_last_instr_bytes_ + std::min<size_t>(cpu_obj.debug_last_instr_length_, sizeof(cpu_obj.debug_last_instr_bytes_)));
 }
 
 
 
 EmulatorUI::EmulatorUI(
-    Cpu& cpu_ref, Bus& bus_ref, TestSuite& ts_ref, std::string& rom_info_ref,
-    bool& paused_ref, bool& step_req_ref, bool& emu_is_running_ref,
-    std::function<void(const TestRom&)> load_test_rom_fn,
-    std::function<void()> reset_cpu_fn)
+    TestSuite& ts_ref, TripleBuffer<DebugSnapshot>& snapshots_ref, SpscRingBuffer<EmulatorCommand>& commands_ref,
+    std::atomic<bool>& emu_is_running_ref, std::atomic<uint64_t>& frames_presented_ref,
+    std::atomic<uint8_t>& joypad_input_ref)
     : window_(nullptr), gl_context_(nullptr),
-    cpu_(cpu_ref), bus_(bus_ref), test_suite_(ts_ref), current_rom_info_(rom_info_ref),
-    is_paused_for_step_(paused_ref), step_requested_(step_req_ref), emulator_is_running_(emu_is_running_ref),
-    load_test_rom_callback_(load_test_rom_fn), reset_cpu_callback_(reset_cpu_fn) {
+    test_suite_(ts_ref), snapshots_(snapshots_ref), commands_(commands_ref),
+    emulator_is_running_(emu_is_running_ref), frames_presented_(frames_presented_ref),
+    joypad_input_(joypad_input_ref) {
 }
 
 EmulatorUI::~EmulatorUI() {
@@ -56,23 +60,26 @@ EmulatorUI::~EmulatorUI() {
 bool EmulatorUI::initialize() {
     if (!initSdlAndOpenGL()) return false;
     initImGui();
-    cpu_state_prev_frame_.capture(cpu_);
     return true;
 }
 
 void EmulatorUI::shutdown() {
+    if (screen_texture_) {
+        glDeleteTextures(1, &screen_texture_);
+        screen_texture_ = 0;
+    }
     cleanupImGui();
     cleanupSdl();
     std::cout << "Emulator UI shutdown." << std::endl;
 }
 
-void EmulatorUI::captureCpuStateForDiff() {
-    cpu_state_prev_frame_.capture(cpu_);
-}
-
-void EmulatorUI::resetDisassemblyViewToPc() {
-    disassembly_view_center_address_ = cpu_.pc;
-    follow_pc_in_disassembly_ = true;
+void EmulatorUI::sendCommand(EmulatorCommand::Type type, uint32_t value) {
+    EmulatorCommand command;
+    command.type = type;
+    command.value = value;
+    if (!commands_.push(command)) {
+        GBC_LOG_WARNING("UI command queue full, command dropped.");
+    }
 }
 
 bool EmulatorUI::initSdlAndOpenGL() {
@@ -153,6 +160,23 @@ void EmulatorUI::processInput() {
             emulator_is_running_ = false;
         }
     }
+
+    // Published as soon as the events are in; the emulation thread reads it when the game
+    // polls JOYP. Keys go to ImGui instead while a text field is being edited.
+    static const struct { SDL_Scancode key; uint8_t button; } KEY_BINDINGS[] = {
+        { SDL_SCANCODE_RIGHT, Joypad::RIGHT }, { SDL_SCANCODE_LEFT, Joypad::LEFT },
+        { SDL_SCANCODE_UP, Joypad::UP }, { SDL_SCANCODE_DOWN, Joypad::DOWN },
+        { SDL_SCANCODE_X, Joypad::A }, { SDL_SCANCODE_Z, Joypad::B },
+        { SDL_SCANCODE_BACKSPACE, Joypad::SELECT }, { SDL_SCANCODE_RETURN, Joypad::START },
+    };
+    uint8_t pressed = 0;
+    if (!ImGui::GetIO().WantTextInput) {
+        const Uint8* keys = SDL_GetKeyboardState(nullptr);
+        for (const auto& binding : KEY_BINDINGS) {
+            if (keys[binding.key]) pressed |= binding.button;
+        }
+    }
+    joypad_input_.store(pressed, std::memory_order_relaxed);
 }
 
 void EmulatorUI::render() {
@@ -162,10 +186,14 @@ void EmulatorUI::render() {
     ImGui_ImplSDL2_NewFrame();
     ImGui::NewFrame();
 
+    // Pick up the newest snapshot; if none was published since the last frame, redraw the old one.
+    if (snapshots_.update()) screen_texture_stale_ = true;
+
     drawCpuRegistersAndStateWindow();
     drawDebugControlsWindow();
     drawDisassemblyContextWindow();
     drawMemoryViewerWindow();
+    drawProfilerWindow();
     renderGBCFrame();
 
     ImGui::Render();
@@ -188,10 +216,58 @@ void EmulatorUI::render() {
     }
 
     SDL_GL_SwapWindow(window_);
+    frames_presented_.fetch_add(1, std::memory_order_release);
 }
 
 void EmulatorUI::renderGBCFrame() {
-    
+    const DebugSnapshot& snapshot = snapshots_.front();
+    if (!screen_texture_) {
+        glGenTextures(1, &screen_texture_);
+        glBindTexture(GL_TEXTURE_2D, screen_texture_);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        screen_texture_width_ = 0;
+        screen_texture_stale_ = true;
+    }
+    if (screen_texture_stale_) {
+        // Only filter and upload when the emulation thread has published something new (or the
+        // filter changed).
+        const uint32_t* pixels = scaler_.process(snapshot.framebuffer.data(), Ppu::SCREEN_WIDTH, Ppu::SCREEN_HEIGHT,
+            scale_filter_, color_correction_);
+        glBindTexture(GL_TEXTURE_2D, screen_texture_);
+        if (scaler_.outputWidth() != screen_texture_width_ || scaler_.outputHeight() != screen_texture_height_) {
+            screen_texture_width_ = scaler_.outputWidth();
+            screen_texture_height_ = scaler_.outputHeight();
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, screen_texture_width_, screen_texture_height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+        else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, screen_texture_width_, screen_texture_height_, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+        screen_texture_stale_ = false;
+    }
+
+    ImGui::SetNextWindowSize(ImVec2(Ppu::SCREEN_WIDTH * 2 + 16, Ppu::SCREEN_HEIGHT * 2 + 60), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowPos(ImVec2(1180, 400), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Screen")) {
+        ImGui::SetNextItemWidth(110);
+        if (ImGui::BeginCombo("##Filter", FrameScaler::name(scale_filter_))) {
+            for (int i = 0; i < static_cast<int>(ScaleFilter::Count); ++i) {
+                ScaleFilter filter = static_cast<ScaleFilter>(i);
+                if (ImGui::Selectable(FrameScaler::name(filter), filter == scale_filter_)) {
+                    scale_filter_ = filter;
+                    screen_texture_stale_ = true;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::SameLine();
+        if (ImGui::Checkbox("CGB colors", &color_correction_)) screen_texture_stale_ = true;
+
+        ImVec2 avail = ImGui::GetContentRegionAvail();
+        float scale = std::max(1.0f, std::min(avail.x / Ppu::SCREEN_WIDTH, avail.y / Ppu::SCREEN_HEIGHT));
+        ImGui::Image((ImTextureID)(intptr_t)screen_texture_, ImVec2(Ppu::SCREEN_WIDTH * scale, Ppu::SCREEN_HEIGHT * scale));
+    }
+    ImGui::End();
 }
 
 
@@ -228,28 +304,32 @@ void EmulatorUI::drawCpuRegistersAndStateWindow() {
             if (lo_changed) ImGui::PopStyleColor();
         };
 
+    const DebugSnapshot& snapshot = snapshots_.front();
+    const CpuDebugState& cpu = snapshot.cpu;
+    const CpuDebugState& cpu_previous = snapshot.cpu_previous;
+
     ImGui::SetNextWindowSize(ImVec2(550, 280), ImGuiCond_FirstUseEver);
     ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
     if (ImGui::Begin("CPU Registers & State")) {
-        ImGui::Text("Loaded: %s", current_rom_info_.c_str());
+        ImGui::Text("Loaded: %s", snapshot.rom_info.c_str());
         ImGui::Separator();
 
         ImGui::BeginChild("RegistersPane", ImVec2(ImGui::GetContentRegionAvail().x * 0.45f, 0), false, ImGuiWindowFlags_NoScrollbar);
 
-        TextDiff16("PC", cpu_.pc, cpu_state_prev_frame_.pc);
-        TextDiff16("SP", cpu_.sp, cpu_state_prev_frame_.sp);
+        TextDiff16("PC", cpu.pc, cpu_previous.pc);
+        TextDiff16("SP", cpu.sp, cpu_previous.sp);
         ImGui::Separator();
 
         
-        TextDiffPair("AF", cpu_.af, cpu_state_prev_frame_.af, "A", cpu_.a(), static_cast<uint8_t>(cpu_state_prev_frame_.af >> 8), "F", cpu_.f(), static_cast<uint8_t>(cpu_state_prev_frame_.af & 0xFF));
-        TextDiffPair("BC", cpu_.bc, cpu_state_prev_frame_.bc, "B", cpu_.b(), static_cast<uint8_t>(cpu_state_prev_frame_.bc >> 8), "C", cpu_.c(), static_cast<uint8_t>(cpu_state_prev_frame_.bc & 0xFF));
-        TextDiffPair("DE", cpu_.de, cpu_state_prev_frame_.de, "D", cpu_.d(), static_cast<uint8_t>(cpu_state_prev_frame_.de >> 8), "E", cpu_.e(), static_cast<uint8_t>(cpu_state_prev_frame_.de & 0xFF));
-        TextDiffPair("HL", cpu_.hl, cpu_state_prev_frame_.hl, "H", cpu_.h(), static_cast<uint8_t>(cpu_state_prev_frame_.hl >> 8), "L", cpu_.l(), static_cast<uint8_t>(cpu_state_prev_frame_.hl & 0xFF));
+        TextDiffPair("AF", cpu.af, cpu_previous.af, "A", static_cast<uint8_t>(cpu.af >> 8), static_cast<uint8_t>(cpu_previous.af >> 8), "F", static_cast<uint8_t>(cpu.af & 0xFF), static_cast<uint8_t>(cpu_previous.af & 0xFF));
+        TextDiffPair("BC", cpu.bc, cpu_previous.bc, "B", static_cast<uint8_t>(cpu.bc >> 8), static_cast<uint8_t>(cpu_previous.bc >> 8), "C", static_cast<uint8_t>(cpu.bc & 0xFF), static_cast<uint8_t>(cpu_previous.bc & 0xFF));
+        TextDiffPair("DE", cpu.de, cpu_previous.de, "D", static_cast<uint8_t>(cpu.de >> 8), static_cast<uint8_t>(cpu_previous.de >> 8), "E", static_cast<uint8_t>(cpu.de & 0xFF), static_cast<uint8_t>(cpu_previous.de & 0xFF));
+        TextDiffPair("HL", cpu.hl, cpu_previous.hl, "H", static_cast<uint8_t>(cpu.hl >> 8), static_cast<uint8_t>(cpu_previous.hl >> 8), "L", static_cast<uint8_t>(cpu.hl & 0xFF), static_cast<uint8_t>(cpu_previous.hl & 0xFF));
 
         ImGui::Separator();
         
-        uint8_t current_f_reg = cpu_.f();
-        uint8_t prev_f_reg = static_cast<uint8_t>(cpu_state_prev_frame_.af & 0xFF);
+        uint8_t current_f_reg = static_cast<uint8_t>(cpu.af & 0xFF);
+        uint8_t prev_f_reg = static_cast<uint8_t>(cpu_previous.af & 0xFF);
 
         bool z_flag_current = (current_f_reg >> Cpu::FLAG_Z_BIT) & 1;
         bool n_flag_current = (current_f_reg >> Cpu::FLAG_N_BIT) & 1;
@@ -288,36 +368,43 @@ void EmulatorUI::drawCpuRegistersAndStateWindow() {
         if (c_flag_current != c_flag_prev) ImGui::PopStyleColor();
 
         ImGui::Separator();
-        ImGui::Text("Total Cycles: %llu", (unsigned long long)cpu_.cycles_elapsed_total_);
-        if (cpu_.current_instruction_cycles_ != 0 || cpu_state_prev_frame_.last_instr_length > 0) {
-            ImGui::Text("Last Op Cycles: %d", cpu_.current_instruction_cycles_);
+        ImGui::Text("IME: %d  HALT: %d  IE: %s  IF: %s", snapshot.ime, snapshot.halted,
+            formatHex8(snapshot.interrupt_enable).c_str(), formatHex8(snapshot.interrupt_flag).c_str());
+        ImGui::Text("LY: %d  Mode: %d", snapshot.ly, snapshot.ppu_mode);
+        if (snapshot.cgb_mode) {
+            ImGui::Text("CGB  Speed: %s  WRAM: %d  VRAM: %d", snapshot.double_speed ? "2x" : "1x",
+                snapshot.wram_bank, snapshot.vram_bank);
+        }
+        ImGui::Text("Total Cycles: %llu", (unsigned long long)snapshot.cycles);
+        if (snapshot.last_instruction_cycles != 0 || cpu.last_instr_length > 0) {
+            ImGui::Text("Last Op Cycles: %d", snapshot.last_instruction_cycles);
         }
         ImGui::EndChild();
 
         ImGui::SameLine();
 
         ImGui::BeginChild("InstructionPane", ImVec2(0, 0), false, 0);
-        ImGui::Text("Last Executed @ %s:", formatHex16(cpu_state_prev_frame_.last_instr_pc).c_str());
+        ImGui::Text("Last Executed @ %s:", formatHex16(cpu.last_instr_pc).c_str());
         std::string last_bytes_str = "";
-        for (uint8_t byte_val : cpu_state_prev_frame_.last_instr_bytes_vec) {
+        for (uint8_t byte_val : cpu.last_instr_bytes_vec) {
             last_bytes_str += formatHex8(byte_val, false) + " ";
         }
         ImGui::Text("Bytes: %s", last_bytes_str.c_str());
-        ImGui::Text("Disasm: %s", cpu_state_prev_frame_.last_disassembled_str.c_str());
-        if (cpu_state_prev_frame_.last_instr_length > 1) {
-            if (cpu_state_prev_frame_.last_instr_length == 2)
-                ImGui::Text("Operand: %s", formatHex8(static_cast<uint8_t>(cpu_state_prev_frame_.last_operand)).c_str());
-            else if (cpu_state_prev_frame_.last_instr_length == 3)
-                ImGui::Text("Operand: %s", formatHex16(cpu_state_prev_frame_.last_operand).c_str());
+        ImGui::Text("Disasm: %s", cpu.last_disassembled_str.c_str());
+        if (cpu.last_instr_length > 1) {
+            if (cpu.last_instr_length == 2)
+                ImGui::Text("Operand: %s", formatHex8(static_cast<uint8_t>(cpu.last_operand)).c_str());
+            else if (cpu.last_instr_length == 3)
+                ImGui::Text("Operand: %s", formatHex16(cpu.last_operand).c_str());
         }
         ImGui::Separator();
-        ImGui::Text("Next to Execute @ %s:", formatHex16(cpu_.pc).c_str());
+        ImGui::Text("Next to Execute @ %s:", formatHex16(cpu.pc).c_str());
         uint8_t next_len;
-        std::vector<uint8_t> next_bytes_vec;
-        std::string next_disasm = cpu_.disassembleInstructionAt(cpu_.pc, next_len, next_bytes_vec);
+        std::string next_disasm = Cpu::disassembleBytes(snapshot.next_instruction_bytes.data(),
+            snapshot.next_instruction_bytes.size(), cpu.pc, next_len);
         std::string next_bytes_display_str = "";
-        for (uint8_t byte_val : next_bytes_vec) {
-            next_bytes_display_str += formatHex8(byte_val, false) + " ";
+        for (uint8_t i = 0; i < next_len; ++i) {
+            next_bytes_display_str += formatHex8(snapshot.next_instruction_bytes[i], false) + " ";
         }
         ImGui::Text("Bytes: %s", next_bytes_display_str.c_str());
         ImGui::Text("Disasm: %s", next_disasm.c_str());
@@ -329,20 +416,87 @@ void EmulatorUI::drawCpuRegistersAndStateWindow() {
 void EmulatorUI::drawDebugControlsWindow() {
     ImGui::SetNextWindowSize(ImVec2(450, 150), ImGuiCond_FirstUseEver);
     ImGui::SetNextWindowPos(ImVec2(570, 10), ImGuiCond_FirstUseEver);
+    const DebugSnapshot& snapshot = snapshots_.front();
     if (ImGui::Begin("Debug Controls")) {
-        ImGui::Text("State: %s", is_paused_for_step_ ? "Paused" : "Running");
-        ImGui::SameLine(); ImGui::Text("(Step Req: %s)", step_requested_ ? "YES" : "no ");
-        if (is_paused_for_step_) {
-            if (ImGui::Button("Step Into")) { step_requested_ = true; }
+        ImGui::Text("State: %s", snapshot.paused ? "Paused" : "Running");
+        ImGui::SameLine(); ImGui::Text("(Frame: %llu)", (unsigned long long)snapshot.frame_count);
+        if (snapshot.paused) {
+            if (ImGui::Button("Step Into")) { sendCommand(EmulatorCommand::Step); }
             ImGui::SameLine();
-            if (ImGui::Button("Run")) { is_paused_for_step_ = false; step_requested_ = false; }
+            if (ImGui::Button("Run")) { sendCommand(EmulatorCommand::Run); }
         }
         else {
-            if (ImGui::Button("Pause")) { is_paused_for_step_ = true; step_requested_ = false; }
+            if (ImGui::Button("Pause")) { sendCommand(EmulatorCommand::Pause); }
         }
         ImGui::SameLine();
         if (ImGui::Button("Reset CPU")) {
-            if (reset_cpu_callback_) reset_cpu_callback_();
+            sendCommand(EmulatorCommand::Reset);
+        }
+        ImGui::Separator();
+        int pacing = (snapshot.pacing_mode == PacingMode::Audio) ? 0 : 1;
+        if (ImGui::Combo("Pacing", &pacing, "Audio (dynamic rate control)\0Display vsync\0")) {
+            sendCommand(EmulatorCommand::SetPacingMode,
+                static_cast<uint32_t>(pacing == 0 ? PacingMode::Audio : PacingMode::Vsync));
+        }
+        bool threaded_rendering = snapshot.threaded_rendering;
+        ImGui::BeginDisabled(snapshot.run_ahead_frames > 0);
+        if (ImGui::Checkbox("Render on worker thread (+1 frame latency)", &threaded_rendering)) {
+            sendCommand(EmulatorCommand::SetThreadedRendering, threaded_rendering ? 1 : 0);
+        }
+        ImGui::EndDisabled();
+        if (snapshot.run_ahead_frames > 0 && ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+            ImGui::SetTooltip("Unavailable while run-ahead is on");
+        }
+        static const uint32_t SPEEDS[] = { 1, 2, 4, FramePacer::SPEED_UNCAPPED };
+        int speed_index = 0;
+        for (int i = 0; i < 4; ++i) {
+            if (SPEEDS[i] == snapshot.speed) speed_index = i;
+        }
+        if (ImGui::Combo("Speed", &speed_index, "1x\0Fast-forward 2x\0Fast-forward 4x\0Fast-forward uncapped\0")) {
+            sendCommand(EmulatorCommand::SetSpeed, SPEEDS[speed_index]);
+        }
+        int run_ahead = static_cast<int>(snapshot.run_ahead_frames);
+        if (ImGui::SliderInt("Run-ahead frames", &run_ahead, 0, 4)) {
+            sendCommand(EmulatorCommand::SetRunAhead, static_cast<uint32_t>(run_ahead));
+        }
+        if (snapshot.run_ahead_frames > 0) {
+            ImGui::SameLine();
+            ImGui::Text("%.2f ms/frame", snapshot.run_ahead_milliseconds);
+        }
+        const FramePacer::Stats& pacing_stats = snapshot.pacing;
+        ImGui::Text("%.2f fps (%.2fx)  Audio: %.1f ms queued, rate %+.3f%%, underruns %llu",
+            pacing_stats.frames_per_second, pacing_stats.speed, pacing_stats.audio_latency_ms,
+            pacing_stats.rate_adjustment * 100.0, (unsigned long long)pacing_stats.underruns);
+        if (snapshot.movie_recording) {
+            if (ImGui::Button("Stop Recording")) sendCommand(EmulatorCommand::SetMovieRecording, 0);
+            ImGui::SameLine();
+            ImGui::Text("Recording movie: %u frames", snapshot.movie_frames);
+        }
+        else if (ImGui::Button("Record Movie")) {
+            sendCommand(EmulatorCommand::SetMovieRecording, 1);
+        }
+        if (ImGui::Button("Screenshot")) sendCommand(EmulatorCommand::SaveScreenshot);
+        ImGui::SameLine();
+        if (snapshot.capture_active) {
+            if (ImGui::Button("Stop Capture")) sendCommand(EmulatorCommand::SetCapture, 0);
+            ImGui::SameLine();
+            ImGui::Text("%llu frames written, %llu dropped",
+                (unsigned long long)snapshot.capture_written, (unsigned long long)snapshot.capture_dropped);
+        }
+        else {
+            if (ImGui::Button("Start Capture") && (capture_png_frames_ || capture_video_)) {
+                uint32_t flags = (capture_png_frames_ ? EmulatorCommand::CAPTURE_PNG_FRAMES : 0) |
+                    (capture_video_ ? EmulatorCommand::CAPTURE_VIDEO : 0) |
+                    (capture_wait_for_encoder_ ? EmulatorCommand::CAPTURE_BLOCK : 0);
+                sendCommand(EmulatorCommand::SetCapture, flags);
+            }
+            ImGui::SameLine();
+            ImGui::Checkbox("PNG frames", &capture_png_frames_);
+            ImGui::SameLine();
+            ImGui::Checkbox("Y4M video", &capture_video_);
+            ImGui::SameLine();
+            ImGui::Checkbox("Never drop", &capture_wait_for_encoder_);
+            if (ImGui::IsItemHovered()) ImGui::SetTooltip("Wait for the encoders instead of dropping frames when they fall behind");
         }
         ImGui::Separator();
         ImGui::Text("Load Test ROM:");
@@ -360,7 +514,7 @@ void EmulatorUI::drawDebugControlsWindow() {
             }
             if (ImGui::Button("Load Selected Test")) {
                 if (selected_test_idx >= 0 && selected_test_idx < static_cast<int>(all_tests.size())) {
-                    if (load_test_rom_callback_) load_test_rom_callback_(all_tests[selected_test_idx]);
+                    sendCommand(EmulatorCommand::LoadTestRom, static_cast<uint32_t>(selected_test_idx));
                 }
             }
         }
@@ -374,115 +528,98 @@ void EmulatorUI::drawDisassemblyContextWindow() {
 
     ImGui::SetNextWindowSize(ImVec2(550, 300), ImGuiCond_FirstUseEver);
     ImGui::SetNextWindowPos(ImVec2(10, 300), ImGuiCond_FirstUseEver);
+    const DebugSnapshot& snapshot = snapshots_.front();
+    const uint16_t pc = snapshot.cpu.pc;
+    const uint16_t view_center = snapshot.code_window_center;
+
     if (ImGui::Begin("Disassembly Context")) {
-        ImGui::Checkbox("Follow PC", &follow_pc_in_disassembly_);
+        bool follow_pc = snapshot.follow_pc;
+        if (ImGui::Checkbox("Follow PC", &follow_pc)) {
+            sendCommand(EmulatorCommand::SetFollowPc, follow_pc ? 1 : 0);
+        }
         ImGui::SameLine();
         static char addr_buf[5] = "0100";
         ImGui::PushItemWidth(60);
         if (ImGui::InputText("Goto Address", addr_buf, 5, ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue)) {
             unsigned int new_addr_uint;
             if (sscanf(addr_buf, "%x", &new_addr_uint) == 1) {
-                disassembly_view_center_address_ = static_cast<uint16_t>(new_addr_uint);
-                follow_pc_in_disassembly_ = false;
+                sendCommand(EmulatorCommand::SetCodeView, new_addr_uint & 0xFFFF);
             }
         }
         ImGui::PopItemWidth();
 
-        if (follow_pc_in_disassembly_) {
-            int pc_val = cpu_.pc;
-            int center_val = disassembly_view_center_address_;
-            int diff = pc_val - center_val;
-            if (diff < -15 || diff > 15) {
-                disassembly_view_center_address_ = cpu_.pc;
-            }
+        // Pick the bank containing the view center. ROM banks come from the shared image,
+        // RAM regions from the copy in the snapshot.
+        if (snapshot.rom.get() != disassembly_rom_identity_) {
+            disassembly_cache_.clear();
+            disassembly_rom_identity_ = snapshot.rom.get();
         }
-
-        ImGui::Separator();
-        ImGui::BeginChild("DisassemblyScroll", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
-
-        const int num_lines_display = 25;
-        const int lines_before_target_ideal = 10;
-        uint16_t current_disasm_addr = disassembly_view_center_address_;
-
-        uint16_t temp_addr = disassembly_view_center_address_;
-        std::vector<uint16_t> prev_addrs_stack;
-        for (int i = 0; i < lines_before_target_ideal + 5; ++i) {
-            bool found_an_earlier_instruction = false;
-            for (uint16_t look_back_offset = 1; look_back_offset <= 3; ++look_back_offset) {
-                if (temp_addr < look_back_offset) break;
-                uint16_t prev_potential_addr = temp_addr - look_back_offset;
-
-                uint8_t L; std::vector<uint8_t> B;
-                cpu_.disassembleInstructionAt(prev_potential_addr, L, B);
-                if (L == 0) L = 1;
-
-                if (prev_potential_addr + L == temp_addr) {
-                    prev_addrs_stack.push_back(prev_potential_addr);
-                    temp_addr = prev_potential_addr;
-                    found_an_earlier_instruction = true;
-                    break;
-                }
-            }
-            if (!found_an_earlier_instruction || prev_addrs_stack.size() >= lines_before_target_ideal) {
-                break;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        uint16_t base_address = 0;
+        uint32_t key = 0;
+        uint64_t generation = 0;
+        if (view_center < 0x8000 && snapshot.rom) {
+            uint32_t bank = (view_center < 0x4000) ? snapshot.rom_bank_low : snapshot.rom_bank_high;
+            size_t bank_offset = static_cast<size_t>(bank) * Cartridge::ROM_BANK_SIZE;
+            if (bank_offset < snapshot.rom->size()) {
+                data = snapshot.rom->data() + bank_offset;
+                size = std::min<size_t>(Cartridge::ROM_BANK_SIZE, snapshot.rom->size() - bank_offset);
+                base_address = static_cast<uint16_t>(view_center & 0xC000);
+                // Bank 0 is listed from 0x0000 and switchable banks from 0x4000.
+                key = DisassemblyCache::makeKey(DisassemblyCache::REGION_ROM, (bank << 1) | (base_address ? 1 : 0));
             }
         }
-        if (prev_addrs_stack.size() >= lines_before_target_ideal && !prev_addrs_stack.empty()) {
-            current_disasm_addr = prev_addrs_stack.back();
+        else if (snapshot.code_region_size != 0) {
+            data = snapshot.code_region.data();
+            size = snapshot.code_region_size;
+            base_address = snapshot.code_region_base;
+            generation = snapshot.code_region_generation;
+            if (base_address == 0x8000) key = DisassemblyCache::makeKey(DisassemblyCache::REGION_VRAM, 0);
+            else if (base_address == 0xA000) key = DisassemblyCache::makeKey(DisassemblyCache::REGION_EXTERNAL_RAM, snapshot.external_ram_bank);
+            else if (base_address == 0xC000) key = DisassemblyCache::makeKey(DisassemblyCache::REGION_WRAM, 0);
+            else key = DisassemblyCache::makeKey(DisassemblyCache::REGION_HRAM, 0);
         }
-        else if (!prev_addrs_stack.empty() && prev_addrs_stack.back() < disassembly_view_center_address_) {
-            current_disasm_addr = prev_addrs_stack.back();
-        }
-        else {
-            current_disasm_addr = (disassembly_view_center_address_ > lines_before_target_ideal / 2u) ? (disassembly_view_center_address_ - lines_before_target_ideal / 2u) : 0u;
-            current_disasm_addr = std::min(current_disasm_addr, disassembly_view_center_address_);
-        }
-
 
-        bool pc_line_visible_and_followed = false;
-
-        for (int line_count = 0; line_count < num_lines_display; ++line_count) {
-            if (current_disasm_addr > 0xFFFF - 3 && current_disasm_addr <= 0xFFFF) {
-            }
-            else if (line_count > 5 && current_disasm_addr > cpu_.pc + 60 && cpu_.pc < 0xFFA0) {
-            }
-
-            uint8_t len = 0;
-            std::vector<uint8_t> current_bytes_vec;
-            std::string dis = "??";
-            if (current_disasm_addr <= 0xFFFF) {
-                dis = cpu_.disassembleInstructionAt(current_disasm_addr, len, current_bytes_vec);
-            }
-            else {
-                break;
-            }
-
-            std::string bytes_str_loop = "";
-            for (size_t k = 0; k < current_bytes_vec.size() && k < 4; ++k) {
-                bytes_str_loop += formatHex8(current_bytes_vec[k], false) + " ";
-            }
-            while (bytes_str_loop.length() < 12) bytes_str_loop += " ";
+        ImGui::Separator();
+        if (!data) {
+            ImGui::Text("No code region at %s.", formatHex16(view_center).c_str());
+            ImGui::End();
+            return;
+        }
 
-            bool is_pc_line = (current_disasm_addr == cpu_.pc);
-            if (is_pc_line) {
-                ImGui::PushStyleColor(ImGuiCol_Text, pc_highlight_color);
-                if (follow_pc_in_disassembly_) {
-                    pc_line_visible_and_followed = true;
-                }
-            }
+        const DisassemblyCache::Bank* bank = &disassembly_cache_.get(key, data, size, base_address, generation);
+        // A PC inside what the linear sweep took for an operand: resync the bank at the PC.
+        if (bank->lineForAddress(pc) >= 0 && !bank->isInstructionStart(pc)) {
+            disassembly_cache_.addAnchor(key, pc);
+            bank = &disassembly_cache_.get(key, data, size, base_address, generation);
+        }
 
-            ImGui::Text("%s: %s%s", formatHex16(current_disasm_addr).c_str(), bytes_str_loop.c_str(), dis.c_str());
+        ImGui::BeginChild("DisassemblyScroll", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
+        const float line_height = ImGui::GetTextLineHeightWithSpacing();
+
+        // Scroll when the view center moves, or when following and the PC leaves the visible lines.
+        int center_line = bank->lineForAddress(view_center);
+        int first_visible = static_cast<int>(ImGui::GetScrollY() / line_height);
+        int visible_count = static_cast<int>(ImGui::GetWindowHeight() / line_height);
+        bool center_moved = view_center != disassembly_scrolled_center_ || key != disassembly_scrolled_key_;
+        bool center_off_screen = center_line < first_visible + 1 || center_line >= first_visible + visible_count - 1;
+        if (center_line >= 0 && (center_moved && (!snapshot.follow_pc || center_off_screen))) {
+            ImGui::SetScrollY(std::max(0.0f, center_line * line_height - ImGui::GetWindowHeight() * 0.4f));
+        }
+        disassembly_scrolled_center_ = view_center;
+        disassembly_scrolled_key_ = key;
 
-            if (is_pc_line) {
-                ImGui::PopStyleColor();
-                if (follow_pc_in_disassembly_) ImGui::SetScrollHereY(0.4f);
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(bank->lines.size()), line_height);
+        while (clipper.Step()) {
+            for (int line_index = clipper.DisplayStart; line_index < clipper.DisplayEnd; ++line_index) {
+                const DisassemblyCache::Line& line = bank->lines[line_index];
+                bool is_pc_line = (line.address == pc);
+                if (is_pc_line) ImGui::PushStyleColor(ImGuiCol_Text, pc_highlight_color);
+                ImGui::TextUnformatted(line.text);
+                if (is_pc_line) ImGui::PopStyleColor();
             }
-
-            if (len == 0) len = 1;
-
-            uint32_t next_addr_check = static_cast<uint32_t>(current_disasm_addr) + len;
-            if (next_addr_check > 0xFFFF) break;
-            current_disasm_addr = static_cast<uint16_t>(next_addr_check);
         }
         ImGui::EndChild();
     }
@@ -493,146 +630,192 @@ void EmulatorUI::drawMemoryViewerWindow() {
     ImGui::SetNextWindowSize(ImVec2(600, 400), ImGuiCond_FirstUseEver); 
     ImGui::SetNextWindowPos(ImVec2(570, 170), ImGuiCond_FirstUseEver); 
 
+    const DebugSnapshot& snapshot = snapshots_.front();
     if (ImGui::Begin("Memory Viewer")) {
-        
+        const float row_height = ImGui::GetTextLineHeightWithSpacing();
+        const uint32_t bytes_per_row = static_cast<uint32_t>(memory_editor_bytes_per_row_);
+
+        int space = static_cast<int>(memory_view_space_);
+        ImGui::PushItemWidth(170);
+        if (ImGui::Combo("##mem_space", &space, "CPU bus (64 KiB)\0ROM (all banks)\0Cartridge RAM (all banks)\0")) {
+            memory_view_space_ = static_cast<MemorySpace>(space);
+            memory_editor_scroll_to_row_ = 0;
+        }
+        ImGui::PopItemWidth();
+        ImGui::SameLine();
         ImGui::PushItemWidth(70); 
-        if (ImGui::InputText("Address", memory_editor_addr_input_buf_, 5,
+        if (ImGui::InputText("Offset", memory_editor_addr_input_buf_, sizeof(memory_editor_addr_input_buf_),
             ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue)) {
             unsigned int new_addr_uint;
             if (sscanf(memory_editor_addr_input_buf_, "%x", &new_addr_uint) == 1) {
-                memory_editor_address_ = static_cast<uint16_t>(new_addr_uint);
+                memory_editor_scroll_to_row_ = static_cast<int>(new_addr_uint / bytes_per_row);
             }
         }
+        bool address_input_active = ImGui::IsItemActive();
         ImGui::PopItemWidth();
         ImGui::SameLine();
         if (ImGui::ArrowButton("##mem_prev_page", ImGuiDir_Left)) {
-            if (memory_editor_address_ >= static_cast<uint16_t>(memory_editor_bytes_per_row_ * memory_editor_num_rows_)) {
-                memory_editor_address_ -= static_cast<uint16_t>(memory_editor_bytes_per_row_ * memory_editor_num_rows_);
-            }
-            else {
-                memory_editor_address_ = 0;
-            }
-            sprintf(memory_editor_addr_input_buf_, "%04X", memory_editor_address_);
+            memory_editor_scroll_to_row_ = std::max(0, static_cast<int>(memory_editor_address_ / bytes_per_row) - memory_editor_visible_rows_);
         }
         ImGui::SameLine();
         if (ImGui::ArrowButton("##mem_next_page", ImGuiDir_Right)) {
-            uint32_t new_addr = static_cast<uint32_t>(memory_editor_address_) + (memory_editor_bytes_per_row_ * memory_editor_num_rows_);
-            if (new_addr <= 0xFFFF) {
-                memory_editor_address_ = static_cast<uint16_t>(new_addr);
-            }
-            else {
-                
-                
-                uint32_t max_start_addr = 0xFFFF - (memory_editor_bytes_per_row_ * memory_editor_num_rows_) + 1;
-                max_start_addr = std::min(max_start_addr, (uint32_t)0xFFFF); 
-                memory_editor_address_ = static_cast<uint16_t>(max_start_addr);
-            }
-            sprintf(memory_editor_addr_input_buf_, "%04X", memory_editor_address_);
+            memory_editor_scroll_to_row_ = static_cast<int>(memory_editor_address_ / bytes_per_row) + memory_editor_visible_rows_;
         }
         ImGui::SameLine();
-        ImGui::Text(" (SP: %s, PC: %s)", formatHex16(cpu_.sp).c_str(), formatHex16(cpu_.pc).c_str());
-
+        ImGui::Text(" (SP: %s, PC: %s)", formatHex16(snapshot.cpu.sp).c_str(), formatHex16(snapshot.cpu.pc).c_str());
 
         ImGui::Separator();
 
-        
-        
-        ImGui::BeginChild("MemoryViewScroll", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
-
-        ImGuiListClipper clipper;
-        
-        
-        clipper.Begin(0xFFFF / memory_editor_bytes_per_row_ + 1, ImGui::GetTextLineHeightWithSpacing());
+        // Until the emulation thread has switched to the selected space there is nothing to show.
+        bool space_published = snapshot.memory_space == memory_view_space_;
+        uint32_t space_size = space_published ? snapshot.memory_space_size : 0;
+        int row_count = static_cast<int>((space_size + bytes_per_row - 1) / bytes_per_row);
 
-        
-        uint16_t current_row_addr = memory_editor_address_;
-
-        for (int row = 0; row < memory_editor_num_rows_; ++row) {
-            if (static_cast<uint32_t>(current_row_addr) + row * memory_editor_bytes_per_row_ > 0xFFFF && row > 0) {
-                
-                
-                break;
-            }
-
-            
-            ImGui::Text("%s: ", formatHex16(current_row_addr + row * memory_editor_bytes_per_row_).c_str());
-            ImGui::SameLine();
+        ImGui::BeginChild("MemoryViewScroll", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
 
-            
-            std::string ascii_representation = " | "; 
-            for (int col = 0; col < memory_editor_bytes_per_row_; ++col) {
-                uint32_t current_byte_addr_long = static_cast<uint32_t>(current_row_addr) +
-                    row * memory_editor_bytes_per_row_ + col;
+        if (memory_editor_scroll_to_row_ >= 0 && space_published) {
+            ImGui::SetScrollY(std::min(memory_editor_scroll_to_row_, std::max(row_count - 1, 0)) * row_height);
+            memory_editor_scroll_to_row_ = -1;
+        }
 
-                if (current_byte_addr_long > 0xFFFF) {
-                    ImGui::TextUnformatted(".."); 
+        // Only the rows the clipper reports visible are drawn, so the view can span the whole
+        // space; bytes come from the published window, which follows the first visible row.
+        ImGuiListClipper clipper;
+        clipper.Begin(row_count, row_height);
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                uint32_t row_offset = static_cast<uint32_t>(row) * bytes_per_row;
+
+                // ROM and cartridge RAM rows are labelled bank:address as the CPU would see them.
+                switch (memory_view_space_) {
+                case MemorySpace::Rom: {
+                    uint32_t bank = row_offset / Cartridge::ROM_BANK_SIZE;
+                    uint32_t address = (bank == 0 ? 0x0000 : 0x4000) + row_offset % Cartridge::ROM_BANK_SIZE;
+                    ImGui::Text("%03X:%04X: ", bank, address);
+                    break;
                 }
-                else {
-                    uint16_t current_byte_addr = static_cast<uint16_t>(current_byte_addr_long);
-                    uint8_t byte_val = bus_.read(current_byte_addr);
+                case MemorySpace::ExternalRam:
+                    ImGui::Text("%02X:%04X: ", row_offset / Cartridge::RAM_BANK_SIZE,
+                        0xA000 + row_offset % Cartridge::RAM_BANK_SIZE);
+                    break;
+                default:
+                    ImGui::Text("%04X: ", row_offset);
+                    break;
+                }
+                ImGui::SameLine();
+
+                char ascii_representation[64] = " | ";
+                size_t ascii_length = 3;
+                for (uint32_t col = 0; col < bytes_per_row; ++col) {
+                    uint32_t offset = row_offset + col;
+                    uint32_t window_offset = offset - snapshot.memory_window_base;
+                    if (offset >= space_size) {
+                        ImGui::TextUnformatted("..");
+                        ascii_representation[ascii_length++] = ' ';
+                    }
+                    else if (window_offset >= snapshot.memory_window_size) {
+                        // Not in the published window yet (the request is still in flight).
+                        ImGui::TextUnformatted("??");
+                        ascii_representation[ascii_length++] = ' ';
+                    }
+                    else {
+                        uint8_t byte_val = snapshot.memory_window[window_offset];
 
-                    
-                    bool is_sp = (current_byte_addr == cpu_.sp);
-                    bool is_pc = (current_byte_addr == cpu_.pc);
-                    if (is_sp && is_pc) ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.5f, 1.0f, 1.0f)); 
-                    else if (is_sp) ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.0f, 1.0f, 1.0f, 1.0f));    
-                    else if (is_pc) ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 1.0f, 0.0f, 1.0f));    
+                        bool on_bus = memory_view_space_ == MemorySpace::Bus;
+                        bool is_sp = on_bus && offset == snapshot.cpu.sp;
+                        bool is_pc = on_bus && offset == snapshot.cpu.pc;
+                        if (is_sp && is_pc) ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.5f, 1.0f, 1.0f)); 
+                        else if (is_sp) ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.0f, 1.0f, 1.0f, 1.0f));    
+                        else if (is_pc) ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 1.0f, 0.0f, 1.0f));    
 
-                    ImGui::TextUnformatted(formatHex8(byte_val, false).c_str());
+                        char hex[3];
+                        snprintf(hex, sizeof(hex), "%02X", byte_val);
+                        ImGui::TextUnformatted(hex);
 
-                    if (is_sp || is_pc) ImGui::PopStyleColor();
+                        if (is_sp || is_pc) ImGui::PopStyleColor();
 
-                    
-                    if (byte_val >= 32 && byte_val <= 126) { 
-                        ascii_representation += static_cast<char>(byte_val);
+                        ascii_representation[ascii_length++] = (byte_val >= 32 && byte_val <= 126) ? static_cast<char>(byte_val) : '.';
                     }
-                    else {
-                        ascii_representation += '.'; 
+                    if (col < bytes_per_row - 1) {
+                        ImGui::SameLine(0, ImGui::GetStyle().ItemSpacing.x / 2); 
                     }
                 }
-                if (col < memory_editor_bytes_per_row_ - 1) {
-                    ImGui::SameLine(0, ImGui::GetStyle().ItemSpacing.x / 2); 
-                }
-            }
+                ascii_representation[ascii_length] = '\0';
 
-            
-            ImGui::SameLine();
-            ImGui::TextUnformatted(ascii_representation.c_str());
-
-            
-            if (static_cast<uint32_t>(current_row_addr) + (row + 1) * memory_editor_bytes_per_row_ > 0xFFFF &&
-                (current_row_addr % memory_editor_bytes_per_row_ != 0 || row * memory_editor_bytes_per_row_ < 0xFFFF)) {
-                
-                
-                break;
+                ImGui::SameLine();
+                ImGui::TextUnformatted(ascii_representation);
             }
         }
-        
-
-        
-        if (ImGui::IsWindowHovered() && ImGui::GetIO().MouseWheel != 0) {
-            int scroll_amount_lines = static_cast<int>(-ImGui::GetIO().MouseWheel); 
-            int scroll_amount_bytes = scroll_amount_lines * memory_editor_bytes_per_row_;
-
-            int32_t new_addr_signed = static_cast<int32_t>(memory_editor_address_) + scroll_amount_bytes;
-
-            if (new_addr_signed < 0) {
-                memory_editor_address_ = 0;
-            }
-            else if (new_addr_signed > 0xFFFF) {
-                
-                uint32_t max_start_addr = 0xFFFF - std::min(memory_editor_bytes_per_row_ * (memory_editor_num_rows_ - 1), 0xFFFF);
-                memory_editor_address_ = static_cast<uint16_t>(max_start_addr);
 
-            }
-            else {
-                memory_editor_address_ = static_cast<uint16_t>(new_addr_signed);
-            }
-            sprintf(memory_editor_addr_input_buf_, "%04X", memory_editor_address_); 
+        // Ask for the window starting at the first visible row.
+        memory_editor_visible_rows_ = std::max(1, static_cast<int>(ImGui::GetWindowHeight() / row_height));
+        uint32_t first_visible_offset = static_cast<uint32_t>(ImGui::GetScrollY() / row_height) * bytes_per_row;
+        if (first_visible_offset != memory_editor_address_ && !address_input_active) {
+            snprintf(memory_editor_addr_input_buf_, sizeof(memory_editor_addr_input_buf_), "%04X", first_visible_offset);
         }
+        memory_editor_address_ = first_visible_offset;
 
+        uint32_t window_request = EmulatorCommand::memoryWindowValue(memory_view_space_, memory_editor_address_);
+        if (window_request != requested_memory_window_) {
+            requested_memory_window_ = window_request;
+            sendCommand(EmulatorCommand::SetMemoryWindow, window_request);
+        }
 
         ImGui::EndChild(); 
     }
     ImGui::End(); 
-}
\ No newline at end of file
+}
+
+void EmulatorUI::drawProfilerWindow() {
+    ImGui::SetNextWindowSize(ImVec2(420, 380), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowPos(ImVec2(1180, 10), ImGuiCond_FirstUseEver);
+    const DebugSnapshot& snapshot = snapshots_.front();
+    if (ImGui::Begin("Profiler")) {
+        const CpuProfiler& profiler = snapshot.profiler;
+        bool profiler_enabled = profiler.enabled;
+        if (ImGui::Checkbox("Enabled", &profiler_enabled)) {
+            sendCommand(EmulatorCommand::SetProfilerEnabled, profiler_enabled ? 1 : 0);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear")) { sendCommand(EmulatorCommand::ClearProfiler); }
+        ImGui::Text("Instructions: %llu", (unsigned long long)profiler.instructions_executed);
+        ImGui::Text("Interrupts: %llu", (unsigned long long)profiler.interrupts_serviced);
+        ImGui::Text("HALT cycles skipped: %llu", (unsigned long long)profiler.halt_cycles_skipped);
+        bool idle_loop_skipping = snapshot.idle_loop_skipping;
+        if (ImGui::Checkbox("Idle-loop skipping", &idle_loop_skipping)) {
+            sendCommand(EmulatorCommand::SetIdleLoopSkipping, idle_loop_skipping ? 1 : 0);
+        }
+        ImGui::Text("Idle loops skipped: %llu (%llu cycles)",
+            (unsigned long long)profiler.idle_loops_skipped, (unsigned long long)profiler.idle_cycles_skipped);
+        ImGui::Separator();
+
+        std::vector<int> order;
+        for (int op = 0; op < 0x100; ++op) {
+            if (profiler.opcode_counts[op] != 0) order.push_back(op);
+        }
+        std::sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+            return profiler.opcode_cycles[lhs] > profiler.opcode_cycles[rhs];
+            });
+
+        uint64_t total_cycles = 0;
+        for (int op : order) total_cycles += profiler.opcode_cycles[op];
+
+        if (ImGui::BeginTable("ProfilerTable", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY)) {
+            ImGui::TableSetupColumn("Op");
+            ImGui::TableSetupColumn("Mnemonic");
+            ImGui::TableSetupColumn("Count");
+            ImGui::TableSetupColumn("Cycles %");
+            ImGui::TableHeadersRow();
+            for (int op : order) {
+                const char* mnemonic = OpcodeTable::MAIN[op].mnemonic;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(formatHex8(static_cast<uint8_t>(op)).c_str());
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(mnemonic ? mnemonic : "(INVALID)");
+                ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)profiler.opcode_counts[op]);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", total_cycles ? 100.0 * profiler.opcode_cycles[op] / total_cycles : 0.0);
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
@@ -0,0 +1,406 @@
+#include "FrameCapture.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+    // --- PNG: zlib stream with one fixed-Huffman deflate block, greedy LZ77 matches ---
+
+    const size_t WINDOW_SIZE = 32768;
+    const size_t MIN_MATCH = 3;
+    const size_t MAX_MATCH = 258;
+    const int HASH_BITS = 15;
+
+    const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+        67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+        12, 12, 13, 13 };
+
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+        // Deflate packs values LSB first.
+        void bits(uint32_t value, int count) {
+            buffer_ |= static_cast<uint64_t>(value) << count_;
+            count_ += count;
+            while (count_ >= 8) {
+                out_.push_back(static_cast<uint8_t>(buffer_));
+                buffer_ >>= 8;
+                count_ -= 8;
+            }
+        }
+
+        // Huffman codes are defined MSB first.
+        void code(uint32_t code, int length) {
+            uint32_t reversed = 0;
+            for (int i = 0; i < length; ++i) reversed |= ((code >> i) & 1) << (length - 1 - i);
+            bits(reversed, length);
+        }
+
+        void flush() {
+            if (count_ > 0) bits(0, 8 - count_);
+        }
+
+    private:
+        std::vector<uint8_t>& out_;
+        uint64_t buffer_ = 0;
+        int count_ = 0;
+    };
+
+    // Fixed literal/length code (RFC 1951, 3.2.6).
+    void writeSymbol(BitWriter& writer, uint32_t symbol) {
+        if (symbol < 144) writer.code(0x30 + symbol, 8);
+        else if (symbol < 256) writer.code(0x190 + symbol - 144, 9);
+        else if (symbol < 280) writer.code(symbol - 256, 7);
+        else writer.code(0xC0 + symbol - 280, 8);
+    }
+
+    void writeMatch(BitWriter& writer, size_t length, size_t distance) {
+        int length_code = 28;
+        while (LENGTH_BASE[length_code] > length) --length_code;
+        writeSymbol(writer, 257 + length_code);
+        writer.bits(static_cast<uint32_t>(length - LENGTH_BASE[length_code]), LENGTH_EXTRA[length_code]);
+
+        int distance_code = 29;
+        while (DISTANCE_BASE[distance_code] > distance) --distance_code;
+        writer.code(distance_code, 5);
+        writer.bits(static_cast<uint32_t>(distance - DISTANCE_BASE[distance_code]), DISTANCE_EXTRA[distance_code]);
+    }
+
+    void deflate(const std::vector<uint8_t>& data, std::vector<uint8_t>& out) {
+        BitWriter writer(out);
+        writer.bits(1, 1); // final block
+        writer.bits(1, 2); // fixed Huffman codes
+
+        // Most recent position of each 3-byte prefix; Game Boy frames are a handful of colours,
+        // so the previous occurrence is nearly always as good as a longer search would find.
+        std::vector<int32_t> last_position(size_t(1) << HASH_BITS, -1);
+        auto hashAt = [&data](size_t position) {
+            uint32_t prefix = data[position] | (data[position + 1] << 8) | (data[position + 2] << 16);
+            return (prefix * 2654435761u) >> (32 - HASH_BITS);
+        };
+
+        size_t position = 0;
+        while (position < data.size()) {
+            size_t best_length = 0;
+            size_t distance = 0;
+            if (position + MIN_MATCH <= data.size()) {
+                uint32_t hash = hashAt(position);
+                int32_t candidate = last_position[hash];
+                last_position[hash] = static_cast<int32_t>(position);
+                if (candidate >= 0 && position - candidate <= WINDOW_SIZE) {
+                    size_t limit = std::min(MAX_MATCH, data.size() - position);
+                    while (best_length < limit && data[candidate + best_length] == data[position + best_length]) ++best_length;
+                    distance = position - candidate;
+                }
+            }
+            if (best_length >= MIN_MATCH) {
+                writeMatch(writer, best_length, distance);
+                for (size_t i = 1; i < best_length && position + i + MIN_MATCH <= data.size(); ++i) {
+                    last_position[hashAt(position + i)] = static_cast<int32_t>(position + i);
+                }
+                position += best_length;
+            }
+            else {
+                writeSymbol(writer, data[position]);
+                ++position;
+            }
+        }
+        writeSymbol(writer, 256);
+        writer.flush();
+    }
+
+    uint32_t adler32(const std::vector<uint8_t>& data) {
+        uint32_t a = 1, b = 0;
+        for (size_t start = 0; start < data.size(); start += 5552) {
+            size_t end = std::min(data.size(), start + 5552);
+            for (size_t i = start; i < end; ++i) {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    const std::array<uint32_t, 256>& crcTable() {
+        static const std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> entries{};
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[n] = c;
+            }
+            return entries;
+        }();
+        return table;
+    }
+
+    void putBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(value >> shift));
+    }
+
+    void writeChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data) {
+        putBigEndian(out, static_cast<uint32_t>(data.size()));
+        size_t crc_start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        const std::array<uint32_t, 256>& table = crcTable();
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = crc_start; i < out.size(); ++i) crc = table[(crc ^ out[i]) & 0xFF] ^ (crc >> 8);
+        putBigEndian(out, crc ^ 0xFFFFFFFFu);
+    }
+
+    bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+        bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+        return std::fclose(file) == 0 && written;
+    }
+}
+
+FrameCapture::FrameCapture(int width, int height, unsigned encoder_threads, size_t frame_buffers)
+    : width_(width), height_(height) {
+    for (size_t i = 0; i < std::max<size_t>(frame_buffers, 1); ++i) {
+        free_buffers_.push_back(std::make_unique<Job>());
+        free_buffers_.back()->pixels.resize(static_cast<size_t>(width) * height);
+    }
+    for (unsigned i = 0; i < std::max(encoder_threads, 1u); ++i) {
+        encoders_.emplace_back(&FrameCapture::encoderMain, this);
+    }
+}
+
+FrameCapture::~FrameCapture() {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_available_.notify_all();
+    for (std::thread& encoder : encoders_) encoder.join();
+}
+
+bool FrameCapture::start(const Options& options) {
+    stop();
+
+    // Each session gets a directory of its own, so a new one never overwrites an earlier one.
+    std::error_code error;
+    std::filesystem::create_directories(options.directory, error);
+    std::filesystem::path session;
+    for (int index = 0; !error; ++index) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "capture_%03d", index);
+        session = std::filesystem::path(options.directory) / name;
+        if (std::filesystem::create_directory(session, error)) break;
+    }
+    if (error) {
+        GBC_LOG_ERROR("Could not create a capture directory in %s: %s", options.directory.c_str(), error.message().c_str());
+        return false;
+    }
+
+    FILE* video = nullptr;
+    if (options.video) {
+        std::string path = (session / "video.y4m").string();
+        video = std::fopen(path.c_str(), "wb");
+        if (!video) {
+            GBC_LOG_ERROR("Could not create capture video %s", path.c_str());
+            return false;
+        }
+        // 4:4:4 keeps single-pixel detail; the frame rate is the DMG's 4194304 / 70224 Hz.
+        std::fprintf(video, "YUV4MPEG2 W%d H%d F4194304:70224 Ip A1:1 C444\n", width_, height_);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+    options_.directory = session.string();
+    video_file_ = video;
+    next_video_sequence_ = 0;
+    video_sequence_written_ = 0;
+    stats_ = Stats();
+    active_ = true;
+    GBC_LOG_INFO("Capturing frames to %s", options_.directory.c_str());
+    return true;
+}
+
+void FrameCapture::stop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!active_) return;
+    active_ = false;
+    idle_.wait(lock, [this] { return queue_.empty() && jobs_in_progress_ == 0; });
+    if (video_file_) {
+        std::fclose(video_file_);
+        video_file_ = nullptr;
+    }
+    GBC_LOG_INFO("Capture stopped: %llu frames written, %llu dropped",
+        (unsigned long long)stats_.written, (unsigned long long)stats_.dropped);
+}
+
+void FrameCapture::setPolicy(CapturePolicy policy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_.policy = policy;
+}
+
+FrameCapture::Stats FrameCapture::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::unique_ptr<FrameCapture::Job> FrameCapture::acquire(std::unique_lock<std::mutex>& lock, bool wait) {
+    if (free_buffers_.empty()) {
+        if (!wait) return nullptr;
+        buffer_free_.wait(lock, [this] { return !free_buffers_.empty(); });
+    }
+    std::unique_ptr<Job> job = std::move(free_buffers_.back());
+    free_buffers_.pop_back();
+    return job;
+}
+
+bool FrameCapture::submit(const uint32_t* pixels, uint64_t frame_number) {
+    if (!active_) return false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    stats_.submitted++;
+    std::unique_ptr<Job> job = acquire(lock, options_.policy == CapturePolicy::Block);
+    if (!job) {
+        stats_.dropped++;
+        return false;
+    }
+    lock.unlock();
+
+    std::copy(pixels, pixels + job->pixels.size(), job->pixels.begin());
+    job->frame_number = frame_number;
+    job->screenshot = false;
+    job->png_path.clear();
+
+    lock.lock();
+    if (options_.png_frames) {
+        char name[40];
+        std::snprintf(name, sizeof(name), "frame_%06llu.png", (unsigned long long)frame_number);
+        job->png_path = (std::filesystem::path(options_.directory) / name).string();
+    }
+    job->video = video_file_ != nullptr;
+    if (job->video) job->sequence = next_video_sequence_++;
+    queue_.push_back(std::move(job));
+    lock.unlock();
+    work_available_.notify_one();
+    return true;
+}
+
+void FrameCapture::screenshot(const uint32_t* pixels, const std::string& path) {
+    std::error_code error;
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, error);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_ptr<Job> job = acquire(lock, true);
+    lock.unlock();
+    std::copy(pixels, pixels + job->pixels.size(), job->pixels.begin());
+    job->png_path = path;
+    job->video = false;
+    job->screenshot = true;
+    lock.lock();
+    queue_.push_back(std::move(job));
+    lock.unlock();
+    work_available_.notify_one();
+}
+
+void FrameCapture::encoderMain() {
+    // Output buffers are per encoder and reused from frame to frame.
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> planes;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        work_available_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+        std::unique_ptr<Job> job = std::move(queue_.front());
+        queue_.pop_front();
+        jobs_in_progress_++;
+        lock.unlock();
+
+        bool written = true;
+        if (!job->png_path.empty()) {
+            encodePng(job->pixels.data(), width_, height_, encoded);
+            if (!writeFile(job->png_path, encoded)) {
+                GBC_LOG_ERROR("Could not write %s", job->png_path.c_str());
+                written = false;
+            }
+        }
+        if (job->video) writeVideoFrame(*job, planes);
+
+        lock.lock();
+        if (written && !job->screenshot) stats_.written++;
+        free_buffers_.push_back(std::move(job));
+        jobs_in_progress_--;
+        buffer_free_.notify_one();
+        if (queue_.empty() && jobs_in_progress_ == 0) idle_.notify_all();
+    }
+}
+
+void FrameCapture::writeVideoFrame(const Job& job, std::vector<uint8_t>& planes) {
+    // BT.601 studio range.
+    size_t pixel_count = job.pixels.size();
+    planes.resize(pixel_count * 3);
+    uint8_t* y_plane = planes.data();
+    uint8_t* u_plane = y_plane + pixel_count;
+    uint8_t* v_plane = u_plane + pixel_count;
+    for (size_t i = 0; i < pixel_count; ++i) {
+        uint32_t pixel = job.pixels[i];
+        int r = pixel & 0xFF, g = (pixel >> 8) & 0xFF, b = (pixel >> 16) & 0xFF;
+        y_plane[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u_plane[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v_plane[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+
+    // Encoders finish out of order; frames go into the file in submission order.
+    std::unique_lock<std::mutex> lock(mutex_);
+    video_turn_.wait(lock, [&] { return video_sequence_written_ == job.sequence; });
+    FILE* file = video_file_;
+    lock.unlock();
+
+    std::fputs("FRAME\n", file);
+    if (std::fwrite(planes.data(), 1, planes.size(), file) != planes.size()) {
+        GBC_LOG_ERROR("Could not write capture video frame %llu", (unsigned long long)job.frame_number);
+    }
+
+    lock.lock();
+    video_sequence_written_++;
+    lock.unlock();
+    video_turn_.notify_all();
+}
+
+void FrameCapture::encodePng(const uint32_t* pixels, int width, int height, std::vector<uint8_t>& out) {
+    // Filter type 0 on every row: with a few flat colours, LZ77 does better on raw rows.
+    std::vector<uint8_t> raw;
+    raw.reserve(static_cast<size_t>(height) * (1 + width * 3));
+    for (int y = 0; y < height; ++y) {
+        raw.push_back(0);
+        for (int x = 0; x < width; ++x) {
+            uint32_t pixel = pixels[y * width + x];
+            raw.push_back(static_cast<uint8_t>(pixel));
+            raw.push_back(static_cast<uint8_t>(pixel >> 8));
+            raw.push_back(static_cast<uint8_t>(pixel >> 16));
+        }
+    }
+
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    deflate(raw, zlib);
+    putBigEndian(zlib, adler32(raw));
+
+    std::vector<uint8_t> header;
+    putBigEndian(header, static_cast<uint32_t>(width));
+    putBigEndian(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8-bit RGB, deflate, no interlace
+
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.assign(SIGNATURE, SIGNATURE + sizeof(SIGNATURE));
+    writeChunk(out, "IHDR", header);
+    writeChunk(out, "IDAT", zlib);
+    writeChunk(out, "IEND", {});
+}
@@ -0,0 +1,114 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+
+FramePacer::FramePacer()
+    : mode_(PacingMode::Audio), speed_(1), started_(false),
+    frame_period_(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / FRAME_RATE))),
+    smoothed_latency_ms_(TARGET_LATENCY_MS), drift_correction_(0.0), uncapped_batch_(1), batch_frames_(0),
+    fps_window_start_(Clock::now()), fps_window_frames_(0) {
+}
+
+void FramePacer::reset() {
+    // drift_correction_ is kept: the clock drift is a property of the host, not of the session.
+    started_ = false;
+    smoothed_latency_ms_ = TARGET_LATENCY_MS;
+    uncapped_batch_ = 1;
+    batch_frames_ = 0;
+}
+
+int FramePacer::framesDue(size_t queued_frames, int sample_rate) {
+    Clock::time_point now = Clock::now();
+    if (!started_) {
+        started_ = true;
+        next_frame_time_ = now;
+    }
+    if (fastForwarding()) return fastForwardFramesDue(now);
+
+    int due = 0;
+    while (now >= next_frame_time_ && due < MAX_CATCH_UP_FRAMES) {
+        next_frame_time_ += frame_period_;
+        due++;
+    }
+    if (now >= next_frame_time_) {
+        // Too far behind to catch up without an audible burst: drop the backlog instead.
+        next_frame_time_ = now + frame_period_;
+    }
+
+    if (sample_rate > 0) {
+        double latency_ms = 1000.0 * static_cast<double>(queued_frames) / sample_rate;
+        if (latency_ms > MAX_LATENCY_MS && due > 0) {
+            // The host clock is running ahead of the audio device; give it a frame to drain.
+            due--;
+        }
+        else if (latency_ms < LOW_LATENCY_MS && due == 0) {
+            // About to underrun: run the next frame early rather than let the device starve.
+            next_frame_time_ += frame_period_;
+            due = 1;
+        }
+    }
+    return due;
+}
+
+int FramePacer::fastForwardFramesDue(Clock::time_point now) {
+    if (now < next_frame_time_) return 0;
+    next_frame_time_ += frame_period_;
+    if (now >= next_frame_time_) {
+        // A batch overran its period; catching up would only make the next one longer.
+        next_frame_time_ = now + frame_period_;
+    }
+    return startBatch(now);
+}
+
+int FramePacer::framesDueOnPresent() {
+    return fastForwarding() ? startBatch(Clock::now()) : 1;
+}
+
+int FramePacer::startBatch(Clock::time_point now) {
+    if (speed_ == SPEED_UNCAPPED && batch_frames_ > 0) {
+        const int max_batch = MAX_UNCAPPED_BATCH;
+        double seconds_per_frame = std::chrono::duration<double>(last_frame_time_ - batch_start_).count() / batch_frames_;
+        double period = std::chrono::duration<double>(frame_period_).count();
+        int fit = seconds_per_frame > 0.0
+            ? static_cast<int>(std::min(period * UNCAPPED_BUSY_FRACTION / seconds_per_frame, static_cast<double>(max_batch)))
+            : max_batch;
+        // Grow at most twofold per tick so one unusually cheap batch cannot stall the next period.
+        uncapped_batch_ = std::clamp(fit, 1, std::min(max_batch, uncapped_batch_ * 2));
+    }
+    batch_start_ = now;
+    batch_frames_ = 0;
+    return framesPerTick();
+}
+
+double FramePacer::resampleRate(size_t queued_frames, int sample_rate) {
+    double latency_ms = 1000.0 * static_cast<double>(queued_frames) / sample_rate;
+    smoothed_latency_ms_ += (latency_ms - smoothed_latency_ms_) * FILL_SMOOTHING;
+    stats_.audio_latency_ms = smoothed_latency_ms_;
+
+    // Below target -> produce slightly more samples per frame, above -> slightly fewer.
+    double error = std::clamp((TARGET_LATENCY_MS - smoothed_latency_ms_) / TARGET_LATENCY_MS, -1.0, 1.0);
+    drift_correction_ = std::clamp(drift_correction_ + error * INTEGRAL_GAIN, -1.0, 1.0);
+    stats_.rate_adjustment = std::clamp(error + drift_correction_, -1.0, 1.0) * MAX_RATE_DEVIATION;
+    return sample_rate * (1.0 + stats_.rate_adjustment);
+}
+
+uint32_t FramePacer::millisecondsUntilNextFrame() const {
+    if (!started_) return 0;
+    Clock::duration remaining = next_frame_time_ - Clock::now();
+    if (remaining <= Clock::duration::zero()) return 0;
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count());
+}
+
+void FramePacer::noteFrameEmulated() {
+    fps_window_frames_++;
+    batch_frames_++;
+    Clock::time_point now = Clock::now();
+    last_frame_time_ = now;
+    double elapsed = std::chrono::duration<double>(now - fps_window_start_).count();
+    if (elapsed >= 0.5) {
+        stats_.frames_per_second = fps_window_frames_ / elapsed;
+        stats_.speed = stats_.frames_per_second / FRAME_RATE;
+        fps_window_start_ = now;
+        fps_window_frames_ = 0;
+    }
+}
@@ -0,0 +1,136 @@
+#include "Hash.h"
+
+#if !defined(GBC_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define GBC_HASH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    const size_t LANES = 8;
+    const size_t STRIPE_SIZE = LANES * 8;
+    const size_t STRIPES_PER_BLOCK = 16;
+    // Stripe s of a block is keyed with words s..s+7; the last LANES words key the scramble.
+    const size_t KEY_WORDS = STRIPES_PER_BLOCK + 2 * LANES;
+
+    const uint64_t PRIME32_1 = 0x9E3779B1ull;
+    const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+
+    // The key is fixed (splitmix64 output), so equal inputs hash equally across runs.
+    struct Key {
+        uint64_t words[KEY_WORDS];
+
+        constexpr Key() : words() {
+            uint64_t x = 0x5EED5EED5EED5EEDull;
+            for (size_t i = 0; i < KEY_WORDS; ++i) {
+                x += 0x9E3779B97F4A7C15ull;
+                uint64_t z = x;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                words[i] = z ^ (z >> 31);
+            }
+        }
+    };
+    constexpr Key KEY;
+
+#ifdef GBC_HASH_SSE2
+    // Per 64-bit lane i: acc[i ^ 1] += data[i], acc[i] += lo32(data ^ key) * hi32(data ^ key).
+    void accumulateStripe(__m128i* acc, const uint8_t* stripe, const uint64_t* key) {
+        for (size_t i = 0; i < LANES / 2; ++i) {
+            __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stripe) + i);
+            __m128i keyed = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key) + i));
+            __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+            __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(swapped, product));
+        }
+    }
+
+    // acc = (acc ^ (acc >> 47) ^ key) * PRIME32_1, from two 32x32 multiplies per lane.
+    void scramble(__m128i* acc, const uint64_t* key) {
+        const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+        for (size_t i = 0; i < LANES / 2; ++i) {
+            __m128i value = _mm_xor_si128(acc[i], _mm_srli_epi64(acc[i], 47));
+            value = _mm_xor_si128(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key) + i));
+            __m128i low = _mm_mul_epu32(value, prime);
+            __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            acc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+        }
+    }
+
+    void hashStripes(uint64_t* lanes, const uint8_t* bytes, size_t stripes) {
+        __m128i acc[LANES / 2];
+        for (size_t i = 0; i < LANES / 2; ++i) acc[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes) + i);
+        for (size_t stripe = 0; stripe < stripes; ++stripe) {
+            size_t in_block = stripe % STRIPES_PER_BLOCK;
+            accumulateStripe(acc, bytes + stripe * STRIPE_SIZE, KEY.words + in_block);
+            if (in_block == STRIPES_PER_BLOCK - 1) scramble(acc, KEY.words + STRIPES_PER_BLOCK + LANES);
+        }
+        for (size_t i = 0; i < LANES / 2; ++i) _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes) + i, acc[i]);
+    }
+#else
+    uint64_t readWord(const uint8_t* bytes) {
+        uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        return word;
+    }
+
+    void hashStripes(uint64_t* lanes, const uint8_t* bytes, size_t stripes) {
+        for (size_t stripe = 0; stripe < stripes; ++stripe) {
+            size_t in_block = stripe % STRIPES_PER_BLOCK;
+            const uint8_t* data = bytes + stripe * STRIPE_SIZE;
+            for (size_t i = 0; i < LANES; ++i) {
+                uint64_t word = readWord(data + i * 8);
+                uint64_t keyed = word ^ KEY.words[in_block + i];
+                lanes[i ^ 1] += word;
+                lanes[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+            }
+            if (in_block == STRIPES_PER_BLOCK - 1) {
+                for (size_t i = 0; i < LANES; ++i) {
+                    uint64_t value = lanes[i] ^ (lanes[i] >> 47) ^ KEY.words[STRIPES_PER_BLOCK + LANES + i];
+                    lanes[i] = value * PRIME32_1;
+                }
+            }
+        }
+    }
+#endif
+
+    // Low half xor high half of the 128-bit product.
+    uint64_t multiplyFold(uint64_t a, uint64_t b) {
+        uint64_t a_low = a & 0xFFFFFFFF, a_high = a >> 32;
+        uint64_t b_low = b & 0xFFFFFFFF, b_high = b >> 32;
+        uint64_t low_low = a_low * b_low;
+        uint64_t high_low = a_high * b_low;
+        uint64_t low_high = a_low * b_high;
+        uint64_t high_high = a_high * b_high;
+        uint64_t cross = (low_low >> 32) + (high_low & 0xFFFFFFFF) + low_high;
+        uint64_t low = (cross << 32) | (low_low & 0xFFFFFFFF);
+        uint64_t high = high_high + (high_low >> 32) + (cross >> 32);
+        return low ^ high;
+    }
+}
+
+uint64_t hashBytes(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t lanes[LANES] = {
+        0xC2B2AE3Dull, PRIME64_1, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull,
+        0x85EBCA77C2B2AE63ull, 0x85EBCA77ull, 0x27D4EB2F165667C5ull, PRIME32_1
+    };
+
+    size_t stripes = size / STRIPE_SIZE;
+    hashStripes(lanes, bytes, stripes);
+    size_t tail = size - stripes * STRIPE_SIZE;
+    if (tail != 0) {
+        // The tail goes through the same stripe code, zero padded; the length below tells
+        // it apart from real zeros.
+        uint8_t last[STRIPE_SIZE] = {};
+        std::memcpy(last, bytes + stripes * STRIPE_SIZE, tail);
+        hashStripes(lanes, last, 1);
+    }
+
+    uint64_t result = static_cast<uint64_t>(size) * PRIME64_1;
+    for (size_t i = 0; i < LANES; i += 2) {
+        result += multiplyFold(lanes[i] ^ KEY.words[i], lanes[i + 1] ^ KEY.words[i + 1]);
+    }
+    result ^= result >> 37;
+    result *= 0x165667919E3779F9ull;
+    return result ^ (result >> 32);
+}
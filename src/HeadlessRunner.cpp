@@ -0,0 +1,213 @@
+#include "HeadlessRunner.h"
+#include "Cpu.h"
+#include "Bus.h"
+#include "Cartridge.h"
+#include "Movie.h"
+#include "SaveState.h"
+#include "Hash.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <iostream>
+#include <cstdio>
+
+HeadlessRunner::HeadlessRunner()
+    : cartridge_(std::make_shared<Cartridge>()), bus_(std::make_shared<Bus>()), cpu_(std::make_unique<Cpu>()) {
+    bus_->connectCartridge(cartridge_);
+    cpu_->connectBus(bus_.get());
+    cpu_->profiler_ = &profiler_;
+    cpu_->debug_trace_enabled_ = false;
+}
+
+HeadlessRunner::~HeadlessRunner() {
+}
+
+bool HeadlessRunner::loadRom(const std::string& rom_path) {
+    if (!cartridge_->loadRom(rom_path)) {
+        return false;
+    }
+    // Again, now that there is a header: the bus picks CGB mode from it.
+    bus_->connectCartridge(cartridge_);
+    bus_->reset();
+    cpu_->reset();
+    return true;
+}
+
+bool HeadlessRunner::loadRomData(const std::vector<uint8_t>& data) {
+    if (!cartridge_->loadTestData(data)) {
+        return false;
+    }
+    bus_->connectCartridge(cartridge_);
+    bus_->reset();
+    cpu_->reset();
+    return true;
+}
+
+void HeadlessRunner::runFrame() {
+    Ppu& ppu = bus_->ppu();
+    ppu.consumeFrameReady();
+    while (!ppu.consumeFrameReady()) {
+        cpu_->step();
+    }
+    bus_->apu().endFrame();
+}
+
+uint64_t HeadlessRunner::frameHash() const {
+    const auto& framebuffer = bus_->ppu().framebuffer();
+    return hashBytes(framebuffer.data(), framebuffer.size() * sizeof(framebuffer[0]));
+}
+
+int HeadlessRunner::run(const HeadlessOptions& options) {
+    if (!options.movie_path.empty()) {
+        return replayMovie(options);
+    }
+    if (!loadRom(options.rom_path)) {
+        std::cerr << "Headless Error: Failed to load ROM: " << options.rom_path << std::endl;
+        return 1;
+    }
+    cpu_->idle_loop_skipping_enabled_ = options.idle_loop_skipping;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t frame = 0; frame < options.frames; ++frame) {
+        runFrame();
+    }
+    double host_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double emulated_seconds = static_cast<double>(options.frames) * Ppu::CYCLES_PER_FRAME / 4194304.0;
+
+    const CpuProfiler& profiler = profiler_;
+    printf("Frames: %llu  Host: %.3f s  Emulated: %.3f s  Speed: %.1fx\n",
+        (unsigned long long)options.frames, host_seconds, emulated_seconds,
+        host_seconds > 0 ? emulated_seconds / host_seconds : 0.0);
+    printf("Instructions: %llu  Interrupts: %llu\n",
+        (unsigned long long)profiler.instructions_executed, (unsigned long long)profiler.interrupts_serviced);
+    printf("HALT cycles skipped: %llu  Idle loops skipped: %llu (%llu cycles)\n",
+        (unsigned long long)profiler.halt_cycles_skipped,
+        (unsigned long long)profiler.idle_loops_skipped, (unsigned long long)profiler.idle_cycles_skipped);
+    printf("Last frame hash: %016llx\n", (unsigned long long)frameHash());
+    return 0;
+}
+
+int HeadlessRunner::replayMovie(const HeadlessOptions& options) {
+    Movie movie;
+    if (!movie.load(options.movie_path)) {
+        std::cerr << "Headless Error: Failed to load movie: " << options.movie_path << std::endl;
+        return 1;
+    }
+    if (!loadRom(options.rom_path)) {
+        std::cerr << "Headless Error: Failed to load ROM: " << options.rom_path << std::endl;
+        return 1;
+    }
+    if (Movie::hashRom(cartridge_->getRomData()) != movie.romHash()) {
+        std::cerr << "Headless Error: The movie was recorded with a different ROM." << std::endl;
+        return 1;
+    }
+    cpu_->idle_loop_skipping_enabled_ = movie.idleLoopSkipping();
+
+    std::atomic<uint8_t> input(0);
+    bus_->joypad().setInput(&input);
+    Movie::powerOn(*cpu_, *bus_, movie.startPc());
+    auto state = std::make_unique<MachineState>();
+
+    int result = 0;
+    uint32_t frame = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (; frame < movie.frameCount(); ++frame) {
+        input.store(movie.input(frame), std::memory_order_relaxed);
+        runFrame();
+        state->save(*cpu_, *bus_);
+        uint64_t hash = Movie::hashState(*state);
+        if (hash != movie.stateHash(frame)) {
+            printf("Desync at frame %u: state hash %016llx, recorded %016llx\n", frame,
+                (unsigned long long)hash, (unsigned long long)movie.stateHash(frame));
+            result = 2;
+            break;
+        }
+    }
+    double host_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bus_->joypad().setInput(nullptr);
+
+    double emulated_seconds = static_cast<double>(frame) * Ppu::CYCLES_PER_FRAME / 4194304.0;
+    printf("Movie: %u of %u frames replayed in %.1f ms (%.1fx)%s\n", frame, movie.frameCount(),
+        host_seconds * 1000.0, host_seconds > 0 ? emulated_seconds / host_seconds : 0.0,
+        result == 0 ? ", all state hashes match" : "");
+    return result;
+}
+
+int HeadlessRunner::runDmaSelfTest() {
+    // A header-less CGB cartridge whose program is `JR -2` at 0x0100; the checks drive the bus.
+    std::vector<uint8_t> image(0x8000, 0x00);
+    image[0x0143] = 0x80;
+    image[0x0100] = 0x18;
+    image[0x0101] = 0xFE;
+
+    struct OverdueCase {
+        const char* name;
+        SchedulerEvent event;
+        uint64_t after_hblank; // base T-cycles after the HBlank DMA's event
+    };
+    // Each other event falls due inside the same tick as the DMA block, either after its
+    // HBlank or at the same time with a higher index (so it is still pending when it runs).
+    const OverdueCase cases[] = {
+        { "timer overflow 4 cycles later", SchedulerEvent::TimerOverflow, 4 },
+        { "serial transfer at the same time", SchedulerEvent::SerialTransfer, 0 },
+        { "link sync 4 cycles later", SchedulerEvent::LinkSync, 4 },
+        { "link sync at the same time", SchedulerEvent::LinkSync, 0 },
+    };
+    const uint32_t TICK_CYCLES = 32;
+
+    int failures = 0;
+    for (const OverdueCase& check : cases) {
+        HeadlessRunner core;
+        core.loadRomData(image);
+        Bus& bus = core.bus();
+        Scheduler& scheduler = bus.scheduler();
+        // Two 16-byte blocks from WRAM to VRAM, one per HBlank.
+        bus.write(0xFF51, 0xC0);
+        bus.write(0xFF52, 0x00);
+        bus.write(0xFF53, 0x00);
+        bus.write(0xFF54, 0x00);
+        bus.write(0xFF55, 0x81);
+        uint64_t hblank = scheduler.eventTime(SchedulerEvent::VramDmaHBlank);
+        while (scheduler.now() + 4 < hblank) bus.tick(4);
+        scheduler.schedule(check.event, hblank + check.after_hblank);
+        bus.takeStallCycles();
+
+        // A hang here is the failure this checks for (the block's stall never getting past
+        // the overdue event).
+        uint64_t tick_end = scheduler.now() + TICK_CYCLES;
+        bus.tick(TICK_CYCLES);
+        uint64_t stall = bus.takeStallCycles();
+        bool passed = bus.cgbMode() && scheduler.now() == tick_end + Bus::VRAM_DMA_BLOCK_CYCLES &&
+            stall == Bus::VRAM_DMA_BLOCK_CYCLES && bus.read(0xFF55) == 0x00 &&
+            scheduler.eventTime(check.event) != hblank + check.after_hblank;
+        printf("HBlank DMA with %s: %s\n", check.name, passed ? "ok" : "FAILED");
+        if (!passed) failures++;
+    }
+
+    struct BusCase {
+        const char* name;
+        uint16_t source;     // OAM DMA source; its first byte is 0x5A
+        uint16_t scratch;    // written and read back while the DMA runs
+        uint16_t conflicted; // reads the byte being moved while the DMA runs
+        uint16_t rom_read;   // 0x0100 reads 0x18 unless the DMA is on the external bus
+    };
+    const BusCase bus_cases[] = {
+        { "OAM DMA from WRAM leaves VRAM reachable", 0xC000, 0x8010, 0xD000, 0x5A },
+        { "OAM DMA from VRAM leaves the external bus reachable", 0x8000, 0xC100, 0x8010, 0x18 },
+    };
+    for (const BusCase& check : bus_cases) {
+        HeadlessRunner core;
+        core.loadRomData(image);
+        Bus& bus = core.bus();
+        bus.write(0xFF40, 0x00); // LCD off, so the PPU never locks VRAM
+        bus.write(check.source, 0x5A);
+        bus.write(0xFF46, static_cast<uint8_t>(check.source >> 8));
+        bus.write(check.scratch, 0x77);
+        bool passed = bus.read(check.scratch) == 0x77 && bus.read(check.conflicted) == 0x5A &&
+            bus.read(0x0100) == check.rom_read && bus.read(0xFE00) == 0xFF;
+        printf("%s: %s\n", check.name, passed ? "ok" : "FAILED");
+        if (!passed) failures++;
+    }
+    return failures == 0 ? 0 : 2;
+}
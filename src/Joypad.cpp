@@ -0,0 +1,43 @@
+#include "Joypad.h"
+#include "Bus.h"
+
+Joypad::Joypad(Bus& bus) : bus_(bus), input_(nullptr) {
+    reset();
+}
+
+void Joypad::reset() {
+    select_ = 0x30;
+    lines_ = 0x0F;
+}
+
+uint8_t Joypad::read() {
+    sample();
+    bus_.notePolledValueChangeTime(bus_.scheduler().now() + POLL_QUANTUM);
+    return peek();
+}
+
+void Joypad::write(uint8_t value) {
+    select_ = value & 0x30;
+    sample();
+}
+
+void Joypad::sample() {
+    uint8_t pressed = input_ ? input_->load(std::memory_order_relaxed) : 0;
+    uint8_t lines = 0x0F;
+    if ((select_ & 0x10) == 0) lines &= static_cast<uint8_t>(~pressed & 0x0F);
+    if ((select_ & 0x20) == 0) lines &= static_cast<uint8_t>(~(pressed >> 4) & 0x0F);
+    if (lines_ & ~lines) {
+        bus_.requestInterrupt(Bus::INTERRUPT_JOYPAD);
+    }
+    lines_ = lines;
+}
+
+void Joypad::saveState(State& state) const {
+    state.select = select_;
+    state.lines = lines_;
+}
+
+void Joypad::loadState(const State& state) {
+    select_ = state.select;
+    lines_ = state.lines;
+}
@@ -0,0 +1,128 @@
+#include "LinkCable.h"
+#include "Serial.h"
+
+#include <algorithm>
+#include <thread>
+
+LinkCable::LinkCable(uint64_t max_drift) : max_drift_(std::max<uint64_t>(max_drift, 1)) {
+}
+
+void LinkCable::attach(int side, Serial& serial) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    End& self = ends_[side];
+    self.serial = &serial;
+    self.clock.store(0);
+    self.sending.store(false);
+    self.answered = false;
+    self.attached.store(true);
+    serial.connectLink(this, side);
+}
+
+void LinkCable::detach(int side) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    End& self = ends_[side];
+    if (self.serial) self.serial->connectLink(nullptr, 0);
+    self.serial = nullptr;
+    self.sending.store(false);
+    self.attached.store(false);
+    changed_.notify_all();
+}
+
+void LinkCable::publish(End& self, const End& other, uint64_t now) {
+    // Sequentially consistent on both sides: either the waiter sees the new clock before it
+    // blocks, or this sees it waiting and wakes it.
+    self.clock.store(now);
+    if (other.waiting.load()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        changed_.notify_all();
+    }
+}
+
+void LinkCable::deliver(End& self, End& other, uint64_t now) {
+    if (!other.sending.load(std::memory_order_relaxed) || other.answered || other.end_time > now) return;
+    other.answer = self.serial ? self.serial->receive(other.value) : 0xFF;
+    other.answered = true;
+    changed_.notify_all();
+}
+
+template <class Done>
+void LinkCable::block(std::unique_lock<std::mutex>& lock, End& self, Done&& done) {
+    self.waiting.store(true);
+    if (!done()) changed_.wait(lock);
+    self.waiting.store(false);
+}
+
+uint64_t LinkCable::sync(int side, uint64_t now) {
+    End& self = ends_[side];
+    End& other = ends_[side ^ 1];
+    publish(self, other, now);
+
+    auto caught_up = [&]() { return !other.attached.load() || now < other.clock.load() + max_drift_; };
+    // The other side is usually close to its next sync, so yield for a while before sleeping
+    // on the condition variable (which costs a wake-up on both sides).
+    for (int spin = 0; spin < SPIN_LIMIT && !caught_up() && !other.sending.load(); ++spin) {
+        std::this_thread::yield();
+    }
+    uint64_t limit;
+    if (other.sending.load() || !caught_up()) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            deliver(self, other, now);
+            if (caught_up()) break;
+            block(lock, self, [&]() {
+                return caught_up() || (other.sending.load(std::memory_order_relaxed) && !other.answered && other.end_time <= now);
+            });
+        }
+        limit = other.attached.load() ? other.clock.load() + max_drift_ : now + max_drift_;
+        if (other.sending.load(std::memory_order_relaxed) && !other.answered && other.end_time > now) {
+            limit = std::min(limit, other.end_time);
+        }
+    }
+    else {
+        limit = other.attached.load() ? other.clock.load() + max_drift_ : now + max_drift_;
+    }
+    // Half-drift slices let both sides keep running while the other publishes.
+    return std::min(limit, now + std::max<uint64_t>(max_drift_ / 2, 1));
+}
+
+void LinkCable::beginTransfer(int side, uint8_t value, uint64_t end_time) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    End& self = ends_[side];
+    self.value = value;
+    self.end_time = end_time;
+    self.answered = false;
+    self.sending.store(true);
+    changed_.notify_all();
+}
+
+void LinkCable::cancelTransfer(int side) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ends_[side].sending.store(false);
+    ends_[side].answered = false;
+}
+
+uint8_t LinkCable::finishTransfer(int side) {
+    End& self = ends_[side];
+    End& other = ends_[side ^ 1];
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!self.sending.load(std::memory_order_relaxed)) return 0xFF;
+    uint64_t now = self.end_time;
+    self.clock.store(now);
+    changed_.notify_all();
+
+    // Both sides may be clocking a transfer at once; each answers the other while it waits.
+    auto done = [&]() {
+        return self.answered || !other.attached.load() ||
+            (other.sending.load(std::memory_order_relaxed) && !other.answered && other.end_time <= now);
+    };
+    for (;;) {
+        deliver(self, other, now);
+        if (self.answered || !other.attached.load()) break;
+        block(lock, self, done);
+    }
+    uint8_t value = self.answered ? self.answer : 0xFF;
+    if (self.answered) transfer_count_.fetch_add(1, std::memory_order_relaxed);
+    self.answered = false;
+    self.sending.store(false);
+    return value;
+}
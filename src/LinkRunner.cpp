@@ -0,0 +1,246 @@
+#include "LinkRunner.h"
+#include "HeadlessRunner.h"
+#include "Cpu.h"
+#include "Bus.h"
+#include "Movie.h"
+#include "SaveState.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+namespace {
+    // Self-test programs, placed at 0x0100 of a header-less 32 KiB image. Each side stores the
+    // byte shifted in by transfer i at C000+i; the master sends i, the slaves send 0x40+i.
+    std::vector<uint8_t> getMasterProgram() {
+        return {
+            0xF3,             // DI
+            0x06, 0x00,       // LD B,0
+            0x21, 0x00, 0xC0, // LD HL,C000
+            0x0E, 0x00,       // loop: LD C,0 (a delay, so the slave is listening first)
+            0x0D,             // delay: DEC C
+            0x20, 0xFD,       // JR NZ,delay
+            0x78,             // LD A,B
+            0xE0, 0x01,       // LDH (SB),A
+            0x3E, 0x81,       // LD A,0x81
+            0xE0, 0x02,       // LDH (SC),A (start, internal clock)
+            0xF0, 0x02,       // wait: LDH A,(SC)
+            0xCB, 0x7F,       // BIT 7,A
+            0x20, 0xFA,       // JR NZ,wait
+            0xF0, 0x01,       // LDH A,(SB)
+            0x22,             // LD (HL+),A
+            0x04,             // INC B
+            0x78,             // LD A,B
+            0xFE, 0x20,       // CP 32
+            0x20, 0xE5,       // JR NZ,loop
+            0x76,             // done: HALT
+            0x18, 0xFD        // JR done
+        };
+    }
+
+    // Waits for each byte in HALT (IE = serial only, IME off, so HALT just resumes).
+    std::vector<uint8_t> getHaltSlaveProgram() {
+        return {
+            0xF3,             // DI
+            0x3E, 0x08,       // LD A,0x08
+            0xE0, 0xFF,       // LDH (IE),A
+            0x06, 0x00,       // LD B,0
+            0x21, 0x00, 0xC0, // LD HL,C000
+            0x78,             // loop: LD A,B
+            0xC6, 0x40,       // ADD A,0x40
+            0xE0, 0x01,       // LDH (SB),A
+            0x3E, 0x80,       // LD A,0x80
+            0xE0, 0x02,       // LDH (SC),A (listen, external clock)
+            0x76,             // HALT
+            0x00,             // NOP
+            0xAF,             // XOR A
+            0xE0, 0x0F,       // LDH (IF),A
+            0xF0, 0x01,       // LDH A,(SB)
+            0x22,             // LD (HL+),A
+            0x04,             // INC B
+            0x78,             // LD A,B
+            0xFE, 0x20,       // CP 32
+            0x20, 0xE9,       // JR NZ,loop
+            0x76,             // done: HALT
+            0x18, 0xFD        // JR done
+        };
+    }
+
+    // Waits for each byte in a loop polling SC (an idle loop the CPU may skip).
+    std::vector<uint8_t> getPollingSlaveProgram() {
+        return {
+            0xF3,             // DI
+            0x3E, 0x08,       // LD A,0x08
+            0xE0, 0xFF,       // LDH (IE),A
+            0x06, 0x00,       // LD B,0
+            0x21, 0x00, 0xC0, // LD HL,C000
+            0x78,             // loop: LD A,B
+            0xC6, 0x40,       // ADD A,0x40
+            0xE0, 0x01,       // LDH (SB),A
+            0x3E, 0x80,       // LD A,0x80
+            0xE0, 0x02,       // LDH (SC),A (listen, external clock)
+            0xF0, 0x02,       // wait: LDH A,(SC)
+            0xCB, 0x7F,       // BIT 7,A
+            0x20, 0xFA,       // JR NZ,wait
+            0xF0, 0x01,       // LDH A,(SB)
+            0x22,             // LD (HL+),A
+            0x04,             // INC B
+            0x78,             // LD A,B
+            0xFE, 0x20,       // CP 32
+            0x20, 0xE8,       // JR NZ,loop
+            0x76,             // done: HALT
+            0x18, 0xFD        // JR done
+        };
+    }
+
+    std::vector<uint8_t> cartridgeImage(const std::vector<uint8_t>& program) {
+        std::vector<uint8_t> image(0x8000, 0x00);
+        std::copy(program.begin(), program.end(), image.begin() + 0x100);
+        return image;
+    }
+
+    const int SELF_TEST_TRANSFERS = 32;
+
+    struct SelfTestPair {
+        const char* name;
+        std::vector<uint8_t> (*slave_program)();
+        const char* slave_file;
+        // State hashes of the master and the slave after SELF_TEST_FRAMES frames.
+        uint64_t expected_hashes[2];
+    };
+
+    const SelfTestPair SELF_TEST_PAIRS[] = {
+        { "HALT slave", getHaltSlaveProgram, "link_slave_halt.gb", { 0x758509c11c144526ull, 0x50a0697e30ef0fadull } },
+        { "polling slave", getPollingSlaveProgram, "link_slave_poll.gb", { 0x758509c11c144526ull, 0x85cedea9dde17cb0ull } },
+    };
+}
+
+int LinkRunner::run(const LinkOptions& options) {
+    std::unique_ptr<HeadlessRunner> cores[2];
+    for (int side = 0; side < 2; ++side) {
+        cores[side] = std::make_unique<HeadlessRunner>();
+        if (!cores[side]->loadRom(options.rom_paths[side])) {
+            std::cerr << "Link Error: Failed to load ROM: " << options.rom_paths[side] << std::endl;
+            return 1;
+        }
+        cores[side]->cpu().idle_loop_skipping_enabled_ = options.idle_loop_skipping;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t transfers = runPair(*cores[0], *cores[1], options, options.frames);
+    double host_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double emulated_seconds = static_cast<double>(options.frames) * Ppu::CYCLES_PER_FRAME / 4194304.0;
+
+    printf("Frames: %llu per console  Host: %.3f s  Speed: %.1fx  Max drift: %llu cycles\n",
+        (unsigned long long)options.frames, host_seconds, host_seconds > 0 ? emulated_seconds / host_seconds : 0.0,
+        (unsigned long long)options.max_drift);
+    printf("Serial transfers: %llu\n", (unsigned long long)transfers);
+    for (int side = 0; side < 2; ++side) {
+        // The state hash matches what --net-link prints for the same ROMs and frame count.
+        printf("Console %d last frame hash: %016llx  State hash: %016llx\n", side + 1,
+            (unsigned long long)cores[side]->frameHash(), (unsigned long long)stateHash(*cores[side]));
+    }
+    return 0;
+}
+
+uint64_t LinkRunner::runPair(HeadlessRunner& first, HeadlessRunner& second, const LinkOptions& options, uint64_t frames) {
+    // Both ends are plugged in before either core starts, so neither runs ahead unsynchronized.
+    LinkCable cable(options.max_drift);
+    cable.attach(0, first.bus().serial());
+    cable.attach(1, second.bus().serial());
+
+    std::thread other(runSide, std::ref(second), std::ref(cable), 1, frames);
+    runSide(first, cable, 0, frames);
+    other.join();
+    return cable.transferCount();
+}
+
+uint64_t LinkRunner::stateHash(HeadlessRunner& core) {
+    auto state = std::make_unique<MachineState>();
+    state->save(core.cpu(), core.bus());
+    return Movie::hashState(*state);
+}
+
+void LinkRunner::runSide(HeadlessRunner& core, LinkCable& cable, int side, uint64_t frames) {
+    Cpu& cpu = core.cpu();
+    Bus& bus = core.bus();
+    Scheduler& scheduler = bus.scheduler();
+    Ppu& ppu = bus.ppu();
+
+    ppu.consumeFrameReady();
+    uint64_t frame = 0;
+    while (frame < frames) {
+        uint64_t limit = cable.sync(side, scheduler.now());
+        // Keeps a halted or idle-looping CPU from skipping past the next sync.
+        scheduler.schedule(SchedulerEvent::LinkSync, limit);
+        while (scheduler.now() < limit && frame < frames) {
+            cpu.step();
+            if (ppu.consumeFrameReady()) {
+                bus.apu().endFrame();
+                frame++;
+            }
+        }
+    }
+    scheduler.cancel(SchedulerEvent::LinkSync);
+    cable.detach(side);
+}
+
+int LinkRunner::runSelfTest(const LinkOptions& options, const std::string& rom_directory) {
+    const std::vector<uint8_t> master = cartridgeImage(getMasterProgram());
+    if (!rom_directory.empty()) {
+        std::vector<std::pair<std::string, std::vector<uint8_t>>> files = { { "link_master.gb", master } };
+        for (const SelfTestPair& pair : SELF_TEST_PAIRS) files.emplace_back(pair.slave_file, cartridgeImage(pair.slave_program()));
+        for (const auto& file : files) {
+            std::filesystem::path path = std::filesystem::path(rom_directory) / file.first;
+            std::ofstream out(path, std::ios::binary);
+            if (!out.write(reinterpret_cast<const char*>(file.second.data()), static_cast<std::streamsize>(file.second.size()))) {
+                std::cerr << "Link Test Error: Cannot write " << path.string() << std::endl;
+                return 1;
+            }
+        }
+        std::cout << "Wrote the link test images to " << rom_directory << std::endl;
+    }
+
+    // Drift bounds under one byte at the normal serial clock keep every transfer at its exact
+    // time (see LinkCable), so only then is the whole machine state reproducible.
+    bool check_hashes = options.max_drift < 8 * Serial::BIT_CYCLES;
+    int failures = 0;
+    for (const SelfTestPair& pair : SELF_TEST_PAIRS) {
+        HeadlessRunner cores[2];
+        cores[0].loadRomData(master);
+        cores[1].loadRomData(cartridgeImage(pair.slave_program()));
+        for (HeadlessRunner& core : cores) core.cpu().idle_loop_skipping_enabled_ = options.idle_loop_skipping;
+        uint64_t transfers = runPair(cores[0], cores[1], options, SELF_TEST_FRAMES);
+
+        int wrong_bytes = 0;
+        for (int i = 0; i < SELF_TEST_TRANSFERS; ++i) {
+            if (cores[0].bus().read(static_cast<uint16_t>(0xC000 + i)) != 0x40 + i) wrong_bytes++;
+            if (cores[1].bus().read(static_cast<uint16_t>(0xC000 + i)) != i) wrong_bytes++;
+        }
+        bool passed = transfers == SELF_TEST_TRANSFERS && wrong_bytes == 0;
+        std::string hash_lines;
+        for (int side = 0; side < 2; ++side) {
+            uint64_t hash = stateHash(cores[side]);
+            bool matched = !check_hashes || hash == pair.expected_hashes[side];
+            passed = passed && matched;
+            char line[96];
+            snprintf(line, sizeof(line), "  Console %d state hash: %016llx", side + 1, (unsigned long long)hash);
+            hash_lines += line;
+            if (!matched) {
+                snprintf(line, sizeof(line), " (expected %016llx)", (unsigned long long)pair.expected_hashes[side]);
+                hash_lines += line;
+            }
+            hash_lines += "\n";
+        }
+        printf("%s: %s  Serial transfers: %llu  Wrong bytes: %d\n%s", pair.name, passed ? "ok" : "FAILED",
+            (unsigned long long)transfers, wrong_bytes, hash_lines.c_str());
+        if (!passed) failures++;
+    }
+    if (!check_hashes) printf("State hashes not checked: transfers are only exact with --link-drift under %u\n", 8 * Serial::BIT_CYCLES);
+    return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,181 @@
+#include "Log.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace {
+    const size_t QUEUE_CAPACITY = 256; // power of two
+    const std::chrono::milliseconds DRAIN_INTERVAL(20);
+
+    const char* levelPrefix(Log::Level level) {
+        switch (level) {
+            case Log::Level::Debug: return "Debug: ";
+            case Log::Level::Info: return "";
+            case Log::Level::Warning: return "Warning: ";
+            case Log::Level::Error: return "Error: ";
+        }
+        return "";
+    }
+
+    // Bounded multi-producer queue (per-slot sequence numbers, as in Vyukov's MPMC queue)
+    // with the logger thread as the only consumer. A producer claims a slot with one CAS and
+    // formats straight into it; when the queue is full the message is counted and dropped.
+    class Logger {
+    public:
+        Logger() {
+            for (size_t i = 0; i < QUEUE_CAPACITY; ++i) {
+                slots_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            thread_ = std::thread(&Logger::run, this);
+        }
+
+        ~Logger() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_one();
+            thread_.join();
+        }
+
+        static Logger& instance() {
+            static Logger logger;
+            return logger;
+        }
+
+        void write(Log::Level level, uint32_t suppressed, const char* format, va_list args) {
+            size_t position = enqueue_position_.load(std::memory_order_relaxed);
+            Slot* slot;
+            for (;;) {
+                slot = &slots_[position & (QUEUE_CAPACITY - 1)];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+                if (difference == 0) {
+                    if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+                }
+                else if (difference < 0) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                else {
+                    position = enqueue_position_.load(std::memory_order_relaxed);
+                }
+            }
+
+            slot->level = level;
+            slot->suppressed = suppressed;
+            int length = std::vsnprintf(slot->text, sizeof(slot->text), format, args);
+            if (length < 0) slot->text[0] = '\0';
+            slot->sequence.store(position + 1, std::memory_order_release);
+        }
+
+        void flush() {
+            size_t target = enqueue_position_.load(std::memory_order_acquire);
+            std::unique_lock<std::mutex> lock(mutex_);
+            flush_requested_ = true;
+            wake_.notify_one();
+            drained_.wait(lock, [&] { return written_ >= target || stop_; });
+        }
+
+    private:
+        struct Slot {
+            std::atomic<size_t> sequence;
+            Log::Level level;
+            uint32_t suppressed;
+            char text[Log::MAX_MESSAGE_LENGTH];
+        };
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (;;) {
+                wake_.wait_for(lock, DRAIN_INTERVAL, [&] { return stop_ || flush_requested_; });
+                bool stopping = stop_;
+                flush_requested_ = false;
+
+                lock.unlock();
+                size_t written = drain();
+                lock.lock();
+
+                written_ = written;
+                drained_.notify_all();
+                if (stopping) return;
+            }
+        }
+
+        // Writes every completed slot in order; returns the total number consumed so far.
+        size_t drain() {
+            bool any = false;
+            for (;;) {
+                Slot& slot = slots_[dequeue_position_ & (QUEUE_CAPACITY - 1)];
+                if (slot.sequence.load(std::memory_order_acquire) != dequeue_position_ + 1) break;
+
+                std::fputs(levelPrefix(slot.level), stderr);
+                std::fputs(slot.text, stderr);
+                if (slot.suppressed != 0) {
+                    std::fprintf(stderr, " (%u similar messages suppressed)", slot.suppressed);
+                }
+                std::fputc('\n', stderr);
+                any = true;
+
+                slot.sequence.store(dequeue_position_ + QUEUE_CAPACITY, std::memory_order_release);
+                dequeue_position_++;
+            }
+
+            uint32_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+            if (dropped != 0) {
+                std::fprintf(stderr, "Warning: %u log messages dropped (log queue full)\n", dropped);
+                any = true;
+            }
+            if (any) std::fflush(stderr);
+            return dequeue_position_;
+        }
+
+        std::array<Slot, QUEUE_CAPACITY> slots_;
+        alignas(64) std::atomic<size_t> enqueue_position_{ 0 };
+        alignas(64) size_t dequeue_position_ = 0;
+        std::atomic<uint32_t> dropped_{ 0 };
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable drained_;
+        bool stop_ = false;
+        bool flush_requested_ = false;
+        size_t written_ = 0;
+        std::thread thread_;
+    };
+
+    uint64_t nowMilliseconds() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+}
+
+bool Log::admit(Site& site) {
+    // Fixed windows: the first call in a new window resets the site's count.
+    uint64_t window = nowMilliseconds() / RATE_LIMIT_WINDOW_MS;
+    if (site.window.load(std::memory_order_relaxed) != window &&
+        site.window.exchange(window, std::memory_order_relaxed) != window) {
+        site.messages_in_window.store(0, std::memory_order_relaxed);
+    }
+    if (site.messages_in_window.fetch_add(1, std::memory_order_relaxed) < RATE_LIMIT_MESSAGES) {
+        return true;
+    }
+    site.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Log::write(Site& site, Level level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    Logger::instance().write(level, site.suppressed.exchange(0, std::memory_order_relaxed), format, args);
+    va_end(args);
+}
+
+void Log::flush() {
+    Logger::instance().flush();
+}
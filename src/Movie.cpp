@@ -0,0 +1,206 @@
+#include "Movie.h"
+#include "SaveState.h"
+#include "Hash.h"
+#include "Log.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    const char MAGIC[8] = { 'G', 'B', 'C', 'M', 'O', 'V', 'I', 'E' };
+
+    void putLittleEndian(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    // Reads from a loaded file image; every read fails once the image is exhausted.
+    class Reader {
+    public:
+        explicit Reader(const std::vector<uint8_t>& data) : data_(data) {}
+
+        bool littleEndian(uint64_t& value, int bytes) {
+            if (data_.size() - position_ < static_cast<size_t>(bytes)) return false;
+            value = 0;
+            for (int i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(data_[position_++]) << (8 * i);
+            return true;
+        }
+
+        bool leb128(uint64_t& value) {
+            value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (position_ == data_.size()) return false;
+                uint8_t byte = data_[position_++];
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) return true;
+            }
+            return false;
+        }
+
+        bool bytes(void* out, size_t size) {
+            if (data_.size() - position_ < size) return false;
+            std::memcpy(out, data_.data() + position_, size);
+            position_ += size;
+            return true;
+        }
+
+    private:
+        const std::vector<uint8_t>& data_;
+        size_t position_ = 0;
+    };
+}
+
+void Movie::begin(uint64_t rom_hash, uint16_t start_pc, bool idle_loop_skipping) {
+    rom_hash_ = rom_hash;
+    start_pc_ = start_pc;
+    idle_loop_skipping_ = idle_loop_skipping;
+    inputs_.clear();
+    state_hashes_.clear();
+}
+
+void Movie::appendFrame(uint8_t input, uint64_t state_hash) {
+    inputs_.push_back(input);
+    state_hashes_.push_back(state_hash);
+}
+
+bool Movie::save(const std::string& path) const {
+    std::vector<uint8_t> out(MAGIC, MAGIC + sizeof(MAGIC));
+    putLittleEndian(out, FORMAT_VERSION, 4);
+    putLittleEndian(out, rom_hash_, 8);
+    putLittleEndian(out, start_pc_, 2);
+    out.push_back(idle_loop_skipping_ ? 0x01 : 0x00);
+    putLittleEndian(out, frameCount(), 4);
+
+    // Inputs change a few times a second at most, so runs compress them well.
+    for (size_t run_start = 0; run_start < inputs_.size();) {
+        size_t run_end = run_start + 1;
+        while (run_end < inputs_.size() && inputs_[run_end] == inputs_[run_start]) ++run_end;
+        out.push_back(inputs_[run_start]);
+        for (uint64_t length = run_end - run_start;; length >>= 7) {
+            if (length < 0x80) {
+                out.push_back(static_cast<uint8_t>(length));
+                break;
+            }
+            out.push_back(static_cast<uint8_t>(length | 0x80));
+        }
+        run_start = run_end;
+    }
+    for (uint64_t hash : state_hashes_) putLittleEndian(out, hash, 8);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()))) {
+        GBC_LOG_ERROR("Could not write movie file: %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Movie::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        GBC_LOG_ERROR("Could not open movie file: %s", path.c_str());
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Reader reader(data);
+
+    char magic[sizeof(MAGIC)];
+    uint64_t version = 0, rom_hash = 0, start_pc = 0, flags = 0, frame_count = 0;
+    if (!reader.bytes(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !reader.littleEndian(version, 4)) {
+        GBC_LOG_ERROR("Not a movie file: %s", path.c_str());
+        return false;
+    }
+    if (version != FORMAT_VERSION) {
+        GBC_LOG_ERROR("Unsupported movie format version %u: %s", static_cast<unsigned>(version), path.c_str());
+        return false;
+    }
+    if (!reader.littleEndian(rom_hash, 8) || !reader.littleEndian(start_pc, 2) ||
+        !reader.littleEndian(flags, 1) || !reader.littleEndian(frame_count, 4)) {
+        GBC_LOG_ERROR("Truncated movie file: %s", path.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> inputs;
+    inputs.reserve(static_cast<size_t>(frame_count));
+    while (inputs.size() < frame_count) {
+        uint64_t input = 0, length = 0;
+        if (!reader.littleEndian(input, 1) || !reader.leb128(length) || length == 0 ||
+            length > frame_count - inputs.size()) {
+            GBC_LOG_ERROR("Corrupt movie input stream: %s", path.c_str());
+            return false;
+        }
+        inputs.insert(inputs.end(), static_cast<size_t>(length), static_cast<uint8_t>(input));
+    }
+    std::vector<uint64_t> state_hashes(static_cast<size_t>(frame_count));
+    for (uint64_t& hash : state_hashes) {
+        if (!reader.littleEndian(hash, 8)) {
+            GBC_LOG_ERROR("Truncated movie state hashes: %s", path.c_str());
+            return false;
+        }
+    }
+
+    rom_hash_ = rom_hash;
+    start_pc_ = static_cast<uint16_t>(start_pc);
+    idle_loop_skipping_ = (flags & 0x01) != 0;
+    inputs_.swap(inputs);
+    state_hashes_.swap(state_hashes);
+    return true;
+}
+
+uint64_t Movie::hashRom(const std::vector<uint8_t>& rom) {
+    Hasher hasher;
+    hasher.addValue(rom.size());
+    hasher.add(rom.data(), rom.size());
+    return hasher.value();
+}
+
+uint64_t Movie::hashState(const MachineState& state) {
+    Hasher hasher;
+    const Cpu& cpu = state.cpu;
+    hasher.addValue(cpu.af); hasher.addValue(cpu.bc); hasher.addValue(cpu.de); hasher.addValue(cpu.hl);
+    hasher.addValue(cpu.sp); hasher.addValue(cpu.pc);
+    hasher.addValue(cpu.ime_); hasher.addValue(cpu.halted_);
+    hasher.addValue(cpu.cycles_elapsed_total_);
+
+    const Bus::State& bus = state.bus;
+    hasher.add(bus.wram.data(), bus.wram.size());
+    hasher.addValue(bus.wram_bank); hasher.addValue(bus.speed_switch_armed);
+    hasher.addValue(bus.oam_dma_source); hasher.addValue(bus.oam_dma_active); hasher.addValue(bus.oam_dma_start);
+    hasher.addValue(bus.vram_dma.source); hasher.addValue(bus.vram_dma.destination);
+    hasher.addValue(bus.vram_dma.blocks_left); hasher.addValue(bus.vram_dma.hblank_active);
+    hasher.add(bus.hram.data(), bus.hram.size());
+    hasher.addValue(bus.interrupt_enable); hasher.addValue(bus.interrupt_flag);
+    hasher.addValue(bus.scheduler.now()); hasher.addValue(bus.scheduler.doubleSpeed());
+
+    hasher.addValue(bus.timer.div_epoch);
+    hasher.addValue(bus.timer.tima); hasher.addValue(bus.timer.tma); hasher.addValue(bus.timer.tac);
+    hasher.addValue(bus.serial.data); hasher.addValue(bus.serial.control);
+
+    const Ppu::State& ppu = state.bus.ppu;
+    const uint8_t ppu_registers[] = { ppu.lcdc, ppu.stat, ppu.scy, ppu.scx, ppu.lyc, ppu.bgp, ppu.obp0, ppu.obp1, ppu.wy, ppu.wx };
+    hasher.add(ppu_registers, sizeof(ppu_registers));
+    hasher.addValue(ppu.lcd_epoch);
+    hasher.addValue(ppu.vram_bank);
+    hasher.add(ppu.vram.data(), ppu.vram.size());
+    hasher.add(ppu.oam.data(), ppu.oam.size());
+
+    hasher.add(bus.apu.registers.data(), bus.apu.registers.size());
+    hasher.add(bus.apu.wave_ram.data(), bus.apu.wave_ram.size());
+    hasher.addValue(bus.apu.lfsr);
+    hasher.addValue(bus.apu.frame_sequencer_step);
+
+    hasher.addValue(bus.joypad.select); hasher.addValue(bus.joypad.lines);
+
+    const Cartridge::State& cartridge = state.bus.cartridge;
+    hasher.add(cartridge.ram.data(), cartridge.ram.size());
+    hasher.addValue(cartridge.ram_enabled); hasher.addValue(cartridge.rom_bank);
+    hasher.addValue(cartridge.bank_high); hasher.addValue(cartridge.mbc1_ram_mode);
+    return hasher.value();
+}
+
+void Movie::powerOn(Cpu& cpu, Bus& bus, uint16_t start_pc) {
+    bus.reset();
+    cpu.reset();
+    cpu.pc = start_pc;
+}
@@ -0,0 +1,409 @@
+#include "NetLink.h"
+#include "HeadlessRunner.h"
+#include "Cpu.h"
+#include "Bus.h"
+#include "Movie.h"
+#include "SaveState.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+    typedef SOCKET SocketHandle;
+    const SocketHandle NO_SOCKET = INVALID_SOCKET;
+    void closeSocket(SocketHandle socket) { closesocket(socket); }
+    bool startSockets() { WSADATA data; return WSAStartup(MAKEWORD(2, 2), &data) == 0; }
+    void stopSockets() { WSACleanup(); }
+#else
+    typedef int SocketHandle;
+    const SocketHandle NO_SOCKET = -1;
+    void closeSocket(SocketHandle socket) { close(socket); }
+    bool startSockets() { return true; }
+    void stopSockets() {}
+#endif
+
+#ifdef MSG_NOSIGNAL
+    const int SEND_FLAGS = MSG_NOSIGNAL; // a closed peer is noticed on the next receive, not by SIGPIPE
+#else
+    const int SEND_FLAGS = 0;
+#endif
+
+    const size_t MESSAGE_SIZE = 10;
+    // How long a waiting side sleeps on the socket before looking again.
+    const int WAIT_MILLISECONDS = 100;
+    // The connecting side retries this long for the listening side to come up.
+    const int CONNECT_ATTEMPTS = 100;
+    const int CONNECT_RETRY_MILLISECONDS = 100;
+
+    sockaddr_in loopbackAddress(uint16_t port) {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return address;
+    }
+
+    SocketHandle acceptPeer(uint16_t port) {
+        SocketHandle listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == NO_SOCKET) return NO_SOCKET;
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        sockaddr_in address = loopbackAddress(port);
+        if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0) {
+            closeSocket(listener);
+            return NO_SOCKET;
+        }
+        std::cout << "Net link: waiting for the other console on port " << port << std::endl;
+        SocketHandle peer = accept(listener, nullptr, nullptr);
+        closeSocket(listener);
+        return peer;
+    }
+
+    SocketHandle connectToPeer(uint16_t port) {
+        sockaddr_in address = loopbackAddress(port);
+        for (int attempt = 0; attempt < CONNECT_ATTEMPTS; ++attempt) {
+            SocketHandle peer = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (peer == NO_SOCKET) return NO_SOCKET;
+            if (connect(peer, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) return peer;
+            closeSocket(peer);
+            std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_RETRY_MILLISECONDS));
+        }
+        return NO_SOCKET;
+    }
+}
+
+struct NetLink::Connection {
+    SocketHandle socket = NO_SOCKET;
+    std::vector<uint8_t> pending; // received bytes not yet parsed into messages
+
+    ~Connection() {
+        if (socket != NO_SOCKET) closeSocket(socket);
+        stopSockets();
+    }
+};
+
+NetLink::NetLink() : ring_(ROLLBACK_FRAMES), rollback_to_(Scheduler::NEVER) {
+}
+
+NetLink::~NetLink() {
+}
+
+int NetLink::run(const NetLinkOptions& options) {
+    core_ = std::make_unique<HeadlessRunner>();
+    if (!core_->loadRom(options.rom_path)) {
+        std::cerr << "Net Link Error: Failed to load ROM: " << options.rom_path << std::endl;
+        return 1;
+    }
+    core_->cpu().idle_loop_skipping_enabled_ = options.idle_loop_skipping;
+
+    if (!startSockets()) {
+        std::cerr << "Net Link Error: Sockets are unavailable." << std::endl;
+        return 1;
+    }
+    connection_ = std::make_unique<Connection>();
+    connection_->socket = options.listen ? acceptPeer(options.port) : connectToPeer(options.port);
+    if (connection_->socket == NO_SOCKET) {
+        std::cerr << "Net Link Error: Could not " << (options.listen ? "listen on" : "connect to") << " port " << options.port << std::endl;
+        return 1;
+    }
+    int no_delay = 1;
+    setsockopt(connection_->socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+
+    for (Snapshot& snapshot : ring_) snapshot.state = std::make_unique<MachineState>();
+    Bus& bus = core_->bus();
+    bus.serial().connectLink(this, 0);
+    updateNextDelivery();
+
+    const uint64_t max_ahead = MAX_FRAMES_AHEAD * Ppu::CYCLES_PER_FRAME;
+    auto start = std::chrono::steady_clock::now();
+    for (;;) {
+        receive(0);
+        if (rollback_to_ != Scheduler::NEVER) rollBack();
+        if (frame_ < options.frames) {
+            if (!peer_gone_ && !peer_done_ && bus.scheduler().now() > peer_clock_ + max_ahead) {
+                receive(WAIT_MILLISECONDS);
+                continue;
+            }
+            simulateFrame();
+            send(MessageType::Clock, bus.scheduler().now());
+            continue;
+        }
+        // Finished, but the peer may still need answers for the past (and change it).
+        if (peer_gone_) break;
+        if (!done_sent_) {
+            send(MessageType::Done, content_received_);
+            done_sent_ = true;
+        }
+        if (peer_done_ && peer_received_ == content_sent_) break;
+        receive(WAIT_MILLISECONDS);
+    }
+    double host_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bus.serial().connectLink(nullptr, 0);
+
+    double emulated_seconds = static_cast<double>(frame_) * Ppu::CYCLES_PER_FRAME / 4194304.0;
+    printf("Frames: %llu  Host: %.3f s  Speed: %.1fx%s\n", (unsigned long long)frame_, host_seconds,
+        host_seconds > 0 ? emulated_seconds / host_seconds : 0.0, peer_gone_ && !peer_done_ ? "  (peer disconnected)" : "");
+    printf("Link messages: %llu sent, %llu received  Mispredictions: %llu  Rollbacks: %llu (%llu frames re-simulated)\n",
+        (unsigned long long)content_sent_, (unsigned long long)content_received_, (unsigned long long)mispredictions_,
+        (unsigned long long)rollbacks_, (unsigned long long)frames_resimulated_);
+    if (rollbacks_out_of_range_ != 0) {
+        printf("Warning: %llu corrections reached further back than the %zu-frame ring; the consoles may have desynced\n",
+            (unsigned long long)rollbacks_out_of_range_, ROLLBACK_FRAMES);
+    }
+    auto state = std::make_unique<MachineState>();
+    state->save(core_->cpu(), bus);
+    printf("Last frame hash: %016llx  State hash: %016llx\n", (unsigned long long)core_->frameHash(),
+        (unsigned long long)Movie::hashState(*state));
+    return 0;
+}
+
+void NetLink::simulateFrame() {
+    Cpu& cpu = core_->cpu();
+    Bus& bus = core_->bus();
+    Ppu& ppu = bus.ppu();
+    Scheduler& scheduler = bus.scheduler();
+
+    Snapshot& snapshot = ring_[frame_ % ROLLBACK_FRAMES];
+    snapshot.state->save(cpu, bus);
+    snapshot.frame = frame_;
+    snapshot.time = scheduler.now();
+    snapshot.valid = true;
+    snapshot.transfer_active = transfer_active_;
+    snapshot.transfer_value = transfer_value_;
+    snapshot.transfer_end = transfer_end_;
+
+    ppu.consumeFrameReady();
+    do {
+        cpu.step();
+        if (scheduler.now() >= next_delivery_) applyDueDeliveries();
+    } while (!ppu.consumeFrameReady());
+    bus.apu().endFrame();
+    frame_++;
+    settleFrame();
+}
+
+void NetLink::applyDueDeliveries() {
+    Serial& serial = core_->bus().serial();
+    uint64_t now = core_->bus().scheduler().now();
+    for (auto it = deliveries_.upper_bound(applied_until_); it != deliveries_.end() && it->first <= now; ++it) {
+        uint8_t sent = serial.receive(it->second);
+        auto previous = sent_replies_.find(it->first);
+        if (previous == sent_replies_.end() || previous->second != sent) {
+            send(MessageType::Reply, it->first, sent);
+            sent_replies_[it->first] = sent;
+        }
+    }
+    applied_until_ = now;
+    updateNextDelivery();
+}
+
+void NetLink::updateNextDelivery() {
+    auto next = deliveries_.upper_bound(applied_until_);
+    next_delivery_ = next != deliveries_.end() ? next->first : Scheduler::NEVER;
+    // Stops the CPU exactly there (not past it in a HALT or idle-loop skip), the same way
+    // whether the byte was known in advance or arrived late and is being re-simulated.
+    Scheduler& scheduler = core_->bus().scheduler();
+    if (next_delivery_ != Scheduler::NEVER) scheduler.schedule(SchedulerEvent::LinkSync, next_delivery_);
+    else scheduler.cancel(SchedulerEvent::LinkSync);
+}
+
+void NetLink::settleFrame() {
+    uint64_t now = core_->bus().scheduler().now();
+    auto stale = sent_transfers_.lower_bound(verify_from_);
+    if (stale != sent_transfers_.end() && stale->first <= now) {
+        send(MessageType::Retract, stale->first);
+        replies_.erase(replies_.lower_bound(stale->first), replies_.end());
+        sent_transfers_.erase(stale, sent_transfers_.end());
+    }
+
+    // Nothing before the oldest state in the ring can be undone any more.
+    const Snapshot& oldest = ring_[frame_ % ROLLBACK_FRAMES];
+    if (!oldest.valid || oldest.frame + ROLLBACK_FRAMES != frame_) return;
+    forgotten_until_ = oldest.time;
+    for (auto* history : { &deliveries_, &sent_replies_, &replies_, &used_replies_ }) {
+        history->erase(history->begin(), history->lower_bound(forgotten_until_));
+    }
+    sent_transfers_.erase(sent_transfers_.begin(), sent_transfers_.lower_bound(std::min(oldest.time, verify_from_)));
+}
+
+void NetLink::requestRollback(uint64_t time) {
+    rollback_to_ = std::min(rollback_to_, time);
+}
+
+void NetLink::rollBack() {
+    uint64_t target = rollback_to_;
+    rollback_to_ = Scheduler::NEVER;
+
+    // The latest frame that started before `target` (an event at exactly a frame's start
+    // time has already happened in it).
+    const Snapshot* from = nullptr;
+    for (uint64_t back = 1; back <= ROLLBACK_FRAMES && back <= frame_; ++back) {
+        const Snapshot& snapshot = ring_[(frame_ - back) % ROLLBACK_FRAMES];
+        if (!snapshot.valid || snapshot.frame != frame_ - back) break;
+        from = &snapshot;
+        if (snapshot.time < target) break;
+    }
+    if (!from) return;
+    if (from->time >= target) rollbacks_out_of_range_++;
+
+    uint64_t resume_frame = frame_;
+    rollbacks_++;
+    frames_resimulated_ += resume_frame - from->frame;
+    from->state->load(core_->cpu(), core_->bus());
+    frame_ = from->frame;
+    transfer_active_ = from->transfer_active;
+    transfer_value_ = from->transfer_value;
+    transfer_end_ = from->transfer_end;
+    applied_until_ = from->time;
+    verify_from_ = from->time + 1;
+    used_replies_.erase(used_replies_.upper_bound(from->time), used_replies_.end());
+    updateNextDelivery();
+    while (frame_ < resume_frame) simulateFrame();
+}
+
+void NetLink::beginTransfer(int, uint8_t value, uint64_t end_time) {
+    transfer_active_ = true;
+    transfer_value_ = value;
+    transfer_end_ = end_time;
+}
+
+void NetLink::cancelTransfer(int) {
+    transfer_active_ = false;
+}
+
+uint8_t NetLink::finishTransfer(int) {
+    if (!transfer_active_) return 0xFF;
+    transfer_active_ = false;
+    uint64_t time = transfer_end_;
+
+    // A re-simulation that repeats a transfer already sent stays quiet; one that diverges
+    // retracts the old timeline's transfers from there on.
+    auto previous = sent_transfers_.lower_bound(verify_from_);
+    if (previous == sent_transfers_.end() || previous->first != time || previous->second != transfer_value_) {
+        if (previous != sent_transfers_.end()) {
+            uint64_t retract_from = std::min(previous->first, time);
+            send(MessageType::Retract, retract_from);
+            replies_.erase(replies_.lower_bound(retract_from), replies_.end());
+            sent_transfers_.erase(previous, sent_transfers_.end());
+        }
+        send(MessageType::Transfer, time, transfer_value_);
+        sent_transfers_[time] = transfer_value_;
+    }
+    verify_from_ = time + 1;
+
+    auto known = replies_.find(time);
+    uint8_t reply = known != replies_.end() ? known->second : last_reply_;
+    used_replies_[time] = reply;
+    return reply;
+}
+
+void NetLink::send(MessageType type, uint64_t time, uint8_t value) {
+    if (type != MessageType::Clock && type != MessageType::Done) {
+        content_sent_++;
+        done_sent_ = false;
+    }
+    if (peer_gone_) return;
+    uint8_t message[MESSAGE_SIZE] = { static_cast<uint8_t>(type), value };
+    for (int i = 0; i < 8; ++i) message[2 + i] = static_cast<uint8_t>(time >> (8 * i));
+    size_t offset = 0;
+    while (offset < MESSAGE_SIZE) {
+        int sent = ::send(connection_->socket, reinterpret_cast<const char*>(message) + offset,
+            static_cast<int>(MESSAGE_SIZE - offset), SEND_FLAGS);
+        if (sent <= 0) {
+            peer_gone_ = true;
+            return;
+        }
+        offset += static_cast<size_t>(sent);
+    }
+}
+
+bool NetLink::receive(int timeout_ms) {
+    std::vector<uint8_t>& pending = connection_->pending;
+    int wait_ms = timeout_ms;
+    while (!peer_gone_) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(connection_->socket, &readable);
+        timeval timeout = { wait_ms / 1000, (wait_ms % 1000) * 1000 };
+        if (select(static_cast<int>(connection_->socket) + 1, &readable, nullptr, nullptr, &timeout) <= 0) break;
+        char chunk[4096];
+        int received = recv(connection_->socket, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            peer_gone_ = true;
+            break;
+        }
+        pending.insert(pending.end(), chunk, chunk + received);
+        wait_ms = 0;
+    }
+
+    size_t offset = 0;
+    for (; pending.size() - offset >= MESSAGE_SIZE; offset += MESSAGE_SIZE) {
+        const uint8_t* message = pending.data() + offset;
+        uint64_t time = 0;
+        for (int i = 0; i < 8; ++i) time |= static_cast<uint64_t>(message[2 + i]) << (8 * i);
+        handleMessage(static_cast<MessageType>(message[0]), time, message[1]);
+    }
+    pending.erase(pending.begin(), pending.begin() + offset);
+    return !peer_gone_;
+}
+
+void NetLink::handleMessage(MessageType type, uint64_t time, uint8_t value) {
+    if (type != MessageType::Clock && type != MessageType::Done) {
+        content_received_++;
+        done_sent_ = false;
+        peer_done_ = false;
+    }
+    uint64_t now = core_->bus().scheduler().now();
+    switch (type) {
+    case MessageType::Transfer:
+        deliveries_[time] = value;
+        if (time <= now) requestRollback(time);
+        updateNextDelivery();
+        break;
+    case MessageType::Reply: {
+        replies_[time] = value;
+        last_reply_ = value;
+        auto used = used_replies_.find(time);
+        if (used != used_replies_.end() && used->second != value) {
+            mispredictions_++;
+            requestRollback(time);
+        } else if (used == used_replies_.end() && time < forgotten_until_) {
+            rollbacks_out_of_range_++; // whatever was used there can no longer be checked
+        }
+        break;
+    }
+    case MessageType::Retract: {
+        auto first = deliveries_.lower_bound(time);
+        if (first != deliveries_.end()) {
+            if (first->first <= now) requestRollback(first->first);
+            deliveries_.erase(first, deliveries_.end());
+        }
+        sent_replies_.erase(sent_replies_.lower_bound(time), sent_replies_.end());
+        updateNextDelivery();
+        break;
+    }
+    case MessageType::Clock:
+        peer_clock_ = time;
+        break;
+    case MessageType::Done:
+        peer_done_ = true;
+        peer_received_ = time;
+        break;
+    }
+}
@@ -1,37 +1,34 @@
 #include "Opcodes.h"
 #include "Cpu.h"
-#include "Utils.h" 
-#include <sstream>
-#include <iostream> 
-#include <iomanip>
+#include "Bus.h"
+#include "FlatBus.h"
+#include "InvalidInstruction.h"
+#include "OpcodeTable.h"
+#include <memory>
 
 
+// Instruction length, base cycle count and disassembly come from OpcodeTable; Cpu::step
+// pre-loads them before calling execute(). Handlers only fetch operands, update state and,
+// for conditional branches, switch to the taken cycle count.
 namespace {
-    uint8_t fetch_d8_operand(Cpu& cpu) {
+    template <class CpuType>
+    uint8_t fetch_d8_operand(CpuType& cpu) {
         uint8_t value = cpu.busRead(cpu.pc);
         cpu.pc++;
         return value;
     }
-    uint16_t fetch_d16_operand(Cpu& cpu) {
+    template <class CpuType>
+    uint16_t fetch_d16_operand(CpuType& cpu) {
         uint8_t lo = cpu.busRead(cpu.pc);
         cpu.pc++;
         uint8_t hi = cpu.busRead(cpu.pc);
         cpu.pc++;
         return (static_cast<uint16_t>(hi) << 8) | lo;
     }
-    const char* reg_name_lut[] = { "B", "C", "D", "E", "H", "L", "(HL)", "A" };
-    const char* get_reg_name(int r_idx) {
-        if (r_idx >= 0 && r_idx < 8) return reg_name_lut[r_idx];
-        return "??R";
-    }
-    const char* rp_name_lut[] = { "BC", "DE", "HL", "SP" };
-    const char* get_rp_name(int rp_idx) {
-        if (rp_idx >= 0 && rp_idx < 4) return rp_name_lut[rp_idx];
-        return "??RP";
-    }
 
-    
-    uint8_t get_reg_value(Cpu& cpu, uint8_t reg_idx) {
+
+    template <class CpuType>
+    uint8_t get_reg_value(CpuType& cpu, uint8_t reg_idx) {
         switch (reg_idx) {
             case 0: return cpu.b();
             case 1: return cpu.c();
@@ -39,14 +36,15 @@ namespace {
             case 3: return cpu.e();
             case 4: return cpu.h();
             case 5: return cpu.l();
-            
+            case 6: return cpu.busRead(cpu.hl);
             case 7: return cpu.a();
-            default: return 0xFF; 
+            default: return 0xFF;
         }
     }
 
-    
-    void set_reg_value(Cpu& cpu, uint8_t reg_idx, uint8_t value) {
+
+    template <class CpuType>
+    void set_reg_value(CpuType& cpu, uint8_t reg_idx, uint8_t value) {
         switch (reg_idx) {
             case 0: cpu.set_b(value); break;
             case 1: cpu.set_c(value); break;
@@ -54,405 +52,711 @@ namespace {
             case 3: cpu.set_e(value); break;
             case 4: cpu.set_h(value); break;
             case 5: cpu.set_l(value); break;
-            
+            case 6: cpu.busWrite(cpu.hl, value); break;
             case 7: cpu.set_a(value); break;
-            
         }
     }
-} 
 
+    template <class CpuType>
+    uint16_t& get_rp_ref(CpuType& cpu, uint8_t rp_idx) {
+        switch (rp_idx) {
+            case 0: return cpu.bc;
+            case 1: return cpu.de;
+            case 2: return cpu.hl;
+            default: return cpu.sp;
+        }
+    }
 
+    template <class CpuType>
+    void set_flags(CpuType& cpu, bool z, bool n, bool h, bool c) {
+        cpu.set_f(static_cast<uint8_t>((z << CpuType::FLAG_Z_BIT) | (n << CpuType::FLAG_N_BIT) |
+            (h << CpuType::FLAG_H_BIT) | (c << CpuType::FLAG_C_BIT)));
+    }
 
+    template <class CpuType>
+    bool condition_met(const CpuType& cpu, BranchCondition cond) {
+        switch (cond) {
+            case BranchCondition::NZ: return !cpu.getFlagZ();
+            case BranchCondition::Z:  return cpu.getFlagZ();
+            case BranchCondition::NC: return !cpu.getFlagC();
+            case BranchCondition::C:  return cpu.getFlagC();
+            default: return true;
+        }
+    }
 
+    template <class CpuType>
+    void push16(CpuType& cpu, uint16_t value) {
+        cpu.sp--;
+        cpu.busWrite(cpu.sp, static_cast<uint8_t>(value >> 8));
+        cpu.sp--;
+        cpu.busWrite(cpu.sp, static_cast<uint8_t>(value & 0xFF));
+    }
 
-void Instr_NOP::execute(Cpu& cpu) {
-    cpu.current_instruction_cycles_ = 4;
-    cpu.debug_last_instr_length_ = 1; 
-    cpu.debug_last_operand_ = 0;      
+    template <class CpuType>
+    uint16_t pop16(CpuType& cpu) {
+        uint8_t lo = cpu.busRead(cpu.sp);
+        cpu.sp++;
+        uint8_t hi = cpu.busRead(cpu.sp);
+        cpu.sp++;
+        return (static_cast<uint16_t>(hi) << 8) | lo;
+    }
+
+    template <class CpuType>
+    void apply_alu_op(CpuType& cpu, AluOp op, uint8_t value) {
+        uint8_t a = cpu.a();
+        switch (op) {
+        case AluOp::ADD: {
+            uint16_t result_wide = static_cast<uint16_t>(a) + value;
+            cpu.set_a(static_cast<uint8_t>(result_wide));
+            cpu.updateFlags_ADD8(a, value, result_wide);
+            break;
+        }
+        case AluOp::ADC: {
+            uint8_t carry = cpu.getFlagC() ? 1 : 0;
+            uint16_t result_wide = static_cast<uint16_t>(a) + value + carry;
+            cpu.set_a(static_cast<uint8_t>(result_wide));
+            set_flags(cpu, static_cast<uint8_t>(result_wide) == 0, false,
+                ((a & 0x0F) + (value & 0x0F) + carry) > 0x0F, result_wide > 0xFF);
+            break;
+        }
+        case AluOp::SUB: {
+            uint8_t result_byte = a - value;
+            cpu.set_a(result_byte);
+            cpu.updateFlags_SUB8(a, value, result_byte);
+            break;
+        }
+        case AluOp::SBC: {
+            uint8_t carry = cpu.getFlagC() ? 1 : 0;
+            int result_wide = static_cast<int>(a) - value - carry;
+            cpu.set_a(static_cast<uint8_t>(result_wide));
+            set_flags(cpu, static_cast<uint8_t>(result_wide) == 0, true,
+                (static_cast<int>(a & 0x0F) - (value & 0x0F) - carry) < 0, result_wide < 0);
+            break;
+        }
+        case AluOp::AND:
+            cpu.set_a(a & value);
+            cpu.updateFlags_LOGIC8(cpu.a(), true);
+            break;
+        case AluOp::XOR:
+            cpu.set_a(a ^ value);
+            cpu.updateFlags_LOGIC8(cpu.a(), false);
+            break;
+        case AluOp::OR:
+            cpu.set_a(a | value);
+            cpu.updateFlags_LOGIC8(cpu.a(), false);
+            break;
+        case AluOp::CP:
+            cpu.updateFlags_SUB8(a, value, static_cast<uint8_t>(a - value));
+            break;
+        }
+    }
+
+    template <class CpuType>
+    void jump_relative(CpuType& cpu, int8_t offset) {
+        cpu.pc = static_cast<uint16_t>(cpu.pc + offset);
+    }
+
+    // Shared flag logic of ADD SP,e8 and LD HL,SP+e8: H and C come from the unsigned low byte add.
+    template <class CpuType>
+    uint16_t sp_plus_e8(CpuType& cpu, uint8_t raw_offset) {
+        int8_t offset = static_cast<int8_t>(raw_offset);
+        uint16_t result = static_cast<uint16_t>(cpu.sp + offset);
+        set_flags(cpu, false, false,
+            ((cpu.sp & 0x0F) + (raw_offset & 0x0F)) > 0x0F,
+            ((cpu.sp & 0xFF) + raw_offset) > 0xFF);
+        return result;
+    }
 }
-std::string Instr_NOP::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode)); 
-    return "NOP";
+
+
+
+
+
+template <class CpuType>
+void Instr_NOP<CpuType>::execute(CpuType&) const {
 }
 
-Instr_LD_RR_D16::Instr_LD_RR_D16(uint8_t rp) : rp_index_(rp) {}
-void Instr_LD_RR_D16::execute(Cpu& cpu) {
-    uint16_t value = fetch_d16_operand(cpu); 
-    switch (rp_index_) {
-    case 0: cpu.bc = value; break;
-    case 1: cpu.de = value; break;
-    case 2: cpu.hl = value; break;
-    case 3: cpu.sp = value; break;
-    }
-    cpu.current_instruction_cycles_ = 12;
-    cpu.debug_last_instr_length_ = 3; 
+template <class CpuType>
+Instr_LD_RR_D16<CpuType>::Instr_LD_RR_D16(uint8_t rp) : rp_index_(rp) {}
+template <class CpuType>
+void Instr_LD_RR_D16<CpuType>::execute(CpuType& cpu) const {
+    uint16_t value = fetch_d16_operand(cpu);
+    get_rp_ref(cpu, rp_index_) = value;
     cpu.debug_last_operand_ = value;
 }
-std::string Instr_LD_RR_D16::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode)); 
-    uint8_t lo = cpu.busRead(pc_at_opcode + 1);
-    uint8_t hi = cpu.busRead(pc_at_opcode + 2);
-    instruction_bytes.push_back(lo);
-    instruction_bytes.push_back(hi);
-    uint16_t d16_val = (static_cast<uint16_t>(hi) << 8) | lo;
-    std::ostringstream oss;
-    oss << "LD " << get_rp_name(rp_index_) << ", " << formatHex16(d16_val);
-    return oss.str();
-}
-
-Instr_INC_R::Instr_INC_R(uint8_t reg) : reg_index_(reg) {}
-void Instr_INC_R::execute(Cpu& cpu) {
-    uint8_t old_val;
-    uint8_t new_val;
-    switch (reg_index_) {
-    case 0: old_val = cpu.b(); cpu.set_b(old_val + 1); new_val = cpu.b(); break;
-    case 1: old_val = cpu.c(); cpu.set_c(old_val + 1); new_val = cpu.c(); break;
-    case 2: old_val = cpu.d(); cpu.set_d(old_val + 1); new_val = cpu.d(); break;
-    case 3: old_val = cpu.e(); cpu.set_e(old_val + 1); new_val = cpu.e(); break;
-    case 4: old_val = cpu.h(); cpu.set_h(old_val + 1); new_val = cpu.h(); break;
-    case 5: old_val = cpu.l(); cpu.set_l(old_val + 1); new_val = cpu.l(); break;
-    case 7: old_val = cpu.a(); cpu.set_a(old_val + 1); new_val = cpu.a(); break;
-    default:
-        std::cerr << "Instr_INC_R: Invalid reg_index " << (int)reg_index_ << std::endl;
-        cpu.current_instruction_cycles_ = 4; cpu.debug_last_instr_length_ = 1; cpu.debug_last_operand_ = 0; return;
-    }
+
+template <class CpuType>
+void Instr_LD_MA16_SP<CpuType>::execute(CpuType& cpu) const {
+    uint16_t address = fetch_d16_operand(cpu);
+    cpu.busWrite(address, static_cast<uint8_t>(cpu.sp & 0xFF));
+    cpu.busWrite(static_cast<uint16_t>(address + 1), static_cast<uint8_t>(cpu.sp >> 8));
+    cpu.debug_last_operand_ = address;
+}
+
+template <class CpuType>
+Instr_INC_R<CpuType>::Instr_INC_R(uint8_t reg) : reg_index_(reg) {}
+template <class CpuType>
+void Instr_INC_R<CpuType>::execute(CpuType& cpu) const {
+    uint8_t old_val = get_reg_value(cpu, reg_index_);
+    uint8_t new_val = old_val + 1;
+    set_reg_value(cpu, reg_index_, new_val);
     cpu.updateFlags_INC8(old_val, new_val);
-    cpu.current_instruction_cycles_ = 4;
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
-}
-std::string Instr_INC_R::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    std::ostringstream oss;
-    oss << "INC " << get_reg_name(reg_index_);
-    return oss.str();
-}
-
-Instr_LD_R_D8::Instr_LD_R_D8(uint8_t reg) : reg_index_(reg) {}
-void Instr_LD_R_D8::execute(Cpu& cpu) {
-    uint8_t value = fetch_d8_operand(cpu); 
-    switch (reg_index_) {
-    case 0: cpu.set_b(value); break;
-    case 1: cpu.set_c(value); break;
-    case 2: cpu.set_d(value); break;
-    case 3: cpu.set_e(value); break;
-    case 4: cpu.set_h(value); break;
-    case 5: cpu.set_l(value); break;
-    case 7: cpu.set_a(value); break;
-    default:
-        std::cerr << "Instr_LD_R_D8: Invalid reg_index " << (int)reg_index_ << std::endl;
-        cpu.current_instruction_cycles_ = 4; cpu.debug_last_instr_length_ = 2; cpu.debug_last_operand_ = value; return; 
-    }
-    cpu.current_instruction_cycles_ = 8;
-    cpu.debug_last_instr_length_ = 2; 
-    cpu.debug_last_operand_ = value;
 }
-std::string Instr_LD_R_D8::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    uint8_t d8_val = cpu.busRead(pc_at_opcode + 1);
-    instruction_bytes.push_back(d8_val);
-    std::ostringstream oss;
-    oss << "LD " << get_reg_name(reg_index_) << ", " << formatHex8(d8_val);
-    return oss.str();
-}
-
-Instr_ADD_A_R::Instr_ADD_A_R(uint8_t reg) : reg_index_(reg) {}
-void Instr_ADD_A_R::execute(Cpu& cpu) {
-    uint8_t value_to_add;
-    if (reg_index_ == 6) { 
-        value_to_add = cpu.busRead(cpu.hl);
-        cpu.current_instruction_cycles_ = 8;
-    } else {
-        value_to_add = get_reg_value(cpu, reg_index_); 
-        cpu.current_instruction_cycles_ = 4;
-    }
-    uint8_t current_a = cpu.a();
-    uint16_t result_wide = static_cast<uint16_t>(current_a) + value_to_add;
-    cpu.set_a(static_cast<uint8_t>(result_wide));
-    cpu.updateFlags_ADD8(current_a, value_to_add, result_wide);
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
-}
-std::string Instr_ADD_A_R::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    std::ostringstream oss;
-    oss << "ADD A, " << get_reg_name(reg_index_);
-    return oss.str();
-}
-
-Instr_SUB_A_R::Instr_SUB_A_R(uint8_t reg) : reg_index_(reg) {}
-void Instr_SUB_A_R::execute(Cpu& cpu) {
-    uint8_t value_to_sub;
-    if (reg_index_ == 6) { 
-        value_to_sub = cpu.busRead(cpu.hl);
-        cpu.current_instruction_cycles_ = 8;
-    } else {
-        value_to_sub = get_reg_value(cpu, reg_index_); 
-        cpu.current_instruction_cycles_ = 4;
-    }
-    uint8_t old_a = cpu.a();
-    uint8_t result_byte = old_a - value_to_sub;
-    cpu.set_a(result_byte);
-    cpu.updateFlags_SUB8(old_a, value_to_sub, result_byte);
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
-}
-std::string Instr_SUB_A_R::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    std::ostringstream oss;
-    oss << "SUB A, " << get_reg_name(reg_index_);
-    return oss.str();
-}
-
-void Instr_XOR_A::execute(Cpu& cpu) {
-    cpu.set_a(0);
-    cpu.updateFlags_LOGIC8(0, false); 
-    cpu.current_instruction_cycles_ = 4;
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
-}
-std::string Instr_XOR_A::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    return "XOR A";
-}
-
-void Instr_JP_A16::execute(Cpu& cpu) {
-    uint16_t target_addr = fetch_d16_operand(cpu); 
-    cpu.pc = target_addr; 
-    cpu.current_instruction_cycles_ = 16;
-    cpu.debug_last_instr_length_ = 3; 
-    cpu.debug_last_operand_ = target_addr;
+
+template <class CpuType>
+Instr_DEC_R<CpuType>::Instr_DEC_R(uint8_t reg) : reg_index_(reg) {}
+template <class CpuType>
+void Instr_DEC_R<CpuType>::execute(CpuType& cpu) const {
+    uint8_t old_val = get_reg_value(cpu, reg_index_);
+    uint8_t new_val = old_val - 1;
+    set_reg_value(cpu, reg_index_, new_val);
+    cpu.updateFlags_DEC8(old_val, new_val);
 }
-std::string Instr_JP_A16::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    uint8_t lo = cpu.busRead(pc_at_opcode + 1);
-    uint8_t hi = cpu.busRead(pc_at_opcode + 2);
-    instruction_bytes.push_back(lo);
-    instruction_bytes.push_back(hi);
-    uint16_t d16_val = (static_cast<uint16_t>(hi) << 8) | lo;
-    std::ostringstream oss;
-    oss << "JP " << formatHex16(d16_val);
-    return oss.str();
+
+template <class CpuType>
+void Instr_INC_MHL<CpuType>::execute(CpuType& cpu) const {
+    uint8_t old_val = cpu.busRead(cpu.hl);
+    uint8_t new_val = old_val + 1;
+    cpu.busWrite(cpu.hl, new_val);
+    cpu.updateFlags_INC8(old_val, new_val);
 }
 
-void Instr_HALT::execute(Cpu& cpu) {
-    cpu.current_instruction_cycles_ = 4;
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
+template <class CpuType>
+void Instr_DEC_MHL<CpuType>::execute(CpuType& cpu) const {
+    uint8_t old_val = cpu.busRead(cpu.hl);
+    uint8_t new_val = old_val - 1;
+    cpu.busWrite(cpu.hl, new_val);
+    cpu.updateFlags_DEC8(old_val, new_val);
 }
-std::string Instr_HALT::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    return "HALT";
+
+template <class CpuType>
+Instr_INC_RR<CpuType>::Instr_INC_RR(uint8_t rp) : rp_index_(rp) {}
+template <class CpuType>
+void Instr_INC_RR<CpuType>::execute(CpuType& cpu) const {
+    get_rp_ref(cpu, rp_index_)++;
 }
 
-void Instr_CB_PREFIX::execute(Cpu& cpu) {
-    uint8_t cb_opcode = fetch_d8_operand(cpu); 
-    Instruction* cb_instr = cpu.getCbInstruction(cb_opcode);
-    cb_instr->execute(cpu);
-    cpu.debug_last_instr_length_ = 2; 
-    cpu.debug_last_operand_ = cb_opcode; 
+template <class CpuType>
+Instr_DEC_RR<CpuType>::Instr_DEC_RR(uint8_t rp) : rp_index_(rp) {}
+template <class CpuType>
+void Instr_DEC_RR<CpuType>::execute(CpuType& cpu) const {
+    get_rp_ref(cpu, rp_index_)--;
 }
-std::string Instr_CB_PREFIX::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode)); 
-    uint8_t cb_sub_opcode = cpu.busRead(pc_at_opcode + 1);   
-    instruction_bytes.push_back(cb_sub_opcode);
-    Instruction* cb_instr_for_disasm = cpu.getCbInstruction(cb_sub_opcode);
-    if (cb_instr_for_disasm) {
-        std::vector<uint8_t> sub_instr_only_bytes; 
-        return cb_instr_for_disasm->disassemble(cpu, pc_at_opcode + 1, sub_instr_only_bytes);
-    }
-    return "CB " + formatHex8(cb_sub_opcode) + " (UNKNOWN_CB)";
+
+template <class CpuType>
+Instr_ADD_HL_RR<CpuType>::Instr_ADD_HL_RR(uint8_t rp) : rp_index_(rp) {}
+template <class CpuType>
+void Instr_ADD_HL_RR<CpuType>::execute(CpuType& cpu) const {
+    uint16_t hl = cpu.hl;
+    uint16_t value = get_rp_ref(cpu, rp_index_);
+    uint32_t result_wide = static_cast<uint32_t>(hl) + value;
+    cpu.hl = static_cast<uint16_t>(result_wide);
+    cpu.setFlagN(false);
+    cpu.setFlagH(((hl & 0x0FFF) + (value & 0x0FFF)) > 0x0FFF);
+    cpu.setFlagC(result_wide > 0xFFFF);
 }
 
-Instr_LD_MHL_R::Instr_LD_MHL_R(uint8_t src_reg) : src_reg_index_(src_reg) {}
-void Instr_LD_MHL_R::execute(Cpu& cpu) {
-    uint8_t value_to_store = get_reg_value(cpu, src_reg_index_); 
+template <class CpuType>
+Instr_LD_R_D8<CpuType>::Instr_LD_R_D8(uint8_t reg) : reg_index_(reg) {}
+template <class CpuType>
+void Instr_LD_R_D8<CpuType>::execute(CpuType& cpu) const {
+    uint8_t value = fetch_d8_operand(cpu);
+    set_reg_value(cpu, reg_index_, value);
+    cpu.debug_last_operand_ = value;
+}
+
+template <class CpuType>
+void Instr_LD_MHL_D8<CpuType>::execute(CpuType& cpu) const {
+    uint8_t value = fetch_d8_operand(cpu);
+    cpu.busWrite(cpu.hl, value);
+    cpu.debug_last_operand_ = value;
+}
+
+template <class CpuType>
+Instr_LD_R_R<CpuType>::Instr_LD_R_R(uint8_t dest_r, uint8_t src_r) : dest_reg_index_(dest_r), src_reg_index_(src_r) {}
+template <class CpuType>
+void Instr_LD_R_R<CpuType>::execute(CpuType& cpu) const {
+    set_reg_value(cpu, dest_reg_index_, get_reg_value(cpu, src_reg_index_));
+}
+
+template <class CpuType>
+Instr_LD_MHL_R<CpuType>::Instr_LD_MHL_R(uint8_t src_reg) : src_reg_index_(src_reg) {}
+template <class CpuType>
+void Instr_LD_MHL_R<CpuType>::execute(CpuType& cpu) const {
+    uint8_t value_to_store = get_reg_value(cpu, src_reg_index_);
     cpu.busWrite(cpu.hl, value_to_store);
-    cpu.current_instruction_cycles_ = 8;
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
-}
-std::string Instr_LD_MHL_R::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    std::ostringstream oss;
-    oss << "LD (HL), " << get_reg_name(src_reg_index_);
-    return oss.str();
-}
-
-Instr_DEC_R::Instr_DEC_R(uint8_t reg) : reg_index_(reg) {}
-void Instr_DEC_R::execute(Cpu& cpu) {
-    uint8_t old_val;
-    uint8_t new_val;
-    switch (reg_index_) {
-    case 0: old_val = cpu.b(); cpu.set_b(old_val - 1); new_val = cpu.b(); break;
-    case 1: old_val = cpu.c(); cpu.set_c(old_val - 1); new_val = cpu.c(); break;
-    case 2: old_val = cpu.d(); cpu.set_d(old_val - 1); new_val = cpu.d(); break;
-    case 3: old_val = cpu.e(); cpu.set_e(old_val - 1); new_val = cpu.e(); break;
-    case 4: old_val = cpu.h(); cpu.set_h(old_val - 1); new_val = cpu.h(); break;
-    case 5: old_val = cpu.l(); cpu.set_l(old_val - 1); new_val = cpu.l(); break;
-    case 7: old_val = cpu.a(); cpu.set_a(old_val - 1); new_val = cpu.a(); break;
-    default:
-        std::cerr << "Instr_DEC_R: Invalid reg_index " << (int)reg_index_ << std::endl;
-        cpu.current_instruction_cycles_ = 4; cpu.debug_last_instr_length_ = 1; cpu.debug_last_operand_ = 0; return;
+}
+
+
+template <class CpuType>
+Instr_LD_A_MRR<CpuType>::Instr_LD_A_MRR(uint8_t rp) : rp_index_(rp) {}
+template <class CpuType>
+void Instr_LD_A_MRR<CpuType>::execute(CpuType& cpu) const {
+    switch (rp_index_) {
+    case 0: cpu.set_a(cpu.busRead(cpu.bc)); break;
+    case 1: cpu.set_a(cpu.busRead(cpu.de)); break;
+    case 2: cpu.set_a(cpu.busRead(cpu.hl)); cpu.hl++; break;
+    case 3: cpu.set_a(cpu.busRead(cpu.hl)); cpu.hl--; break;
     }
-    cpu.updateFlags_DEC8(old_val, new_val);
-    cpu.current_instruction_cycles_ = 4;
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
 }
-std::string Instr_DEC_R::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    std::ostringstream oss;
-    oss << "DEC " << get_reg_name(reg_index_);
-    return oss.str();
+
+
+template <class CpuType>
+Instr_LD_MRR_A<CpuType>::Instr_LD_MRR_A(uint8_t rp) : rp_index_(rp) {}
+template <class CpuType>
+void Instr_LD_MRR_A<CpuType>::execute(CpuType& cpu) const {
+    switch (rp_index_) {
+    case 0: cpu.busWrite(cpu.bc, cpu.a()); break;
+    case 1: cpu.busWrite(cpu.de, cpu.a()); break;
+    case 2: cpu.busWrite(cpu.hl, cpu.a()); cpu.hl++; break;
+    case 3: cpu.busWrite(cpu.hl, cpu.a()); cpu.hl--; break;
+    }
 }
 
-void Instr_INC_MHL::execute(Cpu& cpu) {
-    uint8_t old_val = cpu.busRead(cpu.hl);
-    uint8_t new_val = old_val + 1;
-    cpu.busWrite(cpu.hl, new_val);
-    cpu.updateFlags_INC8(old_val, new_val); 
-    cpu.current_instruction_cycles_ = 12;
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
+
+template <class CpuType>
+void Instr_LD_A_MA16<CpuType>::execute(CpuType& cpu) const {
+    uint16_t address = fetch_d16_operand(cpu);
+    cpu.set_a(cpu.busRead(address));
+    cpu.debug_last_operand_ = address;
 }
-std::string Instr_INC_MHL::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    return "INC (HL)";
+
+
+template <class CpuType>
+void Instr_LD_MA16_A<CpuType>::execute(CpuType& cpu) const {
+    uint16_t address = fetch_d16_operand(cpu);
+    cpu.busWrite(address, cpu.a());
+    cpu.debug_last_operand_ = address;
 }
 
-void Instr_LD_MHL_D8::execute(Cpu& cpu) {
-    uint8_t value = fetch_d8_operand(cpu); 
-    cpu.busWrite(cpu.hl, value);
-    cpu.current_instruction_cycles_ = 12;
-    cpu.debug_last_instr_length_ = 2; 
+
+template <class CpuType>
+void Instr_LDH_A_MA8<CpuType>::execute(CpuType& cpu) const {
+    uint8_t offset = fetch_d8_operand(cpu);
+    cpu.set_a(cpu.busRead(0xFF00 | offset));
+    cpu.debug_last_operand_ = offset;
+}
+
+
+template <class CpuType>
+void Instr_LDH_MA8_A<CpuType>::execute(CpuType& cpu) const {
+    uint8_t offset = fetch_d8_operand(cpu);
+    cpu.busWrite(0xFF00 | offset, cpu.a());
+    cpu.debug_last_operand_ = offset;
+}
+
+
+template <class CpuType>
+void Instr_LD_A_MC<CpuType>::execute(CpuType& cpu) const {
+    cpu.set_a(cpu.busRead(0xFF00 | cpu.c()));
+}
+
+
+template <class CpuType>
+void Instr_LD_MC_A<CpuType>::execute(CpuType& cpu) const {
+    cpu.busWrite(0xFF00 | cpu.c(), cpu.a());
+}
+
+
+template <class CpuType>
+Instr_ALU_A_R<CpuType>::Instr_ALU_A_R(AluOp op, uint8_t reg) : op_(op), reg_index_(reg) {}
+template <class CpuType>
+void Instr_ALU_A_R<CpuType>::execute(CpuType& cpu) const {
+    apply_alu_op(cpu, op_, get_reg_value(cpu, reg_index_));
+}
+
+
+template <class CpuType>
+Instr_ALU_A_D8<CpuType>::Instr_ALU_A_D8(AluOp op) : op_(op) {}
+template <class CpuType>
+void Instr_ALU_A_D8<CpuType>::execute(CpuType& cpu) const {
+    uint8_t value = fetch_d8_operand(cpu);
+    apply_alu_op(cpu, op_, value);
     cpu.debug_last_operand_ = value;
 }
-std::string Instr_LD_MHL_D8::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    uint8_t d8_val = cpu.busRead(pc_at_opcode + 1);
-    instruction_bytes.push_back(d8_val);
-    std::ostringstream oss;
-    oss << "LD (HL), " << formatHex8(d8_val);
-    return oss.str();
+
+
+template <class CpuType>
+Instr_ROTATE_A<CpuType>::Instr_ROTATE_A(uint8_t op) : op_index_(op) {}
+template <class CpuType>
+void Instr_ROTATE_A<CpuType>::execute(CpuType& cpu) const {
+    uint8_t a = cpu.a();
+    uint8_t result = 0;
+    bool carry_out = false;
+    switch (op_index_) {
+    case 0: carry_out = (a & 0x80) != 0; result = static_cast<uint8_t>((a << 1) | (a >> 7)); break;
+    case 1: carry_out = (a & 0x01) != 0; result = static_cast<uint8_t>((a >> 1) | (a << 7)); break;
+    case 2: carry_out = (a & 0x80) != 0; result = static_cast<uint8_t>((a << 1) | (cpu.getFlagC() ? 1 : 0)); break;
+    case 3: carry_out = (a & 0x01) != 0; result = static_cast<uint8_t>((a >> 1) | (cpu.getFlagC() ? 0x80 : 0)); break;
+    }
+    cpu.set_a(result);
+    set_flags(cpu, false, false, false, carry_out);
+}
+
+
+template <class CpuType>
+void Instr_DAA<CpuType>::execute(CpuType& cpu) const {
+    uint8_t a = cpu.a();
+    bool carry = cpu.getFlagC();
+    if (!cpu.getFlagN()) {
+        if (carry || a > 0x99) { a += 0x60; carry = true; }
+        if (cpu.getFlagH() || (a & 0x0F) > 0x09) { a += 0x06; }
+    }
+    else {
+        if (carry) { a -= 0x60; }
+        if (cpu.getFlagH()) { a -= 0x06; }
+    }
+    cpu.set_a(a);
+    set_flags(cpu, a == 0, cpu.getFlagN(), false, carry);
 }
 
 
+template <class CpuType>
+void Instr_CPL<CpuType>::execute(CpuType& cpu) const {
+    cpu.set_a(static_cast<uint8_t>(~cpu.a()));
+    cpu.setFlagN(true);
+    cpu.setFlagH(true);
+}
 
 
+template <class CpuType>
+void Instr_SCF<CpuType>::execute(CpuType& cpu) const {
+    cpu.setFlagN(false);
+    cpu.setFlagH(false);
+    cpu.setFlagC(true);
+}
 
 
+template <class CpuType>
+void Instr_CCF<CpuType>::execute(CpuType& cpu) const {
+    cpu.setFlagN(false);
+    cpu.setFlagH(false);
+    cpu.setFlagC(!cpu.getFlagC());
+}
+
 
-Instr_LD_R_R::Instr_LD_R_R(uint8_t dest_r, uint8_t src_r) : dest_reg_index_(dest_r), src_reg_index_(src_r) {}
-void Instr_LD_R_R::execute(Cpu& cpu) {
-    uint8_t value;
-    if (src_reg_index_ == 6) { 
-        value = cpu.busRead(cpu.hl);
-        cpu.current_instruction_cycles_ = 8;
-    } else {
-        value = get_reg_value(cpu, src_reg_index_);
-        cpu.current_instruction_cycles_ = 4;
+template <class CpuType>
+Instr_JR<CpuType>::Instr_JR(BranchCondition cond) : cond_(cond) {}
+template <class CpuType>
+void Instr_JR<CpuType>::execute(CpuType& cpu) const {
+    uint8_t raw_offset = fetch_d8_operand(cpu);
+    cpu.debug_last_operand_ = raw_offset;
+    if (condition_met(cpu, cond_)) {
+        jump_relative(cpu, static_cast<int8_t>(raw_offset));
+        cpu.applyTakenBranchCycles();
     }
+}
 
-    if (dest_reg_index_ == 6) { 
-                                
-        std::cerr << "Instr_LD_R_R should not handle dest=(HL). Opcode was mis-assigned." << std::endl;
-        
-        
-        cpu.current_instruction_cycles_ = 4; 
-    } else {
-        set_reg_value(cpu, dest_reg_index_, value);
+
+template <class CpuType>
+Instr_JP_A16<CpuType>::Instr_JP_A16(BranchCondition cond) : cond_(cond) {}
+template <class CpuType>
+void Instr_JP_A16<CpuType>::execute(CpuType& cpu) const {
+    uint16_t target_addr = fetch_d16_operand(cpu);
+    cpu.debug_last_operand_ = target_addr;
+    if (condition_met(cpu, cond_)) {
+        cpu.pc = target_addr;
+        cpu.applyTakenBranchCycles();
     }
-    
+}
 
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
+
+template <class CpuType>
+void Instr_JP_HL<CpuType>::execute(CpuType& cpu) const {
+    cpu.pc = cpu.hl;
 }
-std::string Instr_LD_R_R::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    std::ostringstream oss;
-    oss << "LD " << get_reg_name(dest_reg_index_) << ", " << get_reg_name(src_reg_index_);
-    return oss.str();
+
+
+template <class CpuType>
+Instr_CALL_A16<CpuType>::Instr_CALL_A16(BranchCondition cond) : cond_(cond) {}
+template <class CpuType>
+void Instr_CALL_A16<CpuType>::execute(CpuType& cpu) const {
+    uint16_t target_addr = fetch_d16_operand(cpu);
+    cpu.debug_last_operand_ = target_addr;
+    if (condition_met(cpu, cond_)) {
+        push16(cpu, cpu.pc);
+        cpu.pc = target_addr;
+        cpu.applyTakenBranchCycles();
+    }
 }
 
 
-Instr_LD_A_MRR::Instr_LD_A_MRR(uint8_t rp) : rp_index_(rp) {}
-void Instr_LD_A_MRR::execute(Cpu& cpu) {
-    uint16_t address;
-    if (rp_index_ == 0) { 
-        address = cpu.bc;
-    } else { 
-        address = cpu.de;
+template <class CpuType>
+Instr_RET<CpuType>::Instr_RET(BranchCondition cond) : cond_(cond) {}
+template <class CpuType>
+void Instr_RET<CpuType>::execute(CpuType& cpu) const {
+    if (condition_met(cpu, cond_)) {
+        cpu.pc = pop16(cpu);
+        cpu.applyTakenBranchCycles();
     }
-    cpu.set_a(cpu.busRead(address));
-    cpu.current_instruction_cycles_ = 8;
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
 }
-std::string Instr_LD_A_MRR::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    std::ostringstream oss;
-    oss << "LD A, (" << get_rp_name(rp_index_) << ")";
-    return oss.str();
+
+
+template <class CpuType>
+void Instr_RETI<CpuType>::execute(CpuType& cpu) const {
+    cpu.pc = pop16(cpu);
+    cpu.ime_ = true;
+}
+
+
+template <class CpuType>
+Instr_RST<CpuType>::Instr_RST(uint16_t vector) : vector_(vector) {}
+template <class CpuType>
+void Instr_RST<CpuType>::execute(CpuType& cpu) const {
+    push16(cpu, cpu.pc);
+    cpu.pc = vector_;
 }
 
 
-Instr_LD_MRR_A::Instr_LD_MRR_A(uint8_t rp) : rp_index_(rp) {}
-void Instr_LD_MRR_A::execute(Cpu& cpu) {
-    uint16_t address;
-    if (rp_index_ == 0) { 
-        address = cpu.bc;
-    } else { 
-        address = cpu.de;
+template <class CpuType>
+Instr_PUSH_RR<CpuType>::Instr_PUSH_RR(uint8_t rp) : rp_index_(rp) {}
+template <class CpuType>
+void Instr_PUSH_RR<CpuType>::execute(CpuType& cpu) const {
+    push16(cpu, rp_index_ == 3 ? cpu.af : get_rp_ref(cpu, rp_index_));
+}
+
+
+template <class CpuType>
+Instr_POP_RR<CpuType>::Instr_POP_RR(uint8_t rp) : rp_index_(rp) {}
+template <class CpuType>
+void Instr_POP_RR<CpuType>::execute(CpuType& cpu) const {
+    uint16_t value = pop16(cpu);
+    if (rp_index_ == 3) {
+        cpu.af = value & 0xFFF0;
+    }
+    else {
+        get_rp_ref(cpu, rp_index_) = value;
     }
-    cpu.busWrite(address, cpu.a());
-    cpu.current_instruction_cycles_ = 8;
-    cpu.debug_last_instr_length_ = 1;
-    cpu.debug_last_operand_ = 0;
 }
-std::string Instr_LD_MRR_A::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode));
-    std::ostringstream oss;
-    oss << "LD (" << get_rp_name(rp_index_) << "), A";
-    return oss.str();
+
+
+template <class CpuType>
+void Instr_ADD_SP_E8<CpuType>::execute(CpuType& cpu) const {
+    uint8_t raw_offset = fetch_d8_operand(cpu);
+    cpu.sp = sp_plus_e8(cpu, raw_offset);
+    cpu.debug_last_operand_ = raw_offset;
 }
 
 
-void Instr_LD_A_MA16::execute(Cpu& cpu) {
-    uint16_t address = fetch_d16_operand(cpu); 
-    cpu.set_a(cpu.busRead(address));
-    cpu.current_instruction_cycles_ = 16;
-    cpu.debug_last_instr_length_ = 3; 
-    cpu.debug_last_operand_ = address; 
+template <class CpuType>
+void Instr_LD_HL_SP_E8<CpuType>::execute(CpuType& cpu) const {
+    uint8_t raw_offset = fetch_d8_operand(cpu);
+    cpu.hl = sp_plus_e8(cpu, raw_offset);
+    cpu.debug_last_operand_ = raw_offset;
 }
-std::string Instr_LD_A_MA16::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode)); 
-    uint8_t lo = cpu.busRead(pc_at_opcode + 1);
-    uint8_t hi = cpu.busRead(pc_at_opcode + 2);
-    instruction_bytes.push_back(lo);
-    instruction_bytes.push_back(hi);
-    uint16_t d16_val = (static_cast<uint16_t>(hi) << 8) | lo;
-    std::ostringstream oss;
-    oss << "LD A, (" << formatHex16(d16_val) << ")";
-    return oss.str();
+
+
+template <class CpuType>
+void Instr_LD_SP_HL<CpuType>::execute(CpuType& cpu) const {
+    cpu.sp = cpu.hl;
 }
 
 
-void Instr_LD_MA16_A::execute(Cpu& cpu) {
-    uint16_t address = fetch_d16_operand(cpu); 
-    cpu.busWrite(address, cpu.a());
-    cpu.current_instruction_cycles_ = 16;
-    cpu.debug_last_instr_length_ = 3; 
-    cpu.debug_last_operand_ = address; 
-}
-std::string Instr_LD_MA16_A::disassemble(Cpu& cpu, uint16_t pc_at_opcode, std::vector<uint8_t>& instruction_bytes) {
-    instruction_bytes.push_back(cpu.busRead(pc_at_opcode)); 
-    uint8_t lo = cpu.busRead(pc_at_opcode + 1);
-    uint8_t hi = cpu.busRead(pc_at_opcode + 2);
-    instruction_bytes.push_back(lo);
-    instruction_bytes.push_back(hi);
-    uint16_t d16_val = (static_cast<uint16_t>(hi) << 8) | lo;
-    std::ostringstream oss;
-    oss << "LD (" << formatHex16(d16_val) << "), A";
-    return oss.str();
-}
\ No newline at end of file
+template <class CpuType>
+void Instr_DI<CpuType>::execute(CpuType& cpu) const {
+    cpu.ime_ = false;
+    cpu.ime_enable_delay_ = 0;
+}
+
+
+template <class CpuType>
+void Instr_EI<CpuType>::execute(CpuType& cpu) const {
+    if (!cpu.ime_ && cpu.ime_enable_delay_ == 0) {
+        cpu.ime_enable_delay_ = 2;
+    }
+}
+
+
+template <class CpuType>
+void Instr_HALT<CpuType>::execute(CpuType& cpu) const {
+    if (!cpu.ime_ && cpu.pendingInterrupts() != 0) {
+        cpu.halt_bug_ = true;
+    }
+    else {
+        cpu.halted_ = true;
+    }
+}
+
+
+template <class CpuType>
+void Instr_STOP<CpuType>::execute(CpuType& cpu) const {
+    fetch_d8_operand(cpu);
+    cpu.stop();
+}
+
+
+template <class CpuType>
+void Instr_CB_PREFIX<CpuType>::execute(CpuType& cpu) const {
+    uint8_t cb_opcode = fetch_d8_operand(cpu);
+    const Instruction<CpuType>* cb_instr = cpu.getCbInstruction(cb_opcode);
+    cpu.current_instruction_cycles_ = OpcodeTable::CB[cb_opcode].cycles;
+    if (cpu.profiler_) {
+        cpu.profiler_->cb_opcode_counts[cb_opcode]++;
+    }
+    cb_instr->execute(cpu);
+    cpu.debug_last_operand_ = cb_opcode;
+}
+
+
+template <class CpuType>
+Instr_CB_SHIFT<CpuType>::Instr_CB_SHIFT(ShiftOp op, uint8_t reg) : op_(op), reg_index_(reg) {}
+template <class CpuType>
+void Instr_CB_SHIFT<CpuType>::execute(CpuType& cpu) const {
+    uint8_t value = get_reg_value(cpu, reg_index_);
+    uint8_t result = 0;
+    bool carry_out = false;
+    switch (op_) {
+    case ShiftOp::RLC:  carry_out = (value & 0x80) != 0; result = static_cast<uint8_t>((value << 1) | (value >> 7)); break;
+    case ShiftOp::RRC:  carry_out = (value & 0x01) != 0; result = static_cast<uint8_t>((value >> 1) | (value << 7)); break;
+    case ShiftOp::RL:   carry_out = (value & 0x80) != 0; result = static_cast<uint8_t>((value << 1) | (cpu.getFlagC() ? 1 : 0)); break;
+    case ShiftOp::RR:   carry_out = (value & 0x01) != 0; result = static_cast<uint8_t>((value >> 1) | (cpu.getFlagC() ? 0x80 : 0)); break;
+    case ShiftOp::SLA:  carry_out = (value & 0x80) != 0; result = static_cast<uint8_t>(value << 1); break;
+    case ShiftOp::SRA:  carry_out = (value & 0x01) != 0; result = static_cast<uint8_t>((value >> 1) | (value & 0x80)); break;
+    case ShiftOp::SWAP: carry_out = false; result = static_cast<uint8_t>((value << 4) | (value >> 4)); break;
+    case ShiftOp::SRL:  carry_out = (value & 0x01) != 0; result = static_cast<uint8_t>(value >> 1); break;
+    }
+    set_reg_value(cpu, reg_index_, result);
+    set_flags(cpu, result == 0, false, false, carry_out);
+}
+
+
+template <class CpuType>
+Instr_CB_BIT<CpuType>::Instr_CB_BIT(uint8_t bit, uint8_t reg) : bit_(bit), reg_index_(reg) {}
+template <class CpuType>
+void Instr_CB_BIT<CpuType>::execute(CpuType& cpu) const {
+    uint8_t value = get_reg_value(cpu, reg_index_);
+    set_flags(cpu, ((value >> bit_) & 1) == 0, false, true, cpu.getFlagC());
+}
+
+
+template <class CpuType>
+Instr_CB_RES<CpuType>::Instr_CB_RES(uint8_t bit, uint8_t reg) : bit_(bit), reg_index_(reg) {}
+template <class CpuType>
+void Instr_CB_RES<CpuType>::execute(CpuType& cpu) const {
+    set_reg_value(cpu, reg_index_, static_cast<uint8_t>(get_reg_value(cpu, reg_index_) & ~(1 << bit_)));
+}
+
+
+template <class CpuType>
+Instr_CB_SET<CpuType>::Instr_CB_SET(uint8_t bit, uint8_t reg) : bit_(bit), reg_index_(reg) {}
+template <class CpuType>
+void Instr_CB_SET<CpuType>::execute(CpuType& cpu) const {
+    set_reg_value(cpu, reg_index_, static_cast<uint8_t>(get_reg_value(cpu, reg_index_) | (1 << bit_)));
+}
+
+
+// Opcode handlers carry no per-CPU state, so one set per CPU type is built on first use
+// and shared read-only by every instance.
+template <class CpuType>
+InstructionSet<CpuType>::InstructionSet() {
+    
+    for (int i = 0; i < 0x100; ++i) {
+        main[i] = std::make_unique<InvalidInstruction<CpuType>>(static_cast<uint8_t>(i));
+    }
+
+    const BranchCondition conditions[4] = { BranchCondition::NZ, BranchCondition::Z, BranchCondition::NC, BranchCondition::C };
+
+    main[0x00] = std::make_unique<Instr_NOP<CpuType>>();
+    main[0x08] = std::make_unique<Instr_LD_MA16_SP<CpuType>>();
+    main[0x10] = std::make_unique<Instr_STOP<CpuType>>();
+    main[0x18] = std::make_unique<Instr_JR<CpuType>>(BranchCondition::Always);
+
+    for (uint8_t i = 0; i < 4; ++i) {
+        main[0x20 + i * 8] = std::make_unique<Instr_JR<CpuType>>(conditions[i]);
+
+        main[0x01 + i * 16] = std::make_unique<Instr_LD_RR_D16<CpuType>>(i);
+        main[0x02 + i * 16] = std::make_unique<Instr_LD_MRR_A<CpuType>>(i);
+        main[0x03 + i * 16] = std::make_unique<Instr_INC_RR<CpuType>>(i);
+        main[0x09 + i * 16] = std::make_unique<Instr_ADD_HL_RR<CpuType>>(i);
+        main[0x0A + i * 16] = std::make_unique<Instr_LD_A_MRR<CpuType>>(i);
+        main[0x0B + i * 16] = std::make_unique<Instr_DEC_RR<CpuType>>(i);
+
+        main[0xC0 + i * 8] = std::make_unique<Instr_RET<CpuType>>(conditions[i]);
+        main[0xC2 + i * 8] = std::make_unique<Instr_JP_A16<CpuType>>(conditions[i]);
+        main[0xC4 + i * 8] = std::make_unique<Instr_CALL_A16<CpuType>>(conditions[i]);
+        main[0xC1 + i * 16] = std::make_unique<Instr_POP_RR<CpuType>>(i);
+        main[0xC5 + i * 16] = std::make_unique<Instr_PUSH_RR<CpuType>>(i);
+    }
+
+    for (uint8_t reg = 0; reg < 8; ++reg) {
+        if (reg == 6) continue;
+        main[0x04 + reg * 8] = std::make_unique<Instr_INC_R<CpuType>>(reg);
+        main[0x05 + reg * 8] = std::make_unique<Instr_DEC_R<CpuType>>(reg);
+        main[0x06 + reg * 8] = std::make_unique<Instr_LD_R_D8<CpuType>>(reg);
+    }
+    main[0x34] = std::make_unique<Instr_INC_MHL<CpuType>>();
+    main[0x35] = std::make_unique<Instr_DEC_MHL<CpuType>>();
+    main[0x36] = std::make_unique<Instr_LD_MHL_D8<CpuType>>();
+
+    for (uint8_t i = 0; i < 4; ++i) {
+        main[0x07 + i * 8] = std::make_unique<Instr_ROTATE_A<CpuType>>(i);
+    }
+    main[0x27] = std::make_unique<Instr_DAA<CpuType>>();
+    main[0x2F] = std::make_unique<Instr_CPL<CpuType>>();
+    main[0x37] = std::make_unique<Instr_SCF<CpuType>>();
+    main[0x3F] = std::make_unique<Instr_CCF<CpuType>>();
+
+    
+    for (uint8_t opcode = 0x40; opcode <= 0x7F; ++opcode) {
+        if (opcode == 0x76) continue; 
+
+        uint8_t dest_idx = (opcode & 0b00111000) >> 3;
+        uint8_t src_idx = (opcode & 0b00000111);
+
+        if (dest_idx == 6) { 
+            main[opcode] = std::make_unique<Instr_LD_MHL_R<CpuType>>(src_idx);
+            continue;
+        }
+        
+        main[opcode] = std::make_unique<Instr_LD_R_R<CpuType>>(dest_idx, src_idx);
+    }
+    main[0x76] = std::make_unique<Instr_HALT<CpuType>>();
+
+    for (uint8_t op = 0; op < 8; ++op) {
+        for (uint8_t reg = 0; reg < 8; ++reg) {
+            main[0x80 + op * 8 + reg] = std::make_unique<Instr_ALU_A_R<CpuType>>(static_cast<AluOp>(op), reg);
+        }
+        main[0xC6 + op * 8] = std::make_unique<Instr_ALU_A_D8<CpuType>>(static_cast<AluOp>(op));
+        main[0xC7 + op * 8] = std::make_unique<Instr_RST<CpuType>>(static_cast<uint16_t>(op * 8));
+    }
+
+    main[0xC3] = std::make_unique<Instr_JP_A16<CpuType>>();
+    main[0xC9] = std::make_unique<Instr_RET<CpuType>>();
+    main[0xCB] = std::make_unique<Instr_CB_PREFIX<CpuType>>();
+    main[0xCD] = std::make_unique<Instr_CALL_A16<CpuType>>();
+    main[0xD9] = std::make_unique<Instr_RETI<CpuType>>();
+
+    main[0xE0] = std::make_unique<Instr_LDH_MA8_A<CpuType>>();
+    main[0xF0] = std::make_unique<Instr_LDH_A_MA8<CpuType>>();
+    main[0xE2] = std::make_unique<Instr_LD_MC_A<CpuType>>();
+    main[0xF2] = std::make_unique<Instr_LD_A_MC<CpuType>>();
+    main[0xE8] = std::make_unique<Instr_ADD_SP_E8<CpuType>>();
+    main[0xF8] = std::make_unique<Instr_LD_HL_SP_E8<CpuType>>();
+    main[0xE9] = std::make_unique<Instr_JP_HL<CpuType>>();
+    main[0xF9] = std::make_unique<Instr_LD_SP_HL<CpuType>>();
+    main[0xEA] = std::make_unique<Instr_LD_MA16_A<CpuType>>();
+    main[0xFA] = std::make_unique<Instr_LD_A_MA16<CpuType>>();
+    main[0xF3] = std::make_unique<Instr_DI<CpuType>>();
+    main[0xFB] = std::make_unique<Instr_EI<CpuType>>();
+
+    
+    for (int cb_opcode = 0; cb_opcode < 0x100; ++cb_opcode) {
+        uint8_t reg = cb_opcode & 0x07;
+        uint8_t y = (cb_opcode >> 3) & 0x07;
+        switch (cb_opcode >> 6) {
+        case 0: cb[cb_opcode] = std::make_unique<Instr_CB_SHIFT<CpuType>>(static_cast<ShiftOp>(y), reg); break;
+        case 1: cb[cb_opcode] = std::make_unique<Instr_CB_BIT<CpuType>>(y, reg); break;
+        case 2: cb[cb_opcode] = std::make_unique<Instr_CB_RES<CpuType>>(y, reg); break;
+        case 3: cb[cb_opcode] = std::make_unique<Instr_CB_SET<CpuType>>(y, reg); break;
+        }
+    }
+}
+
+template <class CpuType>
+const InstructionSet<CpuType>& InstructionSet<CpuType>::shared() {
+    static const InstructionSet instance;
+    return instance;
+}
+
+template struct InstructionSet<Cpu>;
+template struct InstructionSet<BasicCpu<FlatBus>>;
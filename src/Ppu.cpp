@@ -0,0 +1,344 @@
+#include "Ppu.h"
+#include "Bus.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    const uint32_t BLANK_COLOR = 0xFFFFFFFF;
+    // Registers the renderer keeps its own copy of.
+    const uint16_t RENDER_REGISTERS[] = { 0xFF40, 0xFF42, 0xFF43, 0xFF47, 0xFF48, 0xFF49, 0xFF4A, 0xFF4B };
+}
+
+Ppu::Ppu(Bus& bus) : bus_(bus) {
+    reset();
+}
+
+Ppu::~Ppu() = default;
+
+void Ppu::reset() {
+    lcdc_ = 0x91; stat_ = 0x00; scy_ = 0; scx_ = 0; lyc_ = 0;
+    bgp_ = 0xFC; obp0_ = 0xFF; obp1_ = 0xFF; wy_ = 0; wx_ = 0;
+    lcd_epoch_ = bus_.scheduler().now();
+    stat_interrupt_line_ = false;
+    frame_ready_ = false;
+    frame_count_ = 0;
+    vram_.fill(0);
+    vram_bank_ = 0;
+    oam_.fill(0);
+    vram_write_generation_++;
+
+    if (render_worker_) render_worker_->wait();
+    render_in_flight_ = false;
+    render_log_.clear();
+    for (auto& framebuffer : framebuffers_) framebuffer.fill(BLANK_COLOR);
+    front_framebuffer_ = 0;
+    render_target_ = render_worker_ ? 1 : 0;
+    syncRenderer();
+    scheduleVBlank();
+    scheduleStat();
+}
+
+void Ppu::saveState(State& state) const {
+    state.lcdc = lcdc_; state.stat = stat_; state.scy = scy_; state.scx = scx_; state.lyc = lyc_;
+    state.bgp = bgp_; state.obp0 = obp0_; state.obp1 = obp1_; state.wy = wy_; state.wx = wx_;
+    state.lcd_epoch = lcd_epoch_;
+    state.stat_interrupt_line = stat_interrupt_line_;
+    state.frame_ready = frame_ready_;
+    state.frame_count = frame_count_;
+    state.vram_bank = vram_bank_;
+    state.vram = vram_;
+    state.oam = oam_;
+}
+
+void Ppu::loadState(const State& state) {
+    if (render_worker_) render_worker_->wait();
+    render_in_flight_ = false;
+    render_log_.clear();
+
+    lcdc_ = state.lcdc; stat_ = state.stat; scy_ = state.scy; scx_ = state.scx; lyc_ = state.lyc;
+    bgp_ = state.bgp; obp0_ = state.obp0; obp1_ = state.obp1; wy_ = state.wy; wx_ = state.wx;
+    lcd_epoch_ = state.lcd_epoch;
+    stat_interrupt_line_ = state.stat_interrupt_line;
+    frame_ready_ = state.frame_ready;
+    frame_count_ = state.frame_count;
+    vram_bank_ = state.vram_bank;
+    vram_ = state.vram;
+    oam_ = state.oam;
+    vram_write_generation_++;
+    syncRenderer();
+}
+
+void Ppu::syncRenderer() {
+    renderer_.reset();
+    renderer_.setTarget(framebuffers_[render_target_].data());
+    renderer_.loadMemory(vram_.data(), oam_.data());
+    for (uint16_t address : RENDER_REGISTERS) renderer_.apply(address, read(address));
+}
+
+Ppu::Mode Ppu::modeAt(uint32_t frame_cycle) {
+    if (frame_cycle >= VISIBLE_LINES * CYCLES_PER_LINE) return MODE_VBLANK;
+    uint32_t dot = frame_cycle % CYCLES_PER_LINE;
+    if (dot < MODE2_CYCLES) return MODE_OAM_SCAN;
+    if (dot < MODE2_CYCLES + MODE3_CYCLES) return MODE_TRANSFER;
+    return MODE_HBLANK;
+}
+
+uint8_t Ppu::ly() const {
+    if (!isLcdEnabled()) return 0;
+    return static_cast<uint8_t>(frameCycle(bus_.scheduler().now()) / CYCLES_PER_LINE);
+}
+
+Ppu::Mode Ppu::mode() const {
+    if (!isLcdEnabled()) return MODE_HBLANK;
+    return modeAt(frameCycle(bus_.scheduler().now()));
+}
+
+uint64_t Ppu::nextHBlankTime(uint64_t after) const {
+    if (!isLcdEnabled()) return Scheduler::NEVER;
+    const uint32_t hblank_dot = MODE2_CYCLES + MODE3_CYCLES;
+    uint32_t frame_cycle = frameCycle(after);
+    uint32_t line = frame_cycle / CYCLES_PER_LINE;
+    uint32_t dot = frame_cycle % CYCLES_PER_LINE;
+    uint32_t target;
+    if (line < VISIBLE_LINES && dot < hblank_dot) target = line * CYCLES_PER_LINE + hblank_dot;
+    else if (line + 1 < VISIBLE_LINES) target = (line + 1) * CYCLES_PER_LINE + hblank_dot;
+    else target = CYCLES_PER_FRAME + hblank_dot;
+    return after + (target - frame_cycle);
+}
+
+bool Ppu::statLineAt(uint64_t time) const {
+    if (!isLcdEnabled()) return false;
+    uint32_t frame_cycle = frameCycle(time);
+    Mode m = modeAt(frame_cycle);
+    uint8_t line = static_cast<uint8_t>(frame_cycle / CYCLES_PER_LINE);
+    return ((stat_ & 0x40) && line == lyc_) ||
+        ((stat_ & 0x08) && m == MODE_HBLANK) ||
+        ((stat_ & 0x10) && m == MODE_VBLANK) ||
+        ((stat_ & 0x20) && m == MODE_OAM_SCAN);
+}
+
+uint64_t Ppu::nextStatCandidateTime(uint64_t after) const {
+    // The STAT line can only change at a mode boundary or a line start.
+    uint32_t frame_cycle = frameCycle(after);
+    uint32_t line_start = frame_cycle - frame_cycle % CYCLES_PER_LINE;
+    uint32_t dot = frame_cycle - line_start;
+    uint32_t next;
+    if (frame_cycle >= VISIBLE_LINES * CYCLES_PER_LINE) next = line_start + CYCLES_PER_LINE;
+    else if (dot < MODE2_CYCLES) next = line_start + MODE2_CYCLES;
+    else if (dot < MODE2_CYCLES + MODE3_CYCLES) next = line_start + MODE2_CYCLES + MODE3_CYCLES;
+    else next = line_start + CYCLES_PER_LINE;
+    return after + (next - frame_cycle);
+}
+
+void Ppu::scheduleVBlank() {
+    uint64_t now = bus_.scheduler().now();
+    uint32_t frame_cycle = frameCycle(now);
+    uint32_t vblank_cycle = isLcdEnabled() ? VISIBLE_LINES * CYCLES_PER_LINE : 0;
+    uint32_t wait = (vblank_cycle + CYCLES_PER_FRAME - frame_cycle) % CYCLES_PER_FRAME;
+    if (wait == 0) wait = CYCLES_PER_FRAME;
+    bus_.scheduler().schedule(SchedulerEvent::PpuVBlank, now + wait);
+}
+
+void Ppu::scheduleStat() {
+    if (!isLcdEnabled() || (stat_ & 0x78) == 0) {
+        bus_.scheduler().cancel(SchedulerEvent::PpuStat);
+        return;
+    }
+    uint64_t now = bus_.scheduler().now();
+    uint64_t candidate = nextStatCandidateTime(now);
+    if ((stat_ & 0x38) == 0) {
+        // Only the LY=LYC source is enabled: the line rises at the start of line LYC and
+        // falls at its end, so those are the only two points worth waking up for.
+        if (lyc_ >= TOTAL_LINES) {
+            bus_.scheduler().cancel(SchedulerEvent::PpuStat);
+            return;
+        }
+        uint32_t frame_cycle = frameCycle(now);
+        bool in_lyc_line = frame_cycle / CYCLES_PER_LINE == lyc_;
+        uint32_t target = (in_lyc_line ? (lyc_ + 1u) % TOTAL_LINES : lyc_) * CYCLES_PER_LINE;
+        uint32_t wait = (target + CYCLES_PER_FRAME - frame_cycle) % CYCLES_PER_FRAME;
+        if (wait == 0) wait = CYCLES_PER_FRAME;
+        candidate = now + wait;
+    }
+    bus_.scheduler().schedule(SchedulerEvent::PpuStat, candidate);
+}
+
+void Ppu::onVBlankEvent() {
+    if (render_worker_) {
+        // Present the frame the worker drew while this one ran, then hand it this one.
+        if (render_in_flight_) presentRenderedFrame();
+        uint64_t now = bus_.scheduler().now();
+        render_worker_->submit(render_log_, now - frameCycle(now), now, framebuffers_[render_target_].data(), !skip_drawing_);
+        render_in_flight_ = true;
+        in_flight_drawn_ = !skip_drawing_;
+    }
+    else {
+        catchUpRendering();
+        if (!skip_drawing_) front_framebuffer_ = render_target_;
+        if (threaded_rendering_requested_) {
+            // Switched at a frame boundary so the worker never draws into the presented buffer.
+            render_worker_ = std::make_unique<RenderWorker>(renderer_);
+            render_target_ = front_framebuffer_ ^ 1;
+        }
+    }
+    if (isLcdEnabled()) {
+        bus_.requestInterrupt(Bus::INTERRUPT_VBLANK);
+    }
+    // While the LCD is off there are no interrupts, but frames keep being paced at the normal rate.
+    frame_ready_ = true;
+    frame_count_++;
+    scheduleVBlank();
+}
+
+void Ppu::onStatEvent() {
+    bool line = statLineAt(bus_.scheduler().now());
+    if (line && !stat_interrupt_line_) {
+        bus_.requestInterrupt(Bus::INTERRUPT_LCD_STAT);
+    }
+    stat_interrupt_line_ = line;
+    scheduleStat();
+}
+
+uint8_t Ppu::read(uint16_t address) const {
+    switch (address) {
+    case 0xFF40: return lcdc_;
+    case 0xFF41: {
+        if (isLcdEnabled()) {
+            bus_.notePolledValueChangeTime(nextStatCandidateTime(bus_.scheduler().now()));
+        }
+        uint8_t coincidence = (ly() == lyc_) ? 0x04 : 0x00;
+        return 0x80 | (stat_ & 0x78) | coincidence | static_cast<uint8_t>(mode());
+    }
+    case 0xFF42: return scy_;
+    case 0xFF43: return scx_;
+    case 0xFF44:
+        if (isLcdEnabled()) {
+            uint64_t now = bus_.scheduler().now();
+            bus_.notePolledValueChangeTime(now + CYCLES_PER_LINE - frameCycle(now) % CYCLES_PER_LINE);
+        }
+        return ly();
+    case 0xFF45: return lyc_;
+    case 0xFF47: return bgp_;
+    case 0xFF48: return obp0_;
+    case 0xFF49: return obp1_;
+    case 0xFF4A: return wy_;
+    case 0xFF4B: return wx_;
+    default: return 0xFF;
+    }
+}
+
+void Ppu::write(uint16_t address, uint8_t value) {
+    switch (address) {
+    case 0xFF40: {
+        bool was_enabled = isLcdEnabled();
+        if (was_enabled != ((value & 0x80) != 0)) {
+            // Frame timing restarts, so finish everything logged under the old timing first.
+            finishRendering();
+        }
+        recordRenderWrite(address, value);
+        lcdc_ = value;
+        if (was_enabled != isLcdEnabled()) {
+            if (!isLcdEnabled()) {
+                for (auto& framebuffer : framebuffers_) framebuffer.fill(BLANK_COLOR);
+            }
+            lcd_epoch_ = bus_.scheduler().now();
+            stat_interrupt_line_ = false;
+            scheduleVBlank();
+            scheduleStat();
+        }
+        break;
+    }
+    case 0xFF41:
+        stat_ = value & 0x78;
+        // Enabling a source whose condition already holds raises the line immediately.
+        onStatEvent();
+        break;
+    case 0xFF42: recordRenderWrite(address, value); scy_ = value; break;
+    case 0xFF43: recordRenderWrite(address, value); scx_ = value; break;
+    case 0xFF44: break;
+    case 0xFF45: lyc_ = value; onStatEvent(); break;
+    case 0xFF47: recordRenderWrite(address, value); bgp_ = value; break;
+    case 0xFF48: recordRenderWrite(address, value); obp0_ = value; break;
+    case 0xFF49: recordRenderWrite(address, value); obp1_ = value; break;
+    case 0xFF4A: recordRenderWrite(address, value); wy_ = value; break;
+    case 0xFF4B: recordRenderWrite(address, value); wx_ = value; break;
+    }
+}
+
+void Ppu::writeVram(uint16_t address, uint8_t value) {
+    size_t index = vramIndex(address);
+    if (vram_[index] == value) return;
+    vram_[index] = value;
+    vram_write_generation_++;
+    recordRenderWrite(static_cast<uint16_t>(0x8000 + index), value);
+}
+
+void Ppu::writeOam(uint16_t address, uint8_t value) {
+    oam_[address - 0xFE00] = value;
+    recordRenderWrite(address, value);
+}
+
+void Ppu::writeVramBlock(uint16_t address, const uint8_t* data, size_t length) {
+    size_t index = vramIndex(address);
+    if (std::equal(data, data + length, vram_.data() + index)) return;
+    // Only the bytes that change are logged, before the copy so an overlapping source is read
+    // as it was.
+    for (size_t i = 0; i < length; ++i) {
+        if (vram_[index + i] != data[i]) recordRenderWrite(static_cast<uint16_t>(0x8000 + index + i), data[i]);
+    }
+    std::memmove(vram_.data() + index, data, length);
+    vram_write_generation_++;
+}
+
+void Ppu::writeOamBlock(uint16_t offset, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (oam_[offset + i] != data[i]) recordRenderWrite(static_cast<uint16_t>(0xFE00 + offset + i), data[i]);
+    }
+    std::memmove(oam_.data() + offset, data, length);
+}
+
+void Ppu::recordRenderWrite(uint16_t address, uint8_t value) {
+    if (render_worker_) {
+        render_log_.push_back({ bus_.scheduler().now(), address, value });
+        return;
+    }
+    catchUpRendering();
+    renderer_.apply(address, value);
+}
+
+void Ppu::catchUpRendering() {
+    if (!isLcdEnabled()) return;
+    uint64_t now = bus_.scheduler().now();
+    renderer_.replay(nullptr, 0, now - frameCycle(now), now, !skip_drawing_);
+}
+
+void Ppu::presentRenderedFrame() {
+    render_worker_->wait();
+    if (in_flight_drawn_) {
+        front_framebuffer_ = render_target_;
+        render_target_ ^= 1;
+    }
+    render_in_flight_ = false;
+}
+
+void Ppu::finishRendering() {
+    if (!render_worker_) return;
+    if (render_in_flight_) presentRenderedFrame();
+    // The renderer is idle: draw what this frame has logged so far on this thread.
+    uint64_t now = bus_.scheduler().now();
+    renderer_.setTarget(framebuffers_[render_target_].data());
+    renderer_.replay(render_log_.data(), render_log_.size(), now - frameCycle(now), now, !skip_drawing_);
+    render_log_.clear();
+}
+
+void Ppu::setThreadedRendering(bool enabled) {
+    // Turning it on takes effect at the next VBlank; turning it off finishes the worker's
+    // frame and carries on inline from there.
+    threaded_rendering_requested_ = enabled;
+    if (!enabled && render_worker_) {
+        finishRendering();
+        render_worker_.reset();
+    }
+}
+
@@ -0,0 +1,229 @@
+#include "PpuRenderer.h"
+#include "Ppu.h"
+
+#include <algorithm>
+
+namespace {
+    // DMG shades 0 (lightest) to 3 as RGBA8888.
+    const uint32_t SHADES[4] = { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 };
+
+    const uint16_t TILE_MAP_0 = 0x1800;
+    const uint16_t TILE_MAP_1 = 0x1C00;
+    const int MAX_SPRITES_PER_LINE = 10;
+    const int SCREEN_WIDTH = Ppu::SCREEN_WIDTH;
+}
+
+PpuRenderer::PpuRenderer() : target_(nullptr) {
+    reset();
+}
+
+void PpuRenderer::reset() {
+    vram_.fill(0);
+    oam_.fill(0);
+    tile_cache_.invalidateAll();
+    lcdc_ = 0; scy_ = 0; scx_ = 0; wy_ = 0; wx_ = 0;
+    decodePalette(0, bg_colors_);
+    decodePalette(0, obj_colors_[0]);
+    decodePalette(0, obj_colors_[1]);
+    frame_start_ = ~0ull;
+    next_line_ = 0;
+    window_line_ = 0;
+}
+
+void PpuRenderer::apply(uint16_t address, uint8_t value) {
+    if (address >= 0x8000 && address <= 0xBFFF) {
+        uint16_t index = address - 0x8000;
+        vram_[index] = value;
+        tile_cache_.markDirty(index >> 13, index & 0x1FFF);
+        return;
+    }
+    if (address >= 0xFE00 && address <= 0xFE9F) {
+        oam_[address - 0xFE00] = value;
+        return;
+    }
+    switch (address) {
+    case 0xFF40: lcdc_ = value; break;
+    case 0xFF42: scy_ = value; break;
+    case 0xFF43: scx_ = value; break;
+    case 0xFF47: decodePalette(value, bg_colors_); break;
+    case 0xFF48: decodePalette(value, obj_colors_[0]); break;
+    case 0xFF49: decodePalette(value, obj_colors_[1]); break;
+    case 0xFF4A: wy_ = value; break;
+    case 0xFF4B: wx_ = value; break;
+    }
+}
+
+void PpuRenderer::loadMemory(const uint8_t* vram, const uint8_t* oam) {
+    std::copy(vram, vram + vram_.size(), vram_.begin());
+    std::copy(oam, oam + oam_.size(), oam_.begin());
+    tile_cache_.invalidateAll();
+    frame_start_ = ~0ull;
+}
+
+void PpuRenderer::replay(const RenderWrite* writes, size_t count, uint64_t frame_start, uint64_t end_time, bool draw) {
+    if (frame_start != frame_start_) {
+        frame_start_ = frame_start;
+        next_line_ = 0;
+        window_line_ = 0;
+    }
+
+    size_t next_write = 0;
+    while (next_line_ < Ppu::VISIBLE_LINES && (lcdc_ & 0x80)) {
+        // A line is drawn with the state as it was when its pixel transfer began.
+        uint64_t transfer_start = frame_start + next_line_ * Ppu::CYCLES_PER_LINE + Ppu::MODE2_CYCLES;
+        if (transfer_start > end_time) break;
+        while (next_write < count && writes[next_write].time < transfer_start) {
+            apply(writes[next_write].address, writes[next_write].value);
+            next_write++;
+        }
+        if (draw) renderLine(next_line_);
+        next_line_++;
+    }
+    for (; next_write < count; ++next_write) {
+        apply(writes[next_write].address, writes[next_write].value);
+    }
+}
+
+void PpuRenderer::decodePalette(uint8_t value, std::array<uint32_t, 4>& colors) {
+    for (int i = 0; i < 4; ++i) {
+        colors[i] = SHADES[(value >> (i * 2)) & 0x03];
+    }
+}
+
+int PpuRenderer::tileIndex(uint8_t map_entry, bool sprite) const {
+    // LCDC bit 4 clear: BG/window tile numbers are signed, relative to 0x9000.
+    if (sprite || (lcdc_ & 0x10)) return map_entry;
+    return 256 + static_cast<int8_t>(map_entry);
+}
+
+void PpuRenderer::renderLine(uint8_t line) {
+    uint8_t bg_indices[SCREEN_WIDTH];
+    if (lcdc_ & 0x01) {
+        uint16_t bg_map = (lcdc_ & 0x08) ? TILE_MAP_1 : TILE_MAP_0;
+        renderBackgroundSpan(line, bg_map, static_cast<uint8_t>(scy_ + line), scx_, 0, bg_indices);
+        if ((lcdc_ & 0x20) && line >= wy_ && wx_ <= 166) {
+            uint16_t window_map = (lcdc_ & 0x40) ? TILE_MAP_1 : TILE_MAP_0;
+            renderBackgroundSpan(line, window_map, window_line_, 0, wx_ - 7, bg_indices);
+            window_line_++;
+        }
+    }
+    else {
+        uint32_t* out = target_ + line * SCREEN_WIDTH;
+        std::fill(out, out + SCREEN_WIDTH, SHADES[0]);
+        std::fill(bg_indices, bg_indices + SCREEN_WIDTH, 0);
+    }
+
+    if (lcdc_ & 0x02) {
+        renderSprites(line, bg_indices);
+    }
+}
+
+void PpuRenderer::renderBackgroundSpan(uint8_t line, uint16_t map_base, uint8_t map_y, uint8_t map_x, int first_x, uint8_t* bg_indices) {
+    uint32_t* out = target_ + line * SCREEN_WIDTH;
+    const uint8_t* map_row = &vram_[map_base + (map_y >> 3) * 32];
+    int fine_y = map_y & 7;
+    int clip_x = std::max(first_x, 0);
+    uint8_t column = map_x >> 3;
+
+    // Tiles are placed from one partially hidden on the left (fine scroll) to the right edge.
+    for (int x = first_x - (map_x & 7); x < SCREEN_WIDTH; x += 8) {
+        const uint8_t* pixels = tile_cache_.row(vram_.data(), 0, tileIndex(map_row[column], false), fine_y, false);
+        column = (column + 1) & 31;
+        int begin = std::max(x, clip_x);
+        int end = std::min(x + 8, SCREEN_WIDTH);
+        for (int screen_x = begin; screen_x < end; ++screen_x) {
+            uint8_t index = pixels[screen_x - x];
+            bg_indices[screen_x] = index;
+            out[screen_x] = bg_colors_[index];
+        }
+    }
+}
+
+void PpuRenderer::renderSprites(uint8_t line, const uint8_t* bg_indices) {
+    int height = (lcdc_ & 0x04) ? 16 : 8;
+
+    // The first ten sprites in OAM order that cover the line; on overlap the one with the
+    // lower X (then the lower OAM index) wins.
+    uint8_t selected[MAX_SPRITES_PER_LINE];
+    int count = 0;
+    for (int i = 0; i < 40 && count < MAX_SPRITES_PER_LINE; ++i) {
+        int top = oam_[i * 4] - 16;
+        if (line >= top && line < top + height) selected[count++] = static_cast<uint8_t>(i);
+    }
+    std::stable_sort(selected, selected + count, [this](uint8_t a, uint8_t b) {
+        return oam_[a * 4 + 1] < oam_[b * 4 + 1];
+    });
+
+    uint32_t* out = target_ + line * SCREEN_WIDTH;
+    // A pixel taken by a higher-priority sprite stays taken even where the BG hides it.
+    bool claimed[SCREEN_WIDTH] = {};
+    for (int n = 0; n < count; ++n) {
+        const uint8_t* sprite = &oam_[selected[n] * 4];
+        uint8_t attributes = sprite[3];
+        int row = line - (sprite[0] - 16);
+        if (attributes & 0x40) row = height - 1 - row;
+        int tile = height == 16 ? (sprite[2] & 0xFE) + (row >> 3) : sprite[2];
+        const uint8_t* pixels = tile_cache_.row(vram_.data(), 0, tileIndex(static_cast<uint8_t>(tile), true), row & 7, (attributes & 0x20) != 0);
+        const std::array<uint32_t, 4>& colors = obj_colors_[(attributes >> 4) & 1];
+        bool behind_bg = (attributes & 0x80) != 0;
+
+        int x = sprite[1] - 8;
+        for (int i = 0; i < 8; ++i) {
+            int screen_x = x + i;
+            if (screen_x < 0 || screen_x >= SCREEN_WIDTH || claimed[screen_x]) continue;
+            uint8_t index = pixels[i];
+            if (index == 0) continue;
+            claimed[screen_x] = true;
+            if (behind_bg && bg_indices[screen_x] != 0) continue;
+            out[screen_x] = colors[index];
+        }
+    }
+}
+
+RenderWorker::RenderWorker(PpuRenderer& renderer) : renderer_(renderer) {
+    thread_ = std::thread(&RenderWorker::run, this);
+}
+
+RenderWorker::~RenderWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void RenderWorker::submit(std::vector<RenderWrite>& log, uint64_t frame_start, uint64_t end_time, uint32_t* target, bool draw) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return !pending_; });
+    log_.clear();
+    log_.swap(log);
+    frame_start_ = frame_start;
+    end_time_ = end_time;
+    target_ = target;
+    draw_ = draw;
+    pending_ = true;
+    lock.unlock();
+    wake_.notify_one();
+}
+
+void RenderWorker::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return !pending_; });
+}
+
+void RenderWorker::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return pending_ || stop_; });
+        if (!pending_) return;
+
+        lock.unlock();
+        renderer_.setTarget(target_);
+        renderer_.replay(log_.data(), log_.size(), frame_start_, end_time_, draw_);
+        lock.lock();
+
+        pending_ = false;
+        done_.notify_all();
+    }
+}
@@ -0,0 +1,194 @@
+#include "RegressionRunner.h"
+#include "HeadlessRunner.h"
+#include "Cpu.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <thread>
+
+int RegressionRunner::run(const RegressionOptions& options) {
+    std::vector<RomResult> results;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(options.rom_directory, error), end; !error && it != end; it.increment(error)) {
+        if (!it->is_regular_file(error)) continue;
+        std::string extension = it->path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (extension != ".gb" && extension != ".gbc") continue;
+        RomResult result;
+        result.name = it->path().filename().string();
+        result.path = it->path().string();
+        results.push_back(result);
+    }
+    if (error) {
+        std::cerr << "Regression Error: Cannot read ROM directory " << options.rom_directory << ": " << error.message() << std::endl;
+        return 1;
+    }
+    if (results.empty()) {
+        std::cerr << "Regression Error: No .gb/.gbc ROMs in " << options.rom_directory << std::endl;
+        return 1;
+    }
+    std::sort(results.begin(), results.end(), [](const RomResult& a, const RomResult& b) { return a.name < b.name; });
+
+    // Every ROM gets its own core, so the only thing shared between workers is the next index.
+    unsigned jobs = options.jobs != 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = static_cast<unsigned>(std::min<size_t>(jobs, results.size()));
+    std::atomic<size_t> next_rom(0);
+    auto worker = [&]() {
+        for (size_t index; (index = next_rom.fetch_add(1)) < results.size();) {
+            runRom(results[index], options);
+        }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < jobs; ++i) threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (options.update_manifest) {
+        if (!writeManifest(options.manifest_path, results)) return 1;
+        printf("Wrote %zu ROMs to %s (%.2f s, %u jobs)\n", results.size(), options.manifest_path.c_str(), seconds, jobs);
+        return 0;
+    }
+
+    std::vector<std::pair<std::string, Checkpoint>> entries;
+    if (!readManifest(options.manifest_path, entries)) return 1;
+    std::map<std::string, std::vector<Checkpoint>> expected;
+    for (const auto& entry : entries) expected[entry.first].push_back(entry.second);
+
+    size_t passed = 0, failed = 0, unknown = 0;
+    for (const RomResult& result : results) {
+        std::vector<Checkpoint> golden;
+        auto found = expected.find(result.name);
+        bool known = found != expected.end();
+        if (known) {
+            golden.swap(found->second);
+            expected.erase(found);
+        }
+
+        if (!result.loaded) {
+            printf("FAIL %s: could not be loaded\n", result.name.c_str());
+            failed++;
+        }
+        else if (!known) {
+            printf("NEW  %s: not in the manifest\n", result.name.c_str());
+            unknown++;
+        }
+        else {
+            std::string failure;
+            for (const Checkpoint& checkpoint : golden) {
+                auto actual = std::find_if(result.checkpoints.begin(), result.checkpoints.end(),
+                    [&](const Checkpoint& c) { return c.frame == checkpoint.frame; });
+                char message[96];
+                if (actual == result.checkpoints.end()) {
+                    std::snprintf(message, sizeof(message), "frame %llu was not reached", (unsigned long long)checkpoint.frame);
+                }
+                else if (actual->hash != checkpoint.hash) {
+                    std::snprintf(message, sizeof(message), "frame %llu hash %016llx, expected %016llx",
+                        (unsigned long long)checkpoint.frame, (unsigned long long)actual->hash, (unsigned long long)checkpoint.hash);
+                }
+                else {
+                    continue;
+                }
+                failure = message;
+                break;
+            }
+            if (failure.empty()) {
+                printf("PASS %s (%.0f ms)\n", result.name.c_str(), result.milliseconds);
+                passed++;
+            }
+            else {
+                printf("FAIL %s: %s\n", result.name.c_str(), failure.c_str());
+                failed++;
+            }
+        }
+    }
+    for (const auto& missing : expected) {
+        printf("FAIL %s: in the manifest but not in %s\n", missing.first.c_str(), options.rom_directory.c_str());
+        failed++;
+    }
+
+    printf("%zu passed, %zu failed, %zu not in the manifest (%.2f s, %u jobs)\n", passed, failed, unknown, seconds, jobs);
+    return failed != 0 ? 2 : 0;
+}
+
+void RegressionRunner::runRom(RomResult& result, const RegressionOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    HeadlessRunner runner;
+    if (!runner.loadRom(result.path)) return;
+    result.loaded = true;
+    runner.cpu().idle_loop_skipping_enabled_ = options.idle_loop_skipping;
+
+    for (uint64_t frame = 1; frame <= options.frames; ++frame) {
+        runner.runFrame();
+        bool checkpoint = options.checkpoint_interval != 0 && frame % options.checkpoint_interval == 0;
+        if (checkpoint || frame == options.frames) {
+            result.checkpoints.push_back({ frame, runner.frameHash() });
+        }
+    }
+    result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool RegressionRunner::readManifest(const std::string& path, std::vector<std::pair<std::string, Checkpoint>>& entries) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Regression Error: Cannot open manifest " << path << " (create it with --update-manifest)" << std::endl;
+        return false;
+    }
+    const char* const BLANK = " \t\r";
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); ++line_number) {
+        size_t first = line.find_first_not_of(BLANK);
+        if (first == std::string::npos || line[first] == '#') continue;
+        line.erase(line.find_last_not_of(BLANK) + 1);
+
+        // ROM names may contain spaces, so the frame and hash are taken from the end.
+        size_t hash_start = line.find_last_of(BLANK) + 1;
+        size_t frame_end = hash_start > first ? line.find_last_not_of(BLANK, hash_start - 1) + 1 : 0;
+        size_t frame_start = frame_end > first ? line.find_last_of(BLANK, frame_end - 1) + 1 : 0;
+        size_t name_end = frame_start > first ? line.find_last_not_of(BLANK, frame_start - 1) + 1 : 0;
+        char* frame_parse_end = nullptr;
+        char* hash_parse_end = nullptr;
+        Checkpoint checkpoint{};
+        if (name_end > first) {
+            checkpoint.frame = std::strtoull(line.c_str() + frame_start, &frame_parse_end, 10);
+            checkpoint.hash = std::strtoull(line.c_str() + hash_start, &hash_parse_end, 16);
+        }
+        if (name_end <= first || frame_parse_end != line.c_str() + frame_end || hash_parse_end != line.c_str() + line.size()) {
+            std::cerr << "Regression Error: " << path << ":" << line_number << ": expected \"<rom> <frame> <hash>\"" << std::endl;
+            return false;
+        }
+        entries.emplace_back(line.substr(first, name_end - first), checkpoint);
+    }
+    return true;
+}
+
+bool RegressionRunner::writeManifest(const std::string& path, const std::vector<RomResult>& results) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Regression Error: Cannot write manifest " << path << std::endl;
+        return false;
+    }
+    file << "# Golden frame hashes: <rom file name> <frame> <hash>\n";
+    char hash[17];
+    for (const RomResult& result : results) {
+        if (!result.loaded) {
+            std::cerr << "Regression Warning: " << result.name << " could not be loaded and is left out." << std::endl;
+            continue;
+        }
+        for (const Checkpoint& checkpoint : result.checkpoints) {
+            std::snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)checkpoint.hash);
+            file << result.name << ' ' << checkpoint.frame << ' ' << hash << '\n';
+        }
+    }
+    return static_cast<bool>(file);
+}
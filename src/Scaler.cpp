@@ -0,0 +1,350 @@
+#include "Scaler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(GBC_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define GBC_SCALER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Row pointers below point at the padded pixel for x = 0, so [-1] and [width] are the
+    // repeated edge pixels.
+
+    // Scale2x, one pixel: B above, D left, E centre, F right, H below.
+    inline void scale2xPixel(uint32_t b, uint32_t d, uint32_t e, uint32_t f, uint32_t h, uint32_t* top, uint32_t* bottom) {
+        bool active = b != h && d != f;
+        top[0] = active && d == b ? d : e;
+        top[1] = active && b == f ? f : e;
+        bottom[0] = active && d == h ? d : e;
+        bottom[1] = active && h == f ? f : e;
+    }
+
+    // Scale3x, one pixel, neighbours named as:  A B C / D E F / G H I.
+    inline void scale3xPixel(const uint32_t* above, const uint32_t* row, const uint32_t* below, int x, uint32_t* out0, uint32_t* out1, uint32_t* out2) {
+        uint32_t a = above[x - 1], b = above[x], c = above[x + 1];
+        uint32_t d = row[x - 1], e = row[x], f = row[x + 1];
+        uint32_t g = below[x - 1], h = below[x], i = below[x + 1];
+        if (b != h && d != f) {
+            out0[0] = d == b ? d : e;
+            out0[1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+            out0[2] = b == f ? f : e;
+            out1[0] = (d == b && e != g) || (d == h && e != a) ? d : e;
+            out1[1] = e;
+            out1[2] = (b == f && e != i) || (h == f && e != c) ? f : e;
+            out2[0] = d == h ? d : e;
+            out2[1] = (d == h && e != i) || (h == f && e != g) ? h : e;
+            out2[2] = h == f ? f : e;
+        }
+        else {
+            out0[0] = out0[1] = out0[2] = e;
+            out1[0] = out1[1] = out1[2] = e;
+            out2[0] = out2[1] = out2[2] = e;
+        }
+    }
+
+    // hqx compares colours in YUV: two pixels are alike when every channel is within its
+    // threshold. Keys pack Y | U << 8 | V << 16.
+    const uint32_t HQ_THRESHOLDS = 0x30 | 0x07 << 8 | 0x06 << 16;
+
+    inline uint32_t yuvKey(uint32_t pixel) {
+        int r = pixel & 0xFF, g = (pixel >> 8) & 0xFF, b = (pixel >> 16) & 0xFF;
+        int y = (77 * r + 150 * g + 29 * b) >> 8;
+        int u = ((-43 * r - 85 * g + 128 * b) >> 8) + 128;
+        int v = ((128 * r - 107 * g - 21 * b) >> 8) + 128;
+        return static_cast<uint32_t>(y | u << 8 | v << 16);
+    }
+
+    inline bool alike(uint32_t key_a, uint32_t key_b) {
+        for (int shift = 0; shift < 24; shift += 8) {
+            int a = (key_a >> shift) & 0xFF, b = (key_b >> shift) & 0xFF;
+            int threshold = (HQ_THRESHOLDS >> shift) & 0xFF;
+            if (std::abs(a - b) > threshold) return false;
+        }
+        return true;
+    }
+
+    // Per byte (a + b + 1) / 2, as _mm_avg_epu8.
+    inline uint32_t average(uint32_t a, uint32_t b) {
+        return (a | b) - (((a ^ b) >> 1) & 0x7F7F7F7F);
+    }
+
+    // Hq2x, one pixel: where Scale2x would copy an edge colour into a corner, the corner gets
+    // half the centre and a quarter of each of the two alike neighbours.
+    inline void hq2xPixel(const uint32_t* above, const uint32_t* row, const uint32_t* below,
+        const uint32_t* key_above, const uint32_t* key_row, const uint32_t* key_below, int x, uint32_t* top, uint32_t* bottom) {
+        uint32_t b = above[x], d = row[x - 1], e = row[x], f = row[x + 1], h = below[x];
+        uint32_t kb = key_above[x], kd = key_row[x - 1], kf = key_row[x + 1], kh = key_below[x];
+        bool active = !alike(kb, kh) && !alike(kd, kf);
+        top[0] = active && alike(kd, kb) ? average(e, average(d, b)) : e;
+        top[1] = active && alike(kb, kf) ? average(e, average(b, f)) : e;
+        bottom[0] = active && alike(kd, kh) ? average(e, average(d, h)) : e;
+        bottom[1] = active && alike(kh, kf) ? average(e, average(h, f)) : e;
+    }
+
+#ifdef GBC_SCALER_SSE2
+    inline __m128i load(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    inline void store(uint32_t* p, __m128i v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    inline __m128i select(__m128i mask, __m128i yes, __m128i no) {
+        return _mm_or_si128(_mm_and_si128(mask, yes), _mm_andnot_si128(mask, no));
+    }
+    inline __m128i equal(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+    inline __m128i differ(__m128i a, __m128i b) { return _mm_xor_si128(_mm_cmpeq_epi32(a, b), _mm_set1_epi32(-1)); }
+
+    // Writes pixels a0 b0 a1 b1 a2 b2 a3 b3.
+    inline void storeInterleaved2(uint32_t* out, __m128i a, __m128i b) {
+        store(out, _mm_unpacklo_epi32(a, b));
+        store(out + 4, _mm_unpackhi_epi32(a, b));
+    }
+
+    // Writes pixels a0 b0 c0 a1 b1 c1 ... c3.
+    inline void storeInterleaved3(uint32_t* out, __m128i a, __m128i b, __m128i c) {
+        __m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b), fc = _mm_castsi128_ps(c);
+        __m128 out0 = _mm_shuffle_ps(_mm_unpacklo_ps(fa, fb), _mm_unpacklo_ps(fc, fa), _MM_SHUFFLE(3, 0, 1, 0));
+        __m128 out1 = _mm_shuffle_ps(_mm_unpacklo_ps(fb, fc), _mm_unpackhi_ps(fa, fb), _MM_SHUFFLE(1, 0, 3, 2));
+        __m128 out2 = _mm_shuffle_ps(_mm_unpackhi_ps(fc, fa), _mm_unpackhi_ps(fb, fc), _MM_SHUFFLE(3, 2, 3, 0));
+        store(out, _mm_castps_si128(out0));
+        store(out + 4, _mm_castps_si128(out1));
+        store(out + 8, _mm_castps_si128(out2));
+    }
+
+    inline __m128i alike(__m128i key_a, __m128i key_b) {
+        __m128i difference = _mm_or_si128(_mm_subs_epu8(key_a, key_b), _mm_subs_epu8(key_b, key_a));
+        __m128i over = _mm_subs_epu8(difference, _mm_set1_epi32(static_cast<int>(HQ_THRESHOLDS)));
+        return _mm_cmpeq_epi32(over, _mm_setzero_si128());
+    }
+#endif
+
+    void nearestRow(const uint32_t* row, int width, int factor, uint32_t* out) {
+        int x = 0;
+#ifdef GBC_SCALER_SSE2
+        if (factor == 2) {
+            for (; x + 4 <= width; x += 4, out += 8) {
+                __m128i v = load(row + x);
+                storeInterleaved2(out, v, v);
+            }
+        }
+        else if (factor == 3) {
+            for (; x + 4 <= width; x += 4, out += 12) {
+                __m128i v = load(row + x);
+                store(out, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 0, 0)));
+                store(out + 4, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1)));
+                store(out + 8, _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 2)));
+            }
+        }
+        else if (factor == 4) {
+            for (; x + 4 <= width; x += 4, out += 16) {
+                __m128i v = load(row + x);
+                store(out, _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 0, 0, 0)));
+                store(out + 4, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 1, 1, 1)));
+                store(out + 8, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 2, 2)));
+                store(out + 12, _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+        }
+#endif
+        for (; x < width; ++x) {
+            for (int i = 0; i < factor; ++i) *out++ = row[x];
+        }
+    }
+
+    void scale2xRow(const uint32_t* above, const uint32_t* row, const uint32_t* below, int width, uint32_t* top, uint32_t* bottom) {
+        int x = 0;
+#ifdef GBC_SCALER_SSE2
+        for (; x + 4 <= width; x += 4) {
+            __m128i b = load(above + x), d = load(row + x - 1), e = load(row + x), f = load(row + x + 1), h = load(below + x);
+            __m128i active = _mm_andnot_si128(_mm_or_si128(equal(b, h), equal(d, f)), _mm_set1_epi32(-1));
+            __m128i e0 = select(_mm_and_si128(active, equal(d, b)), d, e);
+            __m128i e1 = select(_mm_and_si128(active, equal(b, f)), f, e);
+            __m128i e2 = select(_mm_and_si128(active, equal(d, h)), d, e);
+            __m128i e3 = select(_mm_and_si128(active, equal(h, f)), f, e);
+            storeInterleaved2(top + 2 * x, e0, e1);
+            storeInterleaved2(bottom + 2 * x, e2, e3);
+        }
+#endif
+        for (; x < width; ++x) {
+            scale2xPixel(above[x], row[x - 1], row[x], row[x + 1], below[x], top + 2 * x, bottom + 2 * x);
+        }
+    }
+
+    void scale3xRow(const uint32_t* above, const uint32_t* row, const uint32_t* below, int width, uint32_t* out0, uint32_t* out1, uint32_t* out2) {
+        int x = 0;
+#ifdef GBC_SCALER_SSE2
+        for (; x + 4 <= width; x += 4) {
+            __m128i a = load(above + x - 1), b = load(above + x), c = load(above + x + 1);
+            __m128i d = load(row + x - 1), e = load(row + x), f = load(row + x + 1);
+            __m128i g = load(below + x - 1), h = load(below + x), i = load(below + x + 1);
+            __m128i active = _mm_andnot_si128(_mm_or_si128(equal(b, h), equal(d, f)), _mm_set1_epi32(-1));
+            __m128i db = _mm_and_si128(active, equal(d, b));
+            __m128i bf = _mm_and_si128(active, equal(b, f));
+            __m128i dh = _mm_and_si128(active, equal(d, h));
+            __m128i hf = _mm_and_si128(active, equal(h, f));
+            __m128i ea = differ(e, a), ec = differ(e, c), eg = differ(e, g), ei = differ(e, i);
+
+            storeInterleaved3(out0 + 3 * x, select(db, d, e),
+                select(_mm_or_si128(_mm_and_si128(db, ec), _mm_and_si128(bf, ea)), b, e), select(bf, f, e));
+            storeInterleaved3(out1 + 3 * x, select(_mm_or_si128(_mm_and_si128(db, eg), _mm_and_si128(dh, ea)), d, e),
+                e, select(_mm_or_si128(_mm_and_si128(bf, ei), _mm_and_si128(hf, ec)), f, e));
+            storeInterleaved3(out2 + 3 * x, select(dh, d, e),
+                select(_mm_or_si128(_mm_and_si128(dh, ei), _mm_and_si128(hf, eg)), h, e), select(hf, f, e));
+        }
+#endif
+        for (; x < width; ++x) {
+            scale3xPixel(above, row, below, x, out0 + 3 * x, out1 + 3 * x, out2 + 3 * x);
+        }
+    }
+
+    void hq2xRow(const uint32_t* above, const uint32_t* row, const uint32_t* below,
+        const uint32_t* key_above, const uint32_t* key_row, const uint32_t* key_below, int width, uint32_t* top, uint32_t* bottom) {
+        int x = 0;
+#ifdef GBC_SCALER_SSE2
+        for (; x + 4 <= width; x += 4) {
+            __m128i b = load(above + x), d = load(row + x - 1), e = load(row + x), f = load(row + x + 1), h = load(below + x);
+            __m128i kb = load(key_above + x), kd = load(key_row + x - 1), kf = load(key_row + x + 1), kh = load(key_below + x);
+            __m128i active = _mm_andnot_si128(_mm_or_si128(alike(kb, kh), alike(kd, kf)), _mm_set1_epi32(-1));
+            __m128i e0 = select(_mm_and_si128(active, alike(kd, kb)), _mm_avg_epu8(e, _mm_avg_epu8(d, b)), e);
+            __m128i e1 = select(_mm_and_si128(active, alike(kb, kf)), _mm_avg_epu8(e, _mm_avg_epu8(b, f)), e);
+            __m128i e2 = select(_mm_and_si128(active, alike(kd, kh)), _mm_avg_epu8(e, _mm_avg_epu8(d, h)), e);
+            __m128i e3 = select(_mm_and_si128(active, alike(kh, kf)), _mm_avg_epu8(e, _mm_avg_epu8(h, f)), e);
+            storeInterleaved2(top + 2 * x, e0, e1);
+            storeInterleaved2(bottom + 2 * x, e2, e3);
+        }
+#endif
+        for (; x < width; ++x) {
+            hq2xPixel(above, row, below, key_above, key_row, key_below, x, top + 2 * x, bottom + 2 * x);
+        }
+    }
+
+    // CGB LCD response: each channel picks up some of the others and the top of the range is
+    // compressed, so the raw RGB555 values look the way they did on the console's screen.
+    struct ColorCorrectionTable {
+        uint32_t entries[0x8000];
+
+        ColorCorrectionTable() {
+            for (uint32_t index = 0; index < 0x8000; ++index) {
+                uint32_t r = index & 0x1F, g = (index >> 5) & 0x1F, b = (index >> 10) & 0x1F;
+                uint32_t red = std::min(960u, r * 26 + g * 4 + b * 2) >> 2;
+                uint32_t green = std::min(960u, g * 24 + b * 8) >> 2;
+                uint32_t blue = std::min(960u, r * 6 + g * 4 + b * 22) >> 2;
+                entries[index] = red | green << 8 | blue << 16;
+            }
+        }
+    };
+}
+
+int FrameScaler::factor(ScaleFilter filter) {
+    switch (filter) {
+    case ScaleFilter::Nearest2x: return 2;
+    case ScaleFilter::Nearest3x: return 3;
+    case ScaleFilter::Nearest4x: return 4;
+    case ScaleFilter::Scale2x: return 2;
+    case ScaleFilter::Scale3x: return 3;
+    case ScaleFilter::Scale4x: return 4;
+    case ScaleFilter::Hq2x: return 2;
+    default: return 1;
+    }
+}
+
+const char* FrameScaler::name(ScaleFilter filter) {
+    switch (filter) {
+    case ScaleFilter::Nearest2x: return "Nearest 2x";
+    case ScaleFilter::Nearest3x: return "Nearest 3x";
+    case ScaleFilter::Nearest4x: return "Nearest 4x";
+    case ScaleFilter::Scale2x: return "Scale2x";
+    case ScaleFilter::Scale3x: return "Scale3x";
+    case ScaleFilter::Scale4x: return "Scale4x";
+    case ScaleFilter::Hq2x: return "Hq2x";
+    default: return "None";
+    }
+}
+
+const uint32_t* FrameScaler::process(const uint32_t* pixels, int width, int height, ScaleFilter filter, bool color_correction) {
+    if (color_correction) {
+        corrected_.assign(pixels, pixels + static_cast<size_t>(width) * height);
+        correctColors(corrected_.data(), corrected_.size());
+        pixels = corrected_.data();
+    }
+    return scale(pixels, width, height, filter, output_);
+}
+
+const uint32_t* FrameScaler::scale(const uint32_t* pixels, int width, int height, ScaleFilter filter, std::vector<uint32_t>& out) {
+    int scale_factor = factor(filter);
+    output_width_ = width * scale_factor;
+    output_height_ = height * scale_factor;
+    if (scale_factor == 1) return pixels;
+    out.resize(static_cast<size_t>(output_width_) * output_height_);
+
+    const size_t out_width = static_cast<size_t>(output_width_);
+    const int padded_width = width + 2;
+    auto paddedRow = [&](const std::vector<uint32_t>& buffer, int y) { return buffer.data() + (y + 1) * padded_width + 1; };
+
+    switch (filter) {
+    case ScaleFilter::Nearest2x:
+    case ScaleFilter::Nearest3x:
+    case ScaleFilter::Nearest4x:
+        for (int y = 0; y < height; ++y) {
+            uint32_t* first = &out[y * scale_factor * out_width];
+            nearestRow(pixels + y * width, width, scale_factor, first);
+            for (int i = 1; i < scale_factor; ++i) std::memcpy(first + i * out_width, first, out_width * sizeof(uint32_t));
+        }
+        break;
+    case ScaleFilter::Scale2x:
+        pad(pixels, width, height);
+        for (int y = 0; y < height; ++y) {
+            uint32_t* top = &out[2 * y * out_width];
+            scale2xRow(paddedRow(padded_, y - 1), paddedRow(padded_, y), paddedRow(padded_, y + 1), width, top, top + out_width);
+        }
+        break;
+    case ScaleFilter::Scale3x:
+        pad(pixels, width, height);
+        for (int y = 0; y < height; ++y) {
+            uint32_t* top = &out[3 * y * out_width];
+            scale3xRow(paddedRow(padded_, y - 1), paddedRow(padded_, y), paddedRow(padded_, y + 1), width,
+                top, top + out_width, top + 2 * out_width);
+        }
+        break;
+    case ScaleFilter::Scale4x:
+        scale(pixels, width, height, ScaleFilter::Scale2x, intermediate_);
+        scale(intermediate_.data(), width * 2, height * 2, ScaleFilter::Scale2x, out);
+        output_width_ = width * scale_factor;
+        output_height_ = height * scale_factor;
+        break;
+    case ScaleFilter::Hq2x:
+        pad(pixels, width, height);
+        keys_.resize(padded_.size());
+        for (size_t i = 0; i < padded_.size(); ++i) keys_[i] = yuvKey(padded_[i]);
+        for (int y = 0; y < height; ++y) {
+            uint32_t* top = &out[2 * y * out_width];
+            hq2xRow(paddedRow(padded_, y - 1), paddedRow(padded_, y), paddedRow(padded_, y + 1),
+                paddedRow(keys_, y - 1), paddedRow(keys_, y), paddedRow(keys_, y + 1), width, top, top + out_width);
+        }
+        break;
+    default:
+        break;
+    }
+    return out.data();
+}
+
+void FrameScaler::pad(const uint32_t* pixels, int width, int height) {
+    const int padded_width = width + 2;
+    padded_.resize(static_cast<size_t>(padded_width) * (height + 2));
+    for (int y = -1; y <= height; ++y) {
+        const uint32_t* row = pixels + std::min(std::max(y, 0), height - 1) * width;
+        uint32_t* out = &padded_[(y + 1) * padded_width];
+        out[0] = row[0];
+        std::memcpy(out + 1, row, width * sizeof(uint32_t));
+        out[width + 1] = row[width - 1];
+    }
+}
+
+void FrameScaler::correctColors(uint32_t* pixels, size_t count) {
+    // A gather is the whole cost here, so there is no SIMD path: SSE2 has no gather, and the
+    // table (128 KiB) is read at cache speed either way.
+    static const ColorCorrectionTable table;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t pixel = pixels[i];
+        uint32_t index = ((pixel >> 3) & 0x1F) | ((pixel >> 6) & 0x3E0) | ((pixel >> 9) & 0x7C00);
+        pixels[i] = table.entries[index] | (pixel & 0xFF000000);
+    }
+}
@@ -0,0 +1,71 @@
+#include "Serial.h"
+#include "Bus.h"
+
+Serial::Serial(Bus& bus) : bus_(bus) {
+    reset();
+}
+
+void Serial::reset() {
+    data_ = 0x00;
+    control_ = 0x00;
+    bus_.scheduler().cancel(SchedulerEvent::SerialTransfer);
+}
+
+void Serial::saveState(State& state) const {
+    state.data = data_;
+    state.control = control_;
+}
+
+void Serial::loadState(const State& state) {
+    data_ = state.data;
+    control_ = state.control;
+}
+
+uint8_t Serial::read(uint16_t address) const {
+    switch (address) {
+    case 0xFF01: return data_;
+    case 0xFF02: return static_cast<uint8_t>(control_ | (bus_.cgbMode() ? 0x7C : 0x7E));
+    default: return 0xFF;
+    }
+}
+
+void Serial::write(uint16_t address, uint8_t value) {
+    if (address == 0xFF01) {
+        data_ = value;
+        return;
+    }
+    if (address != 0xFF02) return;
+
+    bool was_clocking = transferActive() && internalClock();
+    control_ = value & (bus_.cgbMode() ? 0x83 : 0x81);
+    Scheduler& scheduler = bus_.scheduler();
+    if (!transferActive() || !internalClock()) {
+        scheduler.cancel(SchedulerEvent::SerialTransfer);
+        if (was_clocking && link_) link_->cancelTransfer(link_side_);
+        return;
+    }
+    uint32_t bit_cycles = (control_ & 0x02) ? FAST_BIT_CYCLES : BIT_CYCLES;
+    uint64_t end = scheduler.timeAtCpuClock(scheduler.cpuNow() + 8 * bit_cycles);
+    scheduler.schedule(SchedulerEvent::SerialTransfer, end);
+    // Posted now so the other side knows to stop at `end` rather than run past it.
+    if (link_) link_->beginTransfer(link_side_, data_, end);
+}
+
+void Serial::onTransferEvent() {
+    if (!transferActive() || !internalClock()) return;
+    uint8_t value = link_ ? link_->finishTransfer(link_side_) : 0xFF;
+    completeTransfer(value);
+}
+
+uint8_t Serial::receive(uint8_t value) {
+    if (!transferActive() || internalClock()) return 0xFF;
+    uint8_t sent = data_;
+    completeTransfer(value);
+    return sent;
+}
+
+void Serial::completeTransfer(uint8_t value) {
+    data_ = value;
+    control_ &= 0x7F;
+    bus_.requestInterrupt(Bus::INTERRUPT_SERIAL);
+}
@@ -0,0 +1,25 @@
+#include "TileCache.h"
+
+TileCache::TileCache() {
+    invalidateAll();
+}
+
+void TileCache::invalidateAll() {
+    for (auto& bank : dirty_) bank.fill(1);
+}
+
+void TileCache::decode(const uint8_t* bank_data, int bank, int tile) {
+    const uint8_t* source = bank_data + tile * 16;
+    Tile& decoded = tiles_[bank][tile];
+    for (int row = 0; row < 8; ++row) {
+        uint8_t low = source[row * 2];
+        uint8_t high = source[row * 2 + 1];
+        for (int x = 0; x < 8; ++x) {
+            int bit = 7 - x;
+            uint8_t index = static_cast<uint8_t>(((low >> bit) & 1) | (((high >> bit) & 1) << 1));
+            decoded.pixels[row * 8 + x] = index;
+            decoded.flipped[row * 8 + (7 - x)] = index;
+        }
+    }
+    dirty_[bank][tile] = 0;
+}
@@ -0,0 +1,109 @@
+#include "Timer.h"
+#include "Bus.h"
+
+Timer::Timer(Bus& bus) : bus_(bus) {
+    reset();
+}
+
+void Timer::reset() {
+    // Internal counter value left behind by the DMG boot ROM.
+    div_epoch_ = bus_.scheduler().cpuNow() - 0xABCC;
+    tima_last_update_ = bus_.scheduler().cpuNow();
+    tima_ = 0;
+    tma_ = 0;
+    tac_ = 0xF8;
+    bus_.scheduler().cancel(SchedulerEvent::TimerOverflow);
+}
+
+void Timer::saveState(State& state) const {
+    state.div_epoch = div_epoch_;
+    state.tima_last_update = tima_last_update_;
+    state.tima = tima_;
+    state.tma = tma_;
+    state.tac = tac_;
+}
+
+void Timer::loadState(const State& state) {
+    div_epoch_ = state.div_epoch;
+    tima_last_update_ = state.tima_last_update;
+    tima_ = state.tima;
+    tma_ = state.tma;
+    tac_ = state.tac;
+}
+
+int Timer::periodShift() const {
+    static const int shifts[4] = { 10, 4, 6, 8 };
+    return shifts[tac_ & 0x03];
+}
+
+void Timer::catchUpTima() {
+    uint64_t now = bus_.scheduler().cpuNow();
+    if (isEnabled()) {
+        int shift = periodShift();
+        uint64_t ticks = (internalCounter(now) >> shift) - (internalCounter(tima_last_update_) >> shift);
+        uint64_t total = tima_ + ticks;
+        if (total > 0xFF) {
+            // Overflowed between instruction boundaries; reload from TMA and keep counting.
+            uint64_t span = 0x100 - tma_;
+            tima_ = static_cast<uint8_t>(tma_ + (total - 0x100) % span);
+            bus_.requestInterrupt(Bus::INTERRUPT_TIMER);
+        }
+        else {
+            tima_ = static_cast<uint8_t>(total);
+        }
+    }
+    tima_last_update_ = now;
+}
+
+void Timer::scheduleOverflow() {
+    if (!isEnabled()) {
+        bus_.scheduler().cancel(SchedulerEvent::TimerOverflow);
+        return;
+    }
+    int shift = periodShift();
+    uint64_t ticks_to_overflow = 0x100 - tima_;
+    uint64_t overflow_counter = ((internalCounter(tima_last_update_) >> shift) + ticks_to_overflow) << shift;
+    Scheduler& scheduler = bus_.scheduler();
+    scheduler.schedule(SchedulerEvent::TimerOverflow, scheduler.timeAtCpuClock(div_epoch_ + overflow_counter));
+}
+
+void Timer::onOverflowEvent() {
+    catchUpTima();
+    scheduleOverflow();
+}
+
+uint8_t Timer::read(uint16_t address) {
+    const Scheduler& scheduler = bus_.scheduler();
+    switch (address) {
+    case 0xFF04: {
+        uint64_t now = scheduler.cpuNow();
+        uint64_t counter = internalCounter(now);
+        bus_.notePolledValueChangeTime(scheduler.timeAtCpuClock(now + (0x100 - (counter & 0xFF))));
+        return static_cast<uint8_t>(counter >> 8);
+    }
+    case 0xFF05:
+        catchUpTima();
+        if (isEnabled()) {
+            uint64_t period = 1ull << periodShift();
+            uint64_t now = scheduler.cpuNow();
+            uint64_t counter = internalCounter(now);
+            bus_.notePolledValueChangeTime(scheduler.timeAtCpuClock(now + (period - (counter & (period - 1)))));
+        }
+        return tima_;
+    case 0xFF06: return tma_;
+    case 0xFF07: return tac_ | 0xF8;
+    default: return 0xFF;
+    }
+}
+
+void Timer::write(uint16_t address, uint8_t value) {
+    catchUpTima();
+    switch (address) {
+    case 0xFF04: div_epoch_ = bus_.scheduler().cpuNow(); tima_last_update_ = div_epoch_; break;
+    case 0xFF05: tima_ = value; break;
+    case 0xFF06: tma_ = value; break;
+    case 0xFF07: tac_ = value & 0x07; break;
+    default: return;
+    }
+    scheduleOverflow();
+}